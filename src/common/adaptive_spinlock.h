@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+ * Spin locks for host threads which may be sharing a physical CPU.
+ *
+ * A lock is a 32 bit word which is 0 when free and holds a non-zero owner
+ * value when taken. Waiters spin with pause and an exponential backoff, then
+ * yield, and finally sleep on a futex until the lock is released. This keeps
+ * a waiter from burning its whole time slice when the owner was preempted.
+ *
+ * The sleeping waiters are kept in a table hashed by the address of the lock
+ * word, so any existing word can be used, including one in guest memory.
+ */
+
+struct SpinLockStats
+{
+   //! name must outlive the stats, usually it is a string literal
+   SpinLockStats(const char *name);
+
+   const char *name;
+
+   //! Number of times the lock was taken
+   std::atomic<uint64_t> acquires { 0 };
+
+   //! Number of times the lock was already held when someone tried to take it
+   std::atomic<uint64_t> contended { 0 };
+
+   //! Number of times a waiter gave up its time slice
+   std::atomic<uint64_t> yields { 0 };
+
+   //! Number of times a waiter went to sleep until the lock was released
+   std::atomic<uint64_t> sleeps { 0 };
+
+   SpinLockStats *next = nullptr;
+};
+
+// Escalating wait used between attempts to take a lock
+class SpinWait
+{
+public:
+   //! Waits a little longer than last time, or until word looks free
+   void
+   wait(std::atomic<uint32_t> &word,
+        SpinLockStats &stats);
+
+private:
+   unsigned mRound = 0;
+};
+
+inline bool
+spinlock_try_acquire(std::atomic<uint32_t> &word,
+                     uint32_t owner,
+                     SpinLockStats &stats)
+{
+   auto expected = uint32_t { 0 };
+
+   if (word.load(std::memory_order_relaxed) != 0
+    || !word.compare_exchange_strong(expected, owner, std::memory_order_acquire, std::memory_order_relaxed)) {
+      return false;
+   }
+
+   stats.acquires.fetch_add(1, std::memory_order_relaxed);
+   return true;
+}
+
+void
+spinlock_acquire(std::atomic<uint32_t> &word,
+                 uint32_t owner,
+                 SpinLockStats &stats);
+
+//! Releases the lock, waking anyone asleep on it, and returns the old owner
+uint32_t
+spinlock_release(std::atomic<uint32_t> &word);
+
+//! One line for each lock which has been contended, empty if there are none
+std::string
+spinlock_format_stats();
@@ -199,6 +199,21 @@ bit_scan_reverse(unsigned long *out_position, uint32_t bits)
 #endif
 }
 
+inline bool
+bit_scan_forward(unsigned long *out_position, uint32_t bits)
+{
+#ifdef PLATFORM_WINDOWS
+   return !!_BitScanForward(out_position, bits);
+#elif defined(PLATFORM_POSIX)
+   if (bits == 0) {
+      return false;
+   }
+
+   *out_position = __builtin_ctz(bits);
+   return true;
+#endif
+}
+
 #ifdef PLATFORM_WINDOWS
 #define bit_rotate_left _rotl
 #else
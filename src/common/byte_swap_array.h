@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Bulk endian conversion of arrays.
+ *
+ * These pick an SSSE3 or AVX2 implementation at runtime depending on what the
+ * host supports, falling back to byte_swap one element at a time. Unless
+ * stated otherwise dst and src may be the same array but must not otherwise
+ * overlap.
+ */
+
+// Matches the values of gqr.ld_type so they can be used directly
+enum class QuantizedType : uint32_t
+{
+   Floating    = 0,
+   Unsigned8   = 4,
+   Unsigned16  = 5,
+   Signed8     = 6,
+   Signed16    = 7
+};
+
+enum class ByteSwapPath
+{
+   Scalar,
+   SSSE3,
+   AVX2
+};
+
+// Limits the routines below to at most the given path, for testing. Returns
+//  the path which will actually be used on this host. F16C is only used along
+//  with AVX2. Not thread safe.
+ByteSwapPath
+byte_swap_set_max_path(ByteSwapPath path);
+
+void
+byte_swap_copy(uint16_t *dst,
+               const uint16_t *src,
+               size_t count);
+
+void
+byte_swap_copy(uint32_t *dst,
+               const uint32_t *src,
+               size_t count);
+
+void
+byte_swap_copy(uint64_t *dst,
+               const uint64_t *src,
+               size_t count);
+
+template<typename Type>
+inline void
+byte_swap_inplace(Type *data,
+                  size_t count)
+{
+   byte_swap_copy(data, data, count);
+}
+
+// Converts big endian half floats to host floats, dst must not overlap src
+void
+byte_swap_half_to_float(float *dst,
+                        const uint16_t *src,
+                        size_t count);
+
+// Converts big endian quantized values to host floats the same way psq_l
+//  does, scale is the 6 bit signed gqr.ld_scale. dst must not overlap src.
+void
+byte_swap_dequantize(float *dst,
+                     const void *src,
+                     QuantizedType type,
+                     uint32_t scale,
+                     size_t count);
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * zlib compatible checksums.
+ *
+ * These give exactly the same results as zlib's crc32 and adler32, including
+ * how the running value is passed in, but use PCLMULQDQ folding and SSSE3
+ * when the host supports them. Initial values are 0 for crc32 and 1 for
+ * adler32, as with zlib.
+ */
+
+uint32_t
+checksum_crc32(uint32_t crc,
+               const uint8_t *data,
+               size_t size);
+
+uint32_t
+checksum_adler32(uint32_t adler,
+                 const uint8_t *data,
+                 size_t size);
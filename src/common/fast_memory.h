@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+
+/*
+ * Bulk memory operations for guest buffers.
+ *
+ * Small operations go straight to the C library. Copies and fills larger than
+ * the host caches use non-temporal stores instead so that streaming a large
+ * buffer does not evict everything else the emulator is working on.
+ */
+
+void
+fast_memcpy(void *dst,
+            const void *src,
+            size_t size);
+
+void
+fast_memmove(void *dst,
+             const void *src,
+             size_t size);
+
+void
+fast_memset(void *dst,
+            int value,
+            size_t size);
@@ -1,5 +1,7 @@
 #pragma once
+#include <cstdint>
 #include <functional>
+#include <vector>
 
 namespace platform
 {
@@ -20,4 +22,14 @@ destroyFiber(Fiber *fiber);
 void
 swapToFiber(Fiber *current, Fiber *target);
 
+//! Copies the saved registers and stack of a fiber which is not running,
+//  returns false if this is not supported.
+bool
+saveFiberState(Fiber *fiber, std::vector<uint8_t> &state);
+
+//! Puts back state from saveFiberState, so the next switch to the fiber
+//  resumes it from where it was when the state was saved.
+bool
+restoreFiberState(Fiber *fiber, const std::vector<uint8_t> &state);
+
 } // namespace platform
@@ -1,9 +1,19 @@
 #pragma once
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 namespace platform
 {
 
+struct MemorySnapshot;
+
+struct MemoryRange
+{
+   size_t address;
+   size_t size;
+};
+
 enum class ProtectFlags
 {
    NoAccess,
@@ -28,4 +38,42 @@ uncommitMemory(size_t address, size_t size);
 bool
 protectMemory(size_t address, size_t size, ProtectFlags flags);
 
+//! Prefer the given NUMA node for pages of a range when they are first used
+bool
+bindMemoryToNode(size_t address, size_t size, uint32_t node);
+
+//! Size of an explicit huge page, 0 if they are not supported
+size_t
+getHugePageSize();
+
+//! Commits a reserved range with explicit huge pages, the range must be aligned
+//  to getHugePageSize. On failure the range is left reserved but uncommitted.
+//  Protection can then only be changed a whole huge page at a time.
+bool
+commitHugeMemory(size_t address, size_t size, ProtectFlags flags = ProtectFlags::ReadWrite);
+
+//! Asks for a committed range to be backed by transparent huge pages where
+//  possible, protection can still be changed a page at a time.
+bool
+adviseHugePages(size_t address, size_t size);
+
+//! Starts a copy of the given page aligned ranges in the background. The copy
+//  sees the memory as it is at the time of the call, writes made afterwards
+//  are not included. Returns nullptr if snapshots are not supported.
+MemorySnapshot *
+captureMemory(const std::vector<MemoryRange> &ranges);
+
+//! Waits for the copy to finish, returns false if it could not be completed
+bool
+waitMemorySnapshot(MemorySnapshot *snapshot);
+
+//! Maps a finished copy back over the ranges it was taken from. Pages are read
+//  in lazily and writes to them stay private, so the snapshot can be restored
+//  again later. The ranges are left read/write.
+bool
+restoreMemory(MemorySnapshot *snapshot);
+
+void
+freeMemorySnapshot(MemorySnapshot *snapshot);
+
 }
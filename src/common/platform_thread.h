@@ -1,10 +1,40 @@
 #pragma once
+#include <cstdint>
 #include <thread>
 #include <string>
+#include <vector>
 
 namespace platform
 {
 
+struct HostProcessor
+{
+   //! Logical processor number used by the OS
+   uint32_t id;
+
+   //! Physical core within the package, SMT siblings share the same core
+   uint32_t core;
+
+   //! Physical package (socket)
+   uint32_t package;
+
+   //! NUMA node
+   uint32_t node;
+};
+
+struct ThreadPlacement
+{
+   //! Logical processor for each thread which gets a physical core to itself,
+   //  empty if the host does not have enough physical cores.
+   std::vector<uint32_t> pinned;
+
+   //! Logical processors shared by every other thread
+   std::vector<uint32_t> shared;
+
+   //! NUMA node everything was placed on, or -1 if not restricted
+   int node = -1;
+};
+
 void
 setThreadName(std::thread *thread,
 			  const std::string &name);
@@ -12,4 +42,28 @@ setThreadName(std::thread *thread,
 void
 exitThread(int result);
 
+//! Returns every logical processor the process may run on, empty if the
+//  topology could not be read.
+std::vector<HostProcessor>
+getHostProcessors();
+
+//! Restricts a thread to the given logical processors, a null thread means
+//  the calling thread.
+bool
+setThreadAffinity(std::thread *thread,
+                  const std::vector<uint32_t> &processors);
+
+//! Gives a thread a real-time priority if the process is permitted to, a null
+//  thread means the calling thread.
+bool
+setThreadRealtimePriority(std::thread *thread);
+
+//! Gives numPinned threads a distinct physical core each, avoiding SMT
+//  siblings, and leaves the remaining processors for everything else. When
+//  node is not -1 only processors on that NUMA node are used.
+ThreadPlacement
+planThreadPlacement(const std::vector<HostProcessor> &processors,
+                    size_t numPinned,
+                    int node);
+
 } // namespace platform
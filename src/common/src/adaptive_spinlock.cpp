@@ -0,0 +1,194 @@
+#include "adaptive_spinlock.h"
+#include "platform.h"
+#include <array>
+#include <chrono>
+#include <spdlog/fmt/fmt.h>
+#include <thread>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#define SPIN_PAUSE() _mm_pause()
+#else
+#define SPIN_PAUSE()
+#endif
+
+#ifdef PLATFORM_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+// Rounds of pause, each twice as long as the last, before starting to yield
+static const unsigned
+SpinRounds = 10;
+
+// Rounds of yielding before starting to sleep
+static const unsigned
+YieldRounds = 8;
+
+// Longest a waiter sleeps before checking the lock again, this only matters
+//  if a wake up is somehow missed.
+static const std::chrono::milliseconds
+MaxSleep { 1 };
+
+struct alignas(64) ParkingBucket
+{
+   //! Number of threads asleep, or about to be, on locks in this bucket
+   std::atomic<uint32_t> waiters { 0 };
+
+   //! Incremented by every release which needs to wake waiters
+   std::atomic<uint32_t> sequence { 0 };
+
+#ifndef PLATFORM_LINUX
+   std::mutex mutex;
+   std::condition_variable condition;
+#endif
+};
+
+static std::array<ParkingBucket, 64>
+sParkingBuckets;
+
+static std::atomic<SpinLockStats *>
+sStatsList { nullptr };
+
+static ParkingBucket &
+getBucket(const std::atomic<uint32_t> &word)
+{
+   auto hash = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&word) >> 2) * 0x9E3779B97F4A7C15ull;
+   return sParkingBuckets[(hash >> 58) % sParkingBuckets.size()];
+}
+
+static void
+sleepOnBucket(ParkingBucket &bucket,
+              uint32_t sequence)
+{
+#ifdef PLATFORM_LINUX
+   auto timeout = timespec { };
+   timeout.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(MaxSleep).count();
+   syscall(SYS_futex, reinterpret_cast<int *>(&bucket.sequence), FUTEX_WAIT_PRIVATE, sequence, &timeout, nullptr, 0);
+#else
+   std::unique_lock<std::mutex> lock { bucket.mutex };
+   bucket.condition.wait_for(lock, MaxSleep, [&]() {
+      return bucket.sequence.load() != sequence;
+   });
+#endif
+}
+
+static void
+wakeBucket(ParkingBucket &bucket)
+{
+   bucket.sequence.fetch_add(1);
+
+#ifdef PLATFORM_LINUX
+   syscall(SYS_futex, reinterpret_cast<int *>(&bucket.sequence), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#else
+   {
+      // Taking the mutex makes sure a waiter is either already asleep or
+      //  will see the new sequence.
+      std::lock_guard<std::mutex> lock { bucket.mutex };
+   }
+
+   bucket.condition.notify_all();
+#endif
+}
+
+SpinLockStats::SpinLockStats(const char *name) :
+   name(name)
+{
+   next = sStatsList.load();
+
+   while (!sStatsList.compare_exchange_weak(next, this)) {
+   }
+}
+
+void
+SpinWait::wait(std::atomic<uint32_t> &word,
+               SpinLockStats &stats)
+{
+   auto round = mRound++;
+
+   if (round < SpinRounds) {
+      for (auto i = 0u; i < (1u << round); ++i) {
+         SPIN_PAUSE();
+
+         if (word.load(std::memory_order_relaxed) == 0) {
+            break;
+         }
+      }
+   } else if (round < SpinRounds + YieldRounds) {
+      stats.yields.fetch_add(1, std::memory_order_relaxed);
+      std::this_thread::yield();
+   } else {
+      auto &bucket = getBucket(word);
+      bucket.waiters.fetch_add(1);
+
+      // The release clears the word before checking for waiters, so either
+      //  we see it free here or it sees us and changes the sequence.
+      auto sequence = bucket.sequence.load();
+
+      if (word.load() != 0) {
+         stats.sleeps.fetch_add(1, std::memory_order_relaxed);
+         sleepOnBucket(bucket, sequence);
+      }
+
+      bucket.waiters.fetch_sub(1);
+   }
+}
+
+void
+spinlock_acquire(std::atomic<uint32_t> &word,
+                 uint32_t owner,
+                 SpinLockStats &stats)
+{
+   if (spinlock_try_acquire(word, owner, stats)) {
+      return;
+   }
+
+   stats.contended.fetch_add(1, std::memory_order_relaxed);
+
+   auto spinWait = SpinWait { };
+
+   do {
+      spinWait.wait(word, stats);
+   } while (!spinlock_try_acquire(word, owner, stats));
+}
+
+uint32_t
+spinlock_release(std::atomic<uint32_t> &word)
+{
+   auto owner = word.exchange(0);
+   auto &bucket = getBucket(word);
+
+   if (bucket.waiters.load() != 0) {
+      wakeBucket(bucket);
+   }
+
+   return owner;
+}
+
+std::string
+spinlock_format_stats()
+{
+   fmt::MemoryWriter out;
+
+   for (auto stats = sStatsList.load(); stats; stats = stats->next) {
+      auto contended = stats->contended.load();
+
+      if (!contended) {
+         continue;
+      }
+
+      out.write("{}: {} acquired, {} contended, {} yields, {} sleeps\n",
+                stats->name,
+                stats->acquires.load(),
+                contended,
+                stats->yields.load(),
+                stats->sleeps.load());
+   }
+
+   return out.str();
+}
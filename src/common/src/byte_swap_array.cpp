@@ -0,0 +1,428 @@
+#include "byte_swap_array.h"
+#include "bit_cast.h"
+#include "byte_swap.h"
+#include "platform.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define BYTE_SWAP_ARRAY_X86
+
+#ifdef PLATFORM_WINDOWS
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include <immintrin.h>
+#endif
+
+// MSVC allows any intrinsic anywhere, GCC and clang need to be told which
+//  functions are allowed to use which instruction sets.
+#if defined(_MSC_VER)
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#define TARGET_F16C
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_F16C __attribute__((target("avx,f16c")))
+#endif
+
+#ifdef BYTE_SWAP_ARRAY_X86
+
+struct HostFeatures
+{
+   bool ssse3 = false;
+   bool avx2 = false;
+   bool f16c = false;
+};
+
+static void
+hostCpuid(uint32_t leaf,
+          uint32_t subleaf,
+          uint32_t info[4])
+{
+#ifdef PLATFORM_WINDOWS
+   int cpuInfo[4];
+   __cpuidex(cpuInfo, leaf, subleaf);
+
+   for (auto i = 0; i < 4; ++i) {
+      info[i] = static_cast<uint32_t>(cpuInfo[i]);
+   }
+#else
+   __cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+static HostFeatures
+detectHostFeatures()
+{
+   HostFeatures features;
+   uint32_t info[4];
+
+   hostCpuid(0, 0, info);
+   auto maxLeaf = info[0];
+
+   hostCpuid(1, 0, info);
+   features.ssse3 = !!(info[2] & (1 << 9));
+
+   // AVX state has to be enabled by the OS before we can use ymm registers
+   auto osxsave = !!(info[2] & (1 << 27));
+   auto avx = !!(info[2] & (1 << 28));
+   auto f16c = !!(info[2] & (1 << 29));
+   auto osAvx = false;
+
+   if (osxsave) {
+#ifdef PLATFORM_WINDOWS
+      auto xcr0 = _xgetbv(0);
+#else
+      uint32_t eax, edx;
+      __asm__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+      auto xcr0 = (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+      osAvx = (xcr0 & 6) == 6;
+   }
+
+   features.f16c = avx && f16c && osAvx;
+
+   if (maxLeaf >= 7 && osAvx) {
+      hostCpuid(7, 0, info);
+      features.avx2 = !!(info[1] & (1 << 5));
+   }
+
+   return features;
+}
+
+// Only changed by byte_swap_set_max_path
+static HostFeatures &
+getHostFeatures()
+{
+   static HostFeatures features = detectHostFeatures();
+   return features;
+}
+
+// pshufb masks which reverse each element, repeated for both AVX2 lanes
+alignas(32) static const uint8_t
+SwapMask16[32] = {
+   1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+   1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+};
+
+alignas(32) static const uint8_t
+SwapMask32[32] = {
+   3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+   3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+};
+
+alignas(32) static const uint8_t
+SwapMask64[32] = {
+   7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+   7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+};
+
+// Returns the number of bytes swapped, always a multiple of 16
+TARGET_SSSE3 static size_t
+swapBlocksSSSE3(uint8_t *dst,
+                const uint8_t *src,
+                size_t size,
+                const uint8_t *swapMask)
+{
+   auto mask = _mm_load_si128(reinterpret_cast<const __m128i *>(swapMask));
+   auto pos = size_t { 0 };
+
+   for (; pos + 16 <= size; pos += 16) {
+      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + pos));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + pos), _mm_shuffle_epi8(v, mask));
+   }
+
+   return pos;
+}
+
+// Returns the number of bytes swapped, always a multiple of 16
+TARGET_AVX2 static size_t
+swapBlocksAVX2(uint8_t *dst,
+               const uint8_t *src,
+               size_t size,
+               const uint8_t *swapMask)
+{
+   auto mask = _mm256_load_si256(reinterpret_cast<const __m256i *>(swapMask));
+   auto pos = size_t { 0 };
+
+   for (; pos + 64 <= size; pos += 64) {
+      auto v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + pos));
+      auto v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + pos + 32));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + pos), _mm256_shuffle_epi8(v0, mask));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + pos + 32), _mm256_shuffle_epi8(v1, mask));
+   }
+
+   for (; pos + 16 <= size; pos += 16) {
+      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + pos));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + pos), _mm_shuffle_epi8(v, _mm256_castsi256_si128(mask)));
+   }
+
+   return pos;
+}
+
+TARGET_F16C static size_t
+halfToFloatF16C(float *dst,
+                const uint16_t *src,
+                size_t count)
+{
+   auto mask = _mm_load_si128(reinterpret_cast<const __m128i *>(SwapMask16));
+   auto i = size_t { 0 };
+
+   for (; i + 8 <= count; i += 8) {
+      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+      _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_shuffle_epi8(v, mask)));
+   }
+
+   return i;
+}
+
+// Returns the number of values converted
+TARGET_SSSE3 static size_t
+dequantizeSSSE3(float *dst,
+                const void *src,
+                QuantizedType type,
+                float factor,
+                size_t count)
+{
+   auto scale = _mm_set1_ps(factor);
+   auto zero = _mm_setzero_si128();
+   auto bytes = reinterpret_cast<const uint8_t *>(src);
+   auto i = size_t { 0 };
+
+   auto store = [&](size_t index, __m128i values) {
+      _mm_storeu_ps(dst + index, _mm_mul_ps(_mm_cvtepi32_ps(values), scale));
+   };
+
+   switch (type) {
+   case QuantizedType::Unsigned16:
+   case QuantizedType::Signed16:
+   {
+      auto mask = _mm_load_si128(reinterpret_cast<const __m128i *>(SwapMask16));
+
+      for (; i + 8 <= count; i += 8) {
+         auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i * 2));
+         v = _mm_shuffle_epi8(v, mask);
+
+         if (type == QuantizedType::Signed16) {
+            // Put each value in the top half and shift it down to sign extend
+            store(i + 0, _mm_srai_epi32(_mm_unpacklo_epi16(zero, v), 16));
+            store(i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(zero, v), 16));
+         } else {
+            store(i + 0, _mm_unpacklo_epi16(v, zero));
+            store(i + 4, _mm_unpackhi_epi16(v, zero));
+         }
+      }
+      break;
+   }
+   case QuantizedType::Unsigned8:
+   case QuantizedType::Signed8:
+   {
+      for (; i + 16 <= count; i += 16) {
+         auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+
+         if (type == QuantizedType::Signed8) {
+            auto lo = _mm_unpacklo_epi8(zero, v);
+            auto hi = _mm_unpackhi_epi8(zero, v);
+            store(i + 0, _mm_srai_epi32(_mm_unpacklo_epi16(zero, lo), 24));
+            store(i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(zero, lo), 24));
+            store(i + 8, _mm_srai_epi32(_mm_unpacklo_epi16(zero, hi), 24));
+            store(i + 12, _mm_srai_epi32(_mm_unpackhi_epi16(zero, hi), 24));
+         } else {
+            auto lo = _mm_unpacklo_epi8(v, zero);
+            auto hi = _mm_unpackhi_epi8(v, zero);
+            store(i + 0, _mm_unpacklo_epi16(lo, zero));
+            store(i + 4, _mm_unpackhi_epi16(lo, zero));
+            store(i + 8, _mm_unpacklo_epi16(hi, zero));
+            store(i + 12, _mm_unpackhi_epi16(hi, zero));
+         }
+      }
+      break;
+   }
+   default:
+      break;
+   }
+
+   return i;
+}
+
+#endif // BYTE_SWAP_ARRAY_X86
+
+template<typename Type>
+static void
+swapCopy(Type *dst,
+         const Type *src,
+         size_t count,
+         const uint8_t *swapMask)
+{
+   auto i = size_t { 0 };
+
+#ifdef BYTE_SWAP_ARRAY_X86
+   auto &features = getHostFeatures();
+   auto dstBytes = reinterpret_cast<uint8_t *>(dst);
+   auto srcBytes = reinterpret_cast<const uint8_t *>(src);
+
+   if (features.avx2) {
+      i = swapBlocksAVX2(dstBytes, srcBytes, count * sizeof(Type), swapMask) / sizeof(Type);
+   } else if (features.ssse3) {
+      i = swapBlocksSSSE3(dstBytes, srcBytes, count * sizeof(Type), swapMask) / sizeof(Type);
+   }
+#endif
+
+   for (; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
+
+ByteSwapPath
+byte_swap_set_max_path(ByteSwapPath path)
+{
+#ifdef BYTE_SWAP_ARRAY_X86
+   auto detected = detectHostFeatures();
+   auto &features = getHostFeatures();
+   features.ssse3 = detected.ssse3 && path >= ByteSwapPath::SSSE3;
+   features.avx2 = detected.avx2 && path >= ByteSwapPath::AVX2;
+   features.f16c = detected.f16c && path >= ByteSwapPath::AVX2;
+
+   if (features.avx2) {
+      return ByteSwapPath::AVX2;
+   } else if (features.ssse3) {
+      return ByteSwapPath::SSSE3;
+   }
+#endif
+
+   return ByteSwapPath::Scalar;
+}
+
+void
+byte_swap_copy(uint16_t *dst,
+               const uint16_t *src,
+               size_t count)
+{
+#ifdef BYTE_SWAP_ARRAY_X86
+   swapCopy(dst, src, count, SwapMask16);
+#else
+   swapCopy(dst, src, count, nullptr);
+#endif
+}
+
+void
+byte_swap_copy(uint32_t *dst,
+               const uint32_t *src,
+               size_t count)
+{
+#ifdef BYTE_SWAP_ARRAY_X86
+   swapCopy(dst, src, count, SwapMask32);
+#else
+   swapCopy(dst, src, count, nullptr);
+#endif
+}
+
+void
+byte_swap_copy(uint64_t *dst,
+               const uint64_t *src,
+               size_t count)
+{
+#ifdef BYTE_SWAP_ARRAY_X86
+   swapCopy(dst, src, count, SwapMask64);
+#else
+   swapCopy(dst, src, count, nullptr);
+#endif
+}
+
+// Matches F16C, which quiets signalling NaNs
+static float
+halfToFloat(uint16_t half)
+{
+   auto sign = static_cast<uint32_t>(half >> 15) << 31;
+   auto exponent = (half >> 10) & 0x1F;
+   auto mantissa = static_cast<uint32_t>(half & 0x3FF);
+
+   if (exponent == 0) {
+      // Zero or denormal, both are exact as a float
+      auto value = std::ldexp(static_cast<float>(mantissa), -24);
+      return sign ? -value : value;
+   } else if (exponent == 0x1F) {
+      if (mantissa) {
+         mantissa |= 0x200;
+      }
+
+      return bit_cast<float>(sign | 0x7F800000 | (mantissa << 13));
+   } else {
+      return bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+   }
+}
+
+void
+byte_swap_half_to_float(float *dst,
+                        const uint16_t *src,
+                        size_t count)
+{
+   auto i = size_t { 0 };
+
+#ifdef BYTE_SWAP_ARRAY_X86
+   if (getHostFeatures().f16c) {
+      i = halfToFloatF16C(dst, src, count);
+   }
+#endif
+
+   for (; i < count; ++i) {
+      dst[i] = halfToFloat(byte_swap(src[i]));
+   }
+}
+
+template<typename Type>
+static void
+dequantizeScalar(float *dst,
+                 const Type *src,
+                 float factor,
+                 size_t count)
+{
+   for (auto i = size_t { 0 }; i < count; ++i) {
+      dst[i] = static_cast<float>(byte_swap(src[i])) * factor;
+   }
+}
+
+void
+byte_swap_dequantize(float *dst,
+                     const void *src,
+                     QuantizedType type,
+                     uint32_t scale,
+                     size_t count)
+{
+   if (type == QuantizedType::Floating) {
+      byte_swap_copy(reinterpret_cast<uint32_t *>(dst), reinterpret_cast<const uint32_t *>(src), count);
+      return;
+   }
+
+   // Every integer type and scale gives an exactly representable float
+   auto exp = static_cast<int>(scale & 0x3F);
+   exp -= (exp & 32) << 1;
+   auto factor = std::ldexp(1.0f, -exp);
+   auto i = size_t { 0 };
+
+#ifdef BYTE_SWAP_ARRAY_X86
+   if (getHostFeatures().ssse3) {
+      i = dequantizeSSSE3(dst, src, type, factor, count);
+   }
+#endif
+
+   switch (type) {
+   case QuantizedType::Unsigned8:
+      dequantizeScalar(dst + i, reinterpret_cast<const uint8_t *>(src) + i, factor, count - i);
+      break;
+   case QuantizedType::Unsigned16:
+      dequantizeScalar(dst + i, reinterpret_cast<const uint16_t *>(src) + i, factor, count - i);
+      break;
+   case QuantizedType::Signed8:
+      dequantizeScalar(dst + i, reinterpret_cast<const int8_t *>(src) + i, factor, count - i);
+      break;
+   case QuantizedType::Signed16:
+      dequantizeScalar(dst + i, reinterpret_cast<const int16_t *>(src) + i, factor, count - i);
+      break;
+   default:
+      break;
+   }
+}
@@ -0,0 +1,319 @@
+#include "checksum.h"
+#include "platform.h"
+#include <array>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CHECKSUM_X86
+
+#ifdef PLATFORM_WINDOWS
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include <immintrin.h>
+#endif
+
+// MSVC allows any intrinsic anywhere, GCC and clang need to be told which
+//  functions are allowed to use which instruction sets.
+#if defined(_MSC_VER)
+#define TARGET_SSSE3
+#define TARGET_PCLMUL
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#endif
+
+// Largest number of bytes adler32 can sum before s2 may overflow 32 bits
+static const size_t
+AdlerMaxBlock = 5552;
+
+static const uint32_t
+AdlerBase = 65521;
+
+// Below this the SIMD setup costs more than it saves
+static const size_t
+SimdMinimumSize = 64;
+
+static std::array<uint32_t, 256>
+generateCrcTable()
+{
+   std::array<uint32_t, 256> table;
+
+   for (auto i = 0u; i < table.size(); ++i) {
+      auto crc = i;
+
+      for (auto j = 0; j < 8; ++j) {
+         crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+      }
+
+      table[i] = crc;
+   }
+
+   return table;
+}
+
+static uint32_t
+crc32Scalar(uint32_t crc,
+            const uint8_t *data,
+            size_t size)
+{
+   static const auto table = generateCrcTable();
+   crc = ~crc;
+
+   for (auto i = 0u; i < size; ++i) {
+      crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+   }
+
+   return ~crc;
+}
+
+static uint32_t
+adler32Scalar(uint32_t adler,
+              const uint8_t *data,
+              size_t size)
+{
+   auto s1 = adler & 0xFFFF;
+   auto s2 = adler >> 16;
+
+   while (size) {
+      auto block = size < AdlerMaxBlock ? size : AdlerMaxBlock;
+      size -= block;
+
+      for (auto i = 0u; i < block; ++i) {
+         s1 += data[i];
+         s2 += s1;
+      }
+
+      data += block;
+      s1 %= AdlerBase;
+      s2 %= AdlerBase;
+   }
+
+   return s1 | (s2 << 16);
+}
+
+#ifdef CHECKSUM_X86
+
+struct HostFeatures
+{
+   bool ssse3 = false;
+   bool pclmul = false;
+};
+
+static HostFeatures
+detectHostFeatures()
+{
+   HostFeatures features;
+   uint32_t info[4];
+
+#ifdef PLATFORM_WINDOWS
+   int cpuInfo[4];
+   __cpuid(cpuInfo, 1);
+
+   for (auto i = 0; i < 4; ++i) {
+      info[i] = static_cast<uint32_t>(cpuInfo[i]);
+   }
+#else
+   __cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+
+   auto sse41 = !!(info[2] & (1 << 19));
+   features.ssse3 = !!(info[2] & (1 << 9));
+   features.pclmul = sse41 && !!(info[2] & (1 << 1));
+   return features;
+}
+
+static const HostFeatures &
+getHostFeatures()
+{
+   static const HostFeatures features = detectHostFeatures();
+   return features;
+}
+
+/*
+ * CRC-32 by folding 64 bytes at a time with carry-less multiplies, then
+ * reducing to 32 bits with a Barrett reduction. The constants are powers of
+ * x modulo the bit reflected zlib polynomial, see Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ *
+ * size must be a multiple of 16 and at least 64, crc is not inverted.
+ */
+TARGET_PCLMUL static uint32_t
+crc32Pclmul(uint32_t crc,
+            const uint8_t *data,
+            size_t size)
+{
+   alignas(16) static const uint64_t k1k2[] = { 0x0154442BD4, 0x01C6E41596 };
+   alignas(16) static const uint64_t k3k4[] = { 0x01751997D0, 0x00CCAA009E };
+   alignas(16) static const uint64_t k5k0[] = { 0x0163CD6124, 0x0000000000 };
+   alignas(16) static const uint64_t poly[] = { 0x01DB710641, 0x01F7011641 };
+
+   auto x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x00));
+   auto x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x10));
+   auto x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x20));
+   auto x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x30));
+   x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+
+   auto k = _mm_load_si128(reinterpret_cast<const __m128i *>(k1k2));
+   data += 64;
+   size -= 64;
+
+   // Fold four blocks in parallel
+   for (; size >= 64; data += 64, size -= 64) {
+      auto x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+      auto x6 = _mm_clmulepi64_si128(x2, k, 0x00);
+      auto x7 = _mm_clmulepi64_si128(x3, k, 0x00);
+      auto x8 = _mm_clmulepi64_si128(x4, k, 0x00);
+
+      x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x00)));
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x10)));
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x20)));
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x30)));
+   }
+
+   // Fold the four blocks into one
+   k = _mm_load_si128(reinterpret_cast<const __m128i *>(k3k4));
+
+   for (auto next : { x2, x3, x4 }) {
+      auto lo = _mm_clmulepi64_si128(x1, k, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, next), lo);
+   }
+
+   // Fold in any remaining 16 byte blocks
+   for (; size >= 16; data += 16, size -= 16) {
+      auto lo = _mm_clmulepi64_si128(x1, k, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(data))), lo);
+   }
+
+   // Fold 128 bits down to 64
+   auto mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+   x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+   x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+   k = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(k5k0));
+   x2 = _mm_srli_si128(x1, 4);
+   x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   // Barrett reduction to 32 bits
+   k = _mm_load_si128(reinterpret_cast<const __m128i *>(poly));
+   x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x10);
+   x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), k, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+/*
+ * adler32 over 32 byte blocks, s1 is the sum of the bytes and s2 the sum of
+ * each byte weighted by its distance from the end of the block.
+ *
+ * Returns the checksum of the whole blocks, the caller handles the tail.
+ */
+TARGET_SSSE3 static uint32_t
+adler32Ssse3(uint32_t adler,
+             const uint8_t *data,
+             size_t blocks)
+{
+   static const size_t BlockSize = 32;
+   auto s1 = adler & 0xFFFF;
+   auto s2 = adler >> 16;
+
+   auto tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+   auto tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+   auto zero = _mm_setzero_si128();
+   auto ones = _mm_set1_epi16(1);
+
+   while (blocks) {
+      auto n = blocks < AdlerMaxBlock / BlockSize ? blocks : AdlerMaxBlock / BlockSize;
+      blocks -= n;
+
+      // vPrevS1 sums s1 at the start of every block, which each add 32 * s1 to s2
+      auto vPrevS1 = _mm_cvtsi32_si128(static_cast<int>(s1 * n));
+      auto vS2 = _mm_cvtsi32_si128(static_cast<int>(s2));
+      auto vS1 = _mm_setzero_si128();
+
+      do {
+         auto bytes1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+         auto bytes2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+         vPrevS1 = _mm_add_epi32(vPrevS1, vS1);
+
+         vS1 = _mm_add_epi32(vS1, _mm_sad_epu8(bytes1, zero));
+         vS2 = _mm_add_epi32(vS2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+
+         vS1 = _mm_add_epi32(vS1, _mm_sad_epu8(bytes2, zero));
+         vS2 = _mm_add_epi32(vS2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+
+         data += BlockSize;
+      } while (--n);
+
+      vS2 = _mm_add_epi32(vS2, _mm_slli_epi32(vPrevS1, 5));
+
+      // Horizontal sums
+      vS1 = _mm_add_epi32(vS1, _mm_shuffle_epi32(vS1, _MM_SHUFFLE(2, 3, 0, 1)));
+      vS1 = _mm_add_epi32(vS1, _mm_shuffle_epi32(vS1, _MM_SHUFFLE(1, 0, 3, 2)));
+      s1 += static_cast<uint32_t>(_mm_cvtsi128_si32(vS1));
+
+      vS2 = _mm_add_epi32(vS2, _mm_shuffle_epi32(vS2, _MM_SHUFFLE(2, 3, 0, 1)));
+      vS2 = _mm_add_epi32(vS2, _mm_shuffle_epi32(vS2, _MM_SHUFFLE(1, 0, 3, 2)));
+      s2 = static_cast<uint32_t>(_mm_cvtsi128_si32(vS2));
+
+      s1 %= AdlerBase;
+      s2 %= AdlerBase;
+   }
+
+   return s1 | (s2 << 16);
+}
+
+#endif // CHECKSUM_X86
+
+uint32_t
+checksum_crc32(uint32_t crc,
+               const uint8_t *data,
+               size_t size)
+{
+   // zlib returns the initial value for a null buffer
+   if (!data) {
+      return 0;
+   }
+
+#ifdef CHECKSUM_X86
+   if (size >= SimdMinimumSize && getHostFeatures().pclmul) {
+      auto simdSize = size & ~static_cast<size_t>(15);
+      crc = ~crc32Pclmul(~crc, data, simdSize);
+      data += simdSize;
+      size -= simdSize;
+   }
+#endif
+
+   return crc32Scalar(crc, data, size);
+}
+
+uint32_t
+checksum_adler32(uint32_t adler,
+                 const uint8_t *data,
+                 size_t size)
+{
+   if (!data) {
+      return 1;
+   }
+
+#ifdef CHECKSUM_X86
+   if (size >= SimdMinimumSize && getHostFeatures().ssse3) {
+      auto blocks = size / 32;
+      adler = adler32Ssse3(adler, data, blocks);
+      data += blocks * 32;
+      size -= blocks * 32;
+   }
+#endif
+
+   return adler32Scalar(adler, data, size);
+}
@@ -0,0 +1,115 @@
+#include "fast_memory.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define FAST_MEMORY_X86
+#include <emmintrin.h>
+#endif
+
+// Anything smaller than this is likely to fit in the host's last level cache,
+//  where the C library is already as fast as we can be.
+static const size_t
+NonTemporalThreshold = 1024 * 1024;
+
+#ifdef FAST_MEMORY_X86
+
+// SSE2 is part of x86-64 so these need no runtime check
+static void
+streamCopy(uint8_t *dst,
+           const uint8_t *src,
+           size_t size)
+{
+   // Non-temporal stores must be 16 byte aligned, the loads need not be
+   auto head = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15;
+   std::memcpy(dst, src, head);
+   dst += head;
+   src += head;
+   size -= head;
+
+   for (; size >= 64; size -= 64, dst += 64, src += 64) {
+      auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 0));
+      auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+      auto c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32));
+      auto d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 48));
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 0), a);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 16), b);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 32), c);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 48), d);
+   }
+
+   // Make the streamed data visible to other cores before anyone can see
+   //  that the copy has completed
+   _mm_sfence();
+   std::memcpy(dst, src, size);
+}
+
+static void
+streamFill(uint8_t *dst,
+           int value,
+           size_t size)
+{
+   auto head = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15;
+   std::memset(dst, value, head);
+   dst += head;
+   size -= head;
+
+   auto fill = _mm_set1_epi8(static_cast<char>(value));
+
+   for (; size >= 64; size -= 64, dst += 64) {
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 0), fill);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 16), fill);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 32), fill);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 48), fill);
+   }
+
+   _mm_sfence();
+   std::memset(dst, value, size);
+}
+
+#endif
+
+void
+fast_memcpy(void *dst,
+            const void *src,
+            size_t size)
+{
+#ifdef FAST_MEMORY_X86
+   if (size >= NonTemporalThreshold) {
+      streamCopy(reinterpret_cast<uint8_t *>(dst), reinterpret_cast<const uint8_t *>(src), size);
+      return;
+   }
+#endif
+
+   std::memcpy(dst, src, size);
+}
+
+void
+fast_memmove(void *dst,
+             const void *src,
+             size_t size)
+{
+   auto dstAddr = reinterpret_cast<uintptr_t>(dst);
+   auto srcAddr = reinterpret_cast<uintptr_t>(src);
+
+   if (dstAddr + size <= srcAddr || srcAddr + size <= dstAddr) {
+      fast_memcpy(dst, src, size);
+   } else {
+      std::memmove(dst, src, size);
+   }
+}
+
+void
+fast_memset(void *dst,
+            int value,
+            size_t size)
+{
+#ifdef FAST_MEMORY_X86
+   if (size >= NonTemporalThreshold) {
+      streamFill(reinterpret_cast<uint8_t *>(dst), value, size);
+      return;
+   }
+#endif
+
+   std::memset(dst, value, size);
+}
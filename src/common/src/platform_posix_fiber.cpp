@@ -4,6 +4,7 @@
 
 #ifdef PLATFORM_POSIX
 #include <array>
+#include <cstring>
 #include <errno.h>
 #include <signal.h>
 #include <ucontext.h>
@@ -82,6 +83,29 @@ swapToFiber(Fiber *current, Fiber *target)
    }
 }
 
+bool
+saveFiberState(Fiber *fiber, std::vector<uint8_t> &state)
+{
+   // The saved floating point registers are pointed to from within the
+   //  context itself, so it can only be put back into the same fiber.
+   state.resize(sizeof(fiber->context) + fiber->stack.size());
+   std::memcpy(state.data(), &fiber->context, sizeof(fiber->context));
+   std::memcpy(state.data() + sizeof(fiber->context), fiber->stack.data(), fiber->stack.size());
+   return true;
+}
+
+bool
+restoreFiberState(Fiber *fiber, const std::vector<uint8_t> &state)
+{
+   if (state.size() != sizeof(fiber->context) + fiber->stack.size()) {
+      return false;
+   }
+
+   std::memcpy(&fiber->context, state.data(), sizeof(fiber->context));
+   std::memcpy(fiber->stack.data(), state.data() + sizeof(fiber->context), fiber->stack.size());
+   return true;
+}
+
 } // namespace platform
 
 #endif
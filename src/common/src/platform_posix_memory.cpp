@@ -2,11 +2,41 @@
 #include "platform_memory.h"
 
 #ifdef PLATFORM_POSIX
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
 #include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef PLATFORM_LINUX
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <string>
+#include <sys/syscall.h>
+#endif
 
 namespace platform
 {
 
+struct MemorySnapshot
+{
+   std::vector<MemoryRange> ranges;
+
+   //! Holds every range back to back, at their offset in ranges order
+   int fd = -1;
+
+   //! Child process still writing the copy, -1 once it has been reaped
+   pid_t writer = -1;
+
+   bool complete = false;
+};
+
+static const size_t
+SnapshotPageSize = 4096;
+
 static int flagsToProt(ProtectFlags flags)
 {
    switch (flags) {
@@ -74,6 +104,297 @@ protectMemory(size_t address, size_t size, ProtectFlags flags)
    return mprotect(baseAddress, size, flagsToProt(flags)) == 0;
 }
 
+bool
+bindMemoryToNode(size_t address, size_t size, uint32_t node)
+{
+#ifdef PLATFORM_LINUX
+   // Preferred rather than bound so running out of memory on the node falls
+   //  back to another one instead of failing.
+   auto nodemask = 0ul;
+   auto baseAddress = reinterpret_cast<void *>(address);
+
+   if (node >= sizeof(nodemask) * 8) {
+      return false;
+   }
+
+   nodemask = 1ul << node;
+
+   return syscall(SYS_mbind, baseAddress, size, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8, 0) == 0;
+#else
+   return false;
+#endif
+}
+
+size_t
+getHugePageSize()
+{
+#ifdef PLATFORM_LINUX
+   std::ifstream meminfo { "/proc/meminfo" };
+   std::string key;
+
+   while (meminfo >> key) {
+      if (key == "Hugepagesize:") {
+         size_t sizeKb = 0;
+         meminfo >> sizeKb;
+         return sizeKb * 1024;
+      }
+
+      meminfo.ignore(256, '\n');
+   }
+#endif
+
+   return 0;
+}
+
+bool
+commitHugeMemory(size_t address, size_t size, ProtectFlags flags)
+{
+#ifdef PLATFORM_LINUX
+   auto pageSize = getHugePageSize();
+   auto baseAddress = reinterpret_cast<void *>(address);
+
+   if (!pageSize || (address % pageSize) || (size % pageSize)) {
+      return false;
+   }
+
+   // This replaces the reserved pages, the huge pages are reserved up front
+   //  so the mapping fails now rather than faulting later if there are not
+   //  enough of them.
+   auto result = mmap(baseAddress, size, flagsToProt(flags), MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+
+   if (result == baseAddress) {
+      return true;
+   }
+
+   if (result == MAP_FAILED) {
+      // A failed MAP_FIXED may already have dropped the old mapping
+      mmap(baseAddress, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+   }
+#endif
+
+   return false;
+}
+
+bool
+adviseHugePages(size_t address, size_t size)
+{
+#ifdef PLATFORM_LINUX
+   auto baseAddress = reinterpret_cast<void *>(address);
+   return madvise(baseAddress, size, MADV_HUGEPAGE) == 0;
+#else
+   return false;
+#endif
+}
+
+static int
+createSnapshotFile()
+{
+#if defined(PLATFORM_LINUX) && defined(SYS_memfd_create)
+   auto memfd = static_cast<int>(syscall(SYS_memfd_create, "decaf-snapshot", 0));
+
+   if (memfd >= 0) {
+      return memfd;
+   }
+#endif
+
+   char path[] = "/tmp/decaf-snapshot-XXXXXX";
+   auto fd = mkstemp(path);
+
+   if (fd >= 0) {
+      unlink(path);
+   }
+
+   return fd;
+}
+
+static bool
+isZeroPage(const uint8_t *page)
+{
+   auto words = reinterpret_cast<const uint64_t *>(page);
+
+   for (auto i = 0u; i < SnapshotPageSize / sizeof(uint64_t); ++i) {
+      if (words[i]) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+static bool
+writeAll(int fd, const uint8_t *data, size_t size, off_t offset)
+{
+   while (size) {
+      auto written = pwrite(fd, data, size, offset);
+
+      if (written < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+
+         return false;
+      }
+
+      data += written;
+      size -= written;
+      offset += written;
+   }
+
+   return true;
+}
+
+// Runs in the forked child, where only the forking thread exists, so this
+//  must not allocate or take any locks.
+static void
+writeSnapshot(int fd, const std::vector<MemoryRange> &ranges)
+{
+   auto offset = off_t { 0 };
+
+   for (auto &range : ranges) {
+      auto base = reinterpret_cast<uint8_t *>(range.address);
+
+      // Protection only changes in this process, it lets us read pages the
+      //  guest is not allowed to.
+      if (mprotect(base, range.size, PROT_READ) != 0) {
+         _exit(1);
+      }
+
+      // Zero pages are left as holes so the file stays about as small as the
+      //  memory the guest has actually used.
+      auto runStart = size_t { 0 };
+      auto runSize = size_t { 0 };
+
+      for (auto page = size_t { 0 }; page < range.size; page += SnapshotPageSize) {
+         if (!isZeroPage(base + page)) {
+            if (!runSize) {
+               runStart = page;
+            }
+
+            runSize += SnapshotPageSize;
+            continue;
+         }
+
+         if (runSize && !writeAll(fd, base + runStart, runSize, offset + runStart)) {
+            _exit(1);
+         }
+
+         runSize = 0;
+      }
+
+      if (runSize && !writeAll(fd, base + runStart, runSize, offset + runStart)) {
+         _exit(1);
+      }
+
+      offset += range.size;
+   }
+
+   _exit(0);
+}
+
+MemorySnapshot *
+captureMemory(const std::vector<MemoryRange> &ranges)
+{
+   auto totalSize = size_t { 0 };
+
+   for (auto &range : ranges) {
+      if ((range.address % SnapshotPageSize) || (range.size % SnapshotPageSize)) {
+         return nullptr;
+      }
+
+      totalSize += range.size;
+   }
+
+   auto fd = createSnapshotFile();
+
+   if (fd < 0) {
+      return nullptr;
+   }
+
+   if (ftruncate(fd, static_cast<off_t>(totalSize)) != 0) {
+      close(fd);
+      return nullptr;
+   }
+
+   auto snapshot = new MemorySnapshot { };
+   snapshot->ranges = ranges;
+   snapshot->fd = fd;
+
+   // The child gets a copy-on-write view of our memory as it is right now,
+   //  so we can carry on straight away while it writes the copy out.
+   auto pid = fork();
+
+   if (pid == 0) {
+      writeSnapshot(fd, snapshot->ranges);
+   }
+
+   if (pid < 0) {
+      freeMemorySnapshot(snapshot);
+      return nullptr;
+   }
+
+   snapshot->writer = pid;
+   return snapshot;
+}
+
+bool
+waitMemorySnapshot(MemorySnapshot *snapshot)
+{
+   if (snapshot->writer < 0) {
+      return snapshot->complete;
+   }
+
+   auto status = 0;
+
+   while (waitpid(snapshot->writer, &status, 0) < 0) {
+      if (errno != EINTR) {
+         status = -1;
+         break;
+      }
+   }
+
+   snapshot->writer = -1;
+   snapshot->complete = status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+   return snapshot->complete;
+}
+
+bool
+restoreMemory(MemorySnapshot *snapshot)
+{
+   if (!waitMemorySnapshot(snapshot)) {
+      return false;
+   }
+
+   auto offset = off_t { 0 };
+
+   for (auto &range : snapshot->ranges) {
+      auto baseAddress = reinterpret_cast<void *>(range.address);
+      auto result = mmap(baseAddress, range.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, snapshot->fd, offset);
+
+      if (result != baseAddress) {
+         return false;
+      }
+
+      offset += range.size;
+   }
+
+   return true;
+}
+
+void
+freeMemorySnapshot(MemorySnapshot *snapshot)
+{
+   if (snapshot->writer >= 0) {
+      kill(snapshot->writer, SIGKILL);
+      waitMemorySnapshot(snapshot);
+   }
+
+   if (snapshot->fd >= 0) {
+      close(snapshot->fd);
+   }
+
+   delete snapshot;
+}
+
 } // namespace platform
 
 #endif
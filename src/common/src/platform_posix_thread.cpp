@@ -4,10 +4,58 @@
 #ifdef PLATFORM_POSIX
 #include <cstdlib>
 #include <pthread.h>
+#include <sched.h>
+
+#ifdef PLATFORM_LINUX
+#include <dirent.h>
+#include <fstream>
+#endif
 
 namespace platform
 {
 
+static pthread_t
+getNativeHandle(std::thread *thread)
+{
+   return thread ? thread->native_handle() : pthread_self();
+}
+
+#ifdef PLATFORM_LINUX
+static bool
+readSysfsValue(const std::string &path,
+               uint32_t &value)
+{
+   std::ifstream file { path };
+   return !!(file >> value);
+}
+
+// The node a processor belongs to is only given by the name of a nodeN link
+//  in its sysfs directory.
+static uint32_t
+readProcessorNode(const std::string &path)
+{
+   auto dir = opendir(path.c_str());
+   auto node = 0u;
+
+   if (!dir) {
+      return node;
+   }
+
+   while (auto entry = readdir(dir)) {
+      auto name = std::string { entry->d_name };
+
+      if (name.compare(0, 4, "node") == 0 && name.size() > 4
+       && name.find_first_not_of("0123456789", 4) == std::string::npos) {
+         node = static_cast<uint32_t>(std::stoul(name.substr(4)));
+         break;
+      }
+   }
+
+   closedir(dir);
+   return node;
+}
+#endif
+
 void
 setThreadName(std::thread *thread,
               const std::string &name)
@@ -26,6 +74,71 @@ exitThread(int result)
    pthread_exit(res);
 }
 
+std::vector<HostProcessor>
+getHostProcessors()
+{
+   auto processors = std::vector<HostProcessor> { };
+
+#ifdef PLATFORM_LINUX
+   cpu_set_t allowed;
+   CPU_ZERO(&allowed);
+
+   if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      return processors;
+   }
+
+   for (auto i = 0u; i < CPU_SETSIZE; ++i) {
+      if (!CPU_ISSET(i, &allowed)) {
+         continue;
+      }
+
+      auto path = "/sys/devices/system/cpu/cpu" + std::to_string(i);
+      auto processor = HostProcessor { };
+      processor.id = i;
+
+      if (!readSysfsValue(path + "/topology/core_id", processor.core)) {
+         processor.core = i;
+      }
+
+      if (!readSysfsValue(path + "/topology/physical_package_id", processor.package)) {
+         processor.package = 0;
+      }
+
+      processor.node = readProcessorNode(path);
+      processors.push_back(processor);
+   }
+#endif
+
+   return processors;
+}
+
+bool
+setThreadAffinity(std::thread *thread,
+                  const std::vector<uint32_t> &processors)
+{
+#ifdef PLATFORM_LINUX
+   cpu_set_t set;
+   CPU_ZERO(&set);
+
+   for (auto id : processors) {
+      CPU_SET(id, &set);
+   }
+
+   return pthread_setaffinity_np(getNativeHandle(thread), sizeof(set), &set) == 0;
+#else
+   return false;
+#endif
+}
+
+bool
+setThreadRealtimePriority(std::thread *thread)
+{
+   // The lowest real-time priority is still above every normal thread
+   auto param = sched_param { };
+   param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+   return pthread_setschedparam(getNativeHandle(thread), SCHED_FIFO, &param) == 0;
+}
+
 } // namespace platform
 
 #endif
@@ -0,0 +1,85 @@
+#include "platform_thread.h"
+#include <algorithm>
+#include <tuple>
+
+namespace platform
+{
+
+ThreadPlacement
+planThreadPlacement(const std::vector<HostProcessor> &processors,
+                    size_t numPinned,
+                    int node)
+{
+   auto placement = ThreadPlacement { };
+   auto candidates = std::vector<HostProcessor> { };
+
+   for (auto &processor : processors) {
+      if (node < 0 || processor.node == static_cast<uint32_t>(node)) {
+         candidates.push_back(processor);
+      }
+   }
+
+   if (candidates.empty()) {
+      return placement;
+   }
+
+   placement.node = node;
+
+   // Order by physical core so SMT siblings are next to each other
+   std::sort(candidates.begin(), candidates.end(),
+             [](const HostProcessor &lhs, const HostProcessor &rhs) {
+                return std::tie(lhs.node, lhs.package, lhs.core, lhs.id)
+                     < std::tie(rhs.node, rhs.package, rhs.core, rhs.id);
+             });
+
+   // Take the first logical processor of each physical core for the pinned
+   //  threads, the siblings of a pinned processor are left idle so nothing
+   //  else competes with it for the core.
+   auto pinnedCores = std::vector<const HostProcessor *> { };
+
+   for (auto &processor : candidates) {
+      if (pinnedCores.size() == numPinned) {
+         break;
+      }
+
+      if (pinnedCores.empty()
+       || pinnedCores.back()->node != processor.node
+       || pinnedCores.back()->package != processor.package
+       || pinnedCores.back()->core != processor.core) {
+         pinnedCores.push_back(&processor);
+      }
+   }
+
+   if (pinnedCores.size() == numPinned) {
+      for (auto pinned : pinnedCores) {
+         placement.pinned.push_back(pinned->id);
+      }
+   } else {
+      pinnedCores.clear();
+   }
+
+   for (auto &processor : candidates) {
+      auto isPinnedCore = std::any_of(pinnedCores.begin(), pinnedCores.end(),
+                                      [&](const HostProcessor *pinned) {
+                                         return pinned->node == processor.node
+                                             && pinned->package == processor.package
+                                             && pinned->core == processor.core;
+                                      });
+
+      if (!isPinnedCore) {
+         placement.shared.push_back(processor.id);
+      }
+   }
+
+   // With no physical cores to spare everything else has to share with the
+   //  pinned threads.
+   if (placement.shared.empty()) {
+      for (auto &processor : candidates) {
+         placement.shared.push_back(processor.id);
+      }
+   }
+
+   return placement;
+}
+
+} // namespace platform
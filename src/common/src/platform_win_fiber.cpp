@@ -52,6 +52,19 @@ swapToFiber(Fiber *current, Fiber *target)
    SwitchToFiber(target->handle);
 }
 
+bool
+saveFiberState(Fiber *fiber, std::vector<uint8_t> &state)
+{
+   // The stack and registers of a Windows fiber are not ours to copy
+   return false;
+}
+
+bool
+restoreFiberState(Fiber *fiber, const std::vector<uint8_t> &state)
+{
+   return false;
+}
+
 } // namespace platform
 
 #endif
@@ -71,6 +71,59 @@ protectMemory(size_t address, size_t size, ProtectFlags flags)
    return (result != 0);
 }
 
+bool
+bindMemoryToNode(size_t address, size_t size, uint32_t node)
+{
+   // Windows only lets the node be chosen when memory is committed
+   return false;
+}
+
+size_t
+getHugePageSize()
+{
+   return GetLargePageMinimum();
+}
+
+bool
+commitHugeMemory(size_t address, size_t size, ProtectFlags flags)
+{
+   // Large pages can only be allocated as a new reservation, never within
+   //  an existing one, so they cannot be used for a fixed address space.
+   return false;
+}
+
+bool
+adviseHugePages(size_t address, size_t size)
+{
+   // There are no transparent huge pages on Windows
+   return false;
+}
+
+MemorySnapshot *
+captureMemory(const std::vector<MemoryRange> &ranges)
+{
+   // There is no fork, and a placeholder view cannot replace part of an
+   //  existing reservation, so there is no cheap copy-on-write to use.
+   return nullptr;
+}
+
+bool
+waitMemorySnapshot(MemorySnapshot *snapshot)
+{
+   return false;
+}
+
+bool
+restoreMemory(MemorySnapshot *snapshot)
+{
+   return false;
+}
+
+void
+freeMemorySnapshot(MemorySnapshot *snapshot)
+{
+}
+
 } // namespace platform
 
 #endif
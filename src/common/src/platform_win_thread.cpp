@@ -46,6 +46,94 @@ exitThread(int result)
    ExitThread(result);
 }
 
+static HANDLE
+getNativeHandle(std::thread *thread)
+{
+   return thread ? static_cast<HANDLE>(thread->native_handle()) : GetCurrentThread();
+}
+
+static uint32_t
+getFirstProcessor(ULONG_PTR mask)
+{
+   auto id = 0u;
+
+   while (mask && !(mask & 1)) {
+      mask >>= 1;
+      ++id;
+   }
+
+   return id;
+}
+
+std::vector<HostProcessor>
+getHostProcessors()
+{
+   auto processors = std::vector<HostProcessor> { };
+   auto length = DWORD { 0 };
+
+   GetLogicalProcessorInformation(nullptr, &length);
+   auto info = std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION>(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+
+   if (info.empty() || !GetLogicalProcessorInformation(info.data(), &length)) {
+      return processors;
+   }
+
+   // Only the first processor group is visible here, which is every
+   //  processor on hosts with 64 or fewer.
+   for (auto bit = 0u; bit < sizeof(ULONG_PTR) * 8; ++bit) {
+      auto mask = static_cast<ULONG_PTR>(1) << bit;
+      auto processor = HostProcessor { };
+      auto found = false;
+      processor.id = bit;
+
+      for (auto &item : info) {
+         if (!(item.ProcessorMask & mask)) {
+            continue;
+         }
+
+         switch (item.Relationship) {
+         case RelationProcessorCore:
+            processor.core = getFirstProcessor(item.ProcessorMask);
+            found = true;
+            break;
+         case RelationProcessorPackage:
+            processor.package = getFirstProcessor(item.ProcessorMask);
+            break;
+         case RelationNumaNode:
+            processor.node = item.NumaNode.NodeNumber;
+            break;
+         default:
+            break;
+         }
+      }
+
+      if (found) {
+         processors.push_back(processor);
+      }
+   }
+
+   return processors;
+}
+
+bool
+setThreadAffinity(std::thread *thread,
+                  const std::vector<uint32_t> &processors)
+{
+   auto mask = ULONG_PTR { 0 };
+
+   for (auto id : processors) {
+      mask |= static_cast<ULONG_PTR>(1) << id;
+   }
+
+   return SetThreadAffinityMask(getNativeHandle(thread), mask) != 0;
+}
+
+bool
+setThreadRealtimePriority(std::thread *thread)
+{
+   return !!SetThreadPriority(getNativeHandle(thread), THREAD_PRIORITY_TIME_CRITICAL);
+}
+
 } // namespace platform
 
 #endif
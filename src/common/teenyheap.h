@@ -1,127 +1,465 @@
 #pragma once
 #include "align.h"
+#include "bitutils.h"
 #include "decaf_assert.h"
 #include <algorithm>
-#include <map>
+#include <cstdint>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 
+/**
+ * A two level segregated fit allocator for memory which we are not allowed
+ * to store allocator metadata in, such as guest memory.
+ *
+ * Free blocks are kept in size class lists indexed by a pair of bitmaps so
+ * both alloc and free are O(1), and a block is always coalesced with its free
+ * neighbours when it is released.
+ */
 class TeenyHeap
 {
 private:
+   static const uint32_t InvalidBlock = 0xFFFFFFFF;
+
+   static const size_t MinAlignment = 4;
+   static const size_t MinBlockSize = 16;
+
+   static const unsigned SecondLevelBits = 4;
+   static const unsigned SecondLevelCount = 1 << SecondLevelBits;
+
+   //! Sizes below this are all in first level 0 with a linear second level
+   static const unsigned SmallBlockShift = 8;
+   static const size_t SmallBlockSize = 1 << SmallBlockShift;
+
+   static const unsigned FirstLevelCount = 32 - SmallBlockShift + 1;
+
    struct MemoryBlock
    {
-      uint8_t *start;
-      size_t size;
+      uint32_t offset;
+      uint32_t size;
+      uint32_t prevPhys;
+      uint32_t nextPhys;
+      uint32_t prevFree;
+      uint32_t nextFree;
+      bool free;
    };
 
 public:
+   struct Stats
+   {
+      size_t totalSize;
+      size_t usedSize;
+      size_t peakUsedSize;
+      size_t freeSize;
+      size_t largestFreeSize;
+      size_t numFreeBlocks;
+      size_t numAllocations;
+
+      //! 0 when all free memory is contiguous, approaching 1 as it splinters
+      double fragmentation;
+   };
+
+   //! Everything the allocator keeps outside of the memory it manages
+   struct State
+   {
+      size_t freeSize;
+      size_t usedSize;
+      size_t peakUsedSize;
+      size_t numFreeBlocks;
+      uint32_t firstLevelMap;
+      uint32_t secondLevelMap[FirstLevelCount];
+      uint32_t freeLists[FirstLevelCount][SecondLevelCount];
+      std::vector<MemoryBlock> blocks;
+      std::vector<uint32_t> unusedBlocks;
+      std::unordered_map<uint8_t *, uint32_t> allocatedBlocks;
+   };
+
    TeenyHeap(void *buffer, size_t size) :
       mBuffer(static_cast<uint8_t *>(buffer)),
       mSize(size)
    {
-      mFreeBlocks.emplace_back(MemoryBlock { mBuffer, mSize });
+      decaf_check(size <= 0xFFFFFFFF);
+      decaf_check(align_up(mBuffer, MinAlignment) == mBuffer);
+
+      for (auto &list : mFreeLists) {
+         std::fill(std::begin(list), std::end(list), InvalidBlock);
+      }
+
+      auto block = newBlock();
+      mBlocks[block].offset = 0;
+      mBlocks[block].size = static_cast<uint32_t>(size);
+      insertFreeBlock(block);
    }
 
    size_t
    getLargestFreeSize()
    {
-      auto largest = size_t { 0 };
-
-      for (auto &block : mFreeBlocks) {
-         largest = std::max(largest, block.size);
-      }
-
-      return largest;
+      std::unique_lock<std::mutex> lock(mMutex);
+      return largestFreeSize();
    }
 
    size_t
    getTotalFreeSize()
    {
-      auto total = size_t { 0 };
+      std::unique_lock<std::mutex> lock(mMutex);
+      return mFreeSize;
+   }
 
-      for (auto &block : mFreeBlocks) {
-         total += block.size;
+   Stats
+   getStats()
+   {
+      std::unique_lock<std::mutex> lock(mMutex);
+      auto stats = Stats { };
+      stats.totalSize = mSize;
+      stats.usedSize = mUsedSize;
+      stats.peakUsedSize = mPeakUsedSize;
+      stats.freeSize = mFreeSize;
+      stats.largestFreeSize = largestFreeSize();
+      stats.numFreeBlocks = mNumFreeBlocks;
+      stats.numAllocations = mAllocatedBlocks.size();
+
+      if (stats.freeSize) {
+         stats.fragmentation = 1.0 - static_cast<double>(stats.largestFreeSize) / stats.freeSize;
+      } else {
+         stats.fragmentation = 0.0;
       }
 
-      return total;
+      return stats;
    }
 
    void *
    alloc(size_t size, size_t alignment = 4)
    {
       std::unique_lock<std::mutex> lock(mMutex);
-      auto adjSize = size + alignment - 1;
-      auto block = mFreeBlocks.begin();
+      alignment = std::max(alignment, MinAlignment);
+      size = align_up(std::max<size_t>(size, 1), MinAlignment);
 
-      for (block = mFreeBlocks.begin(); block != mFreeBlocks.end(); ++block) {
-         if (block->size >= adjSize) {
-            break;
-         }
+      // Blocks always start at a MinAlignment aligned address, so this is the
+      // most padding we could need to align the start of the allocation.
+      auto searchSize = size + alignment - MinAlignment;
+
+      if (searchSize > mFreeSize) {
+         return nullptr;
       }
 
-      if (block == mFreeBlocks.end()) {
+      auto block = findFreeBlock(searchSize);
+
+      if (block == InvalidBlock) {
          return nullptr;
       }
 
-      auto start = block->start;
-      block->start += adjSize;
-      block->size -= adjSize;
+      removeFreeBlock(block);
+
+      // Split off any padding large enough to be useful as a free block, it is
+      // the address we return which must be aligned, not the offset.
+      auto blockStart = mBuffer + mBlocks[block].offset;
+      auto alignedOffset = static_cast<uint32_t>(align_up(blockStart, alignment) - mBuffer);
+      auto padding = alignedOffset - mBlocks[block].offset;
+
+      if (padding >= MinBlockSize) {
+         auto pad = block;
+         block = splitBlock(pad, padding);
+         insertFreeBlock(pad);
+         padding = 0;
+      }
+
+      // Return any excess at the end of the block to the free lists
+      auto usedSize = padding + size;
 
-      // Erase block if it gets too small
-      if (block->size <= sizeof(MemoryBlock) + 4) {
-         adjSize += block->size;
-         mFreeBlocks.erase(block);
+      if (mBlocks[block].size - usedSize >= MinBlockSize) {
+         auto excess = splitBlock(block, usedSize);
+         insertFreeBlock(excess);
       }
 
-      // Allocate block
-      auto alignedStart = align_up(start, alignment);
-      mAllocatedBlocks.emplace(alignedStart, MemoryBlock { start, adjSize });
+      mUsedSize += mBlocks[block].size;
+      mPeakUsedSize = std::max(mPeakUsedSize, mUsedSize);
 
-      return alignedStart;
+      auto ptr = mBuffer + alignedOffset;
+      mAllocatedBlocks.emplace(ptr, block);
+      return ptr;
    }
 
    void
    free(void *ptr)
    {
       std::unique_lock<std::mutex> lock(mMutex);
-      auto ucptr = static_cast<uint8_t*>(ptr);
-      auto itr = mAllocatedBlocks.find(ucptr);
+      auto itr = mAllocatedBlocks.find(static_cast<uint8_t *>(ptr));
       decaf_check(itr != mAllocatedBlocks.end());
 
-      releaseBlock(itr->second);
+      auto block = itr->second;
       mAllocatedBlocks.erase(itr);
+      mUsedSize -= mBlocks[block].size;
+
+      // Coalesce with the physically adjacent blocks if they are free
+      auto prev = mBlocks[block].prevPhys;
+
+      if (prev != InvalidBlock && mBlocks[prev].free) {
+         removeFreeBlock(prev);
+         mergeBlocks(prev, block);
+         block = prev;
+      }
+
+      auto next = mBlocks[block].nextPhys;
+
+      if (next != InvalidBlock && mBlocks[next].free) {
+         removeFreeBlock(next);
+         mergeBlocks(block, next);
+      }
+
+      insertFreeBlock(block);
    }
 
-protected:
+   State
+   saveState()
+   {
+      std::unique_lock<std::mutex> lock(mMutex);
+      auto state = State { };
+      state.freeSize = mFreeSize;
+      state.usedSize = mUsedSize;
+      state.peakUsedSize = mPeakUsedSize;
+      state.numFreeBlocks = mNumFreeBlocks;
+      state.firstLevelMap = mFirstLevelMap;
+      std::copy(std::begin(mSecondLevelMap), std::end(mSecondLevelMap), std::begin(state.secondLevelMap));
+
+      for (auto fl = 0u; fl < FirstLevelCount; ++fl) {
+         std::copy(std::begin(mFreeLists[fl]), std::end(mFreeLists[fl]), std::begin(state.freeLists[fl]));
+      }
+
+      state.blocks = mBlocks;
+      state.unusedBlocks = mUnusedBlocks;
+      state.allocatedBlocks = mAllocatedBlocks;
+      return state;
+   }
+
+   //! Puts back the allocations from saveState, the memory itself must be
+   //  restored separately.
    void
-   releaseBlock(MemoryBlock block)
+   restoreState(const State &state)
    {
-      auto blockStart = block.start;
-      auto blockEnd = block.start + block.size;
+      std::unique_lock<std::mutex> lock(mMutex);
+      mFreeSize = state.freeSize;
+      mUsedSize = state.usedSize;
+      mPeakUsedSize = state.peakUsedSize;
+      mNumFreeBlocks = state.numFreeBlocks;
+      mFirstLevelMap = state.firstLevelMap;
+      std::copy(std::begin(state.secondLevelMap), std::end(state.secondLevelMap), std::begin(mSecondLevelMap));
+
+      for (auto fl = 0u; fl < FirstLevelCount; ++fl) {
+         std::copy(std::begin(state.freeLists[fl]), std::end(state.freeLists[fl]), std::begin(mFreeLists[fl]));
+      }
+
+      mBlocks = state.blocks;
+      mUnusedBlocks = state.unusedBlocks;
+      mAllocatedBlocks = state.allocatedBlocks;
+   }
+
+private:
+   static void
+   mapping(size_t size, unsigned &fl, unsigned &sl)
+   {
+      if (size < SmallBlockSize) {
+         fl = 0;
+         sl = static_cast<unsigned>(size / (SmallBlockSize / SecondLevelCount));
+      } else {
+         unsigned long msb;
+         bit_scan_reverse(&msb, static_cast<uint32_t>(size));
+         fl = static_cast<unsigned>(msb) - SmallBlockShift + 1;
+         sl = static_cast<unsigned>(size >> (msb - SecondLevelBits)) ^ SecondLevelCount;
+      }
+   }
+
+   uint32_t
+   findFreeBlock(size_t size)
+   {
+      // Round up to the next size class so any block in the class fits
+      auto searchSize = size;
+
+      if (searchSize < SmallBlockSize) {
+         searchSize = align_up(searchSize, SmallBlockSize / SecondLevelCount);
+      } else {
+         unsigned long msb;
+         bit_scan_reverse(&msb, static_cast<uint32_t>(searchSize));
+         searchSize += (size_t { 1 } << (msb - SecondLevelBits)) - 1;
+      }
 
-      for (auto &free : mFreeBlocks) {
-         auto freeStart = free.start;
-         auto freeEnd = free.start + free.size;
+      auto fl = 0u, sl = 0u;
 
-         if (blockStart == freeEnd) {
-            free.size += block.size;
-            return;
+      if (searchSize <= 0xFFFFFFFF) {
+         mapping(searchSize, fl, sl);
+
+         auto slMap = mSecondLevelMap[fl] & (~0u << sl);
+
+         if (!slMap && fl + 1 < FirstLevelCount) {
+            auto flMap = mFirstLevelMap & (~0u << (fl + 1));
+            unsigned long index;
+
+            if (bit_scan_forward(&index, flMap)) {
+               fl = static_cast<unsigned>(index);
+               slMap = mSecondLevelMap[fl];
+            }
+         }
+
+         if (slMap) {
+            unsigned long index;
+            bit_scan_forward(&index, slMap);
+            return mFreeLists[fl][index];
          }
+      }
 
-         if (blockEnd == freeStart) {
-            free.start = blockStart;
-            free.size += block.size;
-            return;
+      // The only blocks left which could fit are in the same size class as the
+      // request, this matters when someone asks for exactly the largest size.
+      mapping(size, fl, sl);
+
+      for (auto block = mFreeLists[fl][sl]; block != InvalidBlock; block = mBlocks[block].nextFree) {
+         if (mBlocks[block].size >= size) {
+            return block;
          }
       }
 
-      mFreeBlocks.emplace_back(block);
+      return InvalidBlock;
+   }
+
+   void
+   insertFreeBlock(uint32_t block)
+   {
+      auto &info = mBlocks[block];
+      auto fl = 0u, sl = 0u;
+      mapping(info.size, fl, sl);
+
+      auto head = mFreeLists[fl][sl];
+      info.free = true;
+      info.prevFree = InvalidBlock;
+      info.nextFree = head;
+
+      if (head != InvalidBlock) {
+         mBlocks[head].prevFree = block;
+      }
+
+      mFreeLists[fl][sl] = block;
+      mFirstLevelMap |= 1u << fl;
+      mSecondLevelMap[fl] |= 1u << sl;
+      mFreeSize += info.size;
+      mNumFreeBlocks++;
+   }
+
+   void
+   removeFreeBlock(uint32_t block)
+   {
+      auto &info = mBlocks[block];
+      auto fl = 0u, sl = 0u;
+      mapping(info.size, fl, sl);
+
+      if (info.prevFree != InvalidBlock) {
+         mBlocks[info.prevFree].nextFree = info.nextFree;
+      } else {
+         mFreeLists[fl][sl] = info.nextFree;
+      }
+
+      if (info.nextFree != InvalidBlock) {
+         mBlocks[info.nextFree].prevFree = info.prevFree;
+      }
+
+      if (mFreeLists[fl][sl] == InvalidBlock) {
+         mSecondLevelMap[fl] &= ~(1u << sl);
+
+         if (!mSecondLevelMap[fl]) {
+            mFirstLevelMap &= ~(1u << fl);
+         }
+      }
+
+      info.free = false;
+      mFreeSize -= info.size;
+      mNumFreeBlocks--;
+   }
+
+   //! Splits block at offset, returns the new block which follows it
+   uint32_t
+   splitBlock(uint32_t block, size_t offset)
+   {
+      auto split = newBlock();
+      auto &info = mBlocks[block];
+      auto &splitInfo = mBlocks[split];
+
+      splitInfo.offset = info.offset + static_cast<uint32_t>(offset);
+      splitInfo.size = info.size - static_cast<uint32_t>(offset);
+      splitInfo.prevPhys = block;
+      splitInfo.nextPhys = info.nextPhys;
+      info.size = static_cast<uint32_t>(offset);
+      info.nextPhys = split;
+
+      if (splitInfo.nextPhys != InvalidBlock) {
+         mBlocks[splitInfo.nextPhys].prevPhys = split;
+      }
+
+      return split;
+   }
+
+   //! Merges next into block, next must directly follow block
+   void
+   mergeBlocks(uint32_t block, uint32_t next)
+   {
+      auto &info = mBlocks[block];
+      auto &nextInfo = mBlocks[next];
+
+      info.size += nextInfo.size;
+      info.nextPhys = nextInfo.nextPhys;
+
+      if (info.nextPhys != InvalidBlock) {
+         mBlocks[info.nextPhys].prevPhys = block;
+      }
+
+      mUnusedBlocks.push_back(next);
+   }
+
+   uint32_t
+   newBlock()
+   {
+      auto block = uint32_t { 0 };
+
+      if (!mUnusedBlocks.empty()) {
+         block = mUnusedBlocks.back();
+         mUnusedBlocks.pop_back();
+      } else {
+         block = static_cast<uint32_t>(mBlocks.size());
+         mBlocks.emplace_back();
+      }
+
+      mBlocks[block] = MemoryBlock { 0, 0, InvalidBlock, InvalidBlock, InvalidBlock, InvalidBlock, false };
+      return block;
+   }
+
+   size_t
+   largestFreeSize()
+   {
+      unsigned long fl, sl;
+
+      if (!bit_scan_reverse(&fl, mFirstLevelMap)) {
+         return 0;
+      }
+
+      bit_scan_reverse(&sl, mSecondLevelMap[fl]);
+
+      // Blocks within a size class are not sorted, so check them all
+      auto largest = size_t { 0 };
+
+      for (auto block = mFreeLists[fl][sl]; block != InvalidBlock; block = mBlocks[block].nextFree) {
+         largest = std::max<size_t>(largest, mBlocks[block].size);
+      }
+
+      return largest;
    }
 
    uint8_t *mBuffer;
    size_t mSize;
-   std::vector<MemoryBlock> mFreeBlocks;
-   std::map<uint8_t *, MemoryBlock> mAllocatedBlocks;
+   size_t mFreeSize = 0;
+   size_t mUsedSize = 0;
+   size_t mPeakUsedSize = 0;
+   size_t mNumFreeBlocks = 0;
+   uint32_t mFirstLevelMap = 0;
+   uint32_t mSecondLevelMap[FirstLevelCount] = { 0 };
+   uint32_t mFreeLists[FirstLevelCount][SecondLevelCount];
+   std::vector<MemoryBlock> mBlocks;
+   std::vector<uint32_t> mUnusedBlocks;
+   std::unordered_map<uint8_t *, uint32_t> mAllocatedBlocks;
    std::mutex mMutex;
 };
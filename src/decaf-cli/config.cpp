@@ -21,9 +21,20 @@ namespace system
 {
 
 uint32_t timeout_ms = 0;
+uint32_t thread_stats_ms = 0;
+uint32_t snapshot_at_ms = 0;
+uint32_t snapshot_restore_ms = 0;
+uint32_t snapshot_restore_count = 1;
 
 } // namespace system
 
+namespace sound
+{
+
+std::string wav_path;
+
+} // namespace sound
+
 struct CerealDebugger
 {
    template <class Archive>
@@ -46,6 +57,7 @@ struct CerealLog
          CEREAL_NVP(to_file),
          CEREAL_NVP(to_stdout),
          CEREAL_NVP(kernel_trace),
+         CEREAL_NVP(binary_trace_path),
          CEREAL_NVP(level));
    }
 };
@@ -57,7 +69,10 @@ struct CerealJit
    {
       using namespace decaf::config::jit;
       ar(CEREAL_NVP(enabled),
-         CEREAL_NVP(verify));
+         CEREAL_NVP(verify),
+         CEREAL_NVP(perf_mode),
+         CEREAL_NVP(profile),
+         CEREAL_NVP(function_blocks));
    }
 };
 
@@ -66,8 +81,11 @@ struct CerealSound
    template <class Archive>
    void serialize(Archive &ar)
    {
+      using namespace sound;
       using namespace decaf::config::sound;
-      ar(CEREAL_NVP(dump_sounds));
+      ar(CEREAL_NVP(dump_sounds),
+         CEREAL_NVP(wav_path),
+         CEREAL_NVP(latency_ms));
    }
 };
 
@@ -80,7 +98,21 @@ struct CerealSystem
       using namespace decaf::config::system;
       ar(CEREAL_NVP(region),
          CEREAL_NVP(system_path),
-         CEREAL_NVP(timeout_ms));
+         CEREAL_NVP(timeout_ms),
+         CEREAL_NVP(thread_stats_ms),
+         CEREAL_NVP(snapshot_at_ms),
+         CEREAL_NVP(snapshot_restore_ms),
+         CEREAL_NVP(snapshot_restore_count),
+         CEREAL_NVP(loader_threads),
+         CEREAL_NVP(loader_cache_path),
+         CEREAL_NVP(expheap_free_index),
+         CEREAL_NVP(zlib_host_memory),
+         CEREAL_NVP(thread_pinning),
+         CEREAL_NVP(thread_numa_node),
+         CEREAL_NVP(thread_realtime),
+         CEREAL_NVP(huge_pages),
+         CEREAL_NVP(record_path),
+         CEREAL_NVP(replay_path));
    }
 };
 
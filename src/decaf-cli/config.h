@@ -8,6 +8,10 @@ namespace system
 {
 
 extern uint32_t timeout_ms;
+extern uint32_t thread_stats_ms;
+extern uint32_t snapshot_at_ms;
+extern uint32_t snapshot_restore_ms;
+extern uint32_t snapshot_restore_count;
 
 } // namespace system
 
@@ -21,6 +25,13 @@ extern std::string level;
 
 } // namespace log
 
+namespace sound
+{
+
+extern std::string wav_path;
+
+} // namespace sound
+
 bool load(const std::string &path);
 void save(const std::string &path);
 
@@ -2,6 +2,8 @@
 #include "config.h"
 #include "libdecaf/decaf_nullgraphicsdriver.h"
 #include "libdecaf/decaf_nullinputdriver.h"
+#include "libdecaf/decaf_nullsounddriver.h"
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
@@ -15,6 +17,7 @@ DecafCLI::run(const std::string &gamePath)
    // Setup drivers
    decaf::setGraphicsDriver(new decaf::NullGraphicsDriver());
    decaf::setInputDriver(new decaf::NullInputDriver());
+   decaf::setSoundDriver(new decaf::NullSoundDriver(config::sound::wav_path));
 
    // Initialise emulator
    if (!decaf::initialise(gamePath)) {
@@ -27,6 +30,8 @@ DecafCLI::run(const std::string &gamePath)
          decaf::getGraphicsDriver()->run();
       } };
 
+   decaf::placeGpuThread(&graphicsThread);
+
    // Setup timeout stuff
    std::atomic_bool running { true };
    std::atomic_bool timedOut { false };
@@ -49,12 +54,105 @@ DecafCLI::run(const std::string &gamePath)
          } };
    }
 
+   // Periodically dump guest thread stats
+   std::thread threadStatsThread;
+   std::mutex threadStatsMutex;
+   std::condition_variable threadStatsCV;
+   bool threadStatsRunning = true;
+
+   if (config::system::thread_stats_ms) {
+      threadStatsThread = std::thread {
+         [&]() {
+            auto interval = std::chrono::milliseconds(config::system::thread_stats_ms);
+            std::unique_lock<std::mutex> lock { threadStatsMutex };
+
+            while (!threadStatsCV.wait_for(lock, interval, [&]() { return !threadStatsRunning; })) {
+               gCliLog->info("Guest thread stats:\n{}", decaf::debugger::formatThreadStats());
+            }
+         } };
+   }
+
+   // Take a snapshot at a fixed time and restore it snapshot_restore_count
+   //  times, each time the game has run on for the same interval. This lets
+   //  one boot be measured from the same point over and over.
+   std::thread snapshotThread;
+   std::mutex snapshotMutex;
+   std::condition_variable snapshotCV;
+   bool snapshotRunning = true;
+
+   if (config::system::snapshot_at_ms) {
+      snapshotThread = std::thread {
+         [&]() {
+            auto start = std::chrono::steady_clock::now();
+            auto saveAt = start + std::chrono::milliseconds(config::system::snapshot_at_ms);
+            auto interval = std::chrono::milliseconds(config::system::snapshot_restore_ms - config::system::snapshot_at_ms);
+            auto totalTime = std::chrono::steady_clock::duration::zero();
+            auto maxTime = std::chrono::steady_clock::duration::zero();
+            auto restores = 0u;
+            std::unique_lock<std::mutex> lock { snapshotMutex };
+
+            if (snapshotCV.wait_until(lock, saveAt, [&]() { return !snapshotRunning; })) {
+               return;
+            }
+
+            if (!decaf::saveSnapshot() || config::system::snapshot_restore_ms <= config::system::snapshot_at_ms) {
+               return;
+            }
+
+            while (restores < config::system::snapshot_restore_count) {
+               if (snapshotCV.wait_for(lock, interval, [&]() { return !snapshotRunning; })) {
+                  break;
+               }
+
+               auto restoreStart = std::chrono::steady_clock::now();
+
+               if (!decaf::restoreSnapshot()) {
+                  break;
+               }
+
+               auto restoreTime = std::chrono::steady_clock::now() - restoreStart;
+               totalTime += restoreTime;
+               maxTime = std::max(maxTime, restoreTime);
+               restores++;
+            }
+
+            if (restores > 1) {
+               gCliLog->info("Restored the snapshot {} times, {:.2f} ms on average and {:.2f} ms at most",
+                             restores,
+                             std::chrono::duration<double, std::milli> { totalTime }.count() / restores,
+                             std::chrono::duration<double, std::milli> { maxTime }.count());
+            }
+         } };
+   }
+
    // Start emulator
    decaf::start();
 
    // Wait until program completes
    result = decaf::waitForExit();
 
+   // Stop waiting to take or restore a snapshot
+   if (snapshotThread.joinable()) {
+      {
+         std::unique_lock<std::mutex> lock { snapshotMutex };
+         snapshotRunning = false;
+      }
+
+      snapshotCV.notify_all();
+      snapshotThread.join();
+   }
+
+   // Stop dumping thread stats
+   if (threadStatsThread.joinable()) {
+      {
+         std::unique_lock<std::mutex> lock { threadStatsMutex };
+         threadStatsRunning = false;
+      }
+
+      threadStatsCV.notify_all();
+      threadStatsThread.join();
+   }
+
    // If we didn't timeout, wakeup timeout thread
    if (!timedOut.load()) {
       running.store(false);
@@ -37,7 +37,17 @@ getCommandLineParser()
       .add_option("jit",
                   description { "Enables the JIT engine." })
       .add_option("jit-verify",
-                  description { "Verify JIT implementation against interpreter." });
+                  description { "Verify JIT implementation against interpreter." })
+      .add_option("jit-perf",
+                  description { "Write JIT symbols for Linux perf to /tmp/perf-<pid>.map or /tmp/jit-<pid>.dump." },
+                  value<std::string> {},
+                  allowed<std::string> { {
+                     "off", "map", "jitdump"
+                  } })
+      .add_option("jit-profile",
+                  description { "Count JIT block entries and log the hottest blocks on exit." })
+      .add_option("jit-function-blocks",
+                  description { "Compile whole guest functions at once so branches within them stay in host code." });
 
    auto log_options = parser.add_option_group("Log Options")
       .add_option("log-file",
@@ -46,6 +56,9 @@ getCommandLineParser()
                   description { "Enable asynchronous logging." })
       .add_option("log-no-stdout",
                   description { "Disable logging to stdout." })
+      .add_option("log-binary-trace",
+                  description { "Write kernel and branch traces to this file in binary instead of the log." },
+                  value<std::string> {})
       .add_option("log-level",
                   description { "Only display logs with severity equal to or greater than this level." },
                   default_value<std::string> { "trace" },
@@ -67,19 +80,58 @@ getCommandLineParser()
       .add_option("sys-path",
                   description { "Where to locate any external system files." },
                   value<std::string> {})
+      .add_option("loader-cache",
+                  description { "Directory to store prelinked module images in." },
+                  value<std::string> {})
       .add_option("time-scale",
                   description { "Time scale factor for emulated clock." },
                   default_value<double> { 1.0 })
+      .add_option("record",
+                  description { "Record everything nondeterministic the game sees to this file." },
+                  value<std::string> {})
+      .add_option("replay",
+                  description { "Replay a file made with --record, running the same guest code again." },
+                  value<std::string> {})
       .add_option("timeout_ms",
                   description { "How long to execute the game for before quitting." },
+                  value<uint32_t> {})
+      .add_option("snapshot-at",
+                  description { "Take a snapshot this many milliseconds after the game starts." },
+                  value<uint32_t> {})
+      .add_option("snapshot-restore",
+                  description { "Restore the snapshot this many milliseconds after the game starts." },
+                  value<uint32_t> {})
+      .add_option("snapshot-restore-count",
+                  description { "Restore the snapshot this many times, letting the game run as long again between each." },
+                  value<uint32_t> {})
+      .add_option("sound-wav",
+                  description { "Write sound output to this WAV file." },
+                  value<std::string> {})
+      .add_option("sound-latency",
+                  description { "Amount of audio to buffer in milliseconds." },
+                  value<unsigned> {});
+
+   auto profiler_options = parser.add_option_group("Profiler Options")
+      .add_option("profile",
+                  description { "Sample guest execution and write collapsed stacks for flamegraphs to this path." },
+                  value<std::string> {})
+      .add_option("profile-rate",
+                  description { "Number of profiler samples per second for each core." },
+                  default_value<unsigned> { 1000 })
+      .add_option("thread-stats",
+                  description { "Log guest thread run, ready and blocked times every this many milliseconds." },
                   value<uint32_t> {});
 
    parser.add_command("play")
       .add_option_group(jit_options)
       .add_option_group(log_options)
+      .add_option_group(profiler_options)
       .add_option_group(sys_options)
       .add_argument("game directory", value<std::string> {});
 
+   parser.add_command("trace-dump")
+      .add_argument("trace file", value<std::string> {});
+
    return parser;
 }
 
@@ -117,6 +169,11 @@ start(excmd::parser &parser,
       std::exit(0);
    }
 
+   // Format a trace written with --log-binary-trace
+   if (options.has("trace-dump")) {
+      return decaf::dumpBinaryTrace(options.get<std::string>("trace file"), std::cout) ? 0 : -1;
+   }
+
    if (!options.has("play")) {
       return 0;
    }
@@ -142,6 +199,18 @@ start(excmd::parser &parser,
       decaf::config::jit::enabled = true;
    }
 
+   if (options.has("jit-perf")) {
+      decaf::config::jit::perf_mode = options.get<std::string>("jit-perf");
+   }
+
+   if (options.has("jit-profile")) {
+      decaf::config::jit::profile = true;
+   }
+
+   if (options.has("jit-function-blocks")) {
+      decaf::config::jit::function_blocks = true;
+   }
+
    if (options.has("log-no-stdout")) {
       config::log::to_stdout = true;
    }
@@ -158,6 +227,19 @@ start(excmd::parser &parser,
       config::log::level = options.get<std::string>("log-level");
    }
 
+   if (options.has("log-binary-trace")) {
+      decaf::config::log::binary_trace_path = options.get<std::string>("log-binary-trace");
+   }
+
+   if (options.has("profile")) {
+      decaf::config::profiler::enabled = true;
+      decaf::config::profiler::output_path = options.get<std::string>("profile");
+   }
+
+   if (options.has("profile-rate")) {
+      decaf::config::profiler::sample_rate = options.get<unsigned>("profile-rate");
+   }
+
    if (options.has("region")) {
       const std::string region = options.get<std::string>("region");
       if (region.compare("JAP") == 0) {
@@ -175,14 +257,50 @@ start(excmd::parser &parser,
       decaf::config::system::system_path = options.get<std::string>("sys-path");
    }
 
+   if (options.has("loader-cache")) {
+      decaf::config::system::loader_cache_path = options.get<std::string>("loader-cache");
+   }
+
    if (options.has("time-scale")) {
       decaf::config::system::time_scale = options.get<double>("time-scale");
    }
 
+   if (options.has("record")) {
+      decaf::config::system::record_path = options.get<std::string>("record");
+   }
+
+   if (options.has("replay")) {
+      decaf::config::system::replay_path = options.get<std::string>("replay");
+   }
+
    if (options.has("timeout_ms")) {
       config::system::timeout_ms = options.get<uint32_t>("timeout_ms");
    }
 
+   if (options.has("snapshot-at")) {
+      config::system::snapshot_at_ms = options.get<uint32_t>("snapshot-at");
+   }
+
+   if (options.has("snapshot-restore")) {
+      config::system::snapshot_restore_ms = options.get<uint32_t>("snapshot-restore");
+   }
+
+   if (options.has("snapshot-restore-count")) {
+      config::system::snapshot_restore_count = options.get<uint32_t>("snapshot-restore-count");
+   }
+
+   if (options.has("sound-wav")) {
+      config::sound::wav_path = options.get<std::string>("sound-wav");
+   }
+
+   if (options.has("sound-latency")) {
+      decaf::config::sound::latency_ms = options.get<unsigned>("sound-latency");
+   }
+
+   if (options.has("thread-stats")) {
+      config::system::thread_stats_ms = options.get<uint32_t>("thread-stats");
+   }
+
    auto gamePath = options.get<std::string>("game directory");
    auto logFile = getPathBasename(gamePath);
    auto logLevel = spdlog::level::info;
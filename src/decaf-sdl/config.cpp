@@ -90,7 +90,8 @@ struct CerealGPU
       using namespace decaf::config::gpu;
       ar(CEREAL_NVP(debug),
          CEREAL_NVP(debug_filters),
-         CEREAL_NVP(force_sync));
+         CEREAL_NVP(force_sync),
+         CEREAL_NVP(interrupt_interval_us));
    }
 };
 
@@ -118,6 +119,7 @@ struct CerealLog
          CEREAL_NVP(kernel_trace),
          CEREAL_NVP(kernel_trace_filters),
          CEREAL_NVP(branch_trace),
+         CEREAL_NVP(binary_trace_path),
          CEREAL_NVP(level));
    }
 };
@@ -129,7 +131,10 @@ struct CerealJit
    {
       using namespace decaf::config::jit;
       ar(CEREAL_NVP(enabled),
-         CEREAL_NVP(verify));
+         CEREAL_NVP(verify),
+         CEREAL_NVP(perf_mode),
+         CEREAL_NVP(profile),
+         CEREAL_NVP(function_blocks));
    }
 };
 
@@ -139,7 +144,8 @@ struct CerealSound
    void serialize(Archive &ar)
    {
       using namespace decaf::config::sound;
-      ar(CEREAL_NVP(dump_sounds));
+      ar(CEREAL_NVP(dump_sounds),
+         CEREAL_NVP(latency_ms));
    }
 };
 
@@ -150,7 +156,17 @@ struct CerealSystem
    {
       using namespace decaf::config::system;
       ar(CEREAL_NVP(region),
-         CEREAL_NVP(system_path));
+         CEREAL_NVP(system_path),
+         CEREAL_NVP(loader_threads),
+         CEREAL_NVP(loader_cache_path),
+         CEREAL_NVP(expheap_free_index),
+         CEREAL_NVP(zlib_host_memory),
+         CEREAL_NVP(thread_pinning),
+         CEREAL_NVP(thread_numa_node),
+         CEREAL_NVP(thread_realtime),
+         CEREAL_NVP(huge_pages),
+         CEREAL_NVP(record_path),
+         CEREAL_NVP(replay_path));
    }
 };
 
@@ -143,6 +143,8 @@ DecafSDL::run(const std::string &gamePath)
             initialiseContext();
             mGraphicsDriver->run();
          } };
+
+      decaf::placeGpuThread(&mGraphicsThread);
    } else {
       // Set the swap interval to 0 so that we don't slow
       //  down the GPU system when presenting...  The game should
@@ -195,6 +197,14 @@ DecafSDL::run(const std::string &gamePath)
                 shouldQuit = true;
             }
 
+            if (event.key.keysym.sym == SDLK_F5) {
+               startSnapshot(false);
+            }
+
+            if (event.key.keysym.sym == SDLK_F9) {
+               startSnapshot(true);
+            }
+
             decaf::injectKeyInput(translateKeyCode(event.key.keysym), decaf::input::KeyboardAction::Release);
             break;
          case SDL_TEXTINPUT:
@@ -220,6 +230,10 @@ DecafSDL::run(const std::string &gamePath)
       }
    }
 
+   if (mSnapshotThread.joinable()) {
+      mSnapshotThread.join();
+   }
+
    // Shut down decaf
    decaf::shutdown();
 
@@ -232,6 +246,30 @@ DecafSDL::run(const std::string &gamePath)
    return true;
 }
 
+// Snapshots wait for the GPU to go idle, which in force_sync mode needs this
+//  thread to keep polling it, so they are taken on a thread of their own.
+void
+DecafSDL::startSnapshot(bool restore)
+{
+   if (mSnapshotBusy.exchange(true)) {
+      return;
+   }
+
+   if (mSnapshotThread.joinable()) {
+      mSnapshotThread.join();
+   }
+
+   mSnapshotThread = std::thread { [this, restore]() {
+      if (restore) {
+         decaf::restoreSnapshot();
+      } else {
+         decaf::saveSnapshot();
+      }
+
+      mSnapshotBusy = false;
+   } };
+}
+
 void
 DecafSDL::onGameLoaded(const decaf::GameInfo &info)
 {
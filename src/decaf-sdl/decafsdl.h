@@ -2,7 +2,9 @@
 #include "decafsdl_sound.h"
 #include "libdecaf/decaf.h"
 #include <SDL.h>
+#include <atomic>
 #include <glbinding/gl/gl.h>
+#include <thread>
 
 using namespace decaf::input;
 
@@ -45,6 +47,9 @@ private:
    decaf::input::MouseButton
    translateMouseButton(int button);
 
+   void
+   startSnapshot(bool restore);
+
    // VPAD
    virtual vpad::Type
    getControllerType(vpad::Channel channel) override;
@@ -102,4 +107,7 @@ private:
    gl::GLuint mSampler;
 
    bool mToggleDRC = false;
+
+   std::thread mSnapshotThread;
+   std::atomic<bool> mSnapshotBusy { false };
 };
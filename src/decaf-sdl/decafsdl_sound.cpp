@@ -1,6 +1,7 @@
 #include "clilog.h"
 #include "common/decaf_assert.h"
 #include "decafsdl.h"
+#include "libdecaf/decaf_config.h"
 #include <SDL.h>
 
 bool
@@ -9,12 +10,16 @@ DecafSDLSound::start(unsigned outputRate,
 {
    mNumChannelsIn = numChannels;
    mNumChannelsOut = std::min(numChannels, 2u);  // TODO: support surround output
-   mOutputFrameLen = 1024;  // TODO: make this configurable (latency control)
+   mRing.reset(outputRate, mNumChannelsOut, decaf::config::sound::latency_ms);
 
-   // Set up the ring buffer with enough space for 3 output frames of audio
-   mOutputBuffer.resize(mOutputFrameLen * mNumChannelsOut * 3);
-   mBufferWritePos = 0;
-   mBufferReadPos = 0;
+   // Use a device buffer of at most half the target latency so the ring
+   //  can hold the rest, SDL wants a power of two.
+   auto maxFrameLen = outputRate * decaf::config::sound::latency_ms / 2000;
+   mOutputFrameLen = 256;
+
+   while (mOutputFrameLen * 2 <= maxFrameLen && mOutputFrameLen < 4096) {
+      mOutputFrameLen *= 2;
+   }
 
    SDL_AudioSpec audiospec;
    audiospec.format = AUDIO_S16LSB;
@@ -36,38 +41,17 @@ DecafSDLSound::start(unsigned outputRate,
 void
 DecafSDLSound::output(int16_t *samples, unsigned numSamples)
 {
-   // Discard channels from the input if necessary.
-   if (mNumChannelsIn != mNumChannelsOut) {
-      decaf_check(mNumChannelsOut < mNumChannelsIn);
-
-      for (auto sample = 1u; sample < numSamples; ++sample) {
-         for (auto channel = 0u; channel < mNumChannelsOut; channel++) {
-            samples[sample * mNumChannelsOut + channel] = samples[sample * mNumChannelsIn + channel];
-         }
-      }
-   }
-
-   // Copy to the output buffer, ignoring the possibility of overrun
-   //  (which should never happen anyway).
-   auto numSamplesOut = static_cast<size_t>(numSamples * mNumChannelsOut);
-
-   while (mBufferWritePos + numSamplesOut >= mOutputBuffer.size()) {
-      auto samplesToCopy = mOutputBuffer.size() - mBufferWritePos;
-      std::memcpy(&mOutputBuffer[mBufferWritePos], samples, samplesToCopy * 2);
-
-      mBufferWritePos = 0;
-      samples += samplesToCopy;
-      numSamplesOut -= samplesToCopy;
-   }
-
-   std::memcpy(&mOutputBuffer[mBufferWritePos], samples, numSamplesOut * 2);
-   mBufferWritePos += numSamplesOut;
+   // Any channels the device does not have are discarded by the ring
+   mRing.write(samples, numSamples, mNumChannelsIn);
 }
 
 void
 DecafSDLSound::stop()
 {
    SDL_CloseAudio();
+
+   auto stats = mRing.getStats();
+   gCliLog->info("Sound output stopped with {} underruns and {} overruns", stats.underruns, stats.overruns);
 }
 
 void
@@ -77,16 +61,6 @@ DecafSDLSound::sdlCallback(void *instance_, Uint8 *stream_, int size)
    int16_t *stream = reinterpret_cast<int16_t *>(stream_);
    decaf_check(size >= 0);
    decaf_check(size % (2 * instance->mNumChannelsOut) == 0);
-   auto numSamples = static_cast<size_t>(size) / 2;
-   auto samplesAvail = (instance->mBufferWritePos + instance->mOutputBuffer.size() - instance->mBufferReadPos) % instance->mOutputBuffer.size();
-
-   if (samplesAvail < numSamples) {
-      // Rather than outputting the partial frame, output a full frame of
-      //  silence to give audio generation a chance to catch up.
-      std::memset(stream, 0, size);
-   } else {
-      decaf_check(instance->mBufferReadPos + numSamples <= instance->mOutputBuffer.size());
-      std::memcpy(stream, &instance->mOutputBuffer[instance->mBufferReadPos], size);
-      instance->mBufferReadPos = (instance->mBufferReadPos + numSamples) % instance->mOutputBuffer.size();
-   }
+   auto numFrames = static_cast<size_t>(size) / (2 * instance->mNumChannelsOut);
+   instance->mRing.read(stream, numFrames);
 }
@@ -1,6 +1,6 @@
 #pragma once
 #include "libdecaf/decaf_sound.h"
-#include <vector>
+#include "libdecaf/decaf_soundring.h"
 #include <SDL.h>
 
 class DecafSDLSound : public decaf::SoundDriver
@@ -26,10 +26,8 @@ private:
    unsigned mNumChannelsOut; // Number of channels we send to the audio device
    unsigned mOutputFrameLen; // Number of samples (per channel) in an output frame
 
-   // Output buffer (ring buffer): written by output(), read by SDL callback
-   std::vector<int16_t> mOutputBuffer;
-   size_t mBufferWritePos; // Index of next sample (array element) to write
-   size_t mBufferReadPos;  // Index of next sample (array element) to read
+   // Written by output(), read by SDL callback
+   decaf::SoundRing mRing;
 
    static void
    sdlCallback(void *instance_, Uint8 *stream_, int size);
@@ -38,7 +38,17 @@ getCommandLineParser()
       .add_option("jit",
                   description { "Enables the JIT engine." })
       .add_option("jit-verify",
-                  description { "Verify JIT implementation against interpreter." });
+                  description { "Verify JIT implementation against interpreter." })
+      .add_option("jit-perf",
+                  description { "Write JIT symbols for Linux perf to /tmp/perf-<pid>.map or /tmp/jit-<pid>.dump." },
+                  value<std::string> {},
+                  allowed<std::string> { {
+                     "off", "map", "jitdump"
+                  } })
+      .add_option("jit-profile",
+                  description { "Count JIT block entries and log the hottest blocks on exit." })
+      .add_option("jit-function-blocks",
+                  description { "Compile whole guest functions at once so branches within them stay in host code." });
 
    auto log_options = parser.add_option_group("Log Options")
       .add_option("log-file",
@@ -47,6 +57,9 @@ getCommandLineParser()
                   description { "Enable asynchronous logging." })
       .add_option("log-no-stdout",
                   description { "Disable logging to stdout." })
+      .add_option("log-binary-trace",
+                  description { "Write kernel and branch traces to this file in binary instead of the log." },
+                  value<std::string> {})
       .add_option("log-level",
                   description { "Only display logs with severity equal to or greater than this level." },
                   default_value<std::string> { "trace" },
@@ -82,6 +95,9 @@ getCommandLineParser()
                   description{ "Enable stretching." })
       .add_option("sound",
                   description { "Enable sound output." })
+      .add_option("sound-latency",
+                  description { "Amount of audio to buffer in milliseconds, lower values increase the chance of crackling." },
+                  value<unsigned> {})
       .add_option("sys-path",
                   description { "Where to locate any external system files." },
                   value<std::string> {})
@@ -90,7 +106,13 @@ getCommandLineParser()
                   value<std::string> {})
       .add_option("time-scale",
                   description { "Time scale factor for emulated clock." },
-                  default_value<double> { 1.0 });
+                  default_value<double> { 1.0 })
+      .add_option("record",
+                  description { "Record everything nondeterministic the game sees to this file." },
+                  value<std::string> {})
+      .add_option("replay",
+                  description { "Replay a file made with --record, running the same guest code again." },
+                  value<std::string> {});
 
    parser.add_command("play")
       .add_option_group(jit_options)
@@ -160,6 +182,18 @@ start(excmd::parser &parser,
       decaf::config::jit::enabled = true;
    }
 
+   if (options.has("jit-perf")) {
+      decaf::config::jit::perf_mode = options.get<std::string>("jit-perf");
+   }
+
+   if (options.has("jit-profile")) {
+      decaf::config::jit::profile = true;
+   }
+
+   if (options.has("jit-function-blocks")) {
+      decaf::config::jit::function_blocks = true;
+   }
+
    if (options.has("log-no-stdout")) {
       config::log::to_stdout = true;
    }
@@ -176,6 +210,10 @@ start(excmd::parser &parser,
       config::log::level = options.get<std::string>("log-level");
    }
 
+   if (options.has("log-binary-trace")) {
+      decaf::config::log::binary_trace_path = options.get<std::string>("log-binary-trace");
+   }
+
    if (options.has("display-mode")) {
        auto mode = options.get<std::string>("display-mode");
 
@@ -230,6 +268,18 @@ start(excmd::parser &parser,
       decaf::config::system::time_scale = options.get<double>("time-scale");
    }
 
+   if (options.has("record")) {
+      decaf::config::system::record_path = options.get<std::string>("record");
+   }
+
+   if (options.has("replay")) {
+      decaf::config::system::replay_path = options.get<std::string>("replay");
+   }
+
+   if (options.has("sound-latency")) {
+      decaf::config::sound::latency_ms = options.get<unsigned>("sound-latency");
+   }
+
    auto gamePath = options.get<std::string>("game directory");
    auto logFile = getPathBasename(gamePath);
    auto logLevel = spdlog::level::info;
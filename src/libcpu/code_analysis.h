@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace cpu
+{
+
+/**
+ * Static analysis of guest code, shared by the JIT and the debugger.
+ *
+ * Each region of code, usually the text section of a loaded module, is
+ * decoded once in parallel and split into functions and basic blocks. The
+ * results are kept in sorted arrays per region and are published as an
+ * immutable snapshot, so lookups from any thread never take a lock.
+ */
+namespace analysis
+{
+
+enum BasicBlockFlags : uint32_t
+{
+   //! Execution can continue into the next block
+   BlockFallsThrough = 1 << 0,
+
+   //! Ends in a branch with a known target which is not a call
+   BlockBranches = 1 << 1,
+
+   //! Ends in a call with a known target
+   BlockCalls = 1 << 2,
+
+   //! Ends in a branch through LR or CTR
+   BlockIndirect = 1 << 3,
+
+   //! Ends with a word which does not decode to an instruction
+   BlockInvalid = 1 << 4,
+};
+
+struct Function
+{
+   uint32_t start;
+   uint32_t end;
+};
+
+struct BasicBlock
+{
+   uint32_t start;
+   uint32_t end;
+
+   //! Target of the branch the block ends in, if it has a known one
+   uint32_t target;
+
+   //! BasicBlockFlags
+   uint32_t flags;
+};
+
+//! A non-call branch with a known target
+struct BranchEdge
+{
+   uint32_t target;
+   uint32_t source;
+};
+
+struct CodeRegionInfo
+{
+   uint32_t start;
+   uint32_t end;
+
+   //! Known function entry points, such as exported or symbol addresses
+   std::vector<uint32_t> entryPoints;
+};
+
+//! Analyse new regions of code using up to numThreads threads
+void
+addRegions(const std::vector<CodeRegionInfo> &regions,
+           unsigned numThreads);
+
+void
+clear();
+
+bool
+findFunction(uint32_t address,
+             Function &function);
+
+bool
+findBlock(uint32_t address,
+          BasicBlock &block);
+
+//! Appends every function which starts within [start, end)
+void
+getFunctions(uint32_t start,
+             uint32_t end,
+             std::vector<Function> &functions);
+
+//! Appends every edge whose target is within [start, end), sorted by target
+void
+getBranchEdges(uint32_t start,
+               uint32_t end,
+               std::vector<BranchEdge> &edges);
+
+//! Appends every address within [start, end) which a branch or call is
+//  known to enter at, sorted and without duplicates
+void
+getBranchTargets(uint32_t start,
+                 uint32_t end,
+                 std::vector<uint32_t> &targets);
+
+} // namespace analysis
+
+} // namespace cpu
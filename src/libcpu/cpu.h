@@ -1,7 +1,10 @@
 #pragma once
+#include <array>
 #include <cstdint>
 #include <atomic>
 #include <functional>
+#include <string>
+#include <thread>
 #include <utility>
 #include "state.h"
 #include "common/types.h"
@@ -18,6 +21,7 @@ const uint32_t DBGBREAK_INTERRUPT = 1 << 3;
 const uint32_t GPU_RETIRE_INTERRUPT = 1 << 4;
 const uint32_t GPU_FLIP_INTERRUPT = 1 << 5;
 const uint32_t FS_DONE_INTERRUPT = 1 << 6;
+const uint32_t SNAPSHOT_INTERRUPT = 1 << 7;
 const uint32_t INTERRUPT_MASK = 0xFFFFFFFF;
 const uint32_t NONMASKABLE_INTERRUPTS = SRESET_INTERRUPT;
 
@@ -30,6 +34,12 @@ enum class jit_mode {
    verify
 };
 
+enum class jit_perf_mode {
+   disabled,
+   perf_map,
+   jitdump
+};
+
 static const uint32_t CALLBACK_ADDR = 0xFBADCDE0;
 
 using EntrypointHandler = void(*)();
@@ -37,6 +47,8 @@ using InterruptHandler = void (*)(uint32_t interrupt_flags);
 using SegfaultHandler = void(*)(uint32_t address);
 using IllInstHandler = void(*)();
 using BranchTraceHandler = void(*)(uint32_t target);
+using SymbolLookupHandler = const char *(*)(uint32_t address, uint32_t *symbolStart);
+using TimeBaseHandler = uint64_t (*)(uint64_t tb);
 using KernelCallFunction = void(*)(Core *state, void *userData);
 
 struct KernelCallEntry
@@ -45,12 +57,68 @@ struct KernelCallEntry
    void *user_data;
 };
 
+// A snapshot of a core's state which is taken from another thread without
+// any synchronisation, so it is only accurate enough for sampling.
+//
+// Under the JIT nia is the start of the block or branch target the core last
+// passed, as that is the last point the registers were written back. It is
+// only meaningful for blocks generated while JIT sampling was enabled.
+struct CoreSample
+{
+   uint32_t nia;
+   uint32_t lr;
+   uint32_t sp;
+   CoreActivity activity;
+};
+
+// Everything about a core which is not kept in guest memory
+struct CoreSnapshot
+{
+   CoreRegs regs;
+   Tracer *tracer;
+   uint32_t interruptMask;
+   uint32_t interrupt;
+   uint64_t reserve;
+
+   //! Time base value of the next alarm, UINT64_MAX if there is none
+   uint64_t nextAlarm;
+};
+
+struct StateSnapshot
+{
+   std::array<CoreSnapshot, 3> cores;
+
+   //! Time base value when the snapshot was taken
+   uint64_t tb;
+};
+
 void
 initialise();
 
+//! Releases host resources once the cores have been joined
+void
+shutdown();
+
 void
 setJitMode(jit_mode mode);
 
+void
+setJitPerfMode(jit_perf_mode mode);
+
+void
+setJitProfiling(bool enabled);
+
+//! Have JIT blocks store their guest address on entry so getCoreSample is
+//!  accurate, only affects blocks generated after it is enabled
+void
+setJitSampling(bool enabled);
+
+void
+setJitFunctionBlocks(bool enabled);
+
+void
+setJitHugePages(bool enabled);
+
 void
 setCoreEntrypointHandler(EntrypointHandler handler);
 
@@ -66,6 +134,14 @@ setIllInstHandler(IllInstHandler handler);
 void
 setBranchTraceHandler(BranchTraceHandler handler);
 
+void
+setSymbolLookupHandler(SymbolLookupHandler handler);
+
+//! Called whenever a core reads its own time base, returns the value the
+//  core sees instead.
+void
+setTimeBaseHandler(TimeBaseHandler handler);
+
 uint32_t
 registerKernelCall(const KernelCallEntry &entry);
 
@@ -81,6 +157,19 @@ halt();
 std::chrono::steady_clock::time_point
 tbToTimePoint(uint64_t ticks);
 
+//! Only consistent when no core is running guest code
+StateSnapshot
+captureState();
+
+//! Also winds the time base back to when the snapshot was taken, so guest
+//  time carries on from there.
+void
+restoreState(const StateSnapshot &snapshot);
+
+//! Moves the time base forward so it reads at least ticks, it never goes back
+void
+advanceTimeBase(uint64_t ticks);
+
 using Tracer = ::Tracer;
 
 Tracer *
@@ -107,6 +196,26 @@ removeBreakpoint(ppcaddr_t address,
 uint64_t *
 getJitFallbackStats();
 
+//! Returns a table of the count most expensive JIT blocks, only has any
+//!  entries when JIT profiling was enabled before the blocks were generated
+std::string
+formatJitProfile(size_t count);
+
+//! Forgets every JIT block so guest code is translated again when it next
+//!  runs. Every core must be stopped outside of JIT code.
+void
+invalidateJitCache();
+
+CoreSample
+getCoreSample(uint32_t core_idx);
+
+//! Host thread running a core, valid once cpu::start has been called
+std::thread &
+getCoreThread(uint32_t core_idx);
+
+std::thread &
+getTimerThread();
+
 namespace this_core
 {
 
@@ -137,6 +246,9 @@ clearInterrupt(uint32_t flags);
 void
 setNextAlarm(std::chrono::steady_clock::time_point alarm_time);
 
+void
+updateRoundingMode();
+
 cpu::Core *
 state();
 
@@ -3,6 +3,8 @@
 #include "common/bitutils.h"
 #include "common/decaf_assert.h"
 #include <algorithm>
+#include <array>
+#include <deque>
 
 namespace espresso
 {
@@ -61,6 +63,41 @@ struct TableEntry
    std::vector<FieldMap> fieldMaps;
 };
 
+/*
+ * The flat decode table.
+ *
+ * The first level is indexed by the primary opcode. Primary opcodes which
+ * hold more than one instruction have a second level indexed by bits 21-30,
+ * which covers every extended opcode field. Each slot then holds the mask and
+ * value of every opcode field of the one instruction which can be there, in
+ * the rare case more than one can they are chained through next.
+ */
+struct DecodeEntry
+{
+   uint32_t mask = 0;
+   uint32_t value = 0;
+   InstructionInfo *instr = nullptr;
+   DecodeEntry *next = nullptr;
+};
+
+struct DecodeTable
+{
+   uint32_t secondaryMask = 0;
+   std::vector<DecodeEntry> entries;
+};
+
+static const uint32_t
+SecondaryShift = 1;
+
+static const uint32_t
+SecondaryMask = 0x3FF;
+
+static std::array<DecodeTable, 64>
+sDecodeTable;
+
+static std::deque<DecodeEntry>
+sDecodeOverflow;
+
 static std::vector<InstructionInfo>
 sInstructionInfo;
 
@@ -164,6 +201,25 @@ encodeSPR(Instruction &instr, SPR spr)
 // Decode Instruction to InstructionInfo
 InstructionInfo *
 decodeInstruction(Instruction instr)
+{
+   auto &table = sDecodeTable[instr.value >> 26];
+   auto entry = &table.entries[(instr.value >> SecondaryShift) & table.secondaryMask];
+
+   do {
+      if ((instr.value & entry->mask) == entry->value) {
+         return entry->instr;
+      }
+
+      entry = entry->next;
+   } while (entry);
+
+   return nullptr;
+}
+
+// Decode Instruction to InstructionInfo by walking the instruction tree, this
+//  is much slower than decodeInstruction and only here to check it against.
+InstructionInfo *
+decodeInstructionTree(Instruction instr)
 {
    auto table = &sInstructionTable;
 
@@ -278,6 +334,67 @@ initialiseInstructionTable()
    }
 }
 
+static void
+addDecodeEntry(DecodeEntry &slot,
+               const DecodeEntry &entry)
+{
+   if (!slot.instr) {
+      slot = entry;
+      return;
+   }
+
+   // Keep the order the instructions were defined in
+   auto last = &slot;
+
+   while (last->next) {
+      last = last->next;
+   }
+
+   sDecodeOverflow.push_back(entry);
+   last->next = &sDecodeOverflow.back();
+}
+
+// Initialise the flat decode table
+static void
+initialiseDecodeTable()
+{
+   std::array<uint32_t, 64> instrCount = { };
+
+   for (auto &instr : sInstructionInfo) {
+      decaf_check(instr.opcode[0].field == InstructionField::opcd);
+      instrCount[instr.opcode[0].value]++;
+   }
+
+   for (auto i = 0u; i < sDecodeTable.size(); ++i) {
+      auto &table = sDecodeTable[i];
+      table.secondaryMask = instrCount[i] > 1 ? SecondaryMask : 0;
+      table.entries.resize(table.secondaryMask + 1);
+   }
+
+   for (auto &instr : sInstructionInfo) {
+      auto entry = DecodeEntry { };
+      entry.instr = &instr;
+
+      for (auto &op : instr.opcode) {
+         auto start = getInstructionFieldStart(op.field);
+         entry.mask |= getInstructionFieldBitmask(op.field);
+         entry.value |= op.value << start;
+      }
+
+      auto &table = sDecodeTable[instr.opcode[0].value];
+
+      // Add the instruction to every slot whose index bits agree with it
+      auto keyMask = (entry.mask >> SecondaryShift) & table.secondaryMask;
+      auto keyValue = (entry.value >> SecondaryShift) & table.secondaryMask;
+
+      for (auto key = 0u; key <= table.secondaryMask; ++key) {
+         if ((key & keyMask) == keyValue) {
+            addDecodeEntry(table.entries[key], entry);
+         }
+      }
+   }
+}
+
 static std::string
 cleanInsName(const std::string& name)
 {
@@ -363,8 +480,9 @@ initialiseInstructionSet()
    // Populate sInstructionAlias
 #  include "espresso_instruction_aliases.inl"
 
-   // Create instruction table
+   // Create instruction tables
    initialiseInstructionTable();
+   initialiseDecodeTable();
 };
 
 #undef INS
@@ -4,6 +4,11 @@
 #include "common/types.h"
 #include <cassert>
 
+namespace platform
+{
+struct MemorySnapshot;
+}
+
 namespace mem
 {
 
@@ -47,6 +52,22 @@ enum AddressSpace : ppcaddr_t
    LoaderSize        = LoaderEnd - LoaderBase,
 };
 
+enum class HugePages
+{
+   Disabled,
+
+   //! Transparent huge pages, where the host supports them
+   Transparent,
+
+   //! Huge pages the host has set aside, falling back to transparent ones
+   Explicit,
+};
+
+//! How MEM1, MEM2 and the foreground bucket are backed, must be set before
+//  initialise is called
+void
+setHugePages(HugePages mode);
+
 void
 initialise();
 
@@ -59,6 +80,16 @@ valid(ppcaddr_t address);
 bool
 protect(ppcaddr_t address, size_t size);
 
+//! Starts a copy-on-write snapshot of every mapped region, returns nullptr if
+//  the host does not support it
+platform::MemorySnapshot *
+captureSnapshot();
+
+//! Replaces every mapped region with the contents of a snapshot, the pages are
+//  only read in as they are touched
+bool
+restoreSnapshot(platform::MemorySnapshot *snapshot);
+
 // Translate WiiU virtual address to host address
 template<typename Type = uint8_t>
 inline Type *
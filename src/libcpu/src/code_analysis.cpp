@@ -0,0 +1,443 @@
+#include "common/bitutils.h"
+#include "code_analysis.h"
+#include "espresso/espresso_instructionset.h"
+#include "mem.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace cpu
+{
+
+namespace analysis
+{
+
+// Number of instructions each worker decodes at a time
+static const uint32_t
+ChunkInstructions = 0x4000;
+
+struct CodeRegion
+{
+   uint32_t start;
+   uint32_t end;
+   std::vector<Function> functions;
+   std::vector<BasicBlock> blocks;
+   std::vector<BranchEdge> edges;
+};
+
+using RegionList = std::vector<std::shared_ptr<const CodeRegion>>;
+
+// Readers take a reference to the current list, writers replace it
+static std::shared_ptr<const RegionList>
+sRegions = std::make_shared<RegionList>();
+
+static std::mutex
+sWriteMutex;
+
+// A word which ends a basic block
+struct BlockEnd
+{
+   uint32_t address;
+   uint32_t target;
+   uint32_t flags;
+};
+
+static bool
+decodeBlockEnd(uint32_t address,
+               BlockEnd &end)
+{
+   auto instr = mem::read<espresso::Instruction>(address);
+   auto data = espresso::decodeInstruction(instr);
+   end.address = address;
+   end.target = 0;
+
+   if (!data) {
+      end.flags = BlockInvalid;
+      return true;
+   }
+
+   // A BO with bits 0 and 2 set ignores both CTR and the condition
+   auto isAlways = (instr.bo & 0x14) == 0x14;
+
+   switch (data->id) {
+   case espresso::InstructionID::b:
+      end.target = sign_extend<26>(instr.li << 2) + (instr.aa ? 0 : address);
+      end.flags = instr.lk ? (BlockCalls | BlockFallsThrough) : BlockBranches;
+      return true;
+   case espresso::InstructionID::bc:
+      end.target = sign_extend<16>(instr.bd << 2) + (instr.aa ? 0 : address);
+
+      if (instr.lk) {
+         end.flags = BlockCalls | BlockFallsThrough;
+      } else {
+         end.flags = BlockBranches | (isAlways ? 0 : BlockFallsThrough);
+      }
+      return true;
+   case espresso::InstructionID::bclr:
+   case espresso::InstructionID::bcctr:
+      end.flags = BlockIndirect | ((instr.lk || !isAlways) ? BlockFallsThrough : 0);
+      return true;
+   default:
+      return false;
+   }
+}
+
+static void
+decodeChunk(uint32_t start,
+            uint32_t end,
+            std::vector<BlockEnd> &ends)
+{
+   auto blockEnd = BlockEnd { };
+
+   for (auto address = start; address < end; address += 4) {
+      if (decodeBlockEnd(address, blockEnd)) {
+         ends.push_back(blockEnd);
+      }
+   }
+}
+
+static std::shared_ptr<CodeRegion>
+buildRegion(const CodeRegionInfo &info,
+            const std::vector<BlockEnd> &ends)
+{
+   auto region = std::make_shared<CodeRegion>();
+   region->start = info.start;
+   region->end = info.end;
+
+   auto inRegion = [&](uint32_t address) {
+      return address >= info.start && address < info.end && !(address & 3);
+   };
+
+   // Functions start at the known entry points and at every call target
+   auto entries = std::vector<uint32_t> { info.start };
+
+   for (auto entry : info.entryPoints) {
+      if (inRegion(entry)) {
+         entries.push_back(entry);
+      }
+   }
+
+   for (auto &end : ends) {
+      if ((end.flags & BlockCalls) && inRegion(end.target)) {
+         entries.push_back(end.target);
+      }
+   }
+
+   std::sort(entries.begin(), entries.end());
+   entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+   region->functions.reserve(entries.size());
+
+   for (auto i = 0u; i < entries.size(); ++i) {
+      auto next = (i + 1 < entries.size()) ? entries[i + 1] : info.end;
+      region->functions.push_back(Function { entries[i], next });
+   }
+
+   // Blocks start at function entries, branch targets and after block ends
+   auto leaders = std::move(entries);
+
+   for (auto &end : ends) {
+      if (end.flags & BlockBranches) {
+         if (inRegion(end.target)) {
+            leaders.push_back(end.target);
+            region->edges.push_back(BranchEdge { end.target, end.address });
+         }
+      }
+
+      if (end.flags & BlockInvalid) {
+         leaders.push_back(end.address);
+      }
+
+      if (end.address + 4 < info.end) {
+         leaders.push_back(end.address + 4);
+      }
+   }
+
+   std::sort(leaders.begin(), leaders.end());
+   leaders.erase(std::unique(leaders.begin(), leaders.end()), leaders.end());
+
+   std::sort(region->edges.begin(), region->edges.end(),
+             [](const BranchEdge &lhs, const BranchEdge &rhs) {
+                return lhs.target < rhs.target || (lhs.target == rhs.target && lhs.source < rhs.source);
+             });
+
+   // Every block end is followed by a leader, so a block can only contain
+   //  a block end as its last instruction.
+   region->blocks.reserve(leaders.size());
+   auto endItr = ends.begin();
+
+   for (auto i = 0u; i < leaders.size(); ++i) {
+      auto block = BasicBlock { };
+      block.start = leaders[i];
+      block.end = (i + 1 < leaders.size()) ? leaders[i + 1] : info.end;
+      block.flags = BlockFallsThrough;
+
+      while (endItr != ends.end() && endItr->address < block.end) {
+         if (endItr->address + 4 == block.end) {
+            block.target = endItr->target;
+            block.flags = endItr->flags;
+         }
+
+         ++endItr;
+      }
+
+      region->blocks.push_back(block);
+   }
+
+   return region;
+}
+
+static std::shared_ptr<const CodeRegion>
+findRegion(const RegionList &regions,
+           uint32_t address)
+{
+   auto itr = std::upper_bound(regions.begin(), regions.end(), address,
+                               [](uint32_t address, const std::shared_ptr<const CodeRegion> &region) {
+                                  return address < region->start;
+                               });
+
+   if (itr == regions.begin()) {
+      return nullptr;
+   }
+
+   --itr;
+
+   if (address >= (*itr)->end) {
+      return nullptr;
+   }
+
+   return *itr;
+}
+
+// Finds the last element of a sorted array which starts at or before address
+template<typename Type>
+static const Type *
+findContaining(const std::vector<Type> &list,
+               uint32_t address)
+{
+   auto itr = std::upper_bound(list.begin(), list.end(), address,
+                               [](uint32_t address, const Type &item) {
+                                  return address < item.start;
+                               });
+
+   if (itr == list.begin()) {
+      return nullptr;
+   }
+
+   --itr;
+
+   if (address >= itr->end) {
+      return nullptr;
+   }
+
+   return &*itr;
+}
+
+void
+addRegions(const std::vector<CodeRegionInfo> &regions,
+           unsigned numThreads)
+{
+   struct Chunk
+   {
+      size_t region;
+      uint32_t start;
+      uint32_t end;
+      std::vector<BlockEnd> ends;
+   };
+
+   // Split every region into chunks which can be decoded independently
+   auto chunks = std::vector<Chunk> { };
+
+   for (auto i = 0u; i < regions.size(); ++i) {
+      auto &region = regions[i];
+
+      for (auto start = region.start; start < region.end; ) {
+         auto end = static_cast<uint32_t>(std::min<uint64_t>(region.end, uint64_t { start } + ChunkInstructions * 4));
+         chunks.push_back(Chunk { i, start, end, { } });
+         start = end;
+      }
+   }
+
+   numThreads = std::max(1u, std::min<unsigned>(numThreads, static_cast<unsigned>(chunks.size())));
+
+   std::atomic<size_t> nextChunk { 0 };
+   auto worker = [&]() {
+      for (auto i = nextChunk++; i < chunks.size(); i = nextChunk++) {
+         decodeChunk(chunks[i].start, chunks[i].end, chunks[i].ends);
+      }
+   };
+
+   auto threads = std::vector<std::thread> { };
+
+   for (auto i = 1u; i < numThreads; ++i) {
+      threads.emplace_back(worker);
+   }
+
+   worker();
+
+   for (auto &thread : threads) {
+      thread.join();
+   }
+
+   // Chunks are in address order so their results can simply be joined
+   auto built = std::vector<std::shared_ptr<const CodeRegion>> { };
+   auto chunkItr = chunks.begin();
+
+   for (auto i = 0u; i < regions.size(); ++i) {
+      auto ends = std::vector<BlockEnd> { };
+
+      for (; chunkItr != chunks.end() && chunkItr->region == i; ++chunkItr) {
+         ends.insert(ends.end(), chunkItr->ends.begin(), chunkItr->ends.end());
+      }
+
+      built.push_back(buildRegion(regions[i], ends));
+   }
+
+   // Publish a new list with the new regions replacing any they overlap
+   std::unique_lock<std::mutex> lock { sWriteMutex };
+   auto list = std::make_shared<RegionList>();
+
+   for (auto &region : *std::atomic_load(&sRegions)) {
+      auto overlaps = std::any_of(built.begin(), built.end(),
+                                  [&](const std::shared_ptr<const CodeRegion> &other) {
+                                     return region->start < other->end && other->start < region->end;
+                                  });
+
+      if (!overlaps) {
+         list->push_back(region);
+      }
+   }
+
+   list->insert(list->end(), built.begin(), built.end());
+
+   std::sort(list->begin(), list->end(),
+             [](const std::shared_ptr<const CodeRegion> &lhs, const std::shared_ptr<const CodeRegion> &rhs) {
+                return lhs->start < rhs->start;
+             });
+
+   std::atomic_store(&sRegions, std::shared_ptr<const RegionList> { list });
+}
+
+void
+clear()
+{
+   std::unique_lock<std::mutex> lock { sWriteMutex };
+   std::atomic_store(&sRegions, std::shared_ptr<const RegionList> { std::make_shared<RegionList>() });
+}
+
+bool
+findFunction(uint32_t address,
+             Function &function)
+{
+   auto regions = std::atomic_load(&sRegions);
+   auto region = findRegion(*regions, address);
+
+   if (!region) {
+      return false;
+   }
+
+   auto found = findContaining(region->functions, address);
+
+   if (!found) {
+      return false;
+   }
+
+   function = *found;
+   return true;
+}
+
+bool
+findBlock(uint32_t address,
+          BasicBlock &block)
+{
+   auto regions = std::atomic_load(&sRegions);
+   auto region = findRegion(*regions, address);
+
+   if (!region) {
+      return false;
+   }
+
+   auto found = findContaining(region->blocks, address);
+
+   if (!found) {
+      return false;
+   }
+
+   block = *found;
+   return true;
+}
+
+void
+getFunctions(uint32_t start,
+             uint32_t end,
+             std::vector<Function> &functions)
+{
+   auto regions = std::atomic_load(&sRegions);
+
+   for (auto &region : *regions) {
+      if (region->end <= start || region->start >= end) {
+         continue;
+      }
+
+      auto itr = std::lower_bound(region->functions.begin(), region->functions.end(), start,
+                                  [](const Function &function, uint32_t address) {
+                                     return function.start < address;
+                                  });
+
+      for (; itr != region->functions.end() && itr->start < end; ++itr) {
+         functions.push_back(*itr);
+      }
+   }
+}
+
+void
+getBranchEdges(uint32_t start,
+               uint32_t end,
+               std::vector<BranchEdge> &edges)
+{
+   auto regions = std::atomic_load(&sRegions);
+
+   for (auto &region : *regions) {
+      if (region->end <= start || region->start >= end) {
+         continue;
+      }
+
+      auto itr = std::lower_bound(region->edges.begin(), region->edges.end(), start,
+                                  [](const BranchEdge &edge, uint32_t address) {
+                                     return edge.target < address;
+                                  });
+
+      for (; itr != region->edges.end() && itr->target < end; ++itr) {
+         edges.push_back(*itr);
+      }
+   }
+}
+
+void
+getBranchTargets(uint32_t start,
+                 uint32_t end,
+                 std::vector<uint32_t> &targets)
+{
+   auto first = targets.size();
+   auto edges = std::vector<BranchEdge> { };
+   auto functions = std::vector<Function> { };
+   getBranchEdges(start, end, edges);
+   getFunctions(start, end, functions);
+
+   for (auto &edge : edges) {
+      targets.push_back(edge.target);
+   }
+
+   for (auto &function : functions) {
+      targets.push_back(function.start);
+   }
+
+   std::sort(targets.begin() + first, targets.end());
+   targets.erase(std::unique(targets.begin() + first, targets.end()), targets.end());
+}
+
+} // namespace analysis
+
+} // namespace cpu
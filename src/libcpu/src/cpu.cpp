@@ -35,9 +35,30 @@ gIllInstHandler;
 BranchTraceHandler
 gBranchTraceHandler;
 
+SymbolLookupHandler
+gSymbolLookupHandler;
+
+TimeBaseHandler
+gTimeBaseHandler;
+
 jit_mode
 gJitMode = jit_mode::disabled;
 
+jit_perf_mode
+gJitPerfMode = jit_perf_mode::disabled;
+
+bool
+gJitProfiling = false;
+
+bool
+gJitSampling = false;
+
+bool
+gJitFunctionBlocks = false;
+
+bool
+gJitHugePages = false;
+
 Core
 gCore[3];
 
@@ -57,12 +78,48 @@ initialise()
    sStartupTime = std::chrono::steady_clock::now();
 }
 
+void
+shutdown()
+{
+   cpu::jit::shutdown();
+}
+
 void
 setJitMode(jit_mode mode)
 {
    gJitMode = mode;
 }
 
+void
+setJitPerfMode(jit_perf_mode mode)
+{
+   gJitPerfMode = mode;
+}
+
+void
+setJitProfiling(bool enabled)
+{
+   gJitProfiling = enabled;
+}
+
+void
+setJitSampling(bool enabled)
+{
+   gJitSampling = enabled;
+}
+
+void
+setJitFunctionBlocks(bool enabled)
+{
+   gJitFunctionBlocks = enabled;
+}
+
+void
+setJitHugePages(bool enabled)
+{
+   gJitHugePages = enabled;
+}
+
 static void
 coreSegfaultEntry()
 {
@@ -200,6 +257,18 @@ setBranchTraceHandler(BranchTraceHandler handler)
    gBranchTraceHandler = handler;
 }
 
+void
+setSymbolLookupHandler(SymbolLookupHandler handler)
+{
+   gSymbolLookupHandler = handler;
+}
+
+void
+setTimeBaseHandler(TimeBaseHandler handler)
+{
+   gTimeBaseHandler = handler;
+}
+
 std::chrono::steady_clock::time_point
 tbToTimePoint(uint64_t ticks)
 {
@@ -208,11 +277,114 @@ tbToTimePoint(uint64_t ticks)
    return sStartupTime + nanos;
 }
 
+StateSnapshot
+captureState()
+{
+   std::unique_lock<std::mutex> lock { gTimerMutex };
+   auto snapshot = StateSnapshot { };
+   snapshot.tb = gCore[0].tb();
+
+   for (auto i = 0; i < 3; ++i) {
+      auto &core = gCore[i];
+      auto &saved = snapshot.cores[i];
+      saved.regs = core;
+      saved.tracer = core.tracer;
+      saved.interruptMask = core.interrupt_mask;
+      saved.interrupt = core.interrupt.load() & ~SNAPSHOT_INTERRUPT;
+      saved.reserve = core.reserve;
+
+      if (core.next_alarm == std::chrono::steady_clock::time_point::max()) {
+         saved.nextAlarm = UINT64_MAX;
+      } else {
+         saved.nextAlarm = std::chrono::duration_cast<TimerDuration>(core.next_alarm - sStartupTime).count();
+      }
+   }
+
+   return snapshot;
+}
+
+void
+restoreState(const StateSnapshot &snapshot)
+{
+   std::unique_lock<std::mutex> lock { gTimerMutex };
+   auto elapsed = std::chrono::duration_cast<std::chrono::steady_clock::duration>(TimerDuration { snapshot.tb });
+   sStartupTime = std::chrono::steady_clock::now() - elapsed;
+
+   for (auto i = 0; i < 3; ++i) {
+      auto &core = gCore[i];
+      auto &saved = snapshot.cores[i];
+      static_cast<CoreRegs &>(core) = saved.regs;
+      core.tracer = saved.tracer;
+      core.interrupt_mask = saved.interruptMask;
+      core.interrupt.store(saved.interrupt);
+      core.reserve = saved.reserve;
+
+      if (saved.nextAlarm == UINT64_MAX) {
+         core.next_alarm = std::chrono::steady_clock::time_point::max();
+      } else {
+         core.next_alarm = tbToTimePoint(saved.nextAlarm);
+      }
+   }
+
+   gTimerCondition.notify_all();
+}
+
+void
+advanceTimeBase(uint64_t ticks)
+{
+   std::unique_lock<std::mutex> lock { gTimerMutex };
+   auto now = std::chrono::steady_clock::now();
+   auto elapsed = std::chrono::duration_cast<std::chrono::steady_clock::duration>(TimerDuration { ticks });
+
+   if (now - sStartupTime < elapsed) {
+      sStartupTime = now - elapsed;
+   }
+
+   gTimerCondition.notify_all();
+}
+
+void
+invalidateJitCache()
+{
+   if (gJitMode != jit_mode::disabled) {
+      jit::invalidateCache();
+   }
+}
+
+CoreSample
+getCoreSample(uint32_t core_idx)
+{
+   auto &core = gCore[core_idx];
+   auto sample = CoreSample {};
+   sample.nia = (gJitMode == jit_mode::disabled) ? core.nia : core.cia;
+   sample.lr = core.lr;
+   sample.sp = core.gpr[1];
+   sample.activity = core.activity.load(std::memory_order_relaxed);
+   return sample;
+}
+
+std::thread &
+getCoreThread(uint32_t core_idx)
+{
+   return gCore[core_idx].thread;
+}
+
+std::thread &
+getTimerThread()
+{
+   return gTimerThread;
+}
+
 uint64_t
 Core::tb()
 {
    auto now = std::chrono::steady_clock::now();
    auto ticks = std::chrono::duration_cast<TimerDuration>(now - sStartupTime);
+
+   if (gTimeBaseHandler && this == tCurrentCore) {
+      return gTimeBaseHandler(ticks.count());
+   }
+
    return ticks.count();
 }
 
@@ -249,9 +421,11 @@ void
 executeSub()
 {
    auto lr = tCurrentCore->lr;
+   auto activity = tCurrentCore->activity.exchange(CoreActivity::Guest, std::memory_order_relaxed);
    tCurrentCore->lr = CALLBACK_ADDR;
    resume();
    tCurrentCore->lr = lr;
+   tCurrentCore->activity.store(activity, std::memory_order_relaxed);
 }
 
 void
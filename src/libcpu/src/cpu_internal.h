@@ -20,9 +20,30 @@ gInterruptHandler;
 extern BranchTraceHandler
 gBranchTraceHandler;
 
+extern SymbolLookupHandler
+gSymbolLookupHandler;
+
 extern jit_mode
 gJitMode;
 
+extern jit_perf_mode
+gJitPerfMode;
+
+extern bool
+gJitProfiling;
+
+extern bool
+gJitSampling;
+
+extern bool
+gJitFunctionBlocks;
+
+extern bool
+gJitHugePages;
+
+extern std::mutex
+gTimerMutex;
+
 extern std::condition_variable
 gTimerCondition;
 
@@ -41,12 +62,4 @@ timerEntryPoint();
 KernelCallEntry *
 getKernelCall(uint32_t id);
 
-namespace this_core
-{
-
-void
-updateRoundingMode();
-
-} // namespace this_core
-
 } // namespace cpu
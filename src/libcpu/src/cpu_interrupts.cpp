@@ -128,7 +128,9 @@ waitForInterrupt()
          gInterruptHandler(flags);
          lock.lock();
       } else {
+         auto activity = core->activity.exchange(CoreActivity::WaitForInterrupt, std::memory_order_relaxed);
          gInterruptCondition.wait(lock);
+         core->activity.store(activity, std::memory_order_relaxed);
       }
    }
 }
@@ -275,7 +275,10 @@ kc(cpu::Core *state, Instruction instr)
    auto kc = cpu::getKernelCall(id);
    decaf_assert(kc, fmt::format("Encountered invalid Kernel Call ID {}", id));
 
+   // The kernel call may switch us to a different core
+   auto activity = state->activity.exchange(cpu::CoreActivity::KernelCall, std::memory_order_relaxed);
    kc->func(state, kc->user_data);
+   cpu::this_core::state()->activity.store(activity, std::memory_order_relaxed);
 }
 
 // Trap Word (Debug Interrupt?)
@@ -3,12 +3,16 @@
 #include "common/bitutils.h"
 #include "common/decaf_assert.h"
 #include "common/fastregionmap.h"
+#include "code_analysis.h"
 #include "cpu.h"
 #include "cpu_internal.h"
 #include "espresso/espresso_instructionset.h"
 #include "jit.h"
 #include "jit_internal.h"
 #include "jit_insreg.h"
+#include "jit_memloop.h"
+#include "jit_perf.h"
+#include "jit_profile.h"
 #include "jit_verify.h"
 #include "jit_vmemruntime.h"
 #include "mem.h"
@@ -16,6 +20,7 @@
 #include <array>
 #include <cfenv>
 #include <map>
+#include <mutex>
 #include <vector>
 
 namespace cpu
@@ -27,6 +32,7 @@ namespace jit
 static const bool JIT_DEBUG = true;
 static const int JIT_MAX_INST = 3000;
 static const bool JIT_REGCACHE = true;
+static const bool JIT_MEMORY_LOOPS = true;
 
 // Insert NOPs at the beginning of a generated block of code.
 //  The Visual Studio disassembler can get confused without these.
@@ -46,6 +52,13 @@ sRuntime;
 static FastRegionMap<JitCode>
 sJitBlocks;
 
+//! Target of every relocation generated, so they can be unlinked again
+static std::mutex
+sRelocationMutex;
+
+static std::vector<uint64_t *>
+sRelocationSlots;
+
 static std::array<uint8_t, 32>
 sBaseRelocCode;
 
@@ -227,7 +240,10 @@ initStubs()
       a.jmp(verifyLabel);
    }
 
+   auto stubSize = a.getCodeSize();
    auto basePtr = a.make();
+   perfRegisterStubs(basePtr, stubSize);
+
    gCallFn = asmjit_cast<JitCall>(basePtr, a.getLabelOffset(introLabel));
    gFinaleFn = asmjit_cast<JitCall>(basePtr, a.getLabelOffset(extroLabel));
    if (gJitMode == jit_mode::verify) {
@@ -254,7 +270,7 @@ initStubs()
 void
 initialiseRuntime()
 {
-   sRuntime = new VMemRuntime(0x20000, 0x40000000);
+   sRuntime = new VMemRuntime(0x20000, 0x40000000, gJitHugePages);
    initStubs();
    registerUnwindTable(sRuntime, reinterpret_cast<intptr_t>(gCallFn));
 }
@@ -272,6 +288,8 @@ freeRuntime()
 void
 initialise()
 {
+   perfInitialise();
+   profileInitialise();
    initialiseRuntime();
 
    sInstructionMap.resize(static_cast<size_t>(espresso::InstructionID::InstructionCount), nullptr);
@@ -286,6 +304,13 @@ initialise()
    registerSystemInstructions();
 }
 
+void
+shutdown()
+{
+   // The generated code is left alone, only the perf output is closed
+   perfShutdown();
+}
+
 jitinstrfptr_t
 getInstructionHandler(espresso::InstructionID id)
 {
@@ -317,9 +342,32 @@ clearCache()
    //  nobody currently executing code!
 
    freeRuntime();
+   perfClearCache();
    initialiseRuntime();
 
    sJitBlocks.clear();
+
+   std::unique_lock<std::mutex> lock { sRelocationMutex };
+   sRelocationSlots.clear();
+}
+
+void
+invalidateCache()
+{
+   // Note: Like clearCache, nobody may be executing code. The generated code
+   //  is kept as host stacks may still return into it, but every branch out
+   //  of a block goes through a relocation slot so nothing will branch to
+   //  it again.
+   sJitBlocks.clear();
+
+   std::unique_lock<std::mutex> lock { sRelocationMutex };
+   auto finale = static_cast<uint64_t>(asmjit::Ptr(gFinaleFn));
+
+   for (auto slot : sRelocationSlots) {
+      *slot = finale;
+   }
+
+   sRelocationSlots.clear();
 }
 
 using JumpTargetList = std::vector<uint32_t>;
@@ -329,29 +377,30 @@ jit_b_direct(PPCEmuAssembler& a, ppcaddr_t addr)
 {
    a.saveAll();
 
-   auto target = sJitBlocks.find(addr);
-   if (target) {
-      // We already know where this function is, let's just jump
-      //  directly to it rather than wasting time going through
-      //  the JIT dispatcher!
-      a.jmp(asmjit::Ptr(target));
-   } else {
-      // We have not JIT'd this section yet.  Let's allocate some
-      //  space for an aligned MOV instruction, then mark it as a
-      //  relocation so it can be filled by the 'linker' below.
-      auto relocLbl = a.newLabel();
-      a.bind(relocLbl);
-
-      // Save 32 bytes of memory so we have room to do set up the
-      //  call during relocation once we know where its going to
-      //  reside in the host jit memory section.
-      for (auto i = 0; i < 32; ++i) {
-         a.int3();
-      }
-      a.jmp(asmjit::x86::rax);
+   auto label = a.targetLabels.find(addr);
+   if (label != a.targetLabels.end()) {
+      // This is within the block we are generating, so the branch never
+      //  has to leave the host code.
+      a.jmp(label->second);
+      return;
+   }
 
-      a.relocLabels.emplace_back(addr, relocLbl);
+   // Every branch out of the block goes through a relocation, even when we
+   //  already know where the target is, so invalidateCache can unlink it.
+   //  Let's allocate some space for an aligned MOV instruction, then mark
+   //  it as a relocation so it can be filled by the 'linker' below.
+   auto relocLbl = a.newLabel();
+   a.bind(relocLbl);
+
+   // Save 32 bytes of memory so we have room to do set up the
+   //  call during relocation once we know where its going to
+   //  reside in the host jit memory section.
+   for (auto i = 0; i < 32; ++i) {
+      a.int3();
    }
+   a.jmp(asmjit::x86::rax);
+
+   a.relocLabels.emplace_back(addr, relocLbl);
 }
 
 bool
@@ -360,13 +409,22 @@ gen(JitBlock &block)
    PPCEmuAssembler a(sRuntime);
    a.relocLabels.reserve(10);
 
+   auto profile = profileGetBlock(block.start);
+   JitFallbackMix fallbackMix;
+
+   if (profile) {
+      a.fallbackMix = &fallbackMix;
+   }
+
    struct TargetLblPair {
       uint32_t idx;
       asmjit::Label label;
    };
    std::map<uint32_t, TargetLblPair> targetLbls;
    for (uint32_t i = 0; i < block.targets.size(); ++i) {
-      targetLbls.emplace(block.targets[i].first, TargetLblPair{ i, a.newLabel() });
+      auto label = a.newLabel();
+      targetLbls.emplace(block.targets[i].first, TargetLblPair{ i, label });
+      a.targetLabels.emplace(block.targets[i].first, label);
    }
 
    auto codeStart = a.newLabel();
@@ -379,13 +437,38 @@ gen(JitBlock &block)
       }
    }
 
+   if (profile) {
+      // Nothing is cached in registers yet so RAX is free to use
+      auto entriesAddr = reinterpret_cast<intptr_t>(&profile->entries);
+      a.mov(asmjit::x86::rax, asmjit::Ptr(entriesAddr));
+      a.lock().inc(asmjit::X86Mem(asmjit::x86::rax, 0, 8));
+   }
+
+   if (gJitSampling) {
+      // Registers are only written back at block boundaries, publishing
+      //  where we are here keeps cia, lr and r1 consistent for samplers
+      a.mov(a.ciaMem, block.start);
+   }
+
+   // Simple copy and clear loops are run in one go, the normal code for the
+   //  loop follows in case the loop declines to do so.
+   auto memoryLoopDone = a.newLabel();
+   auto isMemoryLoop = JIT_MEMORY_LOOPS
+                    && gJitMode != jit_mode::verify
+                    && genMemoryLoop(a, block, memoryLoopDone);
+
    for (lclCia = block.start; lclCia < block.end; lclCia += 4)
    {
       auto targetIter = targetLbls.find(lclCia);
       if (targetIter != targetLbls.end()) {
          // This is a jump target, we should flush any register caches
          //  and then also insert a label so we can find this location.
+         a.evictAll();
          a.bind(targetIter->second.label);
+
+         if (gJitSampling) {
+            a.mov(a.ciaMem, lclCia);
+         }
       }
 
       if (JIT_DEBUG) {
@@ -434,8 +517,15 @@ gen(JitBlock &block)
       }
    }
 
+   if (isMemoryLoop) {
+      // Both paths must arrive here with nothing held in host registers
+      a.evictAll();
+      a.bind(memoryLoopDone);
+   }
+
    jit_b_direct(a, lclCia);
 
+   auto codeSize = a.getCodeSize();
    auto func = asmjit_cast<JitCode>(a.make());
 
    if (func == nullptr) {
@@ -445,6 +535,8 @@ gen(JitBlock &block)
 
    // Write in the relocation data that jumps to the Finale, which can
    //  later be overwritten atomically by the generator.
+   std::unique_lock<std::mutex> relocationLock { sRelocationMutex };
+
    for (auto &reloc : a.relocLabels) {
       // We use a trick here to save some bytes.  We write the addr
       //  part of the info while relocating in spite of being able
@@ -452,7 +544,10 @@ gen(JitBlock &block)
       //  it to before or after the aligned MOV which saves us some
       //  bytes that would otherwise be wasted on NOP's.
 
-      auto targetAddr = asmjit::Ptr(gFinaleFn);
+      // Link straight to the target if it has already been generated,
+      //  otherwise the finale links it the first time it is taken.
+      auto target = sJitBlocks.find(reloc.first);
+      auto targetAddr = target ? asmjit::Ptr(target) : asmjit::Ptr(gFinaleFn);
 
       // Find our bytes of memory allocated above...
       auto mem = asmjit_cast<uint8_t*>(func, a.getLabelOffset(reloc.second));
@@ -476,6 +571,15 @@ gen(JitBlock &block)
       auto atomicAddr = &mem[aligned_mov_offset + 2];
       decaf_check(align_up(atomicAddr, 8) == atomicAddr);
       *reinterpret_cast<uint64_t*>(atomicAddr) = targetAddr;
+      sRelocationSlots.push_back(reinterpret_cast<uint64_t *>(atomicAddr));
+   }
+
+   relocationLock.unlock();
+
+   perfRegisterBlock(block.start, block.end, func, codeSize);
+
+   if (profile) {
+      profileUpdateBlock(profile, block.end, fallbackMix);
    }
 
    // Calculate the starting address of the block
@@ -493,6 +597,60 @@ gen(JitBlock &block)
    return true;
 }
 
+// Returns the target of a direct branch, or 0 if it does not have one
+static uint32_t
+getDirectBranchTarget(uint32_t cia,
+                      espresso::Instruction instr,
+                      espresso::InstructionID id)
+{
+   if (id == espresso::InstructionID::b) {
+      auto nia = static_cast<uint32_t>(sign_extend<26>(instr.li << 2));
+      return instr.aa ? nia : cia + nia;
+   } else if (id == espresso::InstructionID::bc) {
+      auto nia = static_cast<uint32_t>(sign_extend<16>(instr.bd << 2));
+      return instr.aa ? nia : cia + nia;
+   }
+
+   return 0;
+}
+
+static bool
+isBranchInstruction(espresso::InstructionID id)
+{
+   return id == espresso::InstructionID::b
+       || id == espresso::InstructionID::bc
+       || id == espresso::InstructionID::bcctr
+       || id == espresso::InstructionID::bclr;
+}
+
+// Grows a block to the end of the function it is in, so branches within the
+//  function can be generated as jumps within the same host code.
+static void
+extendToFunction(JitBlock &block)
+{
+   // A block which loops back to its own start already stays in host code,
+   //  leave it as it is so it can still be run as a memory loop.
+   auto lastCia = block.end - 4;
+   auto lastInstr = mem::read<espresso::Instruction>(lastCia);
+   auto lastData = espresso::decodeInstruction(lastInstr);
+
+   if (lastData && getDirectBranchTarget(lastCia, lastInstr, lastData->id) == block.start) {
+      return;
+   }
+
+   auto function = analysis::Function { };
+
+   if (!analysis::findFunction(block.start, function)) {
+      return;
+   }
+
+   auto end = std::min<uint32_t>(function.end, block.start + JIT_MAX_INST * 4);
+
+   if (end > block.end) {
+      block.end = end;
+   }
+}
+
 bool
 identBlock(JitBlock& block)
 {
@@ -511,8 +669,6 @@ identBlock(JitBlock& block)
          break;
       }
 
-      // Targets should be added to block.targets if we know of any...
-
       switch (data->id) {
       case espresso::InstructionID::b:
       case espresso::InstructionID::bc:
@@ -540,6 +696,47 @@ identBlock(JitBlock& block)
 
    block.end = fnEnd;
 
+   if (gJitFunctionBlocks) {
+      extendToFunction(block);
+   }
+
+   // Register any addresses inside the block which are known to be branched
+   //  to, so they can be entered here rather than compiled again. Branches
+   //  within the block are found by scanning it too in case the code was
+   //  never analysed.
+   auto targets = std::vector<uint32_t> { };
+   analysis::getBranchTargets(block.start + 4, block.end, targets);
+
+   for (lclCia = block.start; lclCia < block.end; lclCia += 4) {
+      auto instr = mem::read<espresso::Instruction>(lclCia);
+      auto data = espresso::decodeInstruction(instr);
+
+      if (data) {
+         auto target = getDirectBranchTarget(lclCia, instr, data->id);
+
+         if (target > block.start && target < block.end) {
+            targets.push_back(target);
+         }
+
+         // Calls return to the following instruction, which is in this block
+         //  when function blocks are enabled.
+         if (isBranchInstruction(data->id) && instr.lk) {
+            auto ret = lclCia + 4;
+
+            if (ret < block.end) {
+               targets.push_back(ret);
+            }
+         }
+      }
+   }
+
+   std::sort(targets.begin(), targets.end());
+   targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+   for (auto target : targets) {
+      block.targets.emplace_back(target, nullptr);
+   }
+
    return true;
 }
 
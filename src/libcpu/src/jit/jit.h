@@ -8,8 +8,10 @@ namespace jit
 {
 
 void initialise();
+void shutdown();
 
 void clearCache();
+void invalidateCache();
 void resume();
 
 bool hasInstruction(espresso::InstructionID instrId);
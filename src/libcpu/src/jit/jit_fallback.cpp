@@ -27,6 +27,10 @@ bool jit_fallback(PPCEmuAssembler& a, espresso::Instruction instr)
 
    a.evictAll();
 
+   if (a.fallbackMix) {
+      (*a.fallbackMix)[data->id]++;
+   }
+
    if (TRACK_FALLBACK_CALLS) {
       auto fallbackAddr = reinterpret_cast<intptr_t>(&sFallbackCalls[static_cast<uint32_t>(data->id)]);
       a.mov(asmjit::x86::rax, asmjit::Ptr(fallbackAddr));
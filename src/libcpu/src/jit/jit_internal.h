@@ -1,6 +1,7 @@
 #pragma once
 #include "common/decaf_assert.h"
 #include "cpu.h"
+#include "espresso/espresso_instructionid.h"
 #include <array>
 #include <asmjit/asmjit.h>
 #include <map>
@@ -15,6 +16,9 @@ namespace cpu
 namespace jit
 {
 
+//! Number of each instruction in a block which falls back to the interpreter
+using JitFallbackMix = std::map<espresso::InstructionID, uint32_t>;
+
 /*
 Register Assignments:
 RAX    . Scratch
@@ -112,6 +116,7 @@ public:
       PPCMemRef(lrMem, lr);
       PPCMemRef(ctrMem, ctr);
 
+      PPCMemRef(ciaMem, cia);
       PPCMemRef(niaMem, nia);
       PPCMemRef(coreIdMem, id);
       PPCMemRef(interruptMem, interrupt);
@@ -185,6 +190,12 @@ public:
    uint32_t genCia;
    std::vector<std::pair<uint32_t, asmjit::Label>> relocLabels;
 
+   // Guest addresses within the block being generated which can be jumped
+   //  to directly, nothing is held in host registers at any of these.
+   std::map<uint32_t, asmjit::Label> targetLabels;
+
+   JitFallbackMix *fallbackMix = nullptr;
+
    asmjit::X86GpReg sysArgReg[4];
    asmjit::X86GpReg finaleNiaArgReg;
    asmjit::X86GpReg finaleJmpSrcArgReg;
@@ -0,0 +1,259 @@
+#include "common/bitutils.h"
+#include "common/byte_swap.h"
+#include "common/fast_memory.h"
+#include "espresso/espresso_instructionset.h"
+#include "jit_memloop.h"
+#include "mem.h"
+#include <algorithm>
+#include <cstring>
+
+/*
+ * Recognises the small copy and clear loops which compilers emit inline and
+ * replaces the whole block with a single call that does every iteration at
+ * once. Each loop must be the entire block, ending in a bdnz back to its own
+ * start, so the registers and memory we leave behind are exactly what running
+ * the loop would have left. When the loop would run off the end of the address
+ * space the helper declines and the loop runs normally instead.
+ *
+ *  Copy:   lwzu rT, 4(rA)     Fill:   stwu rS, 4(rB)     Clear:  dcbz rA, rB
+ *          stwu rT, 4(rB)             bdnz start                 addi rX, rX, 32
+ *          bdnz start                                            bdnz start
+ */
+
+namespace cpu
+{
+
+namespace jit
+{
+
+using MemoryLoopFn = bool(*)(Core *core, uint32_t regs);
+
+static uint8_t *
+hostAddress(uint32_t address)
+{
+   return reinterpret_cast<uint8_t *>(mem::base() + address);
+}
+
+// The number of bytes the loop covers, or 0 if the loop would wrap around
+//  the address space before ctr reaches zero.
+static uint32_t
+getLoopSize(Core *core,
+            uint32_t start,
+            uint32_t stride)
+{
+   auto count = core->ctr ? uint64_t { core->ctr } : 0x100000000ull;
+   auto size = count * stride;
+
+   if (start + size > 0x100000000ull) {
+      return 0;
+   }
+
+   return static_cast<uint32_t>(size);
+}
+
+static uint32_t
+packRegs(uint32_t a,
+         uint32_t b,
+         uint32_t c = 0)
+{
+   return a | (b << 8) | (c << 16);
+}
+
+static bool
+copyWordsLoop(Core *core,
+              uint32_t regs)
+{
+   auto rT = regs & 0xFF;
+   auto rA = (regs >> 8) & 0xFF;
+   auto rB = (regs >> 16) & 0xFF;
+   auto src = core->gpr[rA] + 4;
+   auto dst = core->gpr[rB] + 4;
+   auto size = std::min(getLoopSize(core, src, 4), getLoopSize(core, dst, 4));
+
+   if (!size) {
+      return false;
+   }
+
+   auto srcPtr = hostAddress(src);
+   auto dstPtr = hostAddress(dst);
+
+   auto last = uint32_t { 0 };
+
+   if (dst > src && dst < uint64_t { src } + size) {
+      // Copying forwards over our own source repeats the data just written,
+      //  which is not what memmove does so we must go a word at a time.
+      for (auto i = 0u; i < size; i += 4) {
+         std::memcpy(&last, srcPtr + i, 4);
+         std::memcpy(dstPtr + i, &last, 4);
+      }
+   } else {
+      // The last word is loaded before anything overlapping it is stored
+      std::memcpy(&last, srcPtr + size - 4, 4);
+      fast_memmove(dstPtr, srcPtr, size);
+   }
+
+   core->gpr[rT] = byte_swap(last);
+   core->gpr[rA] = src + size - 4;
+   core->gpr[rB] = dst + size - 4;
+   core->ctr = 0;
+   return true;
+}
+
+static bool
+fillWordsLoop(Core *core,
+              uint32_t regs)
+{
+   auto rS = regs & 0xFF;
+   auto rB = (regs >> 8) & 0xFF;
+   auto dst = core->gpr[rB] + 4;
+   auto size = getLoopSize(core, dst, 4);
+
+   if (!size) {
+      return false;
+   }
+
+   auto dstPtr = hostAddress(dst);
+   auto value = byte_swap(core->gpr[rS]);
+
+   if (value == (value & 0xFF) * 0x01010101u) {
+      fast_memset(dstPtr, value & 0xFF, size);
+   } else {
+      for (auto i = 0u; i < size; i += 4) {
+         std::memcpy(dstPtr + i, &value, 4);
+      }
+   }
+
+   core->gpr[rB] = dst + size - 4;
+   core->ctr = 0;
+   return true;
+}
+
+static bool
+clearBlocksLoop(Core *core,
+                uint32_t regs)
+{
+   auto rA = regs & 0xFF;
+   auto rB = (regs >> 8) & 0xFF;
+   auto rX = (regs >> 16) & 0xFF;
+   auto start = ((rA ? core->gpr[rA] : 0) + core->gpr[rB]) & ~31u;
+   auto size = getLoopSize(core, start, 32);
+
+   if (!size) {
+      return false;
+   }
+
+   fast_memset(hostAddress(start), 0, size);
+
+   core->gpr[rX] += size;
+   core->ctr = 0;
+   return true;
+}
+
+// bdnz back to the start of the block
+static bool
+isLoopBranch(const JitBlock &block,
+             uint32_t cia,
+             espresso::Instruction instr,
+             const espresso::InstructionInfo *data)
+{
+   if (data->id != espresso::InstructionID::bc || instr.aa || instr.lk) {
+      return false;
+   }
+
+   // Decrement ctr, branch if it is non-zero, ignore cr. The other bits are
+   //  only branch prediction hints.
+   if ((instr.bo & 0b10110) != 0b10000) {
+      return false;
+   }
+
+   return cia + sign_extend<16>(instr.bd << 2) == block.start;
+}
+
+static bool
+isWordUpdate(espresso::Instruction instr)
+{
+   return sign_extend<16>(instr.d) == 4 && instr.rA != 0;
+}
+
+bool
+genMemoryLoop(PPCEmuAssembler &a,
+              const JitBlock &block,
+              const asmjit::Label &loopDone)
+{
+   static const auto MaxInstructions = 3u;
+   espresso::Instruction instrs[MaxInstructions];
+   const espresso::InstructionInfo *data[MaxInstructions];
+   auto count = (block.end - block.start) / 4;
+
+   if (!block.targets.empty() || count < 2 || count > MaxInstructions) {
+      return false;
+   }
+
+   for (auto i = 0u; i < count; ++i) {
+      instrs[i] = mem::read<espresso::Instruction>(block.start + i * 4);
+      data[i] = espresso::decodeInstruction(instrs[i]);
+
+      if (!data[i]) {
+         return false;
+      }
+   }
+
+   auto branchCia = block.end - 4;
+
+   if (!isLoopBranch(block, branchCia, instrs[count - 1], data[count - 1])) {
+      return false;
+   }
+
+   auto fn = MemoryLoopFn { nullptr };
+   auto regs = uint32_t { 0 };
+
+   if (count == 2 && data[0]->id == espresso::InstructionID::stwu) {
+      auto rS = instrs[0].rS;
+      auto rB = instrs[0].rA;
+
+      if (isWordUpdate(instrs[0]) && rS != rB) {
+         fn = &fillWordsLoop;
+         regs = packRegs(rS, rB);
+      }
+   } else if (count == 3
+           && data[0]->id == espresso::InstructionID::lwzu
+           && data[1]->id == espresso::InstructionID::stwu) {
+      auto rT = instrs[0].rD;
+      auto rA = instrs[0].rA;
+      auto rB = instrs[1].rA;
+
+      if (isWordUpdate(instrs[0]) && isWordUpdate(instrs[1])
+       && instrs[1].rS == rT && rT != rA && rT != rB && rA != rB) {
+         fn = &copyWordsLoop;
+         regs = packRegs(rT, rA, rB);
+      }
+   } else if (count == 3
+           && (data[0]->id == espresso::InstructionID::dcbz || data[0]->id == espresso::InstructionID::dcbz_l)
+           && data[1]->id == espresso::InstructionID::addi) {
+      auto rA = instrs[0].rA;
+      auto rB = instrs[0].rB;
+      auto rX = instrs[1].rD;
+
+      if (instrs[1].rA == rX && sign_extend<16>(instrs[1].simm) == 32
+       && rX != 0 && rA != rB && (rX == rB || rX == rA)) {
+         fn = &clearBlocksLoop;
+         regs = packRegs(rA, rB, rX);
+      }
+   }
+
+   if (!fn) {
+      return false;
+   }
+
+   a.evictAll();
+   a.mov(a.sysArgReg[0], a.stateReg);
+   a.mov(a.sysArgReg[1], regs);
+   a.call(asmjit::Ptr(fn));
+   a.test(asmjit::x86::al, asmjit::x86::al);
+   a.jnz(loopDone);
+   return true;
+}
+
+} // namespace jit
+
+} // namespace cpu
@@ -0,0 +1,19 @@
+#pragma once
+#include "jit_internal.h"
+
+namespace cpu
+{
+
+namespace jit
+{
+
+// If the block is a simple copy or clear loop, emits a call which runs every
+//  iteration at once and jumps to loopDone if it succeeded.
+bool
+genMemoryLoop(PPCEmuAssembler &a,
+              const JitBlock &block,
+              const asmjit::Label &loopDone);
+
+} // namespace jit
+
+} // namespace cpu
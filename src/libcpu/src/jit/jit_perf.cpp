@@ -0,0 +1,296 @@
+#include "common/log.h"
+#include "common/platform.h"
+#include "cpu_internal.h"
+#include "jit_perf.h"
+#include <cstdio>
+#include <mutex>
+#include <spdlog/fmt/fmt.h>
+#include <string>
+
+#ifdef PLATFORM_LINUX
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Writes out the location of generated JIT code so that Linux perf can
+ * attribute samples inside the JIT to guest code.
+ *
+ * perf_map writes /tmp/perf-<pid>.map which perf report reads directly, it
+ * only contains symbol names so perf annotate is not possible.
+ *
+ * jitdump writes /tmp/jit-<pid>.dump which must be merged into a recording
+ * with `perf inject --jit`, it contains a copy of the generated code so that
+ * perf annotate works too. Record with `perf record -k 1` so the timestamps
+ * match the ones we write.
+ */
+
+namespace cpu
+{
+
+namespace jit
+{
+
+#ifdef PLATFORM_LINUX
+
+static const uint32_t
+JitdumpMagic = 0x4A695444;
+
+static const uint32_t
+JitdumpVersion = 1;
+
+static const uint32_t
+JitdumpElfMachX86_64 = 62;
+
+static const uint32_t
+JitdumpCodeLoad = 0;
+
+struct JitdumpFileHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t totalSize;
+   uint32_t elfMach;
+   uint32_t pad1;
+   uint32_t pid;
+   uint64_t timestamp;
+   uint64_t flags;
+};
+
+struct JitdumpCodeLoadRecord
+{
+   uint32_t id;
+   uint32_t totalSize;
+   uint64_t timestamp;
+   uint32_t pid;
+   uint32_t tid;
+   uint64_t vma;
+   uint64_t codeAddr;
+   uint64_t codeSize;
+   uint64_t codeIndex;
+};
+
+static std::mutex
+sPerfMutex;
+
+static FILE *
+sPerfFile = nullptr;
+
+static void *
+sJitdumpMarker = nullptr;
+
+static size_t
+sJitdumpMarkerSize = 0;
+
+static uint64_t
+sCodeIndex = 0;
+
+static std::string
+sPerfPath;
+
+static uint64_t
+getPerfTimestamp()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static std::string
+getBlockName(uint32_t start,
+             uint32_t end)
+{
+   auto symbolStart = uint32_t { 0 };
+   auto symbol = gSymbolLookupHandler ? gSymbolLookupHandler(start, &symbolStart) : nullptr;
+
+   if (!symbol) {
+      return fmt::format("ppc_{:08x}-{:08x}", start, end);
+   } else if (symbolStart == start) {
+      return fmt::format("ppc_{:08x}-{:08x} {}", start, end, symbol);
+   } else {
+      return fmt::format("ppc_{:08x}-{:08x} {}+0x{:x}", start, end, symbol, start - symbolStart);
+   }
+}
+
+static void
+writeEntry(const std::string &name,
+           const void *code,
+           size_t size)
+{
+   if (!sPerfFile) {
+      return;
+   }
+
+   if (gJitPerfMode == jit_perf_mode::perf_map) {
+      fmt::print(sPerfFile, "{:x} {:x} {}\n", reinterpret_cast<uintptr_t>(code), size, name);
+   } else {
+      auto record = JitdumpCodeLoadRecord {};
+      record.id = JitdumpCodeLoad;
+      record.totalSize = static_cast<uint32_t>(sizeof(record) + name.size() + 1 + size);
+      record.timestamp = getPerfTimestamp();
+      record.pid = static_cast<uint32_t>(getpid());
+      record.tid = static_cast<uint32_t>(syscall(SYS_gettid));
+      record.vma = reinterpret_cast<uintptr_t>(code);
+      record.codeAddr = reinterpret_cast<uintptr_t>(code);
+      record.codeSize = size;
+      record.codeIndex = sCodeIndex++;
+
+      fwrite(&record, sizeof(record), 1, sPerfFile);
+      fwrite(name.c_str(), name.size() + 1, 1, sPerfFile);
+      fwrite(code, size, 1, sPerfFile);
+   }
+
+   // Blocks are generated rarely enough that flushing each one is cheap, and
+   // it means the file is usable even if we crash.
+   fflush(sPerfFile);
+}
+
+void
+perfInitialise()
+{
+   std::unique_lock<std::mutex> lock { sPerfMutex };
+
+   if (gJitPerfMode == jit_perf_mode::disabled || sPerfFile) {
+      return;
+   }
+
+   if (gJitPerfMode == jit_perf_mode::perf_map) {
+      sPerfPath = fmt::format("/tmp/perf-{}.map", getpid());
+   } else {
+      sPerfPath = fmt::format("/tmp/jit-{}.dump", getpid());
+   }
+
+   sPerfFile = fopen(sPerfPath.c_str(), gJitPerfMode == jit_perf_mode::perf_map ? "w" : "w+b");
+
+   if (!sPerfFile) {
+      gLog->error("Could not open {} for JIT perf output", sPerfPath);
+      return;
+   }
+
+   if (gJitPerfMode == jit_perf_mode::jitdump) {
+      auto header = JitdumpFileHeader {};
+      header.magic = JitdumpMagic;
+      header.version = JitdumpVersion;
+      header.totalSize = sizeof(header);
+      header.elfMach = JitdumpElfMachX86_64;
+      header.pid = static_cast<uint32_t>(getpid());
+      header.timestamp = getPerfTimestamp();
+      fwrite(&header, sizeof(header), 1, sPerfFile);
+      fflush(sPerfFile);
+
+      // perf record finds the jitdump file by looking for an executable
+      // mapping of it, so we have to map it even though we never use it.
+      sJitdumpMarkerSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+      sJitdumpMarker = mmap(nullptr, sJitdumpMarkerSize, PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(sPerfFile), 0);
+
+      if (sJitdumpMarker == MAP_FAILED) {
+         gLog->warn("Could not mmap {}, perf record will not find it", sPerfPath);
+         sJitdumpMarker = nullptr;
+      }
+   }
+
+   gLog->info("Writing JIT perf symbols to {}", sPerfPath);
+}
+
+void
+perfRegisterStubs(const void *code,
+                  size_t size)
+{
+   std::unique_lock<std::mutex> lock { sPerfMutex };
+   writeEntry("decaf_jit_stubs", code, size);
+}
+
+void
+perfRegisterBlock(uint32_t start,
+                  uint32_t end,
+                  const void *code,
+                  size_t size)
+{
+   // perfShutdown may close the file from another thread
+   std::unique_lock<std::mutex> lock { sPerfMutex };
+
+   if (!sPerfFile) {
+      return;
+   }
+
+   writeEntry(getBlockName(start, end), code, size);
+}
+
+void
+perfClearCache()
+{
+   std::unique_lock<std::mutex> lock { sPerfMutex };
+
+   if (!sPerfFile) {
+      return;
+   }
+
+   // The runtime is recreated in the same address range so old entries would
+   // now be wrong. A perf map has no timestamps so we have to start it again,
+   // whereas jitdump code loads are ordered by time so newer ones win.
+   if (gJitPerfMode == jit_perf_mode::perf_map) {
+      sPerfFile = freopen(sPerfPath.c_str(), "w", sPerfFile);
+
+      if (!sPerfFile) {
+         gLog->error("Could not reopen {} for JIT perf output", sPerfPath);
+      }
+   }
+}
+
+void
+perfShutdown()
+{
+   std::unique_lock<std::mutex> lock { sPerfMutex };
+
+   if (sJitdumpMarker) {
+      munmap(sJitdumpMarker, sJitdumpMarkerSize);
+      sJitdumpMarker = nullptr;
+   }
+
+   if (sPerfFile) {
+      fclose(sPerfFile);
+      sPerfFile = nullptr;
+   }
+}
+
+#else
+
+void
+perfInitialise()
+{
+   if (gJitPerfMode != jit_perf_mode::disabled) {
+      gLog->warn("JIT perf output is only supported on Linux");
+   }
+}
+
+void
+perfRegisterStubs(const void *code,
+                  size_t size)
+{
+}
+
+void
+perfRegisterBlock(uint32_t start,
+                  uint32_t end,
+                  const void *code,
+                  size_t size)
+{
+}
+
+void
+perfClearCache()
+{
+}
+
+void
+perfShutdown()
+{
+}
+
+#endif
+
+} // namespace jit
+
+} // namespace cpu
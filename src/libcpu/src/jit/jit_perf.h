@@ -0,0 +1,32 @@
+#pragma once
+#include "cpu.h"
+#include <cstddef>
+
+namespace cpu
+{
+
+namespace jit
+{
+
+void
+perfInitialise();
+
+void
+perfRegisterStubs(const void *code,
+                  size_t size);
+
+void
+perfRegisterBlock(uint32_t start,
+                  uint32_t end,
+                  const void *code,
+                  size_t size);
+
+void
+perfClearCache();
+
+void
+perfShutdown();
+
+} // namespace jit
+
+} // namespace cpu
@@ -0,0 +1,172 @@
+#include "common/log.h"
+#include "cpu_internal.h"
+#include "espresso/espresso_instructionset.h"
+#include "jit_profile.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <spdlog/fmt/fmt.h>
+#include <string>
+#include <vector>
+
+/*
+ * Counts how often each JIT block is entered so we can find the hot guest
+ * code. When enabled every block starts with a locked increment of its entry
+ * in this table, when disabled nothing at all is emitted.
+ *
+ * The cycle estimate is only a weight to rank blocks by, it assumes every
+ * native instruction costs one cycle and every fallback to the interpreter
+ * costs FallbackCycleEstimate.
+ */
+
+namespace cpu
+{
+
+namespace jit
+{
+
+static const uint64_t
+FallbackCycleEstimate = 25;
+
+static std::mutex
+sProfileMutex;
+
+// Entries are never freed so generated code can always increment them, they
+// are kept across clearCache so a regenerated block keeps its count.
+static std::map<uint32_t, std::unique_ptr<JitBlockProfile>>
+sProfiles;
+
+void
+profileInitialise()
+{
+   if (gJitProfiling) {
+      gLog->info("JIT block profiling enabled");
+   }
+}
+
+JitBlockProfile *
+profileGetBlock(uint32_t start)
+{
+   if (!gJitProfiling) {
+      return nullptr;
+   }
+
+   std::unique_lock<std::mutex> lock { sProfileMutex };
+   auto &profile = sProfiles[start];
+
+   if (!profile) {
+      profile = std::make_unique<JitBlockProfile>();
+      profile->start = start;
+   }
+
+   return profile.get();
+}
+
+void
+profileUpdateBlock(JitBlockProfile *profile,
+                   uint32_t end,
+                   const JitFallbackMix &fallbacks)
+{
+   std::unique_lock<std::mutex> lock { sProfileMutex };
+   profile->end = end;
+   profile->fallbacks = fallbacks;
+}
+
+static uint64_t
+getFallbackCount(const JitFallbackMix &fallbacks)
+{
+   auto count = uint64_t { 0 };
+
+   for (auto &fallback : fallbacks) {
+      count += fallback.second;
+   }
+
+   return count;
+}
+
+static uint64_t
+getCycleEstimate(const JitBlockProfile &profile)
+{
+   auto instructions = static_cast<uint64_t>((profile.end - profile.start) / 4);
+   auto fallbacks = getFallbackCount(profile.fallbacks);
+   auto cycles = (instructions - fallbacks) + fallbacks * FallbackCycleEstimate;
+   return profile.entries * cycles;
+}
+
+static std::string
+getSymbolName(uint32_t start)
+{
+   auto symbolStart = uint32_t { 0 };
+   auto symbol = gSymbolLookupHandler ? gSymbolLookupHandler(start, &symbolStart) : nullptr;
+
+   if (!symbol) {
+      return "?";
+   } else if (symbolStart == start) {
+      return symbol;
+   } else {
+      return fmt::format("{}+0x{:x}", symbol, start - symbolStart);
+   }
+}
+
+} // namespace jit
+
+std::string
+formatJitProfile(size_t count)
+{
+   std::vector<jit::JitBlockProfile> blocks;
+
+   {
+      std::unique_lock<std::mutex> lock { jit::sProfileMutex };
+      blocks.reserve(jit::sProfiles.size());
+
+      for (auto &profile : jit::sProfiles) {
+         if (profile.second->entries) {
+            blocks.emplace_back(*profile.second);
+         }
+      }
+   }
+
+   auto totalCycles = uint64_t { 0 };
+
+   for (auto &block : blocks) {
+      totalCycles += jit::getCycleEstimate(block);
+   }
+
+   std::sort(blocks.begin(), blocks.end(),
+      [](const jit::JitBlockProfile &a, const jit::JitBlockProfile &b) {
+         return jit::getCycleEstimate(b) < jit::getCycleEstimate(a);
+      });
+
+   if (blocks.size() > count) {
+      blocks.resize(count);
+   }
+
+   fmt::MemoryWriter out;
+   out.write("{:<8} {:>12} {:>14} {:>6} {:>6} {:>9}  {:<40} {}\n",
+             "Address", "Entries", "Est. cycles", "%", "Instrs", "Fallbacks", "Symbol", "Fallback mix");
+
+   for (auto &block : blocks) {
+      auto cycles = jit::getCycleEstimate(block);
+      fmt::MemoryWriter mix;
+
+      for (auto &fallback : block.fallbacks) {
+         auto info = espresso::findInstructionInfo(fallback.first);
+         mix.write("{}x{} ", info ? info->name : "?", fallback.second);
+      }
+
+      out.write("{:08x} {:>12} {:>14} {:>6.2f} {:>6} {:>9}  {:<40} {}\n",
+                block.start,
+                block.entries,
+                cycles,
+                totalCycles ? 100.0 * cycles / totalCycles : 0.0,
+                (block.end - block.start) / 4,
+                jit::getFallbackCount(block.fallbacks),
+                jit::getSymbolName(block.start),
+                mix.str());
+   }
+
+   return out.str();
+}
+
+} // namespace cpu
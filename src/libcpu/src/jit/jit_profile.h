@@ -0,0 +1,36 @@
+#pragma once
+#include "jit_internal.h"
+#include <cstdint>
+
+namespace cpu
+{
+
+namespace jit
+{
+
+struct JitBlockProfile
+{
+   //! Incremented by the generated code every time the block is entered
+   uint64_t entries = 0;
+
+   uint32_t start = 0;
+   uint32_t end = 0;
+
+   //! Instructions in this block which call into the interpreter
+   JitFallbackMix fallbacks;
+};
+
+void
+profileInitialise();
+
+JitBlockProfile *
+profileGetBlock(uint32_t start);
+
+void
+profileUpdateBlock(JitBlockProfile *profile,
+                   uint32_t end,
+                   const JitFallbackMix &fallbacks);
+
+} // namespace jit
+
+} // namespace cpu
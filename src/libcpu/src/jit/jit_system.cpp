@@ -214,9 +214,12 @@ static Core *
 kc_stub(cpu::KernelCallFunction func, void *userData)
 {
    auto core = cpu::this_core::state();
+   auto activity = core->activity.exchange(CoreActivity::KernelCall, std::memory_order_relaxed);
    func(core, userData);
    // We grab new core since it may have changed while executing!
-   return cpu::this_core::state();
+   core = cpu::this_core::state();
+   core->activity.store(activity, std::memory_order_relaxed);
+   return core;
 }
 
 // Kernel call
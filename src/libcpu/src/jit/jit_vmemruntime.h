@@ -13,7 +13,7 @@ namespace jit
 class VMemRuntime : public asmjit::HostRuntime
 {
 public:
-   VMemRuntime(size_t initialSize, size_t sizeLimit)
+   VMemRuntime(size_t initialSize, size_t sizeLimit, bool hugePages = false)
    {
       // Find a good base address
       mRootAddress = 0;
@@ -28,6 +28,14 @@ public:
 
       decaf_assert(mRootAddress, "Failed to map memory for JIT");
 
+      // Commit a whole huge page at a time so the host is able to back the
+      //  code with them as soon as it is written.
+      auto hugePageSize = platform::getHugePageSize();
+
+      if (hugePages && hugePageSize && platform::adviseHugePages(mRootAddress, sizeLimit)) {
+         initialSize = align_up(initialSize, hugePageSize);
+      }
+
       if (!platform::commitMemory(mRootAddress, initialSize, platform::ProtectFlags::ReadWriteExecute)) {
          decaf_abort("Failed to commit memory for JIT");
       }
@@ -12,23 +12,32 @@ struct Mapping
    size_t start;
    size_t end;
    size_t address;
+
+   //! Large, randomly accessed and never protected a page at a time
+   bool allowHugePages;
 };
 
 static std::vector<Mapping>
 gMemoryMap =
 {
-   { "SystemData",   SystemBase,       SystemEnd,        0 },
-   { "MEM2",         MEM2Base,         MEM2End,          0 },
-   { "Apertures",    AperturesBase,    AperturesEnd,     0 },
-   { "Foreground",   ForegroundBase,   ForegroundEnd,    0 },
-   { "MEM1",         MEM1Base,         MEM1End,          0 },
-   { "LockedCache",  LockedCacheBase,  LockedCacheEnd,   0 },
-   { "SharedData",   SharedDataBase,   SharedDataEnd,    0 },
+   { "SystemData",   SystemBase,       SystemEnd,        0, false },
+   { "MEM2",         MEM2Base,         MEM2End,          0, true },
+   { "Apertures",    AperturesBase,    AperturesEnd,     0, false },
+   { "Foreground",   ForegroundBase,   ForegroundEnd,    0, true },
+   { "MEM1",         MEM1Base,         MEM1End,          0, true },
+   { "LockedCache",  LockedCacheBase,  LockedCacheEnd,   0, false },
+   { "SharedData",   SharedDataBase,   SharedDataEnd,    0, false },
 };
 
 static size_t
 gMemoryBase = 0;
 
+static HugePages
+gHugePages = HugePages::Disabled;
+
+static const char *
+commitMapping(const Mapping &map);
+
 static bool
 tryMapMemory(size_t base);
 
@@ -40,20 +49,62 @@ tryMapMemory(size_t base)
       return false;
    }
 
+   auto backing = std::vector<const char *> { };
+
    for (auto &map : gMemoryMap) {
-      auto size = map.end - map.start;
       map.address = base + map.start;
+      backing.push_back(commitMapping(map));
 
-      if (!platform::commitMemory(map.address, map.end - map.start)) {
+      if (!backing.back()) {
          map.address = 0;
          platform::freeMemory(base, 0x100000000ull);
          return false;
       }
    }
 
+   if (gHugePages != HugePages::Disabled) {
+      for (auto i = 0u; i < gMemoryMap.size(); ++i) {
+         if (gMemoryMap[i].allowHugePages) {
+            gLog->info("{} backed by {}", gMemoryMap[i].name, backing[i]);
+         }
+      }
+   }
+
    return true;
 }
 
+// Commit a mapping, returns a description of what it is backed by or nullptr
+//  if it could not be committed
+static const char *
+commitMapping(const Mapping &map)
+{
+   auto size = map.end - map.start;
+
+   if (map.allowHugePages && gHugePages == HugePages::Explicit) {
+      if (platform::commitHugeMemory(map.address, size)) {
+         return "explicit huge pages";
+      }
+   }
+
+   if (!platform::commitMemory(map.address, size)) {
+      return nullptr;
+   }
+
+   if (map.allowHugePages && gHugePages != HugePages::Disabled) {
+      if (platform::adviseHugePages(map.address, size)) {
+         return "transparent huge pages";
+      }
+   }
+
+   return "normal pages";
+}
+
+void
+setHugePages(HugePages mode)
+{
+   gHugePages = mode;
+}
+
 // Initialise system memory, mapping all valid address space
 void
 initialise()
@@ -93,6 +144,38 @@ valid(ppcaddr_t address)
    return false;
 }
 
+platform::MemorySnapshot *
+captureSnapshot()
+{
+   auto ranges = std::vector<platform::MemoryRange> { };
+
+   for (auto &map : gMemoryMap) {
+      ranges.push_back({ map.address, map.end - map.start });
+   }
+
+   return platform::captureMemory(ranges);
+}
+
+bool
+restoreSnapshot(platform::MemorySnapshot *snapshot)
+{
+   if (!platform::restoreMemory(snapshot)) {
+      return false;
+   }
+
+   // The restored pages are a new file backed mapping, so explicit huge
+   //  pages become normal ones and transparent ones need advising again.
+   if (gHugePages != HugePages::Disabled) {
+      for (auto &map : gMemoryMap) {
+         if (map.allowHugePages) {
+            platform::adviseHugePages(map.address, map.end - map.start);
+         }
+      }
+   }
+
+   return true;
+}
+
 // Cleanup memory, unmapping all views
 void
 shutdown()
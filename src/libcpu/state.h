@@ -15,6 +15,14 @@ static const uint32_t timerClockSpeed = busClockSpeed / 4;
 
 using TimerDuration = std::chrono::duration < uint64_t, std::ratio<1, timerClockSpeed>>;
 
+// What a core is currently doing, used for profiling
+enum class CoreActivity : uint32_t
+{
+   Guest,
+   KernelCall,
+   WaitForInterrupt,
+};
+
 struct CoreRegs
 {
    uint32_t cia;              // Current execution address
@@ -49,6 +57,7 @@ struct Core : CoreRegs
    std::atomic<uint32_t> interrupt { 0 };
    uint64_t reserve { 0xFFFFFFFFFFFFFFFF };
    std::chrono::steady_clock::time_point next_alarm;
+   std::atomic<CoreActivity> activity { CoreActivity::Guest };
 
    uint64_t tb();
 };
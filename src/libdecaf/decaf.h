@@ -1,5 +1,7 @@
 #pragma once
+#include <ostream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <spdlog/spdlog.h>
 #include <glbinding/gl/gl.h>
@@ -37,6 +39,30 @@ waitForExit();
 void
 shutdown();
 
+//! Takes a snapshot of the running game which replaces any earlier one. Must
+//  not be called from the GPU thread, it waits for the GPU to go idle.
+bool
+saveSnapshot();
+
+//! Returns the game to the last snapshot taken in this process
+bool
+restoreSnapshot();
+
+//! Formats a trace written to log::binary_trace_path as text
+bool
+dumpBinaryTrace(const std::string &path,
+                std::ostream &out);
+
+//! Moves the GPU thread onto the host core chosen for it by the thread
+//  placement config, a null thread means the calling thread.
+void
+placeGpuThread(std::thread *thread);
+
+//! Moves a helper thread onto the host processors shared by everything which
+//  is not pinned, a null thread means the calling thread.
+void
+placeHelperThread(std::thread *thread);
+
 // Stuff for the debugger
 void
 injectMouseButtonInput(input::MouseButton button,
@@ -30,6 +30,10 @@ extern bool debug;
 // TODO: should really be a std::set, but cereal doesn't support those...
 extern std::vector<unsigned> debug_filters;
 
+//! Minimum time between GPU retire and flip interrupts while the GPU is busy,
+//  0 delivers every event as its own interrupt
+extern unsigned interrupt_interval_us;
+
 }
 
 namespace gx2
@@ -52,6 +56,15 @@ extern bool enabled;
 //! Use JIT in verification mode where it compares execution to interpreter
 extern bool verify;
 
+//! Write JIT block symbols for Linux perf, one of "off", "map" or "jitdump"
+extern std::string perf_mode;
+
+//! Count how often each JIT block is entered and log the hottest on exit
+extern bool profile;
+
+//! Compile whole functions at once so branches within them stay in host code
+extern bool function_blocks;
+
 } // namespace jit
 
 namespace log
@@ -66,14 +79,34 @@ extern bool branch_trace;
 //! Wildcard filters for kernel trace function name matching
 extern std::vector<std::string> kernel_trace_filters;
 
+//! Write kernel and branch traces to this file in binary instead of the log
+extern std::string binary_trace_path;
+
 } // namespace log
 
+namespace profiler
+{
+
+//! Start the guest sampling profiler when the emulator starts
+extern bool enabled;
+
+//! Number of samples taken per second for each core
+extern unsigned sample_rate;
+
+//! Where to write collapsed stacks for flamegraphs on shutdown
+extern std::string output_path;
+
+} // namespace profiler
+
 namespace sound
 {
 
 //! Dump all sounds to file
 extern bool dump_sounds;
 
+//! Amount of audio to keep buffered for the host device in milliseconds
+extern unsigned latency_ms;
+
 } // namespace sound
 
 namespace system
@@ -91,6 +124,36 @@ extern std::string content_path;
 //! Time scale factor for emulated clock
 extern double time_scale;
 
+//! Number of threads used to inflate RPL sections, 0 to use all host threads
+extern unsigned loader_threads;
+
+//! Directory to store prelinked module images in, empty to disable
+extern std::string loader_cache_path;
+
+//! Keep a host side index of expanded heap free blocks for faster allocation
+extern bool expheap_free_index;
+
+//! Keep zlib125 stream state in a host pool instead of allocating it from the guest
+extern bool zlib_host_memory;
+
+//! Pin each emulated core and the GPU thread to a physical host core of its own
+extern bool thread_pinning;
+
+//! Keep host threads and guest memory on this NUMA node, -1 to not restrict
+extern int thread_numa_node;
+
+//! Run the emulated cores and GPU thread at real-time priority where permitted
+extern bool thread_realtime;
+
+//! Back guest memory and JIT code with huge pages, one of "off", "transparent" or "explicit"
+extern std::string huge_pages;
+
+//! Record everything nondeterministic the game sees to this file, empty to disable
+extern std::string record_path;
+
+//! Replay a recording made with record_path, empty to disable
+extern std::string replay_path;
+
 } // namespace system
 
 } // namespace config
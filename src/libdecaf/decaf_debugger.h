@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <string>
 
 namespace decaf
 {
@@ -16,6 +17,11 @@ initialiseUiGL();
 void
 drawUiGL(uint32_t width, uint32_t height);
 
+//! Returns a table of the time each guest thread has spent running, waiting
+//!  for a core and blocked.
+std::string
+formatThreadStats();
+
 } // namespace debugger
 
 } // namespace decaf
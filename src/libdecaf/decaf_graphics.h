@@ -1,6 +1,7 @@
 #pragma once
 #include "common/types.h"
 #include <functional>
+#include <vector>
 
 namespace decaf
 {
@@ -15,6 +16,18 @@ public:
    virtual void run() = 0;
    virtual void stop() = 0;
    virtual float getAverageFPS() = 0;
+
+   //! Copies the GPU register state for a snapshot, only called while the
+   //  driver has no work queued. Returns false if it is not supported.
+   virtual bool saveRegisters(std::vector<uint32_t> &registers)
+   {
+      return false;
+   }
+
+   virtual bool restoreRegisters(const std::vector<uint32_t> &registers)
+   {
+      return false;
+   }
 };
 
 class OpenGLDriver : public GraphicsDriver
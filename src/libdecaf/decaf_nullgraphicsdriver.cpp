@@ -40,6 +40,20 @@ NullGraphicsDriver::getAverageFPS()
    return 0.0f;
 }
 
+// There is no register state to keep
+bool
+NullGraphicsDriver::saveRegisters(std::vector<uint32_t> &registers)
+{
+   registers.clear();
+   return true;
+}
+
+bool
+NullGraphicsDriver::restoreRegisters(const std::vector<uint32_t> &registers)
+{
+   return true;
+}
+
 OpenGLDriver *
 createGLDriver()
 {
@@ -12,6 +12,8 @@ public:
    virtual void run() override;
    virtual void stop() override;
    virtual float getAverageFPS() override;
+   virtual bool saveRegisters(std::vector<uint32_t> &registers) override;
+   virtual bool restoreRegisters(const std::vector<uint32_t> &registers) override;
 
 private:
    bool mRunning = false;
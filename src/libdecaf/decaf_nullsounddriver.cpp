@@ -0,0 +1,130 @@
+#include "decaf_config.h"
+#include "decaf_nullsounddriver.h"
+#include "common/log.h"
+#include <chrono>
+#include <vector>
+
+namespace decaf
+{
+
+// How often the consumer thread pulls audio from the ring
+static const unsigned
+ConsumerPeriodMs = 10;
+
+NullSoundDriver::NullSoundDriver(const std::string &wavPath) :
+   mWavPath(wavPath)
+{
+}
+
+NullSoundDriver::~NullSoundDriver()
+{
+   stop();
+}
+
+bool
+NullSoundDriver::start(unsigned outputRate,
+                       unsigned numChannels)
+{
+   mOutputRate = outputRate;
+   mNumChannelsIn = numChannels;
+   mRing.reset(outputRate, numChannels, config::sound::latency_ms);
+
+   if (!mWavPath.empty()) {
+      mWavFile.open(mWavPath, std::ofstream::binary | std::ofstream::out);
+
+      if (!mWavFile.is_open()) {
+         gLog->error("Could not open {} for sound output", mWavPath);
+         return false;
+      }
+
+      // Written again with the real sizes once we stop
+      mWavFrames = 0;
+      writeWavHeader();
+   }
+
+   mRunning = true;
+   mThread = std::thread { &NullSoundDriver::consumerThread, this };
+   return true;
+}
+
+void
+NullSoundDriver::output(int16_t *samples,
+                        unsigned numSamples)
+{
+   mRing.write(samples, numSamples, mNumChannelsIn);
+}
+
+void
+NullSoundDriver::stop()
+{
+   if (!mRunning.exchange(false)) {
+      return;
+   }
+
+   mThread.join();
+
+   if (mWavFile.is_open()) {
+      mWavFile.seekp(0);
+      writeWavHeader();
+      mWavFile.close();
+   }
+
+   auto stats = mRing.getStats();
+   gLog->info("Sound output stopped with {} underruns and {} overruns", stats.underruns, stats.overruns);
+}
+
+void
+NullSoundDriver::consumerThread()
+{
+   auto period = std::chrono::milliseconds { ConsumerPeriodMs };
+   auto periodFrames = mOutputRate * ConsumerPeriodMs / 1000;
+   auto buffer = std::vector<int16_t>(periodFrames * mRing.getNumChannels());
+   auto next = std::chrono::steady_clock::now();
+
+   while (mRunning) {
+      next += period;
+      std::this_thread::sleep_until(next);
+      mRing.read(buffer.data(), periodFrames);
+
+      if (mWavFile.is_open()) {
+         mWavFile.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(int16_t));
+         mWavFrames += periodFrames;
+      }
+   }
+}
+
+template<typename Type>
+static void
+writeLittleEndian(std::ofstream &out,
+                  Type value)
+{
+   for (auto i = 0u; i < sizeof(Type); ++i) {
+      out.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+   }
+}
+
+void
+NullSoundDriver::writeWavHeader()
+{
+   auto numChannels = mRing.getNumChannels();
+   auto blockAlign = numChannels * sizeof(int16_t);
+   auto dataSize = static_cast<uint32_t>(mWavFrames * blockAlign);
+
+   mWavFile.write("RIFF", 4);
+   writeLittleEndian<uint32_t>(mWavFile, 36 + dataSize);
+   mWavFile.write("WAVE", 4);
+
+   mWavFile.write("fmt ", 4);
+   writeLittleEndian<uint32_t>(mWavFile, 16);
+   writeLittleEndian<uint16_t>(mWavFile, 1); // PCM
+   writeLittleEndian<uint16_t>(mWavFile, static_cast<uint16_t>(numChannels));
+   writeLittleEndian<uint32_t>(mWavFile, mOutputRate);
+   writeLittleEndian<uint32_t>(mWavFile, static_cast<uint32_t>(mOutputRate * blockAlign));
+   writeLittleEndian<uint16_t>(mWavFile, static_cast<uint16_t>(blockAlign));
+   writeLittleEndian<uint16_t>(mWavFile, 16);
+
+   mWavFile.write("data", 4);
+   writeLittleEndian<uint32_t>(mWavFile, dataSize);
+}
+
+} // namespace decaf
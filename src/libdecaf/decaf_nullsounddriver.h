@@ -0,0 +1,63 @@
+#pragma once
+#include "decaf_sound.h"
+#include "decaf_soundring.h"
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace decaf
+{
+
+/**
+ * Sound driver for running without an audio device.
+ *
+ * A host thread consumes the output at the real sample rate the same way an
+ * audio device would, so the ring behaves as it would with real hardware.
+ * If a path is given the consumed audio is also written to a WAV file.
+ */
+class NullSoundDriver : public SoundDriver
+{
+public:
+   NullSoundDriver(const std::string &wavPath = { });
+
+   virtual ~NullSoundDriver() override;
+
+   virtual bool
+   start(unsigned outputRate,
+         unsigned numChannels) override;
+
+   virtual void
+   output(int16_t *samples,
+          unsigned numSamples) override;
+
+   virtual void
+   stop() override;
+
+   SoundRing::Stats
+   getStats() const
+   {
+      return mRing.getStats();
+   }
+
+private:
+   void
+   consumerThread();
+
+   void
+   writeWavHeader();
+
+private:
+   std::string mWavPath;
+   std::ofstream mWavFile;
+   uint64_t mWavFrames = 0;
+
+   unsigned mOutputRate = 0;
+   unsigned mNumChannelsIn = 0;
+   SoundRing mRing;
+
+   std::thread mThread;
+   std::atomic<bool> mRunning { false };
+};
+
+} // namespace decaf
@@ -0,0 +1,166 @@
+#include "decaf_soundring.h"
+#include "common/decaf_assert.h"
+#include <algorithm>
+#include <cstring>
+
+namespace decaf
+{
+
+// How far from the real sample rate the consumer may resample, 0.5% is
+//  well below what can be heard as a change in pitch.
+static const double
+MaxDriftCorrection = 0.005;
+
+// Correction applied per unit of relative error from the target latency
+static const double
+DriftGain = 0.02;
+
+// Weight of each new fill level in the running average the correction is
+//  based on, the producer writes in bursts so the raw level is noisy.
+static const double
+FillSmoothing = 0.05;
+
+static size_t
+nextPowerOfTwo(size_t value)
+{
+   auto result = size_t { 1 };
+
+   while (result < value) {
+      result <<= 1;
+   }
+
+   return result;
+}
+
+void
+SoundRing::reset(unsigned sampleRate,
+                 unsigned numChannels,
+                 unsigned targetLatencyMs)
+{
+   mNumChannels = numChannels;
+   mTargetFrames = std::max<size_t>(1, sampleRate * targetLatencyMs / 1000);
+
+   // Leave plenty of headroom above the target so bursts are not dropped
+   mCapacity = nextPowerOfTwo(std::max<size_t>(mTargetFrames * 4, 1024));
+   mBuffer.assign(mCapacity * mNumChannels, 0);
+
+   mWritePos.store(0);
+   mReadPos.store(0);
+   mPlaying = false;
+   mPhase = 0.0;
+   mAverageFill = 0.0;
+   mUnderruns.store(0);
+   mOverruns.store(0);
+   mCorrectionPpm.store(0);
+}
+
+size_t
+SoundRing::write(const int16_t *samples,
+                 size_t numFrames,
+                 unsigned inputChannels)
+{
+   decaf_check(inputChannels >= mNumChannels);
+   auto writePos = mWritePos.load(std::memory_order_relaxed);
+   auto readPos = mReadPos.load(std::memory_order_acquire);
+   auto space = mCapacity - (writePos - readPos);
+
+   if (numFrames > space) {
+      mOverruns.fetch_add(1, std::memory_order_relaxed);
+      numFrames = space;
+   }
+
+   for (auto i = 0u; i < numFrames; ++i) {
+      auto dst = &mBuffer[((writePos + i) & (mCapacity - 1)) * mNumChannels];
+      std::memcpy(dst, samples + i * inputChannels, mNumChannels * sizeof(int16_t));
+   }
+
+   mWritePos.store(writePos + numFrames, std::memory_order_release);
+   return numFrames;
+}
+
+void
+SoundRing::read(int16_t *samples,
+                size_t numFrames)
+{
+   auto readPos = mReadPos.load(std::memory_order_relaxed);
+   auto writePos = mWritePos.load(std::memory_order_acquire);
+   auto available = writePos - readPos;
+
+   if (!mPlaying) {
+      // Wait until we have buffered up to the target before starting again,
+      //  this gives the producer a chance to catch up after an underrun.
+      if (available < mTargetFrames) {
+         std::memset(samples, 0, numFrames * mNumChannels * sizeof(int16_t));
+         return;
+      }
+
+      mPlaying = true;
+      mPhase = 0.0;
+      mAverageFill = static_cast<double>(available);
+   }
+
+   // If the producer stalled and then caught up all at once we may be far
+   //  behind, rather than slowly resampling that away just skip ahead.
+   if (available > mTargetFrames * 3) {
+      mOverruns.fetch_add(1, std::memory_order_relaxed);
+      readPos += available - mTargetFrames;
+      available = mTargetFrames;
+      mAverageFill = static_cast<double>(available);
+   }
+
+   mAverageFill += (static_cast<double>(available) - mAverageFill) * FillSmoothing;
+
+   // Consume slightly faster when above the target and slower when below
+   auto error = (mAverageFill - mTargetFrames) / mTargetFrames;
+   auto correction = std::min(std::max(error * DriftGain, -MaxDriftCorrection), MaxDriftCorrection);
+   auto step = 1.0 + correction;
+   mCorrectionPpm.store(static_cast<int32_t>(correction * 1000000.0), std::memory_order_relaxed);
+
+   auto mask = mCapacity - 1;
+   auto frame = 0u;
+
+   for (; frame < numFrames; ++frame) {
+      // Interpolating needs the frame after the current one too
+      if (available < 2) {
+         mUnderruns.fetch_add(1, std::memory_order_relaxed);
+         mPlaying = false;
+         break;
+      }
+
+      auto a = &mBuffer[(readPos & mask) * mNumChannels];
+      auto b = &mBuffer[((readPos + 1) & mask) * mNumChannels];
+      auto out = samples + frame * mNumChannels;
+
+      for (auto channel = 0u; channel < mNumChannels; ++channel) {
+         auto value = a[channel] + (b[channel] - a[channel]) * mPhase;
+         out[channel] = static_cast<int16_t>(value + (value < 0 ? -0.5 : 0.5));
+      }
+
+      mPhase += step;
+
+      while (mPhase >= 1.0) {
+         mPhase -= 1.0;
+         readPos++;
+         available--;
+      }
+   }
+
+   if (frame < numFrames) {
+      std::memset(samples + frame * mNumChannels, 0, (numFrames - frame) * mNumChannels * sizeof(int16_t));
+   }
+
+   mReadPos.store(readPos, std::memory_order_release);
+}
+
+SoundRing::Stats
+SoundRing::getStats() const
+{
+   auto stats = Stats { };
+   stats.underruns = mUnderruns.load(std::memory_order_relaxed);
+   stats.overruns = mOverruns.load(std::memory_order_relaxed);
+   stats.bufferedFrames = mWritePos.load(std::memory_order_relaxed) - mReadPos.load(std::memory_order_relaxed);
+   stats.correctionPpm = mCorrectionPpm.load(std::memory_order_relaxed);
+   return stats;
+}
+
+} // namespace decaf
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace decaf
+{
+
+/**
+ * Lock-free single producer, single consumer ring of interleaved 16 bit
+ * samples for handing audio from the emulator to a host audio device.
+ *
+ * The producer is SoundDriver::output on the AX frame thread, the consumer
+ * is the host audio callback. The guest produces samples by its own clock
+ * which will never exactly match the host device, so the consumer resamples
+ * by a small amount to keep the buffered audio near the target latency.
+ */
+class SoundRing
+{
+public:
+   struct Stats
+   {
+      //! Number of times the consumer ran out of samples
+      uint64_t underruns;
+
+      //! Number of times samples were dropped because the ring was too full
+      uint64_t overruns;
+
+      //! Frames currently buffered
+      size_t bufferedFrames;
+
+      //! Current resampling correction in parts per million
+      int32_t correctionPpm;
+   };
+
+   void
+   reset(unsigned sampleRate,
+         unsigned numChannels,
+         unsigned targetLatencyMs);
+
+   // Producer side, copies the first numChannels channels of every frame
+   //  from samples which has inputChannels channels. Returns the number of
+   //  frames which fit in the ring.
+   size_t
+   write(const int16_t *samples,
+         size_t numFrames,
+         unsigned inputChannels);
+
+   // Consumer side, always fills samples with numFrames frames, using
+   //  silence when there is not enough buffered.
+   void
+   read(int16_t *samples,
+        size_t numFrames);
+
+   Stats
+   getStats() const;
+
+   unsigned
+   getNumChannels() const
+   {
+      return mNumChannels;
+   }
+
+private:
+   std::vector<int16_t> mBuffer;
+   size_t mCapacity = 0;
+   unsigned mNumChannels = 0;
+   size_t mTargetFrames = 0;
+
+   // Total frames ever written and read, indexes wrap with mCapacity - 1
+   std::atomic<size_t> mWritePos { 0 };
+   std::atomic<size_t> mReadPos { 0 };
+
+   // Consumer state
+   bool mPlaying = false;
+   double mPhase = 0.0;
+   double mAverageFill = 0.0;
+
+   std::atomic<uint64_t> mUnderruns { 0 };
+   std::atomic<uint64_t> mOverruns { 0 };
+   std::atomic<int32_t> mCorrectionPpm { 0 };
+};
+
+} // namespace decaf
@@ -1,5 +1,6 @@
 #include "debugger_analysis.h"
 #include "debugger_branchcalc.h"
+#include "libcpu/code_analysis.h"
 #include "libcpu/espresso/espresso_instructionset.h"
 #include "libcpu/mem.h"
 #include "kernel/kernel_loader.h"
@@ -130,6 +131,14 @@ markAsFunction(uint32_t address,
       func.start = address;
       func.end = findFunctionEnd(address);
       func.name = name;
+
+      // Prefer the boundaries found when the module was loaded
+      auto known = cpu::analysis::Function { };
+
+      if (cpu::analysis::findFunction(address, known) && known.start == address) {
+         func.end = known.end;
+      }
+
       sFuncData.emplace(func.start, func);
    }
 }
@@ -188,27 +197,20 @@ analyse(uint32_t start,
 
    kernel::loader::unlockLoader();
 
-   for (auto addr = start; addr < end; addr += 4) {
-      auto instr = mem::read<espresso::Instruction>(addr);
-      auto data = espresso::decodeInstruction(instr);
+   // The code itself was analysed when it was loaded, so this only has to
+   //  copy out the results rather than decode everything again.
+   auto functions = std::vector<cpu::analysis::Function> { };
+   cpu::analysis::getFunctions(start, end, functions);
 
-      if (!data) {
-         continue;
-      }
+   for (auto &func : functions) {
+      markAsFunction(func.start);
+   }
 
-      if (isBranchInstr(data)) {
-         auto meta = getBranchMeta(addr, instr, data, nullptr);
+   auto edges = std::vector<cpu::analysis::BranchEdge> { };
+   cpu::analysis::getBranchEdges(start, end, edges);
 
-         if (!meta.isCall && !meta.isVariable) {
-            sInstrData[meta.target].sourceBranches.push_back(addr);
-         }
-
-         // If this is a call, and its not variable, we should mark
-         //  the target as a function, since it likely is...
-         if (meta.isCall && !meta.isVariable) {
-            markAsFunction(meta.target);
-         }
-      }
+   for (auto &edge : edges) {
+      sInstrData[edge.target].sourceBranches.push_back(edge.source);
    }
 }
 
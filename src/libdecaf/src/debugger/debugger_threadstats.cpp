@@ -0,0 +1,58 @@
+#include "decaf_debugger.h"
+#include "modules/coreinit/coreinit_internal_threadstats.h"
+#include "modules/coreinit/coreinit_scheduler.h"
+#include "modules/coreinit/coreinit_thread.h"
+#include <spdlog/spdlog.h>
+
+namespace decaf
+{
+
+namespace debugger
+{
+
+std::string
+formatThreadStats()
+{
+   fmt::MemoryWriter out;
+   out.write("{:>4} {:<32} {:>12} {:>12} {:>12} {:>9} {:>9} {:>9}  {}\n",
+             "ID", "Name", "Run ms", "Ready ms", "Blocked ms", "Switches", "Preempts", "Migrates", "Blocked on");
+
+   coreinit::internal::lockScheduler();
+
+   for (auto thread = coreinit::internal::getFirstActiveThread(); thread; thread = thread->activeLink.next) {
+      coreinit::internal::ThreadStats stats;
+
+      if (!coreinit::internal::getThreadStatsNoLock(thread, stats)) {
+         continue;
+      }
+
+      auto blockedNs = uint64_t { 0 };
+      fmt::MemoryWriter blockedOn;
+
+      for (auto i = 0u; i < stats.blockedTimeNs.size(); ++i) {
+         if (stats.blockedTimeNs[i]) {
+            auto reason = static_cast<coreinit::internal::ThreadWaitReason>(i);
+            blockedNs += stats.blockedTimeNs[i];
+            blockedOn.write("{}={:.1f} ", coreinit::internal::threadWaitReasonName(reason), stats.blockedTimeNs[i] / 1000000.0);
+         }
+      }
+
+      out.write("{:>4} {:<32} {:>12.1f} {:>12.1f} {:>12.1f} {:>9} {:>9} {:>9}  {}\n",
+                thread->id,
+                thread->name ? thread->name.get() : "",
+                stats.runTimeNs / 1000000.0,
+                stats.readyTimeNs / 1000000.0,
+                blockedNs / 1000000.0,
+                stats.switchCount,
+                stats.preemptCount,
+                stats.migrationCount,
+                blockedOn.str());
+   }
+
+   coreinit::internal::unlockScheduler();
+   return out.str();
+}
+
+} // namespace debugger
+
+} // namespace decaf
@@ -1,7 +1,10 @@
 #include "debugger_ui_internal.h"
+#include "decaf_config.h"
 #include "libcpu/cpu.h"
 #include "libcpu/espresso/espresso_instructionid.h"
 #include "libcpu/espresso/espresso_instructionset.h"
+#include "modules/gx2/gx2_event.h"
+#include "profiler/profiler.h"
 #include <algorithm>
 #include <chrono>
 #include <cinttypes>
@@ -20,6 +23,9 @@ namespace StatsView
 static const size_t
 InstrCount = static_cast<size_t>(espresso::InstructionID::InstructionCount);
 
+static const size_t
+MaxProfilerFunctions = 50;
+
 bool
 gIsVisible = true;
 
@@ -35,6 +41,18 @@ sFirstSeen = std::chrono::time_point<std::chrono::system_clock>::max();
 static uint64_t
 sFirstSeenValues[InstrCount] = { 0 };
 
+struct GpuInterruptRates
+{
+   std::chrono::time_point<std::chrono::system_clock> sampleTime;
+   uint64_t events = 0;
+   uint64_t interrupts = 0;
+   float eventsPerSecond = 0.0f;
+   float interruptsPerSecond = 0.0f;
+};
+
+static GpuInterruptRates
+sGpuInterruptRates;
+
 void
 draw()
 {
@@ -118,6 +136,104 @@ draw()
       ImGui::TreePop();
    }
 
+   if (ImGui::TreeNode("GPU Interrupts"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      uint64_t events, interrupts;
+      gx2::internal::getGpuInterruptStats(events, interrupts);
+
+      // Rates are taken over roughly a second so they stay readable
+      using seconds_duration = std::chrono::duration<float, std::chrono::seconds::period>;
+      auto now = std::chrono::system_clock::now();
+      auto secondsDelta = std::chrono::duration_cast<seconds_duration>(now - sGpuInterruptRates.sampleTime).count();
+
+      if (secondsDelta >= 1.0f) {
+         if (sGpuInterruptRates.sampleTime.time_since_epoch().count()) {
+            sGpuInterruptRates.eventsPerSecond = static_cast<float>(events - sGpuInterruptRates.events) / secondsDelta;
+            sGpuInterruptRates.interruptsPerSecond = static_cast<float>(interrupts - sGpuInterruptRates.interrupts) / secondsDelta;
+         }
+
+         sGpuInterruptRates.sampleTime = now;
+         sGpuInterruptRates.events = events;
+         sGpuInterruptRates.interrupts = interrupts;
+      }
+
+      ImGui::Text("Events");
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, events);
+      ImGui::NextColumn();
+      ImGui::Text("%.0f", sGpuInterruptRates.eventsPerSecond);
+      ImGui::NextColumn();
+
+      ImGui::Text("Interrupts");
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, interrupts);
+      ImGui::NextColumn();
+      ImGui::Text("%.0f", sGpuInterruptRates.interruptsPerSecond);
+      ImGui::NextColumn();
+
+      ImGui::TreePop();
+   }
+
+   if (ImGui::TreeNode("Profiler"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      if (profiler::isRunning()) {
+         if (ImGui::Button("Stop")) {
+            profiler::stop();
+         }
+      } else {
+         if (ImGui::Button("Start")) {
+            profiler::start(decaf::config::profiler::sample_rate);
+         }
+      }
+
+      ImGui::SameLine();
+
+      if (ImGui::Button("Reset")) {
+         profiler::reset();
+      }
+
+      ImGui::SameLine();
+
+      if (ImGui::Button("Save")) {
+         profiler::writeCollapsedStacks(decaf::config::profiler::output_path);
+      }
+
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      auto summary = profiler::getSummary(MaxProfilerFunctions);
+      auto total = static_cast<float>(std::max<uint64_t>(summary.samples, 1));
+
+      auto showSamples = [&](const char *name, uint64_t samples) {
+         ImGui::Text("%s", name);
+         ImGui::NextColumn();
+         ImGui::Text("%" PRIu64, samples);
+         ImGui::NextColumn();
+         ImGui::Text("%.1f%%", 100.0f * static_cast<float>(samples) / total);
+         ImGui::NextColumn();
+      };
+
+      showSamples("Guest", summary.guestSamples);
+      showSamples("HLE", summary.hleSamples);
+      showSamples("Idle", summary.idleSamples);
+      ImGui::Separator();
+
+      for (auto &function : summary.topFunctions) {
+         showSamples(function.first.c_str(), function.second);
+      }
+
+      ImGui::TreePop();
+   }
+
    ImGui::Columns(1);
    ImGui::End();
 }
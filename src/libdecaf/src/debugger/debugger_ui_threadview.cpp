@@ -1,5 +1,6 @@
 #include "debugger_ui_internal.h"
 #include "modules/coreinit/coreinit_enum_string.h"
+#include "modules/coreinit/coreinit_internal_threadstats.h"
 #include "modules/coreinit/coreinit_scheduler.h"
 #include "modules/coreinit/coreinit_thread.h"
 #include <cinttypes>
@@ -27,6 +28,7 @@ struct ThreadInfo
    coreinit::OSThreadState state;
    int32_t coreId;
    uint64_t coreTimeNs;
+   coreinit::internal::ThreadStats stats;
    int32_t priority;
    int32_t basePriority;
    uint32_t affinity;
@@ -83,23 +85,28 @@ draw()
       tinfo.coreTimeNs = thread->coreTimeConsumedNs;
 
       if (tinfo.coreId != -1) {
-         tinfo.coreTimeNs += coreinit::internal::getCoreThreadRunningTime(0);
+         tinfo.coreTimeNs += coreinit::internal::getCoreThreadRunningTime(tinfo.coreId);
       }
 
+      coreinit::internal::getThreadStatsNoLock(thread, tinfo.stats);
+
       sThreadsCache.push_back(tinfo);
    }
 
    coreinit::internal::unlockScheduler();
 
-   ImGui::Columns(8, "threadList", false);
+   ImGui::Columns(11, "threadList", false);
    ImGui::SetColumnOffset(0, ImGui::GetWindowWidth() * 0.00f);
-   ImGui::SetColumnOffset(1, ImGui::GetWindowWidth() * 0.05f);
-   ImGui::SetColumnOffset(2, ImGui::GetWindowWidth() * 0.35f);
-   ImGui::SetColumnOffset(3, ImGui::GetWindowWidth() * 0.50f);
-   ImGui::SetColumnOffset(4, ImGui::GetWindowWidth() * 0.60f);
-   ImGui::SetColumnOffset(5, ImGui::GetWindowWidth() * 0.70f);
-   ImGui::SetColumnOffset(6, ImGui::GetWindowWidth() * 0.75f);
-   ImGui::SetColumnOffset(7, ImGui::GetWindowWidth() * 0.84f);
+   ImGui::SetColumnOffset(1, ImGui::GetWindowWidth() * 0.04f);
+   ImGui::SetColumnOffset(2, ImGui::GetWindowWidth() * 0.26f);
+   ImGui::SetColumnOffset(3, ImGui::GetWindowWidth() * 0.36f);
+   ImGui::SetColumnOffset(4, ImGui::GetWindowWidth() * 0.44f);
+   ImGui::SetColumnOffset(5, ImGui::GetWindowWidth() * 0.52f);
+   ImGui::SetColumnOffset(6, ImGui::GetWindowWidth() * 0.57f);
+   ImGui::SetColumnOffset(7, ImGui::GetWindowWidth() * 0.62f);
+   ImGui::SetColumnOffset(8, ImGui::GetWindowWidth() * 0.71f);
+   ImGui::SetColumnOffset(9, ImGui::GetWindowWidth() * 0.80f);
+   ImGui::SetColumnOffset(10, ImGui::GetWindowWidth() * 0.89f);
 
    ImGui::Text("ID"); ImGui::NextColumn();
    ImGui::Text("Name"); ImGui::NextColumn();
@@ -109,6 +116,9 @@ draw()
    ImGui::Text("Aff"); ImGui::NextColumn();
    ImGui::Text("Core"); ImGui::NextColumn();
    ImGui::Text("Core Time"); ImGui::NextColumn();
+   ImGui::Text("Ready Time"); ImGui::NextColumn();
+   ImGui::Text("Blocked"); ImGui::NextColumn();
+   ImGui::Text("Switches"); ImGui::NextColumn();
    ImGui::Separator();
 
    for (auto &thread : sThreadsCache) {
@@ -201,6 +211,43 @@ draw()
       // Core Time
       ImGui::Text("%" PRIu64, thread.coreTimeNs / 1000);
       ImGui::NextColumn();
+
+      // Time spent waiting for a core
+      ImGui::Text("%" PRIu64, thread.stats.readyTimeNs / 1000);
+      ImGui::NextColumn();
+
+      // Time spent blocked, with what it was blocked on in the tooltip
+      auto blockedNs = uint64_t { 0 };
+
+      for (auto ns : thread.stats.blockedTimeNs) {
+         blockedNs += ns;
+      }
+
+      ImGui::Text("%" PRIu64, blockedNs / 1000);
+
+      if (ImGui::IsItemHovered()) {
+         ImGui::BeginTooltip();
+
+         for (auto i = 0u; i < thread.stats.blockedTimeNs.size(); ++i) {
+            if (thread.stats.blockedTimeNs[i]) {
+               auto reason = static_cast<coreinit::internal::ThreadWaitReason>(i);
+               ImGui::Text("%s: %" PRIu64, coreinit::internal::threadWaitReasonName(reason), thread.stats.blockedTimeNs[i] / 1000);
+            }
+         }
+
+         ImGui::EndTooltip();
+      }
+
+      ImGui::NextColumn();
+
+      // Context switches
+      ImGui::Text("%" PRIu64, thread.stats.switchCount);
+
+      if (ImGui::IsItemHovered()) {
+         ImGui::SetTooltip("Preempted: %" PRIu64 "\nMigrated: %" PRIu64, thread.stats.preemptCount, thread.stats.migrationCount);
+      }
+
+      ImGui::NextColumn();
    }
 
    ImGui::Columns(1);
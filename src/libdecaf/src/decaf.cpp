@@ -1,4 +1,7 @@
+#include "common/adaptive_spinlock.h"
 #include "common/platform_dir.h"
+#include "common/platform_memory.h"
+#include "common/platform_thread.h"
 #include "decaf.h"
 #include "decaf_config.h"
 #include "decaf_graphics.h"
@@ -9,13 +12,17 @@
 #include "filesystem/filesystem.h"
 #include "input/input.h"
 #include "kernel/kernel.h"
+#include "kernel/kernel_binarytrace.h"
 #include "kernel/kernel_hlefunction.h"
 #include "kernel/kernel_filesystem.h"
+#include "kernel/kernel_replay.h"
+#include "kernel/kernel_snapshot.h"
 #include "libcpu/cpu.h"
 #include "libcpu/mem.h"
 #include "modules/coreinit/coreinit_fs.h"
 #include "modules/coreinit/coreinit_scheduler.h"
 #include "modules/swkbd/swkbd_core.h"
+#include "profiler/profiler.h"
 #include <condition_variable>
 #include <mutex>
 
@@ -60,6 +67,98 @@ public:
    }
 };
 
+// Threads which get a physical host core each, in the order they are given one
+enum PinnedThread
+{
+   PinnedCore0,
+   PinnedCore1,
+   PinnedCore2,
+   PinnedGpu,
+   NumPinnedThreads,
+};
+
+static platform::ThreadPlacement
+sThreadPlacement;
+
+static std::string
+formatProcessors(const std::vector<uint32_t> &processors)
+{
+   fmt::MemoryWriter out;
+
+   for (auto i = 0u; i < processors.size(); ++i) {
+      out.write(i ? ",{}" : "{}", processors[i]);
+   }
+
+   return out.str();
+}
+
+static void
+initialiseThreadPlacement()
+{
+   auto pinning = decaf::config::system::thread_pinning;
+   auto node = decaf::config::system::thread_numa_node;
+
+   if (!pinning && node < 0) {
+      return;
+   }
+
+   auto processors = platform::getHostProcessors();
+   sThreadPlacement = platform::planThreadPlacement(processors, pinning ? NumPinnedThreads : 0, node);
+
+   if (sThreadPlacement.shared.empty()) {
+      gLog->warn("Could not place host threads, found {} host processors for NUMA node {}", processors.size(), node);
+      return;
+   }
+
+   if (pinning && sThreadPlacement.pinned.empty()) {
+      gLog->warn("Not enough physical host cores to pin {} threads", static_cast<int>(NumPinnedThreads));
+   }
+
+   if (!sThreadPlacement.pinned.empty()) {
+      gLog->info("Thread placement: cores on host processors {}, GPU on {}, other threads on {}",
+                 formatProcessors({ sThreadPlacement.pinned.begin(), sThreadPlacement.pinned.begin() + PinnedGpu }),
+                 sThreadPlacement.pinned[PinnedGpu],
+                 formatProcessors(sThreadPlacement.shared));
+   } else {
+      gLog->info("Thread placement: all threads on host processors {}",
+                 formatProcessors(sThreadPlacement.shared));
+   }
+}
+
+static void
+placeThread(std::thread *thread,
+            int pinned,
+            bool realtime)
+{
+   auto processors = sThreadPlacement.shared;
+
+   if (pinned >= 0 && static_cast<size_t>(pinned) < sThreadPlacement.pinned.size()) {
+      processors = { sThreadPlacement.pinned[pinned] };
+   }
+
+   if (!processors.empty() && !platform::setThreadAffinity(thread, processors)) {
+      gLog->warn("Could not set affinity of host thread to processors {}", formatProcessors(processors));
+   }
+
+   if (realtime && decaf::config::system::thread_realtime) {
+      if (!platform::setThreadRealtimePriority(thread)) {
+         gLog->warn("Not permitted to give host threads real-time priority");
+      }
+   }
+}
+
+void
+placeGpuThread(std::thread *thread)
+{
+   placeThread(thread, PinnedGpu, true);
+}
+
+void
+placeHelperThread(std::thread *thread)
+{
+   placeThread(thread, -1, false);
+}
+
 std::string
 makeConfigPath(const std::string &filename)
 {
@@ -108,8 +207,41 @@ initialise(const std::string &gamePath)
       cpu::setJitMode(cpu::jit_mode::disabled);
    }
 
+   if (decaf::config::jit::perf_mode == "map") {
+      cpu::setJitPerfMode(cpu::jit_perf_mode::perf_map);
+   } else if (decaf::config::jit::perf_mode == "jitdump") {
+      cpu::setJitPerfMode(cpu::jit_perf_mode::jitdump);
+   } else {
+      cpu::setJitPerfMode(cpu::jit_perf_mode::disabled);
+   }
+
+   cpu::setJitProfiling(decaf::config::jit::profile);
+   cpu::setJitSampling(decaf::config::profiler::enabled || decaf::config::debugger::enabled);
+   cpu::setJitFunctionBlocks(decaf::config::jit::function_blocks);
+
+   auto hugePages = mem::HugePages::Disabled;
+
+   if (decaf::config::system::huge_pages == "transparent") {
+      hugePages = mem::HugePages::Transparent;
+   } else if (decaf::config::system::huge_pages == "explicit") {
+      hugePages = mem::HugePages::Explicit;
+   } else if (decaf::config::system::huge_pages != "off") {
+      gLog->warn("Unknown huge_pages value \"{}\", huge pages are disabled", decaf::config::system::huge_pages);
+   }
+
+   mem::setHugePages(hugePages);
+   cpu::setJitHugePages(hugePages != mem::HugePages::Disabled);
+
    // Setup core
+   initialiseThreadPlacement();
    mem::initialise();
+
+   if (sThreadPlacement.node >= 0) {
+      if (!platform::bindMemoryToNode(mem::base(), 0x100000000ull, sThreadPlacement.node)) {
+         gLog->warn("Could not bind guest memory to NUMA node {}", sThreadPlacement.node);
+      }
+   }
+
    cpu::initialise();
    kernel::initialise();
 
@@ -178,8 +310,29 @@ initialise(const std::string &gamePath)
 void
 start()
 {
+   if (!decaf::config::log::binary_trace_path.empty()) {
+      kernel::startBinaryTrace(decaf::config::log::binary_trace_path);
+   }
+
+   // A replay takes priority over making a new recording
+   if (!decaf::config::system::replay_path.empty()) {
+      kernel::startReplay(decaf::config::system::replay_path);
+   } else if (!decaf::config::system::record_path.empty()) {
+      kernel::startRecording(decaf::config::system::record_path);
+   }
+
    cpu::start();
 
+   for (auto i = 0; i < 3; ++i) {
+      placeThread(&cpu::getCoreThread(i), PinnedCore0 + i, true);
+   }
+
+   placeThread(&cpu::getTimerThread(), -1, false);
+
+   if (decaf::config::profiler::enabled) {
+      profiler::start(decaf::config::profiler::sample_rate);
+   }
+
    volatile int zero = 0;
    if (zero) {
       tracePrint(nullptr, 0, 0);
@@ -208,6 +361,25 @@ waitForExit()
    return kernel::getExitCode();
 }
 
+bool
+saveSnapshot()
+{
+   return kernel::saveSnapshot();
+}
+
+bool
+restoreSnapshot()
+{
+   return kernel::restoreSnapshot();
+}
+
+bool
+dumpBinaryTrace(const std::string &path,
+                std::ostream &out)
+{
+   return kernel::dumpBinaryTrace(path, out);
+}
+
 void
 shutdown()
 {
@@ -225,6 +397,33 @@ shutdown()
    // Wait for CPU to finish
    cpu::join();
 
+   // Stop the profiler
+   if (profiler::isRunning()) {
+      profiler::stop();
+      profiler::writeCollapsedStacks(decaf::config::profiler::output_path);
+   }
+
+   // Report the hottest JIT blocks
+   if (decaf::config::jit::profile) {
+      gLog->info("Hottest JIT blocks:\n{}", cpu::formatJitProfile(50));
+   }
+
+   // Close the JIT perf output
+   cpu::shutdown();
+
+   // Report which host side locks were fought over
+   auto lockStats = spinlock_format_stats();
+
+   if (!lockStats.empty()) {
+      gLog->debug("Lock contention:\n{}", lockStats);
+   }
+
+   // Flush the binary trace
+   kernel::stopBinaryTrace();
+
+   // Flush the recording
+   kernel::stopReplay();
+
    // Stop the FS
    coreinit::internal::shutdownFsThread();
 
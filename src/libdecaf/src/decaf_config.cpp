@@ -20,6 +20,7 @@ namespace gpu
 
 bool debug = false;
 std::vector<unsigned> debug_filters = {};
+unsigned interrupt_interval_us = 1000;
 
 } // namespace gpu
 
@@ -36,6 +37,9 @@ namespace jit
 
 bool enabled = true;
 bool verify = false;
+std::string perf_mode = "off";
+bool profile = false;
+bool function_blocks = false;
 
 } // namespace jit
 
@@ -44,6 +48,7 @@ namespace log
 
 bool kernel_trace = false;
 bool branch_trace = false;
+std::string binary_trace_path = "";
 
 std::vector<std::string> kernel_trace_filters =
 {
@@ -60,10 +65,20 @@ std::vector<std::string> kernel_trace_filters =
 
 } // namespace log
 
+namespace profiler
+{
+
+bool enabled = false;
+unsigned sample_rate = 1000;
+std::string output_path = "decaf_profile.folded";
+
+} // namespace profiler
+
 namespace sound
 {
 
 bool dump_sounds = false;
+unsigned latency_ms = 50;
 
 } // namespace sound
 
@@ -74,6 +89,16 @@ int region = static_cast<int>(coreinit::SCIRegion::USA);
 std::string system_path = "/undefined_system_path";
 std::string content_path = {};
 double time_scale = 1.0;
+unsigned loader_threads = 0;
+std::string loader_cache_path = {};
+bool expheap_free_index = true;
+bool zlib_host_memory = true;
+bool thread_pinning = false;
+int thread_numa_node = -1;
+bool thread_realtime = false;
+std::string huge_pages = "off";
+std::string record_path = {};
+std::string replay_path = {};
 
 } // namespace system
 
@@ -3,6 +3,7 @@
 #include "modules/gx2/gx2_event.h"
 #include "modules/gx2/gx2_cbpool.h"
 #include "modules/coreinit/coreinit_time.h"
+#include <atomic>
 #include <condition_variable>
 #include <queue>
 #include <mutex>
@@ -35,6 +36,12 @@ public:
       return next;
    }
 
+   bool empty()
+   {
+      std::unique_lock<std::mutex> lock { mQueueMutex };
+      return mQueue.empty();
+   }
+
    pm4::Buffer *waitForBuffer()
    {
       std::unique_lock<std::mutex> lock { mQueueMutex };
@@ -57,6 +64,10 @@ private:
 static CommandQueue
 gQueue;
 
+//! Buffers queued which have not been retired yet
+static std::atomic<uint32_t>
+sBuffersInFlight { 0 };
+
 void
 awaken()
 {
@@ -68,6 +79,7 @@ queueCommandBuffer(pm4::Buffer *buf)
 {
    buf->submitTime = coreinit::OSGetTime();
    gx2::internal::setLastSubmittedTimestamp(buf->submitTime);
+   sBuffersInFlight.fetch_add(1, std::memory_order_acq_rel);
    gQueue.appendBuffer(buf);
 }
 
@@ -75,6 +87,11 @@ queueCommandBuffer(pm4::Buffer *buf)
 pm4::Buffer *
 unqueueCommandBuffer()
 {
+   // Never sleep with GPU interrupts still held back
+   if (gQueue.empty()) {
+      gx2::internal::flushGpuInterrupts();
+   }
+
    return gQueue.waitForBuffer();
 }
 
@@ -82,7 +99,13 @@ unqueueCommandBuffer()
 pm4::Buffer *
 tryUnqueueCommandBuffer()
 {
-   return gQueue.dequeueBuffer();
+   auto buf = gQueue.dequeueBuffer();
+
+   if (!buf) {
+      gx2::internal::flushGpuInterrupts();
+   }
+
+   return buf;
 }
 
 void
@@ -90,6 +113,19 @@ retireCommandBuffer(pm4::Buffer *buf)
 {
    gx2::internal::setRetiredTimestamp(buf->submitTime);
    gx2::internal::freeCommandBuffer(buf);
+   sBuffersInFlight.fetch_sub(1, std::memory_order_acq_rel);
+
+   // Interrupts are coalesced while there is more work queued, once the
+   //  queue drains deliver whatever is left so waiters are not delayed.
+   if (gQueue.empty()) {
+      gx2::internal::flushGpuInterrupts();
+   }
+}
+
+bool
+isIdle()
+{
+   return sBuffersInFlight.load(std::memory_order_acquire) == 0;
 }
 
 } // namespace gpu
@@ -24,4 +24,8 @@ unqueueCommandBuffer();
 pm4::Buffer *
 tryUnqueueCommandBuffer();
 
+//! True once every queued buffer has been retired and freed
+bool
+isIdle();
+
 } // namespace gpu
@@ -0,0 +1,175 @@
+#include "gpu_indices.h"
+#include "common/byte_swap.h"
+#include "common/byte_swap_array.h"
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define GPU_INDICES_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace gpu
+{
+
+#ifdef GPU_INDICES_SSE2
+
+static inline __m128i
+swap16x8(__m128i v)
+{
+   return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i
+swap32x4(__m128i v)
+{
+   // Swap the 16 bit halves of each word, then the bytes of each half
+   v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+   v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+   return swap16x8(v);
+}
+
+static inline __m128i
+shuffle2x32(__m128i a, __m128i b, int imm)
+{
+   return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), imm));
+}
+
+#endif
+
+uint32_t
+getConvertedIndexCount(IndexExpand expand,
+                       uint32_t count)
+{
+   if (expand == IndexExpand::None) {
+      return count;
+   } else {
+      return (count / 4) * 6;
+   }
+}
+
+template<typename Type>
+static inline void
+expandQuad(Type *dst,
+           Type index0,
+           Type index1,
+           Type index2,
+           Type index3,
+           IndexExpand expand)
+{
+   dst[0] = index0;
+   dst[1] = index1;
+   dst[2] = index2;
+
+   if (expand == IndexExpand::Quads) {
+      dst[3] = index0;
+      dst[4] = index2;
+      dst[5] = index3;
+   } else {
+      // Rectangles use a different winding order apparently...
+      dst[3] = index2;
+      dst[4] = index1;
+      dst[5] = index3;
+   }
+}
+
+template<typename Type>
+static void
+expandIndicesScalar(Type *dst,
+                    const Type *src,
+                    uint32_t quads,
+                    bool swap,
+                    IndexExpand expand)
+{
+   for (auto i = 0u; i < quads; ++i, src += 4, dst += 6) {
+      if (swap) {
+         expandQuad(dst, byte_swap(src[0]), byte_swap(src[1]), byte_swap(src[2]), byte_swap(src[3]), expand);
+      } else {
+         expandQuad(dst, src[0], src[1], src[2], src[3], expand);
+      }
+   }
+}
+
+void
+convertIndices(uint16_t *dst,
+               const uint16_t *src,
+               uint32_t count,
+               bool swap,
+               IndexExpand expand)
+{
+   if (expand != IndexExpand::None) {
+      expandIndicesScalar(dst, src, count / 4, swap, expand);
+      return;
+   }
+
+   if (swap) {
+      byte_swap_copy(dst, src, count);
+   } else {
+      std::copy(src, src + count, dst);
+   }
+}
+
+void
+convertIndices(uint32_t *dst,
+               const uint32_t *src,
+               uint32_t count,
+               bool swap,
+               IndexExpand expand)
+{
+   if (expand != IndexExpand::None) {
+      auto quads = count / 4;
+      auto q = 0u;
+
+#ifdef GPU_INDICES_SSE2
+      // Two quads { a b c d } become three vectors of triangle indices
+      for (; q + 2 <= quads; q += 2, src += 8, dst += 12) {
+         auto q0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+         auto q1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4));
+
+         if (swap) {
+            q0 = swap32x4(q0);
+            q1 = swap32x4(q1);
+         }
+
+         __m128i out0, out1, out2;
+
+         if (expand == IndexExpand::Quads) {
+            // a0 b0 c0 a0 | c0 d0 a1 b1 | c1 a1 c1 d1
+            out0 = _mm_shuffle_epi32(q0, _MM_SHUFFLE(0, 2, 1, 0));
+            out1 = shuffle2x32(q0, q1, _MM_SHUFFLE(1, 0, 3, 2));
+            out2 = _mm_shuffle_epi32(q1, _MM_SHUFFLE(3, 2, 0, 2));
+         } else {
+            // a0 b0 c0 c0 | b0 d0 a1 b1 | c1 c1 b1 d1
+            out0 = _mm_shuffle_epi32(q0, _MM_SHUFFLE(2, 2, 1, 0));
+            out1 = shuffle2x32(_mm_shuffle_epi32(q0, _MM_SHUFFLE(3, 3, 3, 1)), q1, _MM_SHUFFLE(1, 0, 1, 0));
+            out2 = _mm_shuffle_epi32(q1, _MM_SHUFFLE(3, 1, 2, 2));
+         }
+
+         _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 0), out0);
+         _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4), out1);
+         _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 8), out2);
+      }
+#endif
+
+      expandIndicesScalar(dst, src, quads - q, swap, expand);
+      return;
+   }
+
+   if (swap) {
+      byte_swap_copy(dst, src, count);
+   } else {
+      std::copy(src, src + count, dst);
+   }
+}
+
+void
+generateQuadIndices(uint32_t *dst,
+                    uint32_t count,
+                    IndexExpand expand)
+{
+   for (auto i = 0u; i < count / 4; ++i, dst += 6) {
+      auto index = i * 4;
+      expandQuad(dst, index + 0, index + 1, index + 2, index + 3, expand);
+   }
+}
+
+} // namespace gpu
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+
+namespace gpu
+{
+
+/**
+ * Conversion of guest index buffers into something the host can draw with.
+ *
+ * These do not touch any graphics API so they can be used, and tested, on
+ * their own.
+ */
+
+enum class IndexExpand
+{
+   //! Indices are copied as they are
+   None,
+
+   //! Every 4 indices form a quad which is split into 2 triangles
+   Quads,
+
+   //! Like quads, but with the winding order used for rect lists
+   Rects,
+};
+
+uint32_t
+getConvertedIndexCount(IndexExpand expand,
+                       uint32_t count);
+
+void
+convertIndices(uint16_t *dst,
+               const uint16_t *src,
+               uint32_t count,
+               bool swap,
+               IndexExpand expand);
+
+void
+convertIndices(uint32_t *dst,
+               const uint32_t *src,
+               uint32_t count,
+               bool swap,
+               IndexExpand expand);
+
+void
+generateQuadIndices(uint32_t *dst,
+                    uint32_t count,
+                    IndexExpand expand);
+
+} // namespace gpu
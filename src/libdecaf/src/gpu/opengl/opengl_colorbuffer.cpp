@@ -56,6 +56,7 @@ bool GLDriver::checkActiveColorBuffer()
          mColorBufferCache[i].object = surfaceObject;
 
          gl::glFramebufferTexture(gl::GL_FRAMEBUFFER, gl::GL_COLOR_ATTACHMENT0 + i, surfaceObject, 0);
+         mDirtyState |= DirtyFramebuffer;
 
          mDrawBuffers[i] = surfaceObject ? gl::GL_COLOR_ATTACHMENT0 + i : gl::GL_NONE;
          changedDrawBuffers = true;
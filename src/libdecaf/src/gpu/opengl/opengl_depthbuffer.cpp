@@ -67,6 +67,7 @@ bool GLDriver::checkActiveDepthBuffer()
       }
 
       mDepthBufferCache.object = surfaceObject;
+      mDirtyState |= DirtyFramebuffer;
       mDepthBufferCache.depthBound = z_enable;
       mDepthBufferCache.stencilBound = stencil_enable;
    }
@@ -0,0 +1,239 @@
+#include "common/byte_swap_array.h"
+#include "common/log.h"
+#include "common/murmur3.h"
+#include "decaf_config.h"
+#include "gpu/pm4_reader.h"
+#include "opengl_driver.h"
+
+namespace gpu
+{
+
+namespace opengl
+{
+
+// Display lists which go unused for this many frames are freed
+static const uint64_t DisplayListMaxUnusedFrames = 60;
+
+// How often to log the display list cache hit rate in debug mode
+static const uint64_t DisplayListStatsInterval = 600;
+
+template<typename Type>
+static void
+readRegisterRun(DisplayListPacket &packet,
+                pm4::PacketReader &reader)
+{
+   auto data = pm4::read<Type>(reader);
+   packet.id = static_cast<uint32_t>(data.id);
+   packet.values = data.values;
+}
+
+void
+GLDriver::runDisplayList(uint32_t address,
+                         uint32_t *buffer,
+                         uint32_t size)
+{
+   // Games build most display lists once and call them every frame, so keep
+   //  them decoded and only decode them again if their memory changes.
+   uint64_t newHash[2] = { 0, 0 };
+   MurmurHash3_x64_128(buffer, size * sizeof(uint32_t), 0, newHash);
+
+   auto &list = mDisplayLists[address];
+   list.lastUsedFrame = mFrameCount;
+
+   if (list.size == size
+    && list.cpuMemHash[0] == newHash[0]
+    && list.cpuMemHash[1] == newHash[1]) {
+      mDisplayListHits++;
+   } else {
+      mDisplayListMisses++;
+      list.size = size;
+      list.cpuMemHash[0] = newHash[0];
+      list.cpuMemHash[1] = newHash[1];
+      decodeDisplayList(list, buffer, size);
+   }
+
+   mDisplayListDepth++;
+   replayDisplayList(list);
+   mDisplayListDepth--;
+}
+
+void
+GLDriver::decodeDisplayList(DisplayList &list,
+                            uint32_t *buffer,
+                            uint32_t size)
+{
+   list.words.resize(size);
+   list.packets.clear();
+   list.drawIndexAuto.clear();
+   list.drawIndex2.clear();
+   byte_swap_copy(list.words.data(), buffer, size);
+
+   auto words = list.words.data();
+
+   for (auto pos = 0u; pos < size; ) {
+      auto header = *reinterpret_cast<pm4::Header *>(&words[pos]);
+      auto packetSize = 0u;
+
+      if (words[pos] == 0) {
+         break;
+      }
+
+      switch (header.type()) {
+      case pm4::Header::Type3:
+      {
+         auto header3 = pm4::type3::Header::get(header.value);
+         packetSize = header3.size() + 1;
+
+         if (pos + packetSize > size) {
+            gLog->error("Invalid packet type3 size: {}", packetSize);
+            break;
+         }
+
+         auto packet = DisplayListPacket { header.value, 0, gsl::as_span(&words[pos + 1], packetSize) };
+         pm4::PacketReader reader { packet.values };
+
+         // Pre-read the packets which appear most often so replaying them
+         //  skips the generic packet reader.
+         switch (header3.opcode()) {
+         case pm4::type3::SET_ALU_CONST:
+            readRegisterRun<pm4::SetAluConsts>(packet, reader);
+            break;
+         case pm4::type3::SET_CONFIG_REG:
+            readRegisterRun<pm4::SetConfigRegs>(packet, reader);
+            break;
+         case pm4::type3::SET_CONTEXT_REG:
+            readRegisterRun<pm4::SetContextRegs>(packet, reader);
+            break;
+         case pm4::type3::SET_CTL_CONST:
+            readRegisterRun<pm4::SetControlConstants>(packet, reader);
+            break;
+         case pm4::type3::SET_LOOP_CONST:
+            readRegisterRun<pm4::SetLoopConsts>(packet, reader);
+            break;
+         case pm4::type3::SET_SAMPLER:
+            readRegisterRun<pm4::SetSamplers>(packet, reader);
+            break;
+         case pm4::type3::SET_RESOURCE:
+            readRegisterRun<pm4::SetResources>(packet, reader);
+            break;
+         case pm4::type3::DRAW_INDEX_AUTO:
+            packet.id = static_cast<uint32_t>(list.drawIndexAuto.size());
+            list.drawIndexAuto.push_back(pm4::read<pm4::DrawIndexAuto>(reader));
+            break;
+         case pm4::type3::DRAW_INDEX_2:
+            packet.id = static_cast<uint32_t>(list.drawIndex2.size());
+            list.drawIndex2.push_back(pm4::read<pm4::DrawIndex2>(reader));
+            break;
+         default:
+            break;
+         }
+
+         list.packets.push_back(packet);
+         break;
+      }
+      case pm4::Header::Type0:
+      {
+         auto header0 = pm4::type0::Header::get(header.value);
+         packetSize = header0.count() + 1;
+
+         if (pos + packetSize > size) {
+            gLog->error("Invalid packet type0 size: {}", packetSize);
+            break;
+         }
+
+         list.packets.push_back(DisplayListPacket { header.value, 0, gsl::as_span(&words[pos + 1], packetSize) });
+         break;
+      }
+      case pm4::Header::Type2:
+      {
+         // Filler packet, ignore
+         break;
+      }
+      case pm4::Header::Type1:
+      default:
+         gLog->error("Invalid packet header type {}, header = 0x{:08X}", header.type(), header.value);
+         pos = size;
+         break;
+      }
+
+      pos += packetSize + 1;
+   }
+}
+
+void
+GLDriver::replayDisplayList(const DisplayList &list)
+{
+   for (auto &packet : list.packets) {
+      auto header = pm4::Header::get(packet.header);
+
+      if (header.type() == pm4::Header::Type0) {
+         handlePacketType0(pm4::type0::Header::get(packet.header), packet.values);
+         continue;
+      }
+
+      auto header3 = pm4::type3::Header::get(packet.header);
+
+      switch (header3.opcode()) {
+      case pm4::type3::SET_ALU_CONST:
+         setAluConsts(pm4::SetAluConsts { static_cast<latte::Register>(packet.id), packet.values });
+         break;
+      case pm4::type3::SET_CONFIG_REG:
+         setConfigRegs(pm4::SetConfigRegs { static_cast<latte::Register>(packet.id), packet.values });
+         break;
+      case pm4::type3::SET_CONTEXT_REG:
+         setContextRegs(pm4::SetContextRegs { static_cast<latte::Register>(packet.id), packet.values });
+         break;
+      case pm4::type3::SET_CTL_CONST:
+         setControlConstants(pm4::SetControlConstants { static_cast<latte::Register>(packet.id), packet.values });
+         break;
+      case pm4::type3::SET_LOOP_CONST:
+         setLoopConsts(pm4::SetLoopConsts { static_cast<latte::Register>(packet.id), packet.values });
+         break;
+      case pm4::type3::SET_SAMPLER:
+         setSamplers(pm4::SetSamplers { static_cast<latte::Register>(packet.id), packet.values });
+         break;
+      case pm4::type3::SET_RESOURCE:
+         setResources(pm4::SetResources { packet.id, packet.values });
+         break;
+      case pm4::type3::DRAW_INDEX_AUTO:
+         drawIndexAuto(list.drawIndexAuto[packet.id]);
+         break;
+      case pm4::type3::DRAW_INDEX_2:
+         drawIndex2(list.drawIndex2[packet.id]);
+         break;
+      default:
+         handlePacketType3(header3, packet.values);
+      }
+   }
+}
+
+void
+GLDriver::pruneDisplayLists()
+{
+   if (decaf::config::gpu::debug && mFrameCount % DisplayListStatsInterval == 0) {
+      auto total = mDisplayListHits + mDisplayListMisses;
+
+      if (total) {
+         gLog->debug("Display list cache: {} hits, {} misses, {:.1f}% hit rate, {} cached",
+                     mDisplayListHits, mDisplayListMisses,
+                     100.0 * mDisplayListHits / total, mDisplayLists.size());
+      }
+   }
+
+   // A display list could swap buffers, don't free anything still in use
+   if (mDisplayListDepth) {
+      return;
+   }
+
+   for (auto itr = mDisplayLists.begin(); itr != mDisplayLists.end(); ) {
+      if (mFrameCount - itr->second.lastUsedFrame > DisplayListMaxUnusedFrames) {
+         itr = mDisplayLists.erase(itr);
+      } else {
+         ++itr;
+      }
+   }
+}
+
+} // namespace opengl
+
+} // namespace gpu
@@ -12,6 +12,8 @@ namespace opengl
 
 bool GLDriver::checkReadyDraw()
 {
+   applyDirtyState();
+
    if (!checkActiveShader()) {
       gLog->warn("Skipping draw with invalid shader.");
       return false;
@@ -42,20 +44,38 @@ bool GLDriver::checkReadyDraw()
       return false;
    }
 
-   if (!checkActiveColorBuffer()) {
-      gLog->warn("Skipping draw with invalid color buffer.");
-      return false;
+   // Render targets only need to be looked up again when their registers
+   //  change, or when any surface has switched its active host surface.
+   if (mRenderTargetGeneration != mSurfaceGeneration) {
+      mRenderTargetGeneration = mSurfaceGeneration;
+      mDirtyState |= DirtyColorTargets | DirtyDepthTarget;
    }
 
-   if (!checkActiveDepthBuffer()) {
-      gLog->warn("Skipping draw with invalid depth buffer.");
-      return false;
+   if (mDirtyState & DirtyColorTargets) {
+      if (!checkActiveColorBuffer()) {
+         gLog->warn("Skipping draw with invalid color buffer.");
+         return false;
+      }
+
+      mDirtyState &= ~DirtyColorTargets;
    }
 
-   auto fbStatus = gl::glCheckFramebufferStatus(gl::GL_FRAMEBUFFER);
+   if (mDirtyState & DirtyDepthTarget) {
+      if (!checkActiveDepthBuffer()) {
+         gLog->warn("Skipping draw with invalid depth buffer.");
+         return false;
+      }
 
-   if (fbStatus != gl::GL_FRAMEBUFFER_COMPLETE) {
-      gLog->warn("Draw attempted with an incomplete framebuffer, status {}.", glbinding::Meta::getString(fbStatus));
+      mDirtyState &= ~DirtyDepthTarget;
+   }
+
+   if (mDirtyState & DirtyFramebuffer) {
+      mFramebufferStatus = gl::glCheckFramebufferStatus(gl::GL_FRAMEBUFFER);
+      mDirtyState &= ~DirtyFramebuffer;
+   }
+
+   if (mFramebufferStatus != gl::GL_FRAMEBUFFER_COMPLETE) {
+      gLog->warn("Draw attempted with an incomplete framebuffer, status {}.", glbinding::Meta::getString(mFramebufferStatus));
       return false;
    }
 
@@ -92,101 +112,36 @@ getPrimitiveMode(latte::VGT_DI_PRIMITIVE_TYPE type)
    }
 }
 
-template<typename IndexType>
 static void
 drawPrimitives2(gl::GLenum mode,
                 uint32_t count,
-                const IndexType *indices,
+                gl::GLenum indexType,
+                const void *indexOffset,
                 uint32_t baseVertex,
                 uint32_t numInstances,
                 uint32_t baseInstance)
 {
    if (numInstances == 1) {
-      if (!indices) {
+      if (indexType == gl::GL_NONE) {
          gl::glDrawArrays(mode, baseVertex, count);
-      } else if (std::is_same<IndexType, uint16_t>()) {
-         gl::glDrawElementsBaseVertex(mode, count, gl::GL_UNSIGNED_SHORT, indices, baseVertex);
-      } else if (std::is_same<IndexType, uint32_t>()) {
-         gl::glDrawElementsBaseVertex(mode, count, gl::GL_UNSIGNED_INT, indices, baseVertex);
+      } else {
+         gl::glDrawElementsBaseVertex(mode, count, indexType, indexOffset, baseVertex);
       }
    } else {
-      if (!indices) {
+      if (indexType == gl::GL_NONE) {
          gl::glDrawArraysInstancedBaseInstance(mode, 0, count, numInstances, baseInstance);
-      } else if (std::is_same<IndexType, uint16_t>()) {
-         gl::glDrawElementsInstancedBaseInstance(mode, count, gl::GL_UNSIGNED_SHORT, indices, numInstances, baseInstance);
-      } else if (std::is_same<IndexType, uint32_t>()) {
-         gl::glDrawElementsInstancedBaseInstance(mode, count, gl::GL_UNSIGNED_INT, indices, numInstances, baseInstance);
-      }
-   }
-}
-
-template<bool IsRects, typename IndexType>
-static void
-unpackQuadRectList(uint32_t count,
-               const IndexType *src,
-               uint32_t baseVertex,
-               uint32_t numInstances,
-               uint32_t baseInstance)
-{
-   auto tris = (count / 4) * 6;
-   auto unpacked = std::vector<IndexType>(tris);
-   auto dst = &unpacked[0];
-
-   // Unpack quad indices into triangle indices
-   if (src) {
-      for (auto i = 0u; i < count / 4; ++i) {
-         auto index_0 = *src++;
-         auto index_1 = *src++;
-         auto index_2 = *src++;
-         auto index_3 = *src++;
-
-         *(dst++) = index_0;
-         *(dst++) = index_1;
-         *(dst++) = index_2;
-
-         if (!IsRects) {
-            *(dst++) = index_0;
-            *(dst++) = index_2;
-            *(dst++) = index_3;
-         } else {
-            // Rectangles use a different winding order apparently...
-            *(dst++) = index_2;
-            *(dst++) = index_1;
-            *(dst++) = index_3;
-         }
-      }
-   } else {
-      auto index_0 = 0u;
-      auto index_1 = 1u;
-      auto index_2 = 2u;
-      auto index_3 = 3u;
-
-      for (auto i = 0u; i < count / 4; ++i) {
-         auto index = i * 4;
-         *(dst++) = index_0 + index;
-         *(dst++) = index_1 + index;
-         *(dst++) = index_2 + index;
-
-         if (!IsRects) {
-            *(dst++) = index_0 + index;
-            *(dst++) = index_2 + index;
-            *(dst++) = index_3 + index;
-         } else {
-            // Rectangles use a different winding order apparently...
-            *(dst++) = index_2 + index;
-            *(dst++) = index_1 + index;
-            *(dst++) = index_3 + index;
-         }
+      } else {
+         gl::glDrawElementsInstancedBaseInstance(mode, count, indexType, indexOffset, numInstances, baseInstance);
       }
    }
-
-   drawPrimitives2(gl::GL_TRIANGLES, tris, unpacked.data(), baseVertex, numInstances, baseInstance);
 }
 
 void
 GLDriver::drawPrimitives(uint32_t count,
                          const void *indices,
-                         latte::VGT_INDEX indexFmt)
+                         uint32_t indicesAddress,
+                         latte::VGT_INDEX indexFmt,
+                         bool swapIndices)
 {
    auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
    auto sq_vtx_base_vtx_loc = getRegister<latte::SQ_VTX_BASE_VTX_LOC>(latte::Register::SQ_VTX_BASE_VTX_LOC);
@@ -199,6 +154,28 @@ GLDriver::drawPrimitives(uint32_t count,
    auto baseInstance = 0;
 
    auto mode = getPrimitiveMode(primType);
+   auto expand = IndexExpand::None;
+
+   if (primType == latte::VGT_DI_PT_QUADLIST) {
+      expand = IndexExpand::Quads;
+   } else if (primType == latte::VGT_DI_PT_RECTLIST) {
+      expand = IndexExpand::Rects;
+   }
+
+   auto indexType = gl::GL_NONE;
+   auto indexOffset = uint32_t { 0 };
+   auto drawCount = getConvertedIndexCount(expand, count);
+
+   if (!drawCount) {
+      return;
+   }
+
+   // Quads and rects are drawn as triangles, so they always need indices
+   if (indices || expand != IndexExpand::None) {
+      auto buffer = getIndexBuffer(indices, indicesAddress, count, indexFmt, swapIndices, expand, indexOffset);
+      gl::glBindBuffer(gl::GL_ELEMENT_ARRAY_BUFFER, buffer);
+      indexType = (indexFmt == latte::VGT_INDEX_16) ? gl::GL_UNSIGNED_SHORT : gl::GL_UNSIGNED_INT;
+   }
 
    if (vgt_strmout_en.STREAMOUT()) {
       if (!mFeedbackQuery) {
@@ -222,25 +199,13 @@ GLDriver::drawPrimitives(uint32_t count,
       gl::glBeginTransformFeedback(baseMode);
    }
 
-   if (primType == latte::VGT_DI_PT_QUADLIST) {
-      if (indexFmt == latte::VGT_INDEX_16) {
-         unpackQuadRectList<false>(count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_32) {
-         unpackQuadRectList<false>(count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
-      }
-   } else if (primType == latte::VGT_DI_PT_RECTLIST) {
-      if (indexFmt == latte::VGT_INDEX_16) {
-         unpackQuadRectList<true>(count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_32) {
-         unpackQuadRectList<true>(count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
-      }
-   } else {
-      if (indexFmt == latte::VGT_INDEX_16) {
-         drawPrimitives2(mode, count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_32) {
-         drawPrimitives2(mode, count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
-      }
-   }
+   drawPrimitives2(mode,
+                   drawCount,
+                   indexType,
+                   reinterpret_cast<const void *>(static_cast<uintptr_t>(indexOffset)),
+                   baseVertex,
+                   numInstances,
+                   baseInstance);
 
    if (vgt_strmout_en.STREAMOUT()) {
       gl::glEndTransformFeedback();
@@ -269,58 +234,40 @@ GLDriver::drawPrimitives(uint32_t count,
 
 void
 GLDriver::drawPrimitivesIndexed(const void *buffer,
+                                uint32_t indicesAddress,
                                 uint32_t count)
 {
    if (!checkReadyDraw()) {
       return;
    }
 
-   auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
-   auto sq_vtx_base_vtx_loc = getRegister<latte::SQ_VTX_BASE_VTX_LOC>(latte::Register::SQ_VTX_BASE_VTX_LOC);
    auto vgt_dma_index_type = getRegister<latte::VGT_DMA_INDEX_TYPE>(latte::Register::VGT_DMA_INDEX_TYPE);
-   auto vgt_dma_num_instances = getRegister<latte::VGT_DMA_NUM_INSTANCES>(latte::Register::VGT_DMA_NUM_INSTANCES);
-   auto vgt_strmout_en = getRegister<latte::VGT_STRMOUT_EN>(latte::Register::VGT_STRMOUT_EN);
+   auto swapIndices = false;
 
    // Swap and indexBytes are separate because you can have 32-bit swap,
    //   but 16-bit indices in some cases...  This is also why we pre-swap
    //   the data before intercepting QUAD and POLYGON draws.
    if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP_16_BIT) {
-      auto *src = reinterpret_cast<const uint16_t *>(buffer);
-      auto indices = std::vector<uint16_t>(count);
-
       if (vgt_dma_index_type.INDEX_TYPE() != latte::VGT_INDEX_16) {
          decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_16_BIT", vgt_dma_index_type.INDEX_TYPE()));
       }
 
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
-
-      drawPrimitives(count,
-                     indices.data(),
-                     vgt_dma_index_type.INDEX_TYPE());
+      swapIndices = true;
    } else if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP_32_BIT) {
-      auto *src = reinterpret_cast<const uint32_t *>(buffer);
-      auto indices = std::vector<uint32_t>(count);
-
       if (vgt_dma_index_type.INDEX_TYPE() != latte::VGT_INDEX_32) {
          decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_32_BIT", vgt_dma_index_type.INDEX_TYPE()));
       }
 
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
-
-      drawPrimitives(count,
-                     indices.data(),
-                     vgt_dma_index_type.INDEX_TYPE());
-   } else if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP_NONE) {
-      drawPrimitives(count,
-                     buffer,
-                     vgt_dma_index_type.INDEX_TYPE());
-   } else {
+      swapIndices = true;
+   } else if (vgt_dma_index_type.SWAP_MODE() != latte::VGT_DMA_SWAP_NONE) {
       decaf_abort(fmt::format("Unimplemented vgt_dma_index_type.SWAP_MODE {}", vgt_dma_index_type.SWAP_MODE()));
    }
+
+   drawPrimitives(count,
+                  buffer,
+                  indicesAddress,
+                  vgt_dma_index_type.INDEX_TYPE(),
+                  swapIndices);
 }
 
 void
@@ -332,19 +279,22 @@ GLDriver::drawIndexAuto(const pm4::DrawIndexAuto &data)
 
    drawPrimitives(data.count,
                   nullptr,
-                  latte::VGT_INDEX_32);
+                  0,
+                  latte::VGT_INDEX_32,
+                  false);
 }
 
 void
 GLDriver::drawIndex2(const pm4::DrawIndex2 &data)
 {
-   drawPrimitivesIndexed(data.addr, data.count);
+   // Only indices in guest memory are cached, by their address
+   drawPrimitivesIndexed(data.addr, data.addr.getAddress(), data.count);
 }
 
 void
 GLDriver::drawIndexImmd(const pm4::DrawIndexImmd &data)
 {
-   drawPrimitivesIndexed(data.indices.data(), data.count);
+   drawPrimitivesIndexed(data.indices.data(), 0, data.count);
 }
 
 void
@@ -357,6 +307,9 @@ GLDriver::decafClearColor(const pm4::DecafClearColor &data)
       data.alpha
    };
 
+   // Make sure state such as rasterizer discard is current before clearing
+   applyDirtyState();
+
    // Find our colorbuffer to clear
    auto cb_color_base = bit_cast<latte::CB_COLORN_BASE>(data.bufferAddr);
    auto buffer = getColorBuffer(cb_color_base, data.cb_color_size, data.cb_color_info, true);
@@ -375,6 +328,7 @@ GLDriver::decafClearColor(const pm4::DecafClearColor &data)
    // Clear color buffer
    glColorMaski(0, gl::GL_TRUE, gl::GL_TRUE, gl::GL_TRUE, gl::GL_TRUE);
    mColorBufferCache[0].mask = 0xF; // Recheck mask on next color buffer update
+   mDirtyState |= DirtyColorTargets;
    gl::glDisable(gl::GL_SCISSOR_TEST);
 
    gl::glClearNamedFramebufferfv(mColorClearFrameBuffer, gl::GL_COLOR, 0, colors);
@@ -392,6 +346,9 @@ GLDriver::decafClearDepthStencil(const pm4::DecafClearDepthStencil &data)
                    || dbFormat == latte::DEPTH_8_24_FLOAT
                    || dbFormat == latte::DEPTH_X24_8_32_FLOAT);
 
+   // Make sure the depth mask matches DB_DEPTH_CONTROL before clearing
+   applyDirtyState();
+
    // Find our depthbuffer to clear
    auto db_depth_base = bit_cast<latte::DB_DEPTH_BASE>(data.bufferAddr);
    auto buffer = getDepthBuffer(db_depth_base, data.db_depth_size, data.db_depth_info, true);
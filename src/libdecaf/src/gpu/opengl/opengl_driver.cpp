@@ -26,11 +26,10 @@ MaxUniformBlockSize = 0;
 void
 GLDriver::initGL()
 {
-   // Clear active state
+   // Clear active state, all GL state is applied on the first draw
    mRegisters.fill(0);
-   for (auto i = 0u; i < mRegisters.size(); ++i) {
-      applyRegister(static_cast<latte::Register>(i*4));
-   }
+   mDirtyState = DirtyAll;
+   mDirtyBlendTargets = 0xFF;
    mActiveShader = nullptr;
    mDrawBuffers.fill(gl::GL_NONE);
 
@@ -53,6 +52,8 @@ GLDriver::initGL()
       gl::glObjectLabel(gl::GL_FRAMEBUFFER, mDepthClearFrameBuffer, -1, "depth clear");
    }
 
+   initIndexBuffers();
+
    gl::GLint value;
    gl::glGetIntegerv(gl::GL_MAX_UNIFORM_BLOCK_SIZE, &value);
    MaxUniformBlockSize = value;
@@ -146,6 +147,10 @@ GLDriver::decafSwapBuffers(const pm4::DecafSwapBuffers &data)
    //  otherwise, we may overwrite a buffer used on this frame.
    gl::glFinish();
 
+   // Free any cached index buffers and display lists which are no longer used
+   pruneIndexBuffers();
+   pruneDisplayLists();
+
    // TODO: We should have a render chain of 2 buffers so that we don't render stuff
    //  until the game actually asked us to.
 
@@ -533,8 +538,13 @@ GLDriver::pfpSyncMe(const pm4::PfpSyncMe &data)
 void
 GLDriver::executeBuffer(pm4::Buffer *buffer)
 {
-   // Execute command buffer
-   runCommandBuffer(buffer->buffer, buffer->curSize);
+   // Execute command buffer, display lists from GX2DirectCallDisplayList
+   //  are usually called every frame so go through the display list cache.
+   if (buffer->displayList) {
+      runDisplayList(mem::untranslate(buffer->buffer), buffer->buffer, buffer->curSize);
+   } else {
+      runCommandBuffer(buffer->buffer, buffer->curSize);
+   }
 
    // Handle end-of-pipeline events
    handlePendingEOP();
@@ -2,6 +2,7 @@
 #include "common/platform.h"
 #include "common/log.h"
 #include "glsl2_translate.h"
+#include "gpu/gpu_indices.h"
 #include "gpu/pm4.h"
 #include "gpu/latte_constants.h"
 #include "gpu/latte_contextstate.h"
@@ -153,6 +154,57 @@ struct DataBuffer : public Resource
    uint64_t cpuMemHash[2] = { 0, 0 };
 };
 
+struct IndexBuffer
+{
+   //! Dedicated buffer holding converted indices, 0 until the data is stable
+   gl::GLuint object = 0;
+   uint32_t size = 0;
+   uint64_t cpuMemHash[2] = { 0, 0 };
+
+   //! Number of consecutive draws which found the same source data
+   uint32_t stableCount = 0;
+   uint64_t lastUsedFrame = 0;
+};
+
+// Address, count, and packed index type / swap mode / expansion
+using IndexBufferKey = std::tuple<uint32_t, uint32_t, uint32_t>;
+
+static const uint32_t IndexStreamSegments = 4;
+
+struct IndexStreamBuffer
+{
+   gl::GLuint object = 0;
+   uint8_t *mappedBuffer = nullptr;
+   uint32_t size = 0;
+   uint32_t offset = 0;
+   uint32_t segment = 0;
+   std::array<gl::GLsync, IndexStreamSegments> fences;
+};
+
+struct DisplayListPacket
+{
+   uint32_t header;
+
+   //! Register offset of SET_* packets, or the index of pre-read draw packets
+   uint32_t id;
+
+   //! Register values of SET_* packets, or the whole packet body otherwise
+   gsl::span<uint32_t> values;
+};
+
+struct DisplayList
+{
+   uint32_t size = 0;
+   uint64_t cpuMemHash[2] = { 0, 0 };
+   uint64_t lastUsedFrame = 0;
+
+   //! Byte swapped copy of the display list which packets point into
+   std::vector<uint32_t> words;
+   std::vector<DisplayListPacket> packets;
+   std::vector<pm4::DrawIndexAuto> drawIndexAuto;
+   std::vector<pm4::DrawIndex2> drawIndex2;
+};
+
 struct Sampler
 {
    gl::GLuint object = 0;
@@ -206,6 +258,8 @@ public:
    virtual void run() override;
    virtual void stop() override;
    virtual float getAverageFPS() override;
+   virtual bool saveRegisters(std::vector<uint32_t> &registers) override;
+   virtual bool restoreRegisters(const std::vector<uint32_t> &registers) override;
    virtual void getSwapBuffers(unsigned int *tv, unsigned int *drc) override;
    virtual void syncPoll(const SwapFunction &swapFunc) override;
 
@@ -340,13 +394,23 @@ private:
                       uint32_t size);
 
    void setRegister(latte::Register reg, uint32_t value);
-   void applyRegister(latte::Register reg);
+   void markRegisterDirty(latte::Register reg);
+   void applyDirtyState();
+   void applyBlendControl();
+   void applyBlendEnable();
+   void applyBlendColor();
+   void applyDepthStencil();
+   void applyRaster();
 
    bool parseFetchShader(FetchShader &shader, void *buffer, size_t size);
    bool compileVertexShader(VertexShader &vertex, FetchShader &fetch, uint8_t *buffer, size_t size, bool isScreenSpace);
    bool compilePixelShader(PixelShader &pixel, VertexShader &vertex, uint8_t *buffer, size_t size);
 
    void runCommandBuffer(uint32_t *buffer, uint32_t size);
+   void runDisplayList(uint32_t address, uint32_t *buffer, uint32_t size);
+   void decodeDisplayList(DisplayList &list, uint32_t *buffer, uint32_t size);
+   void replayDisplayList(const DisplayList &list);
+   void pruneDisplayLists();
 
    template<typename Type>
    Type getRegister(uint32_t id)
@@ -357,12 +421,31 @@ private:
 
    void drawPrimitives(uint32_t count,
                        const void *indices,
-                       latte::VGT_INDEX indexFmt);
+                       uint32_t indicesAddress,
+                       latte::VGT_INDEX indexFmt,
+                       bool swapIndices);
 
    void
    drawPrimitivesIndexed(const void *indices,
+                         uint32_t indicesAddress,
                          uint32_t count);
 
+   void initIndexBuffers();
+   void pruneIndexBuffers();
+
+   uint8_t *
+   allocateIndexStream(uint32_t size,
+                       uint32_t &offset);
+
+   gl::GLuint
+   getIndexBuffer(const void *indices,
+                  uint32_t indicesAddress,
+                  uint32_t count,
+                  latte::VGT_INDEX indexFmt,
+                  bool swapIndices,
+                  IndexExpand expand,
+                  uint32_t &offset);
+
 private:
    enum class RunState
    {
@@ -371,6 +454,22 @@ private:
       Stopped
    };
 
+   // Groups of state which are updated lazily at the next draw
+   enum DirtyState : uint32_t
+   {
+      DirtyBlendControl = 1 << 0,
+      DirtyBlendEnable = 1 << 1,
+      DirtyBlendColor = 1 << 2,
+      DirtyDepthStencil = 1 << 3,
+      DirtyRaster = 1 << 4,
+      DirtyViewport = 1 << 5,
+      DirtyScissor = 1 << 6,
+      DirtyColorTargets = 1 << 7,
+      DirtyDepthTarget = 1 << 8,
+      DirtyFramebuffer = 1 << 9,
+      DirtyAll = 0xFFFFFFFF,
+   };
+
    volatile RunState mRunState = RunState::None;
    std::thread mThread;
    unsigned mSwapInterval = 1;
@@ -378,8 +477,14 @@ private:
 
    std::array<uint32_t, 0x10000> mRegisters;
 
-   bool mViewportDirty = false;
-   bool mScissorDirty = false;
+   uint32_t mDirtyState = DirtyAll;
+   uint32_t mDirtyBlendTargets = 0xFF;
+   gl::GLenum mFramebufferStatus;
+
+   //! Incremented whenever a surface changes its active host surface, which
+   //!  means any cached render target bindings might be stale.
+   uint64_t mSurfaceGeneration = 0;
+   uint64_t mRenderTargetGeneration = 0;
 
    std::unordered_map<uint64_t, FetchShader> mFetchShaders;
    std::unordered_map<uint64_t, VertexShader> mVertexShaders;
@@ -387,6 +492,17 @@ private:
    std::map<ShaderKey, Shader> mShaders;
    std::unordered_map<uint64_t, SurfaceBuffer> mSurfaces;
    std::unordered_map<uint32_t, DataBuffer> mDataBuffers;
+   std::map<IndexBufferKey, IndexBuffer> mIndexBuffers;
+
+   IndexStreamBuffer mIndexStream;
+   gl::GLuint mIndexFallbackBuffer = 0;
+   std::vector<uint8_t> mIndexFallbackData;
+   uint64_t mFrameCount = 0;
+
+   std::unordered_map<uint32_t, DisplayList> mDisplayLists;
+   uint32_t mDisplayListDepth = 0;
+   uint64_t mDisplayListHits = 0;
+   uint64_t mDisplayListMisses = 0;
 
    std::array<Sampler, latte::MaxSamplers> mVertexSamplers;
    std::array<Sampler, latte::MaxSamplers> mPixelSamplers;
@@ -0,0 +1,211 @@
+#include "common/align.h"
+#include "common/decaf_assert.h"
+#include "common/log.h"
+#include "common/murmur3.h"
+#include "decaf_config.h"
+#include "opengl_driver.h"
+#include <glbinding/gl/gl.h>
+
+namespace gpu
+{
+
+namespace opengl
+{
+
+// Size of the persistently mapped buffer used to stream converted indices
+static const uint32_t IndexStreamSize = 8 * 1024 * 1024;
+
+// How many draws must see the same index data before it is given its own
+//  buffer, this stops us copying around data which changes every frame.
+static const uint32_t IndexBufferPromoteCount = 2;
+
+// Cached index buffers which go unused for this many frames are deleted
+static const uint64_t IndexBufferMaxUnusedFrames = 60;
+
+void
+GLDriver::initIndexBuffers()
+{
+   gl::glCreateBuffers(1, &mIndexStream.object);
+   gl::glCreateBuffers(1, &mIndexFallbackBuffer);
+
+   if (decaf::config::gpu::debug) {
+      gl::glObjectLabel(gl::GL_BUFFER, mIndexStream.object, -1, "index stream");
+      gl::glObjectLabel(gl::GL_BUFFER, mIndexFallbackBuffer, -1, "index fallback");
+   }
+
+   gl::BufferStorageMask usage = static_cast<gl::BufferStorageMask>(0);
+   usage |= gl::GL_MAP_WRITE_BIT | gl::GL_MAP_PERSISTENT_BIT | gl::GL_MAP_COHERENT_BIT;
+   gl::glNamedBufferStorage(mIndexStream.object, IndexStreamSize, nullptr, usage);
+
+   gl::BufferAccessMask access = gl::GL_MAP_PERSISTENT_BIT;
+   access |= gl::GL_MAP_WRITE_BIT | gl::GL_MAP_COHERENT_BIT;
+   mIndexStream.mappedBuffer = static_cast<uint8_t *>(gl::glMapNamedBufferRange(mIndexStream.object, 0, IndexStreamSize, access));
+   mIndexStream.size = IndexStreamSize;
+   mIndexStream.offset = 0;
+   mIndexStream.segment = 0;
+   mIndexStream.fences.fill(nullptr);
+
+   mIndexBuffers.clear();
+}
+
+void
+GLDriver::pruneIndexBuffers()
+{
+   ++mFrameCount;
+
+   for (auto itr = mIndexBuffers.begin(); itr != mIndexBuffers.end(); ) {
+      auto &buffer = itr->second;
+
+      if (mFrameCount - buffer.lastUsedFrame > IndexBufferMaxUnusedFrames) {
+         if (buffer.object) {
+            gl::glDeleteBuffers(1, &buffer.object);
+         }
+
+         itr = mIndexBuffers.erase(itr);
+      } else {
+         ++itr;
+      }
+   }
+}
+
+uint8_t *
+GLDriver::allocateIndexStream(uint32_t size,
+                              uint32_t &offset)
+{
+   auto segmentSize = mIndexStream.size / IndexStreamSegments;
+
+   if (!mIndexStream.mappedBuffer || size > segmentSize) {
+      return nullptr;
+   }
+
+   auto start = align_up(mIndexStream.offset, 4u);
+
+   if (start + size > mIndexStream.size) {
+      start = 0;
+   }
+
+   // Before writing into a new segment, fence off the segment we are leaving
+   //  and wait for the GPU to finish with any previous use of the new one.
+   auto lastSegment = (start + size - 1) / segmentSize;
+
+   while (mIndexStream.segment != lastSegment || start < mIndexStream.offset) {
+      auto &leaving = mIndexStream.fences[mIndexStream.segment];
+
+      if (leaving) {
+         gl::glDeleteSync(leaving);
+      }
+
+      leaving = gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, gl::UnusedMask::GL_NONE_BIT);
+      mIndexStream.segment = (mIndexStream.segment + 1) % IndexStreamSegments;
+
+      auto &entering = mIndexStream.fences[mIndexStream.segment];
+
+      if (entering) {
+         gl::glClientWaitSync(entering, gl::GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+         gl::glDeleteSync(entering);
+         entering = nullptr;
+      }
+
+      if (mIndexStream.segment == 0) {
+         // We have wrapped around to the start of the buffer
+         mIndexStream.offset = 0;
+      }
+   }
+
+   mIndexStream.offset = start + size;
+   offset = start;
+   return mIndexStream.mappedBuffer + start;
+}
+
+gl::GLuint
+GLDriver::getIndexBuffer(const void *indices,
+                         uint32_t indicesAddress,
+                         uint32_t count,
+                         latte::VGT_INDEX indexFmt,
+                         bool swapIndices,
+                         IndexExpand expand,
+                         uint32_t &offset)
+{
+   auto indexBytes = (indexFmt == latte::VGT_INDEX_16) ? 2u : 4u;
+   auto srcSize = count * indexBytes;
+   auto dstSize = getConvertedIndexCount(expand, count) * indexBytes;
+   auto isGenerated = !indices;
+   auto isCacheable = isGenerated || indicesAddress;
+   IndexBuffer *cached = nullptr;
+   uint64_t newHash[2] = { 0, 0 };
+
+   if (isCacheable) {
+      auto format = static_cast<uint32_t>(indexFmt)
+                  | (static_cast<uint32_t>(swapIndices) << 8)
+                  | (static_cast<uint32_t>(expand) << 16);
+      cached = &mIndexBuffers[IndexBufferKey { indicesAddress, count, format }];
+      cached->lastUsedFrame = mFrameCount;
+
+      // Generated indices only depend on the key, so never need checking
+      if (!isGenerated) {
+         MurmurHash3_x64_128(indices, srcSize, 0, newHash);
+      }
+
+      if (newHash[0] == cached->cpuMemHash[0] && newHash[1] == cached->cpuMemHash[1]) {
+         cached->stableCount++;
+      } else {
+         cached->cpuMemHash[0] = newHash[0];
+         cached->cpuMemHash[1] = newHash[1];
+         cached->stableCount = 0;
+
+         if (cached->object) {
+            gl::glDeleteBuffers(1, &cached->object);
+            cached->object = 0;
+         }
+      }
+
+      if (cached->object) {
+         offset = 0;
+         return cached->object;
+      }
+   }
+
+   // Convert the indices into the stream buffer, or into the fallback buffer
+   //  if this draw is too big to fit.
+   auto buffer = mIndexStream.object;
+   auto dst = allocateIndexStream(dstSize, offset);
+
+   if (!dst) {
+      mIndexFallbackData.resize(dstSize);
+      dst = mIndexFallbackData.data();
+      buffer = mIndexFallbackBuffer;
+      offset = 0;
+   }
+
+   if (isGenerated) {
+      generateQuadIndices(reinterpret_cast<uint32_t *>(dst), count, expand);
+   } else if (indexFmt == latte::VGT_INDEX_16) {
+      convertIndices(reinterpret_cast<uint16_t *>(dst), reinterpret_cast<const uint16_t *>(indices), count, swapIndices, expand);
+   } else {
+      convertIndices(reinterpret_cast<uint32_t *>(dst), reinterpret_cast<const uint32_t *>(indices), count, swapIndices, expand);
+   }
+
+   if (buffer == mIndexFallbackBuffer) {
+      gl::glNamedBufferData(mIndexFallbackBuffer, dstSize, dst, gl::GL_STREAM_DRAW);
+   }
+
+   // Give index data which has stopped changing a buffer of its own
+   if (cached && (isGenerated || cached->stableCount >= IndexBufferPromoteCount)) {
+      gl::glCreateBuffers(1, &cached->object);
+
+      if (decaf::config::gpu::debug) {
+         auto label = fmt::format("index buffer @ 0x{:08X}", indicesAddress);
+         gl::glObjectLabel(gl::GL_BUFFER, cached->object, -1, label.c_str());
+      }
+
+      gl::glNamedBufferStorage(cached->object, dstSize, nullptr, static_cast<gl::BufferStorageMask>(0));
+      gl::glCopyNamedBufferSubData(buffer, cached->object, offset, 0, dstSize);
+      cached->size = dstSize;
+   }
+
+   return buffer;
+}
+
+} // namespace opengl
+
+} // namespace gpu
@@ -1,3 +1,4 @@
+#include "common/byte_swap_array.h"
 #include "opengl_driver.h"
 #include "gpu/pm4_reader.h"
 
@@ -11,7 +12,7 @@ void
 GLDriver::indirectBufferCall(const pm4::IndirectBufferCall &data)
 {
    auto buffer = reinterpret_cast<uint32_t*>(data.addr.get());
-   runCommandBuffer(buffer, data.size);
+   runDisplayList(data.addr.getAddress(), buffer, data.size);
 }
 
 void
@@ -19,10 +20,7 @@ GLDriver::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
 {
    std::vector<uint32_t> swapped;
    swapped.resize(buffer_size);
-
-   for (auto i = 0u; i < buffer_size; ++i) {
-      swapped[i] = byte_swap(buffer[i]);
-   }
+   byte_swap_copy(swapped.data(), buffer, buffer_size);
 
    buffer = swapped.data();
 
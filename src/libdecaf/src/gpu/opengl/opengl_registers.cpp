@@ -1,5 +1,6 @@
 #include "common/decaf_assert.h"
 #include "opengl_driver.h"
+#include <algorithm>
 #include <glbinding/gl/gl.h>
 
 namespace gpu
@@ -39,17 +40,39 @@ GLDriver::setRegister(latte::Register reg,
       }
    }
 
-   // Apply changes directly to OpenGL state if appropriate
+   // OpenGL state is only updated at the next draw, as games often write the
+   //  same state several times between draws
    if (isChanged) {
-      applyRegister(reg);
+      markRegisterDirty(reg);
    }
 }
 
-void
-GLDriver::applyRegister(latte::Register reg)
+bool
+GLDriver::saveRegisters(std::vector<uint32_t> &registers)
 {
-   auto value = mRegisters[reg / 4];
+   registers.assign(mRegisters.begin(), mRegisters.end());
+   return true;
+}
+
+bool
+GLDriver::restoreRegisters(const std::vector<uint32_t> &registers)
+{
+   if (registers.size() != mRegisters.size()) {
+      return false;
+   }
 
+   std::copy(registers.begin(), registers.end(), mRegisters.begin());
+
+   // The caches of applied state are left alone, so everything is compared
+   //  against the restored registers at the next draw.
+   mDirtyState = DirtyAll;
+   mDirtyBlendTargets = 0xFF;
+   return true;
+}
+
+void
+GLDriver::markRegisterDirty(latte::Register reg)
+{
    switch (reg) {
    case latte::Register::CB_BLEND0_CONTROL:
    case latte::Register::CB_BLEND1_CONTROL:
@@ -59,126 +82,36 @@ GLDriver::applyRegister(latte::Register reg)
    case latte::Register::CB_BLEND5_CONTROL:
    case latte::Register::CB_BLEND6_CONTROL:
    case latte::Register::CB_BLEND7_CONTROL:
-   {
-      auto target = (reg - latte::Register::CB_BLEND0_CONTROL) / 4;
-      auto cb_blend_control = latte::CB_BLENDN_CONTROL::get(value);
-      auto dstRGB = getBlendFunc(cb_blend_control.COLOR_DESTBLEND());
-      auto srcRGB = getBlendFunc(cb_blend_control.COLOR_SRCBLEND());
-      auto modeRGB = getBlendEquation(cb_blend_control.COLOR_COMB_FCN());
-
-      if (!cb_blend_control.SEPARATE_ALPHA_BLEND()) {
-         gl::glBlendFunci(target, srcRGB, dstRGB);
-         gl::glBlendEquationi(target, modeRGB);
-      } else {
-         auto dstAlpha = getBlendFunc(cb_blend_control.ALPHA_DESTBLEND());
-         auto srcAlpha = getBlendFunc(cb_blend_control.ALPHA_SRCBLEND());
-         auto modeAlpha = getBlendEquation(cb_blend_control.ALPHA_COMB_FCN());
-         gl::glBlendFuncSeparatei(target, srcRGB, dstRGB, srcAlpha, dstAlpha);
-         gl::glBlendEquationSeparatei(target, modeRGB, modeAlpha);
-      }
-   } break;
+      mDirtyBlendTargets |= 1 << ((reg - latte::Register::CB_BLEND0_CONTROL) / 4);
+      mDirtyState |= DirtyBlendControl;
+      break;
 
    case latte::Register::CB_COLOR_CONTROL:
-   {
-      auto cb_color_control = latte::CB_COLOR_CONTROL::get(value);
-
-      for (auto i = 0u; i < 8; ++i) {
-         if (cb_color_control.TARGET_BLEND_ENABLE() & (1 << i)) {
-            gl::glEnablei(gl::GL_BLEND, i);
-         } else {
-            gl::glDisablei(gl::GL_BLEND, i);
-         }
-      }
-   } break;
-
-   case latte::Register::DB_STENCILREFMASK_BF:
-   {
-      auto db_depth_control = getRegister<latte::DB_DEPTH_CONTROL>(latte::Register::DB_DEPTH_CONTROL);
-      auto db_stencilrefmask_bf = latte::DB_STENCILREFMASK_BF::get(value);
-      auto backStencilFunc = getRefFunc(db_depth_control.STENCILFUNC_BF());
-
-      if (db_depth_control.BACKFACE_ENABLE()) {
-         gl::glStencilFuncSeparate(gl::GL_BACK, backStencilFunc, db_stencilrefmask_bf.STENCILREF_BF(), db_stencilrefmask_bf.STENCILMASK_BF());
-      }
-   } break;
-
-   case latte::Register::DB_STENCILREFMASK:
-   {
-      auto db_depth_control = getRegister<latte::DB_DEPTH_CONTROL>(latte::Register::DB_DEPTH_CONTROL);
-      auto db_stencilrefmask = latte::DB_STENCILREFMASK::get(value);
-      auto frontStencilFunc = getRefFunc(db_depth_control.STENCILFUNC());
-
-      if (!db_depth_control.BACKFACE_ENABLE()) {
-         gl::glStencilFuncSeparate(gl::GL_FRONT_AND_BACK, frontStencilFunc, db_stencilrefmask.STENCILREF(), db_stencilrefmask.STENCILMASK());
-      } else {
-         gl::glStencilFuncSeparate(gl::GL_FRONT, frontStencilFunc, db_stencilrefmask.STENCILREF(), db_stencilrefmask.STENCILMASK());
-      }
-   } break;
-
-   case latte::Register::DB_DEPTH_CONTROL:
-   {
-      auto db_depth_control = latte::DB_DEPTH_CONTROL::get(value);
-      auto db_stencilrefmask = getRegister<latte::DB_STENCILREFMASK>(latte::Register::DB_STENCILREFMASK);
-      auto db_stencilrefmask_bf = getRegister<latte::DB_STENCILREFMASK_BF>(latte::Register::DB_STENCILREFMASK_BF);
-
-      if (db_depth_control.Z_ENABLE()) {
-         gl::glEnable(gl::GL_DEPTH_TEST);
-      } else {
-         gl::glDisable(gl::GL_DEPTH_TEST);
-      }
-
-      if (db_depth_control.Z_WRITE_ENABLE()) {
-         gl::glDepthMask(gl::GL_TRUE);
-      } else {
-         gl::glDepthMask(gl::GL_FALSE);
-      }
-
-      auto zfunc = getRefFunc(db_depth_control.ZFUNC());
-      gl::glDepthFunc(zfunc);
-
-      if (db_depth_control.STENCIL_ENABLE()) {
-         gl::glEnable(gl::GL_STENCIL_TEST);
-      } else {
-         gl::glDisable(gl::GL_STENCIL_TEST);
-      }
-
-      auto frontStencilFunc = getRefFunc(db_depth_control.STENCILFUNC());
-      auto frontStencilZPass = getStencilFunc(db_depth_control.STENCILZPASS());
-      auto frontStencilZFail = getStencilFunc(db_depth_control.STENCILZFAIL());
-      auto frontStencilFail = getStencilFunc(db_depth_control.STENCILFAIL());
-
-      if (!db_depth_control.BACKFACE_ENABLE()) {
-         gl::glStencilFuncSeparate(gl::GL_FRONT_AND_BACK, frontStencilFunc, db_stencilrefmask.STENCILREF(), db_stencilrefmask.STENCILMASK());
-         gl::glStencilOpSeparate(gl::GL_FRONT_AND_BACK, frontStencilFail, frontStencilZFail, frontStencilZPass);
-      } else {
-         auto backStencilFunc = getRefFunc(db_depth_control.STENCILFUNC_BF());
-         auto backStencilZPass = getStencilFunc(db_depth_control.STENCILZPASS_BF());
-         auto backStencilZFail = getStencilFunc(db_depth_control.STENCILZFAIL_BF());
-         auto backStencilFail = getStencilFunc(db_depth_control.STENCILFAIL_BF());
-
-         gl::glStencilFuncSeparate(gl::GL_FRONT, frontStencilFunc, db_stencilrefmask.STENCILREF(), db_stencilrefmask.STENCILMASK());
-         gl::glStencilOpSeparate(gl::GL_FRONT, frontStencilFail, frontStencilZFail, frontStencilZPass);
-
-         gl::glStencilFuncSeparate(gl::GL_BACK, backStencilFunc, db_stencilrefmask_bf.STENCILREF_BF(), db_stencilrefmask_bf.STENCILMASK_BF());
-         gl::glStencilOpSeparate(gl::GL_BACK, backStencilFail, backStencilZFail, backStencilZPass);
-      }
-   } break;
+      mDirtyState |= DirtyBlendEnable | DirtyColorTargets;
+      break;
 
    case latte::Register::CB_BLEND_RED:
    case latte::Register::CB_BLEND_GREEN:
    case latte::Register::CB_BLEND_BLUE:
    case latte::Register::CB_BLEND_ALPHA:
-   {
-      auto cb_blend_red = getRegister<latte::CB_BLEND_RED>(latte::Register::CB_BLEND_RED);
-      auto cb_blend_green = getRegister<latte::CB_BLEND_GREEN>(latte::Register::CB_BLEND_GREEN);
-      auto cb_blend_blue = getRegister<latte::CB_BLEND_BLUE>(latte::Register::CB_BLEND_BLUE);
-      auto cb_blend_alpha = getRegister<latte::CB_BLEND_ALPHA>(latte::Register::CB_BLEND_ALPHA);
-
-      gl::glBlendColor(cb_blend_red.BLEND_RED / 255.0f,
-                       cb_blend_green.BLEND_GREEN / 255.0f,
-                       cb_blend_blue.BLEND_BLUE / 255.0f,
-                       cb_blend_alpha.BLEND_ALPHA / 255.0f);
-   } break;
+      mDirtyState |= DirtyBlendColor;
+      break;
+
+   case latte::Register::DB_DEPTH_CONTROL:
+      mDirtyState |= DirtyDepthStencil | DirtyDepthTarget;
+      break;
+
+   case latte::Register::DB_STENCILREFMASK:
+   case latte::Register::DB_STENCILREFMASK_BF:
+      mDirtyState |= DirtyDepthStencil;
+      break;
+
+   case latte::Register::PA_SU_SC_MODE_CNTL:
+   case latte::Register::PA_CL_CLIP_CNTL:
+   case latte::Register::VGT_MULTI_PRIM_IB_RESET_EN:
+   case latte::Register::VGT_MULTI_PRIM_IB_RESET_INDX:
+      mDirtyState |= DirtyRaster;
+      break;
 
    case latte::Register::PA_CL_VPORT_XSCALE_0:
    case latte::Register::PA_CL_VPORT_XOFFSET_0:
@@ -188,81 +121,222 @@ GLDriver::applyRegister(latte::Register reg)
    case latte::Register::PA_CL_VPORT_ZOFFSET_0:
    case latte::Register::PA_SC_VPORT_ZMIN_0:
    case latte::Register::PA_SC_VPORT_ZMAX_0:
-      mViewportDirty = true;
+      mDirtyState |= DirtyViewport;
       break;
 
    case latte::Register::PA_SC_GENERIC_SCISSOR_TL:
    case latte::Register::PA_SC_GENERIC_SCISSOR_BR:
-      mScissorDirty = true;
+      mDirtyState |= DirtyScissor;
       break;
 
-   case latte::Register::PA_SU_SC_MODE_CNTL:
-   {
-      auto pa_su_sc_mode_cntl = latte::PA_SU_SC_MODE_CNTL::get(value);
+   case latte::Register::CB_TARGET_MASK:
+   case latte::Register::CB_SHADER_MASK:
+   case latte::Register::CB_SHADER_CONTROL:
+      mDirtyState |= DirtyColorTargets;
+      break;
 
-      if (pa_su_sc_mode_cntl.FACE() == latte::FACE_CW) {
-         gl::glFrontFace(gl::GL_CW);
-      } else {
-         gl::glFrontFace(gl::GL_CCW);
-      }
+   case latte::Register::DB_DEPTH_BASE:
+   case latte::Register::DB_DEPTH_SIZE:
+   case latte::Register::DB_DEPTH_INFO:
+      mDirtyState |= DirtyDepthTarget;
+      break;
 
-      if (pa_su_sc_mode_cntl.CULL_FRONT() && pa_su_sc_mode_cntl.CULL_BACK()) {
-         gl::glEnable(gl::GL_CULL_FACE);
-         gl::glCullFace(gl::GL_FRONT_AND_BACK);
-      } else if (pa_su_sc_mode_cntl.CULL_FRONT()) {
-         gl::glEnable(gl::GL_CULL_FACE);
-         gl::glCullFace(gl::GL_FRONT);
-      } else if (pa_su_sc_mode_cntl.CULL_BACK()) {
-         gl::glEnable(gl::GL_CULL_FACE);
-         gl::glCullFace(gl::GL_BACK);
-      } else {
-         gl::glDisable(gl::GL_CULL_FACE);
+   default:
+      if ((reg >= latte::Register::CB_COLOR0_BASE && reg <= latte::Register::CB_COLOR7_BASE)
+       || (reg >= latte::Register::CB_COLOR0_SIZE && reg <= latte::Register::CB_COLOR7_SIZE)
+       || (reg >= latte::Register::CB_COLOR0_INFO && reg <= latte::Register::CB_COLOR7_INFO)) {
+         mDirtyState |= DirtyColorTargets;
       }
-   } break;
+      break;
+   }
+}
 
-   case latte::Register::PA_CL_CLIP_CNTL:
-   {
-      auto pa_cl_clip_cntl = latte::PA_CL_CLIP_CNTL::get(value);
+void
+GLDriver::applyDirtyState()
+{
+   if (mDirtyState & DirtyBlendControl) {
+      applyBlendControl();
+   }
 
-      if (pa_cl_clip_cntl.RASTERISER_DISABLE()) {
-         gl::glEnable(gl::GL_RASTERIZER_DISCARD);
-      } else {
-         gl::glDisable(gl::GL_RASTERIZER_DISCARD);
-      }
+   if (mDirtyState & DirtyBlendEnable) {
+      applyBlendEnable();
+   }
 
-      decaf_assert(pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE() == pa_cl_clip_cntl.ZCLIP_FAR_DISABLE(),
-                   fmt::format("Inconsistent near/far depth clamp setting"));
-      if (pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE()) {
-         gl::glEnable(gl::GL_DEPTH_CLAMP);
-      } else {
-         gl::glDisable(gl::GL_DEPTH_CLAMP);
+   if (mDirtyState & DirtyBlendColor) {
+      applyBlendColor();
+   }
+
+   if (mDirtyState & DirtyDepthStencil) {
+      applyDepthStencil();
+   }
+
+   if (mDirtyState & DirtyRaster) {
+      applyRaster();
+   }
+
+   mDirtyState &= ~(DirtyBlendControl | DirtyBlendEnable | DirtyBlendColor | DirtyDepthStencil | DirtyRaster);
+}
+
+void
+GLDriver::applyBlendControl()
+{
+   for (auto target = 0u; target < latte::MaxRenderTargets; ++target) {
+      if (!(mDirtyBlendTargets & (1 << target))) {
+         continue;
       }
 
-      if (pa_cl_clip_cntl.DX_CLIP_SPACE_DEF()) {
-         gl::glClipControl(gl::GL_UPPER_LEFT, gl::GL_ZERO_TO_ONE);
+      auto cb_blend_control = getRegister<latte::CB_BLENDN_CONTROL>(latte::Register::CB_BLEND0_CONTROL + target * 4);
+      auto dstRGB = getBlendFunc(cb_blend_control.COLOR_DESTBLEND());
+      auto srcRGB = getBlendFunc(cb_blend_control.COLOR_SRCBLEND());
+      auto modeRGB = getBlendEquation(cb_blend_control.COLOR_COMB_FCN());
+
+      if (!cb_blend_control.SEPARATE_ALPHA_BLEND()) {
+         gl::glBlendFunci(target, srcRGB, dstRGB);
+         gl::glBlendEquationi(target, modeRGB);
       } else {
-         gl::glClipControl(gl::GL_UPPER_LEFT, gl::GL_NEGATIVE_ONE_TO_ONE);
+         auto dstAlpha = getBlendFunc(cb_blend_control.ALPHA_DESTBLEND());
+         auto srcAlpha = getBlendFunc(cb_blend_control.ALPHA_SRCBLEND());
+         auto modeAlpha = getBlendEquation(cb_blend_control.ALPHA_COMB_FCN());
+         gl::glBlendFuncSeparatei(target, srcRGB, dstRGB, srcAlpha, dstAlpha);
+         gl::glBlendEquationSeparatei(target, modeRGB, modeAlpha);
       }
-   } break;
+   }
 
-   case latte::Register::VGT_MULTI_PRIM_IB_RESET_EN:
-   {
-      auto vgt_multi_prim_ib_reset_en = *reinterpret_cast<latte::VGT_MULTI_PRIM_IB_RESET_EN*>(&value);
+   mDirtyBlendTargets = 0;
+}
 
-      if (vgt_multi_prim_ib_reset_en.RESET_EN()) {
-         gl::glEnable(gl::GL_PRIMITIVE_RESTART);
+void
+GLDriver::applyBlendEnable()
+{
+   auto cb_color_control = getRegister<latte::CB_COLOR_CONTROL>(latte::Register::CB_COLOR_CONTROL);
+
+   for (auto i = 0u; i < 8; ++i) {
+      if (cb_color_control.TARGET_BLEND_ENABLE() & (1 << i)) {
+         gl::glEnablei(gl::GL_BLEND, i);
       } else {
-         gl::glDisable(gl::GL_PRIMITIVE_RESTART);
+         gl::glDisablei(gl::GL_BLEND, i);
       }
-   } break;
+   }
+}
 
-   case latte::Register::VGT_MULTI_PRIM_IB_RESET_INDX:
-   {
-      auto vgt_multi_prim_ib_reset_indx = *reinterpret_cast<latte::VGT_MULTI_PRIM_IB_RESET_INDX*>(&value);
-      gl::glPrimitiveRestartIndex(vgt_multi_prim_ib_reset_indx.RESET_INDX);
-   } break;
+void
+GLDriver::applyBlendColor()
+{
+   auto cb_blend_red = getRegister<latte::CB_BLEND_RED>(latte::Register::CB_BLEND_RED);
+   auto cb_blend_green = getRegister<latte::CB_BLEND_GREEN>(latte::Register::CB_BLEND_GREEN);
+   auto cb_blend_blue = getRegister<latte::CB_BLEND_BLUE>(latte::Register::CB_BLEND_BLUE);
+   auto cb_blend_alpha = getRegister<latte::CB_BLEND_ALPHA>(latte::Register::CB_BLEND_ALPHA);
+
+   gl::glBlendColor(cb_blend_red.BLEND_RED / 255.0f,
+                    cb_blend_green.BLEND_GREEN / 255.0f,
+                    cb_blend_blue.BLEND_BLUE / 255.0f,
+                    cb_blend_alpha.BLEND_ALPHA / 255.0f);
+}
 
+void
+GLDriver::applyDepthStencil()
+{
+   auto db_depth_control = getRegister<latte::DB_DEPTH_CONTROL>(latte::Register::DB_DEPTH_CONTROL);
+   auto db_stencilrefmask = getRegister<latte::DB_STENCILREFMASK>(latte::Register::DB_STENCILREFMASK);
+   auto db_stencilrefmask_bf = getRegister<latte::DB_STENCILREFMASK_BF>(latte::Register::DB_STENCILREFMASK_BF);
+
+   if (db_depth_control.Z_ENABLE()) {
+      gl::glEnable(gl::GL_DEPTH_TEST);
+   } else {
+      gl::glDisable(gl::GL_DEPTH_TEST);
    }
+
+   if (db_depth_control.Z_WRITE_ENABLE()) {
+      gl::glDepthMask(gl::GL_TRUE);
+   } else {
+      gl::glDepthMask(gl::GL_FALSE);
+   }
+
+   auto zfunc = getRefFunc(db_depth_control.ZFUNC());
+   gl::glDepthFunc(zfunc);
+
+   if (db_depth_control.STENCIL_ENABLE()) {
+      gl::glEnable(gl::GL_STENCIL_TEST);
+   } else {
+      gl::glDisable(gl::GL_STENCIL_TEST);
+   }
+
+   auto frontStencilFunc = getRefFunc(db_depth_control.STENCILFUNC());
+   auto frontStencilZPass = getStencilFunc(db_depth_control.STENCILZPASS());
+   auto frontStencilZFail = getStencilFunc(db_depth_control.STENCILZFAIL());
+   auto frontStencilFail = getStencilFunc(db_depth_control.STENCILFAIL());
+
+   if (!db_depth_control.BACKFACE_ENABLE()) {
+      gl::glStencilFuncSeparate(gl::GL_FRONT_AND_BACK, frontStencilFunc, db_stencilrefmask.STENCILREF(), db_stencilrefmask.STENCILMASK());
+      gl::glStencilOpSeparate(gl::GL_FRONT_AND_BACK, frontStencilFail, frontStencilZFail, frontStencilZPass);
+   } else {
+      auto backStencilFunc = getRefFunc(db_depth_control.STENCILFUNC_BF());
+      auto backStencilZPass = getStencilFunc(db_depth_control.STENCILZPASS_BF());
+      auto backStencilZFail = getStencilFunc(db_depth_control.STENCILZFAIL_BF());
+      auto backStencilFail = getStencilFunc(db_depth_control.STENCILFAIL_BF());
+
+      gl::glStencilFuncSeparate(gl::GL_FRONT, frontStencilFunc, db_stencilrefmask.STENCILREF(), db_stencilrefmask.STENCILMASK());
+      gl::glStencilOpSeparate(gl::GL_FRONT, frontStencilFail, frontStencilZFail, frontStencilZPass);
+
+      gl::glStencilFuncSeparate(gl::GL_BACK, backStencilFunc, db_stencilrefmask_bf.STENCILREF_BF(), db_stencilrefmask_bf.STENCILMASK_BF());
+      gl::glStencilOpSeparate(gl::GL_BACK, backStencilFail, backStencilZFail, backStencilZPass);
+   }
+}
+
+void
+GLDriver::applyRaster()
+{
+   auto pa_su_sc_mode_cntl = getRegister<latte::PA_SU_SC_MODE_CNTL>(latte::Register::PA_SU_SC_MODE_CNTL);
+   auto pa_cl_clip_cntl = getRegister<latte::PA_CL_CLIP_CNTL>(latte::Register::PA_CL_CLIP_CNTL);
+   auto vgt_multi_prim_ib_reset_en = getRegister<latte::VGT_MULTI_PRIM_IB_RESET_EN>(latte::Register::VGT_MULTI_PRIM_IB_RESET_EN);
+   auto vgt_multi_prim_ib_reset_indx = getRegister<latte::VGT_MULTI_PRIM_IB_RESET_INDX>(latte::Register::VGT_MULTI_PRIM_IB_RESET_INDX);
+
+   if (pa_su_sc_mode_cntl.FACE() == latte::FACE_CW) {
+      gl::glFrontFace(gl::GL_CW);
+   } else {
+      gl::glFrontFace(gl::GL_CCW);
+   }
+
+   if (pa_su_sc_mode_cntl.CULL_FRONT() && pa_su_sc_mode_cntl.CULL_BACK()) {
+      gl::glEnable(gl::GL_CULL_FACE);
+      gl::glCullFace(gl::GL_FRONT_AND_BACK);
+   } else if (pa_su_sc_mode_cntl.CULL_FRONT()) {
+      gl::glEnable(gl::GL_CULL_FACE);
+      gl::glCullFace(gl::GL_FRONT);
+   } else if (pa_su_sc_mode_cntl.CULL_BACK()) {
+      gl::glEnable(gl::GL_CULL_FACE);
+      gl::glCullFace(gl::GL_BACK);
+   } else {
+      gl::glDisable(gl::GL_CULL_FACE);
+   }
+
+   if (pa_cl_clip_cntl.RASTERISER_DISABLE()) {
+      gl::glEnable(gl::GL_RASTERIZER_DISCARD);
+   } else {
+      gl::glDisable(gl::GL_RASTERIZER_DISCARD);
+   }
+
+   decaf_assert(pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE() == pa_cl_clip_cntl.ZCLIP_FAR_DISABLE(),
+                fmt::format("Inconsistent near/far depth clamp setting"));
+   if (pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE()) {
+      gl::glEnable(gl::GL_DEPTH_CLAMP);
+   } else {
+      gl::glDisable(gl::GL_DEPTH_CLAMP);
+   }
+
+   if (pa_cl_clip_cntl.DX_CLIP_SPACE_DEF()) {
+      gl::glClipControl(gl::GL_UPPER_LEFT, gl::GL_ZERO_TO_ONE);
+   } else {
+      gl::glClipControl(gl::GL_UPPER_LEFT, gl::GL_NEGATIVE_ONE_TO_ONE);
+   }
+
+   if (vgt_multi_prim_ib_reset_en.RESET_EN()) {
+      gl::glEnable(gl::GL_PRIMITIVE_RESTART);
+   } else {
+      gl::glDisable(gl::GL_PRIMITIVE_RESTART);
+   }
+
+   gl::glPrimitiveRestartIndex(vgt_multi_prim_ib_reset_indx.RESET_INDX);
 }
 
 void
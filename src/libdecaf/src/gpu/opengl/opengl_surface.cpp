@@ -767,6 +767,7 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
 
       auto newSurf = createHostSurface(baseAddress, pitch, width, height, depth, dim, format, numFormat, formatComp, degamma, isDepthBuffer);
       buffer.active = newSurf;
+      mSurfaceGeneration++;
       buffer.master = newSurf;
 
       if (!forWrite) {
@@ -831,6 +832,7 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
          copyHostSurface(buffer.master, buffer.active, dim);
       }
       buffer.active = buffer.master;
+      mSurfaceGeneration++;
    }
 
    // If we allocated a new master, we need to copy the old master to
@@ -841,6 +843,7 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
          copyHostSurface(newMaster, buffer.active, dim);
       }
       buffer.active = newMaster;
+      mSurfaceGeneration++;
    }
 
    // Check to see if we have finally became the active surface, if we
@@ -850,6 +853,7 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
          copyHostSurface(foundSurface, buffer.active, dim);
       }
       buffer.active = foundSurface;
+      mSurfaceGeneration++;
    }
 
    // If we have a new master surface, we need to put it at the top
@@ -25,7 +25,7 @@ GLDriver::checkViewport()
          1.0f / static_cast<float>(pa_cl_vport_yscale.VPORT_YSCALE));
    }
 
-   if (mViewportDirty) {
+   if (mDirtyState & DirtyViewport) {
       auto pa_cl_vport_xscale = getRegister<latte::PA_CL_VPORT_XSCALE_N>(latte::Register::PA_CL_VPORT_XSCALE_0);
       auto pa_cl_vport_xoffset = getRegister<latte::PA_CL_VPORT_XOFFSET_N>(latte::Register::PA_CL_VPORT_XOFFSET_0);
       auto pa_cl_vport_yscale = getRegister<latte::PA_CL_VPORT_YSCALE_N>(latte::Register::PA_CL_VPORT_YSCALE_0);
@@ -57,10 +57,10 @@ GLDriver::checkViewport()
       }
 
       gl::glDepthRangef(nearZ, farZ);
-      mViewportDirty = false;
+      mDirtyState &= ~DirtyViewport;
    }
 
-   if (mScissorDirty) {
+   if (mDirtyState & DirtyScissor) {
       auto pa_sc_generic_scissor_tl = getRegister<latte::PA_SC_GENERIC_SCISSOR_TL>(latte::Register::PA_SC_GENERIC_SCISSOR_TL);
       auto pa_sc_generic_scissor_br = getRegister<latte::PA_SC_GENERIC_SCISSOR_BR>(latte::Register::PA_SC_GENERIC_SCISSOR_BR);
 
@@ -71,7 +71,7 @@ GLDriver::checkViewport()
 
       gl::glEnable(gl::GL_SCISSOR_TEST);
       gl::glScissor(x, y, width, height);
-      mScissorDirty = false;
+      mDirtyState &= ~DirtyScissor;
    }
 
    return true;
@@ -1,4 +1,5 @@
 #pragma once
+#include "common/byte_swap_array.h"
 #include "common/decaf_assert.h"
 #include "common/log.h"
 #include "pm4.h"
@@ -138,9 +139,7 @@ public:
       auto size = gsl::narrow_cast<uint32_t>(((values.size() * sizeof(Type)) + 3) / 4);
       memcpy(&mBuffer->buffer[mBuffer->curSize], values.data(), size * sizeof(uint32_t));
       // We do the byte_swap here separately as Type may not be uint32_t sized
-      for (uint32_t i = 0; i < size; ++i) {
-         mBuffer->buffer[mBuffer->curSize + i] = byte_swap(mBuffer->buffer[mBuffer->curSize + i]);
-      }
+      byte_swap_inplace(&mBuffer->buffer[mBuffer->curSize], size);
       mBuffer->curSize += size;
       return *this;
    }
@@ -1,82 +1,105 @@
 #include "decaf.h"
 #include "input.h"
+#include "kernel/kernel_replay.h"
 
 namespace input
 {
 
+// Input is read through the replay log, so a replay sees the same buttons
+//  pressed at the same point as the recording did.
+template<typename Type>
+static Type
+replayed(Type value)
+{
+   return static_cast<Type>(kernel::replayValue(kernel::ReplayChannel::Input, static_cast<uint64_t>(value)));
+}
+
+static float
+replayed(float value)
+{
+   return kernel::replayValue(kernel::ReplayChannel::Input, value);
+}
+
 vpad::Type
 getControllerType(vpad::Channel channel)
 {
-   return decaf::getInputDriver()->getControllerType(channel);
+   return replayed(decaf::getInputDriver()->getControllerType(channel));
 }
 
 ButtonStatus
 getButtonStatus(vpad::Channel channel,
                 vpad::Core button)
 {
-   return decaf::getInputDriver()->getButtonStatus(channel, button);
+   return replayed(decaf::getInputDriver()->getButtonStatus(channel, button));
 }
 
 float
 getAxisValue(vpad::Channel channel,
              vpad::CoreAxis axis)
 {
-   return decaf::getInputDriver()->getAxisValue(channel, axis);
+   return replayed(decaf::getInputDriver()->getAxisValue(channel, axis));
 }
 
 bool
 getTouchPosition(input::vpad::Channel channel,
                  input::vpad::TouchPosition &position)
 {
-   return decaf::getInputDriver()->getTouchPosition(channel, position);
+   auto touched = replayed(decaf::getInputDriver()->getTouchPosition(channel, position));
+
+   if (touched) {
+      position.x = replayed(position.x);
+      position.y = replayed(position.y);
+   }
+
+   return touched;
 }
 
 wpad::Type
 getControllerType(wpad::Channel channel)
 {
-   return decaf::getInputDriver()->getControllerType(channel);
+   return replayed(decaf::getInputDriver()->getControllerType(channel));
 }
 
 ButtonStatus
 getButtonStatus(wpad::Channel channel,
                 wpad::Core button)
 {
-   return decaf::getInputDriver()->getButtonStatus(channel, button);
+   return replayed(decaf::getInputDriver()->getButtonStatus(channel, button));
 }
 
 ButtonStatus
 getButtonStatus(wpad::Channel channel,
                 wpad::Nunchuck button)
 {
-   return decaf::getInputDriver()->getButtonStatus(channel, button);
+   return replayed(decaf::getInputDriver()->getButtonStatus(channel, button));
 }
 
 ButtonStatus
 getButtonStatus(wpad::Channel channel,
                 wpad::Classic button)
 {
-   return decaf::getInputDriver()->getButtonStatus(channel, button);
+   return replayed(decaf::getInputDriver()->getButtonStatus(channel, button));
 }
 
 ButtonStatus
 getButtonStatus(wpad::Channel channel,
                 wpad::Pro button)
 {
-   return decaf::getInputDriver()->getButtonStatus(channel, button);
+   return replayed(decaf::getInputDriver()->getButtonStatus(channel, button));
 }
 
 float
 getAxisValue(wpad::Channel channel,
              wpad::NunchuckAxis axis)
 {
-   return decaf::getInputDriver()->getAxisValue(channel, axis);
+   return replayed(decaf::getInputDriver()->getAxisValue(channel, axis));
 }
 
 float
 getAxisValue(wpad::Channel channel,
              wpad::ProAxis axis)
 {
-   return decaf::getInputDriver()->getAxisValue(channel, axis);
+   return replayed(decaf::getInputDriver()->getAxisValue(channel, axis));
 }
 
 } // namespace input
@@ -152,52 +152,82 @@ readSectionHeaders(BigEndianView &in, Header &header, std::vector<XSection>& sec
 }
 
 
-bool
-readSectionData(BigEndianView &in, const SectionHeader& header, std::vector<uint8_t> &data)
+// Returns the size of the section data after decompression
+uint32_t
+getSectionDataSize(BigEndianView &in, const SectionHeader &header)
 {
    if (header.type == SHT_NOBITS || header.size == 0) {
-      data.clear();
-      return true;
+      return 0;
    }
 
    if (header.flags & SHF_DEFLATED) {
-      auto stream = z_stream{};
-      auto ret = Z_OK;
-
-      // Read the original size
       in.seek(header.offset);
-      data.resize(in.read<uint32_t>());
+      return in.read<uint32_t>();
+   }
 
-      // Inflate
-      memset(&stream, 0, sizeof(stream));
-      stream.zalloc = Z_NULL;
-      stream.zfree = Z_NULL;
-      stream.opaque = Z_NULL;
+   return header.size;
+}
 
-      ret = inflateInit(&stream);
 
-      if (ret != Z_OK) {
-         gLog->error("Couldn't decompress .rpx section because inflateInit returned {}", ret);
-         data.clear();
-      } else {
-         stream.avail_in = header.size;
-         stream.next_in = const_cast<Bytef*>(in.readRaw<Bytef>(header.size));
-         stream.avail_out = static_cast<uInt>(data.size());
-         stream.next_out = reinterpret_cast<Bytef*>(data.data());
+// Reads section data directly into dst which must be getSectionDataSize bytes.
+// This does not log or touch any shared state so it is safe to call from
+// multiple threads at once, it returns a zlib error code on failure.
+int
+readSectionData(const uint8_t *file, const SectionHeader &header, uint8_t *dst, uint32_t size)
+{
+   if (size == 0) {
+      return Z_OK;
+   }
 
-         ret = inflate(&stream, Z_FINISH);
+   if (!(header.flags & SHF_DEFLATED)) {
+      std::memcpy(dst, file + header.offset, size);
+      return Z_OK;
+   }
 
-         if (ret != Z_OK && ret != Z_STREAM_END) {
-            gLog->error("Couldn't decompress .rpx section because inflate returned {}", ret);
-            data.clear();
-         }
+   auto stream = z_stream{};
+   std::memset(&stream, 0, sizeof(stream));
+   stream.zalloc = Z_NULL;
+   stream.zfree = Z_NULL;
+   stream.opaque = Z_NULL;
 
-         inflateEnd(&stream);
-      }
-   } else {
-      data.resize(header.size);
-      in.seek(header.offset);
-      in.read(data.data(), header.size);
+   auto ret = inflateInit(&stream);
+
+   if (ret != Z_OK) {
+      return ret;
+   }
+
+   // Skip the uncompressed size which prefixes the deflated data
+   stream.avail_in = header.size - sizeof(uint32_t);
+   stream.next_in = const_cast<Bytef *>(file + header.offset + sizeof(uint32_t));
+   stream.avail_out = size;
+   stream.next_out = reinterpret_cast<Bytef *>(dst);
+
+   ret = inflate(&stream, Z_FINISH);
+   inflateEnd(&stream);
+
+   if (ret == Z_STREAM_END) {
+      ret = Z_OK;
+   }
+
+   return ret;
+}
+
+
+bool
+readSectionData(BigEndianView &in, const SectionHeader& header, std::vector<uint8_t> &data)
+{
+   data.resize(getSectionDataSize(in, header));
+
+   if (data.empty()) {
+      return header.type == SHT_NOBITS || header.size == 0;
+   }
+
+   in.seek(0);
+   auto ret = readSectionData(in.readRaw<uint8_t>(0), header, data.data(), static_cast<uint32_t>(data.size()));
+
+   if (ret != Z_OK) {
+      gLog->error("Couldn't decompress .rpx section because inflate returned {}", ret);
+      data.clear();
    }
 
    return data.size() > 0;
@@ -309,4 +309,10 @@ readSectionHeaders(BigEndianView &in, Header &header, std::vector<XSection>& sec
 bool
 readSectionData(BigEndianView &in, const SectionHeader& header, std::vector<uint8_t> &data);
 
+uint32_t
+getSectionDataSize(BigEndianView &in, const SectionHeader &header);
+
+int
+readSectionData(const uint8_t *file, const SectionHeader &header, uint8_t *dst, uint32_t size);
+
 };
@@ -1,9 +1,12 @@
 #include "kernel.h"
+#include "kernel_binarytrace.h"
 #include "kernel_hle.h"
 #include "kernel_internal.h"
 #include "kernel_loader.h"
 #include "kernel_memory.h"
 #include "kernel_filesystem.h"
+#include "kernel_replay.h"
+#include "kernel_snapshot.h"
 #include "debugger/debugger.h"
 #include "decaf_events.h"
 #include "filesystem/filesystem.h"
@@ -45,6 +48,18 @@ kcTraceHandler(const std::string& str)
    traceLogSyscall(str);
    gLog->debug(str);
 }
+
+bool
+kcBinaryTraceHandler(cpu::Core *thread,
+                     uint32_t syscallID)
+{
+   if (!isBinaryTraceRunning()) {
+      return false;
+   }
+
+   binaryTraceHleCall(thread, syscallID);
+   return true;
+}
 }
 
 enum class FaultReason : uint32_t {
@@ -68,6 +83,13 @@ cpuIllInstHandler();
 static void
 cpuBranchTraceHandler(uint32_t target);
 
+static void
+cpuBinaryBranchTraceHandler(uint32_t target);
+
+static const char *
+cpuSymbolLookupHandler(uint32_t address,
+                       uint32_t *symbolStart);
+
 static bool
 launchGame();
 
@@ -114,10 +136,33 @@ initialise()
    cpu::setInterruptHandler(&cpuInterruptHandler);
 
    if (decaf::config::log::branch_trace) {
-      cpu::setBranchTraceHandler(&cpuBranchTraceHandler);
+      if (decaf::config::log::binary_trace_path.empty()) {
+         cpu::setBranchTraceHandler(&cpuBranchTraceHandler);
+      } else {
+         cpu::setBranchTraceHandler(&cpuBinaryBranchTraceHandler);
+      }
    }
 
+   cpu::setSymbolLookupHandler(&cpuSymbolLookupHandler);
+
    sSystemHeap = new TeenyHeap(mem::translate(mem::SystemBase), mem::SystemSize);
+
+   registerSnapshotState("system heap", []() -> SnapshotRestoreFunction {
+      auto state = sSystemHeap->saveState();
+
+      return [=]() {
+         sSystemHeap->restoreState(state);
+      };
+   });
+
+   // The loader's temporary memory is not part of a snapshot
+   registerSnapshotState("loader", []() -> SnapshotRestoreFunction {
+      if (loader::isLoading()) {
+         return { };
+      }
+
+      return []() { };
+   });
 }
 
 TeenyHeap *
@@ -137,6 +182,29 @@ cpuBranchTraceHandler(uint32_t target)
    gLog->debug("CPU branched to: {}", *symNamePtr);
 }
 
+static void
+cpuBinaryBranchTraceHandler(uint32_t target)
+{
+   // Every branch is recorded, ones without a symbol are dropped when dumped
+   binaryTraceBranch(cpu::this_core::state(), target);
+}
+
+static const char *
+cpuSymbolLookupHandler(uint32_t address,
+                       uint32_t *symbolStart)
+{
+   // Symbol names are never removed, so the string outlives the lock
+   loader::lockLoader();
+   auto symNamePtr = loader::findContainingSymbolNameForAddress(address, symbolStart);
+   loader::unlockLoader();
+
+   if (!symNamePtr) {
+      return nullptr;
+   }
+
+   return symNamePtr->c_str();
+}
+
 static std::string
 coreStateToString(cpu::Core *core)
 {
@@ -259,6 +327,20 @@ cpuInterruptHandler(uint32_t interrupt_flags)
 
    decaf_check(coreinit::internal::isSchedulerEnabled());
 
+   // Recording and replaying hold guest interrupts back until they can be
+   //  delivered at the same point in every run.
+   interrupt_flags = replayInterrupts(interrupt_flags);
+
+   if (!(interrupt_flags & ~unsafeInterrupts)) {
+      return;
+   }
+
+   // This must happen before anything below changes the core's state, as
+   //  a restored snapshot resumes from here too.
+   if (interrupt_flags & cpu::SNAPSHOT_INTERRUPT) {
+      handleSnapshotInterrupt();
+   }
+
    coreinit::OSContext savedContext;
    kernel::saveContext(&savedContext);
    kernel::restoreContext(&sInterruptContext[cpu::this_core::id()]);
@@ -329,9 +411,11 @@ cpuEntrypoint()
 
    // Run the scheduler loop, this is what will
    //   execute when there is nothing else to do.
-   while (sRunning) {
-      cpu::this_core::waitForInterrupt();
-   }
+   runIdleFiber([]() {
+      while (sRunning) {
+         cpu::this_core::waitForInterrupt();
+      }
+   });
 }
 
 bool
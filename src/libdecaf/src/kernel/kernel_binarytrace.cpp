@@ -0,0 +1,432 @@
+#include "kernel_binarytrace.h"
+#include "kernel_hle.h"
+#include "kernel_hlefunction.h"
+#include "kernel_loader.h"
+#include "common/log.h"
+#include "common/platform_thread.h"
+#include "libcpu/state.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace kernel
+{
+
+static const uint32_t
+BinaryTraceCoreCount = 3;
+
+// Records buffered per core, must be a power of two
+static const uint64_t
+BinaryTraceRingSize = 64 * 1024;
+
+// How often the writer thread empties the core buffers
+static const auto
+BinaryTraceDrainInterval = std::chrono::milliseconds { 10 };
+
+// A single producer, single consumer ring, the producer is the core thread
+//  which owns it and the consumer is the writer thread.
+struct BinaryTraceRing
+{
+   std::unique_ptr<BinaryTraceRecord[]> records;
+   alignas(64) std::atomic<uint64_t> head { 0 };
+   alignas(64) std::atomic<uint64_t> tail { 0 };
+   std::atomic<uint64_t> dropped { 0 };
+};
+
+static std::array<BinaryTraceRing, BinaryTraceCoreCount>
+sRings;
+
+static std::atomic<bool>
+sRunning { false };
+
+static std::chrono::steady_clock::time_point
+sStartTime;
+
+static std::ofstream
+sFile;
+
+static std::thread
+sWriterThread;
+
+static std::mutex
+sWriterMutex;
+
+static std::condition_variable
+sWriterCondition;
+
+static std::set<uint32_t>
+sSeenFunctions;
+
+static std::set<uint32_t>
+sSeenBranches;
+
+static BinaryTraceRecord *
+allocateRecord(cpu::Core *core)
+{
+   if (!sRunning.load(std::memory_order_relaxed) || core->id >= BinaryTraceCoreCount) {
+      return nullptr;
+   }
+
+   auto &ring = sRings[core->id];
+   auto head = ring.head.load(std::memory_order_relaxed);
+
+   // Never block a core on the writer, just count what we lose
+   if (head - ring.tail.load(std::memory_order_acquire) >= BinaryTraceRingSize) {
+      ring.dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+   }
+
+   auto record = &ring.records[head & (BinaryTraceRingSize - 1)];
+   record->time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sStartTime).count();
+   record->core = static_cast<uint8_t>(core->id);
+   record->reserved = 0;
+   record->lr = core->lr;
+   record->sp = core->gpr[1];
+   return record;
+}
+
+static void
+commitRecord(cpu::Core *core)
+{
+   auto &ring = sRings[core->id];
+   ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void
+binaryTraceHleCall(cpu::Core *core,
+                   uint32_t syscallID)
+{
+   auto record = allocateRecord(core);
+
+   if (!record) {
+      return;
+   }
+
+   record->type = BinaryTraceRecordType::HleCall;
+   record->id = syscallID;
+   std::copy(&core->gpr[3], &core->gpr[11], record->args);
+   commitRecord(core);
+}
+
+void
+binaryTraceBranch(cpu::Core *core,
+                  uint32_t target)
+{
+   auto record = allocateRecord(core);
+
+   if (!record) {
+      return;
+   }
+
+   record->type = BinaryTraceRecordType::Branch;
+   record->id = target;
+   std::fill(std::begin(record->args), std::end(record->args), 0);
+   commitRecord(core);
+}
+
+static void
+writeChunk(BinaryTraceChunkType type,
+           const void *data,
+           size_t size)
+{
+   auto chunk = BinaryTraceChunk { type, static_cast<uint32_t>(size) };
+   sFile.write(reinterpret_cast<const char *>(&chunk), sizeof(BinaryTraceChunk));
+   sFile.write(reinterpret_cast<const char *>(data), size);
+}
+
+// Copies everything currently in the core buffers to the file
+static void
+drainRings(std::vector<BinaryTraceRecord> &buffer)
+{
+   buffer.clear();
+
+   for (auto &ring : sRings) {
+      auto tail = ring.tail.load(std::memory_order_relaxed);
+      auto head = ring.head.load(std::memory_order_acquire);
+
+      for (; tail != head; ++tail) {
+         auto &record = ring.records[tail & (BinaryTraceRingSize - 1)];
+
+         if (record.type == BinaryTraceRecordType::HleCall) {
+            sSeenFunctions.insert(record.id);
+         } else {
+            sSeenBranches.insert(record.id);
+         }
+
+         buffer.push_back(record);
+      }
+
+      ring.tail.store(tail, std::memory_order_release);
+   }
+
+   if (!buffer.empty()) {
+      writeChunk(BinaryTraceChunkType::Records, buffer.data(), buffer.size() * sizeof(BinaryTraceRecord));
+   }
+}
+
+static void
+writerThreadEntry()
+{
+   std::vector<BinaryTraceRecord> buffer;
+   buffer.reserve(BinaryTraceRingSize * BinaryTraceCoreCount);
+
+   std::unique_lock<std::mutex> lock { sWriterMutex };
+
+   while (sRunning) {
+      sWriterCondition.wait_for(lock, BinaryTraceDrainInterval);
+      drainRings(buffer);
+   }
+
+   drainRings(buffer);
+}
+
+static void
+appendName(std::vector<char> &names,
+           BinaryTraceRecordType type,
+           uint32_t id,
+           const std::string &name)
+{
+   auto entry = BinaryTraceName { type, 0, static_cast<uint16_t>(std::min<size_t>(name.size(), 0xFFFF)), id };
+   auto bytes = reinterpret_cast<const char *>(&entry);
+   names.insert(names.end(), bytes, bytes + sizeof(BinaryTraceName));
+   names.insert(names.end(), name.begin(), name.begin() + entry.length);
+}
+
+// Names are looked up once at the end so the writer thread never touches the
+//  loader while modules are being loaded.
+static void
+writeNames()
+{
+   std::vector<char> names;
+
+   for (auto id : sSeenFunctions) {
+      auto func = findHleFunction(id);
+
+      if (func) {
+         appendName(names, BinaryTraceRecordType::HleCall, id, func->module + "::" + func->name);
+      }
+   }
+
+   for (auto address : sSeenBranches) {
+      auto name = loader::findSymbolNameForAddress(address);
+
+      if (name) {
+         appendName(names, BinaryTraceRecordType::Branch, address, *name);
+      }
+   }
+
+   writeChunk(BinaryTraceChunkType::Names, names.data(), names.size());
+}
+
+bool
+startBinaryTrace(const std::string &path)
+{
+   if (sRunning) {
+      return true;
+   }
+
+   sFile.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+   if (!sFile.is_open()) {
+      gLog->error("Could not open binary trace file {}", path);
+      return false;
+   }
+
+   auto header = BinaryTraceHeader { BinaryTraceMagic, BinaryTraceVersion, sizeof(BinaryTraceRecord), BinaryTraceCoreCount };
+   sFile.write(reinterpret_cast<const char *>(&header), sizeof(BinaryTraceHeader));
+
+   for (auto &ring : sRings) {
+      ring.records.reset(new BinaryTraceRecord[BinaryTraceRingSize]);
+      ring.head = 0;
+      ring.tail = 0;
+      ring.dropped = 0;
+   }
+
+   sSeenFunctions.clear();
+   sSeenBranches.clear();
+   sStartTime = std::chrono::steady_clock::now();
+   sRunning = true;
+
+   sWriterThread = std::thread { writerThreadEntry };
+   platform::setThreadName(&sWriterThread, "Binary Trace Writer");
+   gLog->info("Writing binary trace to {}", path);
+   return true;
+}
+
+void
+stopBinaryTrace()
+{
+   if (!sRunning) {
+      return;
+   }
+
+   sRunning = false;
+   sWriterCondition.notify_all();
+   sWriterThread.join();
+
+   std::array<BinaryTraceDropCount, BinaryTraceCoreCount> dropped;
+
+   for (auto i = 0u; i < BinaryTraceCoreCount; ++i) {
+      dropped[i] = sRings[i].dropped;
+      sRings[i].records.reset();
+
+      if (dropped[i]) {
+         gLog->warn("Binary trace dropped {} records from core {}", dropped[i], i);
+      }
+   }
+
+   writeChunk(BinaryTraceChunkType::Stats, dropped.data(), sizeof(dropped));
+   writeNames();
+   sFile.close();
+}
+
+bool
+isBinaryTraceRunning()
+{
+   return sRunning.load(std::memory_order_relaxed);
+}
+
+static bool
+readChunk(std::ifstream &file,
+          BinaryTraceChunk &chunk,
+          std::vector<char> &data)
+{
+   if (!file.read(reinterpret_cast<char *>(&chunk), sizeof(BinaryTraceChunk))) {
+      return false;
+   }
+
+   data.resize(chunk.size);
+   return !!file.read(data.data(), chunk.size);
+}
+
+bool
+dumpBinaryTrace(const std::string &path,
+                std::ostream &out)
+{
+   std::ifstream file { path, std::ifstream::in | std::ifstream::binary };
+   BinaryTraceHeader header;
+
+   if (!file.read(reinterpret_cast<char *>(&header), sizeof(BinaryTraceHeader))
+    || header.magic != BinaryTraceMagic) {
+      out << "Not a binary trace file: " << path << std::endl;
+      return false;
+   }
+
+   if (header.version != BinaryTraceVersion || header.recordSize != sizeof(BinaryTraceRecord)) {
+      out << "Unsupported binary trace version " << header.version << std::endl;
+      return false;
+   }
+
+   // The names are at the end of the file, so find them first
+   std::map<uint32_t, std::string> functionNames;
+   std::map<uint32_t, std::string> branchNames;
+   std::vector<BinaryTraceDropCount> dropped;
+   auto recordsStart = file.tellg();
+   BinaryTraceChunk chunk;
+   std::vector<char> data;
+
+   while (file.read(reinterpret_cast<char *>(&chunk), sizeof(BinaryTraceChunk))) {
+      if (chunk.type == BinaryTraceChunkType::Records) {
+         file.seekg(chunk.size, std::ifstream::cur);
+         continue;
+      }
+
+      data.resize(chunk.size);
+
+      if (!file.read(data.data(), chunk.size)) {
+         break;
+      }
+
+      if (chunk.type == BinaryTraceChunkType::Stats) {
+         auto counts = reinterpret_cast<BinaryTraceDropCount *>(data.data());
+         dropped.assign(counts, counts + chunk.size / sizeof(BinaryTraceDropCount));
+      } else if (chunk.type == BinaryTraceChunkType::Names) {
+         for (auto pos = size_t { 0 }; pos + sizeof(BinaryTraceName) <= data.size(); ) {
+            auto entry = reinterpret_cast<BinaryTraceName *>(&data[pos]);
+            auto name = std::string { &data[pos + sizeof(BinaryTraceName)], entry->length };
+            pos += sizeof(BinaryTraceName) + entry->length;
+
+            if (entry->type == BinaryTraceRecordType::HleCall) {
+               functionNames[entry->id] = name;
+            } else {
+               branchNames[entry->id] = name;
+            }
+         }
+      }
+   }
+
+   if (dropped.empty()) {
+      out << "Warning: trace is incomplete, names are unavailable" << std::endl;
+   }
+
+   file.clear();
+   file.seekg(recordsStart);
+
+   while (readChunk(file, chunk, data)) {
+      if (chunk.type != BinaryTraceChunkType::Records) {
+         continue;
+      }
+
+      auto records = reinterpret_cast<BinaryTraceRecord *>(data.data());
+      auto count = chunk.size / sizeof(BinaryTraceRecord);
+
+      // Each chunk holds the records of every core, interleave them by time
+      std::stable_sort(records, records + count,
+                       [](const BinaryTraceRecord &lhs, const BinaryTraceRecord &rhs) {
+                          return lhs.time < rhs.time;
+                       });
+
+      for (auto i = 0u; i < count; ++i) {
+         auto &record = records[i];
+         fmt::MemoryWriter line;
+         line.write("[{:>12.6f} core {}] ", record.time / 1000000000.0, record.core);
+
+         if (record.type == BinaryTraceRecordType::HleCall) {
+            auto itr = functionNames.find(record.id);
+
+            if (itr != functionNames.end()) {
+               line.write("{}(", itr->second);
+            } else {
+               line.write("syscall_{}(", record.id);
+            }
+
+            for (auto arg = 0u; arg < 8; ++arg) {
+               line.write(arg ? ", 0x{:X}" : "0x{:X}", record.args[arg]);
+            }
+
+            line.write(") from 0x{:08X}", record.lr);
+         } else {
+            auto itr = branchNames.find(record.id);
+
+            if (itr != branchNames.end()) {
+               line.write("CPU branched to: {}", itr->second);
+            } else if (dropped.empty()) {
+               line.write("CPU branched to: 0x{:08X}", record.id);
+            } else {
+               continue;
+            }
+         }
+
+         out << line.str() << '\n';
+      }
+   }
+
+   for (auto i = 0u; i < dropped.size(); ++i) {
+      if (dropped[i]) {
+         out << "Core " << i << " dropped " << dropped[i] << " records" << std::endl;
+      }
+   }
+
+   return true;
+}
+
+} // namespace kernel
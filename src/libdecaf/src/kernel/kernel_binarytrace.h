@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace cpu
+{
+struct Core;
+}
+
+namespace kernel
+{
+
+/*
+ * Binary trace file layout, all values are in host byte order:
+ *
+ *    BinaryTraceHeader
+ *    BinaryTraceChunk, followed by chunk.size bytes of payload
+ *    ...
+ *
+ * Records chunks contain packed BinaryTraceRecord, one chunk is written each
+ * time the writer thread drains the per-core buffers. The names of every
+ * function and branch target seen are written in a Names chunk when the trace
+ * is stopped, so they only have to be looked up once. Branch records are
+ * written for every branch, when dumped the ones to addresses without a
+ * symbol are skipped like the text trace does.
+ */
+static const uint32_t BinaryTraceMagic = 0x43525444; // "DTRC"
+static const uint32_t BinaryTraceVersion = 1;
+
+enum class BinaryTraceChunkType : uint32_t
+{
+   Records = 1,
+   Names = 2,
+   Stats = 3,
+};
+
+enum class BinaryTraceRecordType : uint8_t
+{
+   HleCall = 1,
+   Branch = 2,
+};
+
+struct BinaryTraceHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t recordSize;
+   uint32_t coreCount;
+};
+
+struct BinaryTraceChunk
+{
+   BinaryTraceChunkType type;
+   uint32_t size;
+};
+
+struct BinaryTraceRecord
+{
+   //! Nanoseconds since the trace was started
+   uint64_t time;
+
+   BinaryTraceRecordType type;
+   uint8_t core;
+   uint16_t reserved;
+
+   //! Syscall ID for HleCall, target address for Branch
+   uint32_t id;
+
+   uint32_t lr;
+   uint32_t sp;
+
+   //! r3 to r10
+   uint32_t args[8];
+};
+
+static_assert(sizeof(BinaryTraceRecord) == 56, "Binary trace records must stay a fixed size");
+
+//! Each entry of a Names chunk is followed by length bytes of name
+struct BinaryTraceName
+{
+   BinaryTraceRecordType type;
+   uint8_t reserved;
+   uint16_t length;
+   uint32_t id;
+};
+
+//! The Stats chunk is an array of dropped record counts, one per core
+using BinaryTraceDropCount = uint64_t;
+
+bool
+startBinaryTrace(const std::string &path);
+
+void
+stopBinaryTrace();
+
+bool
+isBinaryTraceRunning();
+
+void
+binaryTraceHleCall(cpu::Core *core,
+                   uint32_t syscallID);
+
+void
+binaryTraceBranch(cpu::Core *core,
+                  uint32_t target);
+
+//! Formats a binary trace file as text
+bool
+dumpBinaryTrace(const std::string &path,
+                std::ostream &out);
+
+} // namespace kernel
@@ -1,6 +1,9 @@
 #include "kernel.h"
+#include "kernel_internal.h"
 #include <algorithm>
 #include <cfenv>
+#include <unordered_set>
+#include <vector>
 #include "libcpu/cpu.h"
 #include "libcpu/mem.h"
 #include "common/platform_fiber.h"
@@ -23,9 +26,15 @@ sCurrentContext[3];
 static coreinit::OSContext *
 sDeadContext[3];
 
+static platform::Fiber *
+sThreadFiber[3];
+
 static platform::Fiber *
 sIdleFiber[3];
 
+static platform::Fiber *
+sRunningFiber[3];
+
 static coreinit::OSContext
 sIdleContext[3];
 
@@ -36,6 +45,35 @@ struct Fiber
    cpu::Tracer *tracer = nullptr;
 };
 
+struct SavedFiber
+{
+   Fiber *fiber;
+   Fiber value;
+   std::vector<uint8_t> state;
+};
+
+struct FiberSnapshot
+{
+   std::vector<SavedFiber> fibers;
+   std::vector<uint8_t> idleState[3];
+   coreinit::OSContext *currentContext[3];
+   coreinit::OSContext *deadContext[3];
+   coreinit::OSContext idleContext[3];
+};
+
+// Only touched with every core stopped or under the scheduler lock, which
+//  every fiber allocation and free happens under.
+static std::unordered_set<Fiber *>
+sFibers;
+
+//! Fibers a snapshot may need to go back to
+static std::unordered_set<Fiber *>
+sSnapshotFibers;
+
+//! Fibers of exited threads which are kept alive for a snapshot
+static std::vector<Fiber *>
+sRetiredFibers;
+
 static void
 checkDeadContext();
 
@@ -183,6 +221,7 @@ allocateFiber(coreinit::OSContext *context)
    fiber->tracer = cpu::allocTracer(1024 * 10 * 10);
    fiber->handle = platform::createFiber(fiberEntryPoint, nullptr);
    fiber->context = context;
+   sFibers.insert(fiber);
    return fiber;
 }
 
@@ -193,16 +232,29 @@ reallocateContextFiber(coreinit::OSContext *context,
    auto oldFiber = context->fiber->handle;
    auto newFiber = platform::createFiber(entry, nullptr);
    context->fiber->handle = newFiber;
+   sRunningFiber[cpu::this_core::id()] = newFiber;
    platform::swapToFiber(oldFiber, newFiber);
 }
 
 static void
-freeFiber(Fiber *fiber)
+destroyFiber(Fiber *fiber)
 {
    cpu::freeTracer(fiber->tracer);
    platform::destroyFiber(fiber->handle);
 }
 
+static void
+freeFiber(Fiber *fiber)
+{
+   sFibers.erase(fiber);
+
+   if (sSnapshotFibers.count(fiber)) {
+      sRetiredFibers.push_back(fiber);
+   } else {
+      destroyFiber(fiber);
+   }
+}
+
 // This must be called under the same scheduler lock
 // that added the thread to tDeadThread, we simply use
 // the thread_local to pass it between fibers.
@@ -238,11 +290,44 @@ initCoreFiber()
    auto fiber = platform::getThreadFiber();
 
    // Save some needed information about the fiber run states.
+   sThreadFiber[coreId] = fiber;
    sIdleFiber[coreId] = fiber;
+   sRunningFiber[coreId] = fiber;
    sCurrentContext[coreId] = nullptr;
    sDeadContext[coreId] = nullptr;
 }
 
+void
+runIdleFiber(std::function<void()> loop)
+{
+   auto coreId = cpu::this_core::id();
+
+   // Unlike the host thread's own stack, a fiber we created can be saved
+   //  and restored by a snapshot.
+   auto idleFiber = platform::createFiber([loop, coreId](void *) {
+      loop();
+      platform::swapToFiber(nullptr, sThreadFiber[coreId]);
+   }, nullptr);
+
+   sIdleFiber[coreId] = idleFiber;
+   sRunningFiber[coreId] = idleFiber;
+   platform::swapToFiber(sThreadFiber[coreId], idleFiber);
+
+   platform::destroyFiber(idleFiber);
+}
+
+platform::Fiber *
+getCurrentFiber()
+{
+   return sRunningFiber[cpu::this_core::id()];
+}
+
+void
+setCurrentFiber(platform::Fiber *fiber)
+{
+   sRunningFiber[cpu::this_core::id()] = fiber;
+}
+
 void
 exitThreadNoLock()
 {
@@ -287,11 +372,91 @@ setContext(coreinit::OSContext *next)
    // Switch to the new fiber, note that coreId is no longer valid
    // after this point, as this context may have been switched to
    // a new core.
+   auto nextFiber = getContextFiber(next);
    sCurrentContext[coreId] = next;
-   platform::swapToFiber(getContextFiber(current), getContextFiber(next));
+   sRunningFiber[coreId] = nextFiber;
+   platform::swapToFiber(getContextFiber(current), nextFiber);
 
    // Perform restoral operations after the switch
    wakeCurrentContext();
 }
 
+FiberSnapshot *
+captureFibers()
+{
+   auto snapshot = new FiberSnapshot { };
+
+   for (auto fiber : sFibers) {
+      auto saved = SavedFiber { fiber, *fiber };
+
+      if (!platform::saveFiberState(fiber->handle, saved.state)) {
+         delete snapshot;
+         return nullptr;
+      }
+
+      snapshot->fibers.push_back(std::move(saved));
+   }
+
+   for (auto i = 0; i < 3; ++i) {
+      // Until a core reaches its idle loop it is still on the host thread's
+      //  own stack, which cannot be saved.
+      if (sIdleFiber[i] == sThreadFiber[i]
+       || !platform::saveFiberState(sIdleFiber[i], snapshot->idleState[i])) {
+         delete snapshot;
+         return nullptr;
+      }
+
+      snapshot->currentContext[i] = sCurrentContext[i];
+      snapshot->deadContext[i] = sDeadContext[i];
+      snapshot->idleContext[i] = sIdleContext[i];
+   }
+
+   sSnapshotFibers.clear();
+
+   for (auto &saved : snapshot->fibers) {
+      sSnapshotFibers.insert(saved.fiber);
+   }
+
+   return snapshot;
+}
+
+void
+restoreFibers(FiberSnapshot *snapshot)
+{
+   // Anything created since the snapshot was taken is unreachable afterwards
+   for (auto fiber : sFibers) {
+      if (!sSnapshotFibers.count(fiber)) {
+         destroyFiber(fiber);
+      }
+   }
+
+   sFibers.clear();
+   sRetiredFibers.clear();
+
+   for (auto &saved : snapshot->fibers) {
+      *saved.fiber = saved.value;
+      platform::restoreFiberState(saved.fiber->handle, saved.state);
+      sFibers.insert(saved.fiber);
+   }
+
+   for (auto i = 0; i < 3; ++i) {
+      platform::restoreFiberState(sIdleFiber[i], snapshot->idleState[i]);
+      sCurrentContext[i] = snapshot->currentContext[i];
+      sDeadContext[i] = snapshot->deadContext[i];
+      sIdleContext[i] = snapshot->idleContext[i];
+   }
+}
+
+void
+freeFiberSnapshot(FiberSnapshot *snapshot)
+{
+   for (auto fiber : sRetiredFibers) {
+      destroyFiber(fiber);
+   }
+
+   sRetiredFibers.clear();
+   sSnapshotFibers.clear();
+   delete snapshot;
+}
+
 } // namespace kernel
@@ -1,5 +1,6 @@
 #include "kernel_hle.h"
 #include "kernel_internal.h"
+#include "kernel_replay.h"
 #include "modules/coreinit/coreinit.h"
 #include "modules/coreinit/coreinit_core.h"
 #include "modules/coreinit/coreinit_memheap.h"
@@ -41,6 +42,7 @@ static void
 kcstub(cpu::Core *state, void *data)
 {
    auto func = static_cast<HleFunction *>(data);
+   replayKernelCall();
 
    if (!func->valid) {
       gLog->info("Unimplemented kernel function {}::{} called from 0x{:08X}", func->module, func->name, state->lr);
@@ -88,6 +90,18 @@ registerUnimplementedHleFunc(const std::string &module, const std::string &name)
    return ppcFn->syscallID;
 }
 
+HleFunction *
+findHleFunction(uint32_t syscallID)
+{
+   auto itr = gHleFuncs.find(syscallID);
+
+   if (itr == gHleFuncs.end()) {
+      return nullptr;
+   } else {
+      return itr->second;
+   }
+}
+
 HleModule *
 findHleModule(const std::string &name)
 {
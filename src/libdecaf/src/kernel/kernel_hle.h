@@ -6,10 +6,14 @@ namespace kernel
 {
 
 class HleModule;
+struct HleFunction;
 
 void
 initialiseHleMmodules();
 
+HleFunction *
+findHleFunction(uint32_t syscallID);
+
 HleModule *
 findHleModule(const std::string &name);
 
@@ -30,6 +30,9 @@ namespace functions
 
 void kcTraceHandler(const std::string& str);
 
+//! Returns true if the call was recorded to the binary trace instead
+bool kcBinaryTraceHandler(cpu::Core *thread, uint32_t syscallID);
+
 template<typename ReturnType, typename... Args>
 struct HleFunctionImpl : HleFunction
 {
@@ -37,7 +40,7 @@ struct HleFunctionImpl : HleFunction
 
    virtual void call(cpu::Core *thread) override
    {
-      if (decaf::config::log::kernel_trace && traceEnabled) {
+      if (decaf::config::log::kernel_trace && traceEnabled && !kcBinaryTraceHandler(thread, syscallID)) {
          ppctypes::invoke(kcTraceHandler, thread, wrapped_function, name);
       } else {
          ppctypes::invoke(nullptr, thread, wrapped_function, name);
@@ -52,7 +55,7 @@ struct HleMemberFunctionImpl : HleFunction
 
    virtual void call(cpu::Core *thread) override
    {
-      if (decaf::config::log::kernel_trace && traceEnabled) {
+      if (decaf::config::log::kernel_trace && traceEnabled && !kcBinaryTraceHandler(thread, syscallID)) {
          ppctypes::invokeMemberFn(kcTraceHandler, thread, wrapped_function, name);
       } else {
          ppctypes::invokeMemberFn(nullptr, thread, wrapped_function, name);
@@ -70,7 +73,7 @@ struct HleConstructorFunctionImpl : HleFunction
 
    virtual void call(cpu::Core *thread) override
    {
-      if (decaf::config::log::kernel_trace && traceEnabled) {
+      if (decaf::config::log::kernel_trace && traceEnabled && !kcBinaryTraceHandler(thread, syscallID)) {
          ppctypes::invoke(kcTraceHandler, thread, &trampFunction, name);
       } else {
          ppctypes::invoke(nullptr, thread, &trampFunction, name);
@@ -88,7 +91,7 @@ struct HleDestructorFunctionImpl : HleFunction
 
    virtual void call(cpu::Core *thread) override
    {
-      if (decaf::config::log::kernel_trace && traceEnabled) {
+      if (decaf::config::log::kernel_trace && traceEnabled && !kcBinaryTraceHandler(thread, syscallID)) {
          ppctypes::invoke(kcTraceHandler, thread, &trampFunction, name);
       } else {
          ppctypes::invoke(nullptr, thread, &trampFunction, name);
@@ -6,9 +6,36 @@
 namespace kernel
 {
 
+struct FiberSnapshot;
+
 void
 initCoreFiber();
 
+//! Runs the core's idle loop on a fiber of its own, returns once loop does
+void
+runIdleFiber(std::function<void()> loop);
+
+//! The fiber the calling core is running
+platform::Fiber *
+getCurrentFiber();
+
+//! For when a core has been switched to a fiber behind the kernel's back
+void
+setCurrentFiber(platform::Fiber *fiber);
+
+//! Saves every guest thread's fiber and the idle fibers, every core must be
+//  stopped somewhere other than on those fibers. Returns nullptr if the host
+//  cannot save fibers. Fibers in the snapshot are kept alive until it is freed.
+FiberSnapshot *
+captureFibers();
+
+//! Puts every fiber back how it was, destroying any created since
+void
+restoreFibers(FiberSnapshot *snapshot);
+
+void
+freeFiberSnapshot(FiberSnapshot *snapshot);
+
 void
 reallocateContextFiber(coreinit::OSContext *context,
                        platform::FiberEntryPoint entry);
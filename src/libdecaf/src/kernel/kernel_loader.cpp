@@ -1,4 +1,5 @@
 #include "kernel_loader.h"
+#include "common/adaptive_spinlock.h"
 #include "common/align.h"
 #include "common/bigendianview.h"
 #include "common/decaf_assert.h"
@@ -12,13 +13,19 @@
 #include "kernel_hle.h"
 #include "kernel_hlemodule.h"
 #include "kernel_hlefunction.h"
+#include "kernel_loadercache.h"
 #include "kernel_memory.h"
+#include "libcpu/code_analysis.h"
 #include "modules/coreinit/coreinit_memory.h"
 #include "modules/coreinit/coreinit_memheap.h"
 #include "modules/coreinit/coreinit_dynload.h"
 #include "modules/coreinit/coreinit_scheduler.h"
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <map>
+#include <memory>
+#include <thread>
 #include <unordered_map>
 
 class SequentialMemoryTracker
@@ -72,12 +79,18 @@ using AddressRange = std::pair<ppcaddr_t, ppcaddr_t>;
 static std::atomic<uint32_t>
 sLoaderLock{ 0 };
 
+static SpinLockStats
+sLoaderLockStats { "Loader" };
+
 static std::map<std::string, LoadedModule*>
 gLoadedModules;
 
 static std::map<ppcaddr_t, std::string, std::greater<ppcaddr_t>>
 gGlobalSymbolLookup;
 
+static std::atomic<uint32_t>
+sSymbolGeneration { 0 };
+
 static std::map<std::string, ppcaddr_t>
 gUnimplementedFunctions;
 
@@ -126,19 +139,15 @@ loaderFree(void *mem)
 void
 lockLoader()
 {
-   uint32_t expected = 0;
    auto core = 1 << cpu::this_core::id();
-
-   while (!sLoaderLock.compare_exchange_weak(expected, core, std::memory_order_acquire)) {
-      expected = 0;
-   }
+   spinlock_acquire(sLoaderLock, core, sLoaderLockStats);
 }
 
 void
 unlockLoader()
 {
    auto core = 1 << cpu::this_core::id();
-   auto oldCore = sLoaderLock.exchange(0, std::memory_order_release);
+   auto oldCore = spinlock_release(sLoaderLock);
    decaf_check(oldCore == core);
 }
 
@@ -148,6 +157,18 @@ getLoadedModules()
    return gLoadedModules;
 }
 
+bool
+isLoading()
+{
+   return sLoaderLock.load() != 0 || sLoaderHeap != nullptr;
+}
+
+uint32_t
+getSymbolGeneration()
+{
+   return sSymbolGeneration.load();
+}
+
 static LoadedModule *
 loadRPLNoLock(const std::string& name);
 
@@ -461,6 +482,7 @@ loadHleModule(const std::string &moduleName,
       auto codeRegion = static_cast<uint8_t*>(coreinit::internal::sysAlloc(codeSize, 4));
       auto start = mem::untranslate(codeRegion);
       auto end = start + codeSize;
+      loadedMod->codeBase = start;
       loadedMod->sections.emplace_back(LoadedSection { ".text", LoadedSectionType::Code, start, end });
 
       for (auto &func : funcSymbols) {
@@ -497,6 +519,7 @@ loadHleModule(const std::string &moduleName,
       auto dataRegion = static_cast<uint8_t *>(coreinit::internal::sysAlloc(dataSize, 4));
       auto start = mem::untranslate(dataRegion);
       auto end = start + codeSize;
+      loadedMod->dataBase = start;
       loadedMod->sections.emplace_back(LoadedSection { ".data", LoadedSectionType::Data, start, end });
 
       for (auto &data : dataSymbols) {
@@ -693,7 +716,8 @@ processRelocations(LoadedModule *loadedMod,
 
 bool
 processImports(LoadedModule *loadedMod,
-               SectionList &sections)
+               SectionList &sections,
+               std::vector<CachedImport> *resolvedImports)
 {
    std::map<std::string, ppcaddr_t> symbolTable;
 
@@ -782,6 +806,10 @@ processImports(LoadedModule *loadedMod,
             // Write the symbol address into .fimport or .dimport
             decaf_check(type == elf::STT_TLS || symbolAddr);
             mem::write(virtAddress, symbolAddr);
+
+            if (resolvedImports) {
+               resolvedImports->emplace_back(CachedImport { impsec.name, name, static_cast<uint32_t>(type), symbolAddr });
+            }
          }
       }
    }
@@ -911,21 +939,148 @@ processExports(LoadedModule *loadedMod,
 }
 
 
-LoadedModule *
-loadRPL(const std::string &moduleName,
-        const std::string &name,
-        const gsl::span<uint8_t> &data)
+struct PendingModule;
+
+struct SectionInflateJob
+{
+   PendingModule *pending;
+   const elf::SectionHeader *header;
+   uint8_t *dst;
+   uint32_t size;
+   int result;
+};
+
+// An RPL which has had its memory allocated and its section inflation queued
+// but which has not yet been linked.
+struct PendingModule
+{
+   LoadedModule *module = nullptr;
+   std::string moduleName;
+   std::string fileName;
+   std::vector<uint8_t> fileData;
+   elf::Header header;
+   elf::FileInfo info;
+   SectionList sections;
+   void *loadSegAddr = nullptr;
+   SequentialMemoryTracker codeSeg { nullptr, 0 };
+   bool inflateFailed = false;
+   ModuleCacheKey cacheKey;
+   std::unique_ptr<CachedModule> cached;
+   std::vector<SectionInflateJob> cachedInflateJobs;
+};
+
+
+struct LoaderTimings
+{
+   std::chrono::steady_clock::duration read { 0 };
+   std::chrono::steady_clock::duration inflate { 0 };
+   std::chrono::steady_clock::duration link { 0 };
+   std::chrono::steady_clock::duration analyse { 0 };
+};
+
+using PendingModuleList = std::vector<std::unique_ptr<PendingModule>>;
+using SectionInflateJobList = std::vector<SectionInflateJob>;
+
+static LoadedModule *
+prepareModule(const std::string &name,
+              PendingModuleList &pendingModules,
+              SectionInflateJobList &inflateJobs);
+
+static void
+finaliseRPL(PendingModule &pending);
+
+
+static void
+runSectionInflateJob(SectionInflateJob &job)
+{
+   if (job.header->type == elf::SHT_NOBITS) {
+      std::memset(job.dst, 0, job.size);
+      job.result = 0;
+   } else {
+      job.result = elf::readSectionData(job.pending->fileData.data(), *job.header, job.dst, job.size);
+   }
+}
+
+
+static const uint32_t
+InflateBytesPerThread = 1024 * 1024;
+
+static unsigned
+getLoaderThreadCount()
+{
+   auto numThreads = decaf::config::system::loader_threads;
+
+   if (numThreads == 0) {
+      numThreads = std::max(1u, std::thread::hardware_concurrency());
+   }
+
+   return numThreads;
+}
+
+
+// Inflate all queued sections straight into their final destination using a
+// pool of worker threads, the calling thread participates as a worker too.
+// Each extra thread must have at least InflateBytesPerThread to inflate, so
+// the small loads of a running game are inflated inline.
+static unsigned
+runSectionInflateJobs(SectionInflateJobList &jobs)
+{
+   auto totalSize = uint64_t { 0 };
+
+   for (auto &job : jobs) {
+      totalSize += job.size;
+   }
+
+   auto numThreads = std::min<unsigned>(getLoaderThreadCount(), static_cast<unsigned>(jobs.size()));
+   numThreads = static_cast<unsigned>(std::min<uint64_t>(numThreads, totalSize / InflateBytesPerThread));
+
+   std::atomic<size_t> nextJob { 0 };
+   auto worker = [&]() {
+      for (auto i = nextJob++; i < jobs.size(); i = nextJob++) {
+         runSectionInflateJob(jobs[i]);
+      }
+   };
+
+   auto threads = std::vector<std::thread> {};
+
+   for (auto i = 1u; i < numThreads; ++i) {
+      threads.emplace_back(worker);
+   }
+
+   worker();
+
+   for (auto &thread : threads) {
+      thread.join();
+   }
+
+   for (auto &job : jobs) {
+      if (job.result != 0) {
+         gLog->error("Couldn't decompress section of {} because inflate returned {}", job.pending->fileName, job.result);
+         job.pending->inflateFailed = true;
+      }
+   }
+
+   return std::max(1u, numThreads);
+}
+
+
+// Parse the elf headers, allocate memory for all sections and queue their
+// data to be inflated, then recursively prepare any imported modules.
+static LoadedModule *
+prepareRPL(PendingModule &pending,
+           PendingModuleList &pendingModules,
+           SectionInflateJobList &inflateJobs)
 {
-   std::vector<uint8_t> buffer;
-   auto in = BigEndianView{ data };
+   auto in = BigEndianView{ gsl::as_span(pending.fileData) };
    auto loadedMod = new LoadedModule();
-   loadedMod->name = name;
-   gLoadedModules.emplace(moduleName, loadedMod);
+   loadedMod->name = pending.fileName;
+   pending.module = loadedMod;
+   gLoadedModules.emplace(pending.moduleName, loadedMod);
 
-   gLog->debug("Loading module {}", moduleName);
+   gLog->debug("Loading module {}", pending.moduleName);
 
    // Read header
-   auto header = elf::Header{};
+   auto &header = pending.header;
 
    if (!elf::readHeader(in, header)) {
       gLog->error("Failed elf::readHeader");
@@ -939,7 +1094,7 @@ loadRPL(const std::string &moduleName,
    }
 
    // Read sections
-   auto sections = std::vector<elf::XSection>{};
+   auto &sections = pending.sections;
 
    if (!elf::readSectionHeaders(in, header, sections)) {
       gLog->error("Failed elf::readSectionHeaders");
@@ -948,7 +1103,7 @@ loadRPL(const std::string &moduleName,
 
    // Allocate memory segments for load / code / data
    void *codeSegAddr, *loadSegAddr, *dataSegAddr;
-   elf::FileInfo info;
+   auto &info = pending.info;
 
    readFileInfo(in, sections, info);
 
@@ -965,7 +1120,18 @@ loadRPL(const std::string &moduleName,
    decaf_check(dataSegAddr);
    decaf_check(loadSegAddr);
 
-   auto codeSeg = SequentialMemoryTracker{ codeSegAddr, info.textSize };
+   pending.loadSegAddr = loadSegAddr;
+   pending.codeSeg = SequentialMemoryTracker{ codeSegAddr, info.textSize };
+   loadedMod->codeBase = mem::untranslate(codeSegAddr);
+   loadedMod->dataBase = mem::untranslate(dataSegAddr);
+
+   // Apparently info.tlsModuleIndex is always zero... so let's create our own!
+   decaf_check(info.tlsModuleIndex == 0);
+   loadedMod->tlsModuleIndex = sModuleIndex++;
+   loadedMod->tlsAlignShift = info.tlsAlignShift;
+
+   auto sectionJobs = SectionInflateJobList {};
+   auto &codeSeg = pending.codeSeg;
    auto dataSeg = SequentialMemoryTracker{ dataSegAddr, info.dataSize };
    auto loadSeg = SequentialMemoryTracker{ loadSegAddr, info.loadSize };
 
@@ -973,13 +1139,12 @@ loadRPL(const std::string &moduleName,
    for (auto &section : sections) {
       if (section.header.flags & elf::SHF_ALLOC) {
          void *allocData = nullptr;
+         auto size = section.header.size;
 
-         // Read the section data
-         if (section.header.type == elf::SHT_NOBITS) {
-            buffer.clear();
-            buffer.resize(section.header.size, 0);
-         } else {
-            if (!elf::readSectionData(in, section.header, buffer)) {
+         if (section.header.type != elf::SHT_NOBITS) {
+            size = elf::getSectionDataSize(in, section.header);
+
+            if (size == 0 && section.header.size != 0) {
                gLog->error("Failed to read section data");
                return nullptr;
             }
@@ -988,27 +1153,100 @@ loadRPL(const std::string &moduleName,
          // Allocate from correct memory segment
          if (section.header.type == elf::SHT_PROGBITS || section.header.type == elf::SHT_NOBITS) {
             if (section.header.flags & elf::SHF_EXECINSTR) {
-               allocData = codeSeg.get(buffer.size(), section.header.addralign);
+               allocData = codeSeg.get(size, section.header.addralign);
             } else {
-               allocData = dataSeg.get(buffer.size(), section.header.addralign);
+               allocData = dataSeg.get(size, section.header.addralign);
             }
          } else {
-            allocData = loadSeg.get(buffer.size(), section.header.addralign);
+            allocData = loadSeg.get(size, section.header.addralign);
          }
 
-         memcpy(allocData, buffer.data(), buffer.size());
          section.memory = reinterpret_cast<uint8_t*>(allocData);
          section.virtAddress = mem::untranslate(allocData);
-         section.virtSize = static_cast<uint32_t>(buffer.size());
+         section.virtSize = size;
+
+         auto job = SectionInflateJob { &pending, &section.header, section.memory, size, 0 };
+
+         if (section.header.type == elf::SHT_RPL_IMPORTS) {
+            // We need the import library names now to find our dependencies
+            runSectionInflateJob(job);
+
+            if (job.result != 0) {
+               gLog->error("Couldn't decompress import section because inflate returned {}", job.result);
+               return nullptr;
+            }
+         } else {
+            sectionJobs.emplace_back(job);
+         }
       }
    }
 
+   // Prepare our imports so their sections are inflated alongside our own
+   auto importLayouts = std::vector<ImportedModuleLayout> {};
+
+   for (auto &section : sections) {
+      if (section.header.type == elf::SHT_RPL_IMPORTS && section.virtSize > 8) {
+         auto libraryName = reinterpret_cast<const char *>(section.memory + 8);
+         auto importMod = prepareModule(libraryName, pendingModules, inflateJobs);
+         auto layout = ImportedModuleLayout { 0, 0, 0 };
+
+         if (importMod) {
+            layout.tlsModuleIndex = importMod->tlsModuleIndex;
+            layout.codeAddr = importMod->codeBase;
+            layout.dataAddr = importMod->dataBase;
+         }
+
+         importLayouts.push_back(layout);
+      }
+   }
+
+   // Check for a prelinked image of this module at this exact memory layout,
+   // which includes where our imports were loaded and their TLS indices
+   if (isModuleCacheEnabled()) {
+      pending.cacheKey = makeModuleCacheKey(pending.fileData,
+                                            mem::untranslate(codeSegAddr), info.textSize,
+                                            mem::untranslate(dataSegAddr), info.dataSize,
+                                            mem::untranslate(loadSegAddr),
+                                            loadedMod->tlsModuleIndex,
+                                            sSyscallAddress,
+                                            importLayouts);
+
+      auto cached = std::make_unique<CachedModule>();
+
+      if (readCachedModule(pending.cacheKey, *cached)) {
+         pending.cached = std::move(cached);
+      }
+   }
+
+   if (pending.cached) {
+      // Only needed if the cached image turns out to be stale
+      pending.cachedInflateJobs = std::move(sectionJobs);
+   } else {
+      inflateJobs.insert(inflateJobs.end(), sectionJobs.begin(), sectionJobs.end());
+   }
+
+   return loadedMod;
+}
+
+
+// Link an RPL whose section data has been inflated and whose imports have
+// had their exports processed.
+static bool
+linkRPL(PendingModule &pending)
+{
+   auto loadedMod = pending.module;
+   auto &header = pending.header;
+   auto &info = pending.info;
+   auto &sections = pending.sections;
+   auto &codeSeg = pending.codeSeg;
+   auto in = BigEndianView{ gsl::as_span(pending.fileData) };
+
    // Read strtab
    auto shStrTab = reinterpret_cast<const char*>(sections[header.shstrndx].memory);
 
    if (!shStrTab) {
       gLog->error("Section name table missing");
-      return nullptr;
+      return false;
    }
 
    for (auto &section : sections) {
@@ -1055,27 +1293,18 @@ loadRPL(const std::string &moduleName,
       loadedMod->tlsSize = end - start;
    }
 
-   // Apparently info.tlsModuleIndex is always zero... so let's create our own!
-   decaf_check(info.tlsModuleIndex == 0);
-   loadedMod->tlsModuleIndex = sModuleIndex++;
-   loadedMod->tlsAlignShift = info.tlsAlignShift;
-
-   // Process exports
-   if (!processExports(loadedMod, sections)) {
-      gLog->error("Error loading exports");
-      return nullptr;
-   }
-
    // Process imports
-   if (!processImports(loadedMod, sections)) {
+   auto resolvedImports = std::vector<CachedImport> {};
+
+   if (!processImports(loadedMod, sections, isModuleCacheEnabled() ? &resolvedImports : nullptr)) {
       gLog->error("Error loading imports");
-      return nullptr;
+      return false;
    }
 
    // Process symbols
    if (!processSymbols(loadedMod, sections)) {
       gLog->error("Error loading symbols");
-      return nullptr;
+      return false;
    }
 
    // Process relocations
@@ -1083,7 +1312,7 @@ loadRPL(const std::string &moduleName,
 
    if (!processRelocations(loadedMod, sections, in, shStrTab, codeSeg, trampSeg)) {
       gLog->error("Error loading relocations");
-      return nullptr;
+      return false;
    }
 
    // Process dot syscall
@@ -1127,9 +1356,173 @@ loadRPL(const std::string &moduleName,
 
    // Add the modules entry point as an symbol called 'start'
    loadedMod->symbols.emplace("__start", Symbol{ entryPoint, SymbolType::Function });
+   loadedMod->defaultStackSize = info.stackSize;
+   loadedMod->entryPoint = entryPoint;
+
+   if (isModuleCacheEnabled()) {
+      writeCachedModule(pending.cacheKey, loadedMod, resolvedImports);
+   }
+
+   finaliseRPL(pending);
+   return true;
+}
+
+
+// Find the address an import of a prelinked image resolves to now, returns
+// false if it is unimplemented and does not have a thunk yet.
+static bool
+findCachedImportAddress(const CachedImport &import,
+                        ppcaddr_t &address)
+{
+   auto linkedModule = loadRPLNoLock(import.module);
+   address = linkedModule ? linkedModule->findExport(import.name) : 0u;
+
+   if (address) {
+      return true;
+   }
+
+   if (import.type == elf::STT_FUNC) {
+      auto itr = gUnimplementedFunctions.find(import.name);
+
+      if (itr == gUnimplementedFunctions.end()) {
+         return false;
+      }
+
+      address = itr->second;
+   } else if (import.type == elf::STT_OBJECT) {
+      auto itr = gUnimplementedData.find(import.name);
+
+      if (itr == gUnimplementedData.end()) {
+         return false;
+      }
+
+      address = itr->second | 0x800;
+   }
+
+   return true;
+}
+
+
+// Returns false if any of the symbols a prelinked image imports now resolve
+// to a different address.
+static bool
+isCachedImportListCurrent(PendingModule &pending)
+{
+   auto &cached = *pending.cached;
+   auto unimplemented = std::vector<const CachedImport *> {};
+
+   for (auto &import : cached.imports) {
+      auto symbolAddr = ppcaddr_t { 0 };
+
+      if (!findCachedImportAddress(import, symbolAddr)) {
+         unimplemented.push_back(&import);
+         continue;
+      }
+
+      if (symbolAddr != import.address) {
+         gLog->debug("Prelinked image for {} is stale, import {}::{} moved from {:08x} to {:08x}",
+                     pending.fileName, import.module, import.name, import.address, symbolAddr);
+         return false;
+      }
+   }
+
+   // Linking the module ourselves would create these same thunks, so only
+   // create them once everything else is known to match.
+   for (auto import : unimplemented) {
+      auto symbolAddr = ppcaddr_t { 0 };
+
+      if (import->type == elf::STT_FUNC) {
+         symbolAddr = generateUnimplementedFunctionThunk(import->module, import->name);
+      } else {
+         symbolAddr = generateUnimplementedDataThunk(import->module, import->name);
+      }
+
+      if (symbolAddr != import->address) {
+         gLog->debug("Prelinked image for {} is stale, thunk for {}::{} moved from {:08x} to {:08x}",
+                     pending.fileName, import->module, import->name, import->address, symbolAddr);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+// Check every prelinked image against the current exports of its imports.
+// A stale module is inflated and has its exports processed for real, which
+// can in turn make the images of modules importing from it stale.
+static void
+checkCachedModules(PendingModuleList &pendingModules)
+{
+   auto changed = true;
+
+   while (changed) {
+      changed = false;
+
+      for (auto &pending : pendingModules) {
+         if (!pending->module || !pending->cached) {
+            continue;
+         }
+
+         if (isCachedImportListCurrent(*pending)) {
+            if (readCachedModuleImage(*pending->cached)) {
+               continue;
+            }
+
+            gLog->warn("Failed to read prelinked image for {}", pending->fileName);
+         }
+
+         // Fall back to inflating and linking the module ourselves
+         changed = true;
+         pending->cached.reset();
+         pending->module->exports.clear();
+
+         for (auto &job : pending->cachedInflateJobs) {
+            runSectionInflateJob(job);
+            pending->inflateFailed |= (job.result != 0);
+         }
+
+         if (pending->inflateFailed || !processExports(pending->module, pending->sections)) {
+            gLog->error("Failed to load module {}", pending->fileName);
+            gLoadedModules.erase(pending->moduleName);
+            pending->module = nullptr;
+         }
+      }
+   }
+}
+
+
+// Restore a module from its prelinked image, which checkCachedModules has
+// already verified and read into memory.
+static void
+linkCachedRPL(PendingModule &pending)
+{
+   auto loadedMod = pending.module;
+   auto &cached = *pending.cached;
+
+   loadedMod->entryPoint = cached.entryPoint;
+   loadedMod->defaultStackSize = cached.defaultStackSize;
+   loadedMod->sdaBase = cached.sdaBase;
+   loadedMod->sda2Base = cached.sda2Base;
+   loadedMod->tlsBase = cached.tlsBase;
+   loadedMod->tlsAlignShift = cached.tlsAlignShift;
+   loadedMod->tlsSize = cached.tlsSize;
+   loadedMod->sections = cached.sections;
+   loadedMod->symbols = cached.symbols;
+
+   finaliseRPL(pending);
+}
+
+
+// Release loader memory and publish a linked module
+static void
+finaliseRPL(PendingModule &pending)
+{
+   auto loadedMod = pending.module;
 
    // Free the load segment
-   loaderFree(loadSegAddr);
+   loaderFree(pending.loadSegAddr);
+   pending.loadSegAddr = nullptr;
 
    // Add all the modules symbols to the Global Symbol Map
    for (auto &i : loadedMod->symbols) {
@@ -1142,12 +1535,50 @@ loadRPL(const std::string &moduleName,
       }
    }
 
-   loadedMod->defaultStackSize = info.stackSize;
-   loadedMod->entryPoint = entryPoint;
+   sSymbolGeneration++;
+
    loadedMod->handle = coreinit::internal::sysAlloc<LoadedModuleHandleData>();
    loadedMod->handle->ptr = loadedMod;
+}
 
-   return loadedMod;
+
+// Find the functions and branch targets of all newly loaded code, these are
+// shared by the JIT and the debugger.
+static void
+analyseModules(const PendingModuleList &pendingModules,
+               unsigned numThreads)
+{
+   auto regions = std::vector<cpu::analysis::CodeRegionInfo> {};
+
+   for (auto &pending : pendingModules) {
+      auto module = pending->module;
+
+      if (!module) {
+         continue;
+      }
+
+      for (auto &section : module->sections) {
+         if (section.type != LoadedSectionType::Code || section.end <= section.start) {
+            continue;
+         }
+
+         auto region = cpu::analysis::CodeRegionInfo { section.start, section.end, {} };
+
+         if (module->entryPoint) {
+            region.entryPoints.push_back(module->entryPoint);
+         }
+
+         for (auto &symbol : module->symbols) {
+            if (symbol.second.type == SymbolType::Function) {
+               region.entryPoints.push_back(symbol.second.address);
+            }
+         }
+
+         regions.emplace_back(std::move(region));
+      }
+   }
+
+   cpu::analysis::addRegions(regions, numThreads);
 }
 
 static void
@@ -1164,8 +1595,12 @@ normalizeModuleName(const std::string &name,
    }
 }
 
-LoadedModule *
-loadRPLNoLock(const std::string &name)
+// Find a module which is already loaded, load it if it is a HLE module, or
+// read it from the game code directory and queue it up to be linked.
+static LoadedModule *
+prepareModule(const std::string &name,
+              PendingModuleList &pendingModules,
+              SectionInflateJobList &inflateJobs)
 {
    LoadedModule *module = nullptr;
    std::string moduleName;
@@ -1195,22 +1630,119 @@ loadRPLNoLock(const std::string &name)
       auto fh = fs->openFile("/vol/code/" + fileName, fs::File::Read);
 
       if (fh) {
-         auto buffer = std::vector<uint8_t>(fh->size());
-         fh->read(buffer.data(), buffer.size(), 1);
+         pendingModules.emplace_back(std::make_unique<PendingModule>());
+         auto &pending = *pendingModules.back();
+         pending.moduleName = moduleName;
+         pending.fileName = fileName;
+         pending.fileData.resize(fh->size());
+         fh->read(pending.fileData.data(), pending.fileData.size(), 1);
          fh->close();
 
-         module = loadRPL(moduleName, fileName, buffer);
+         module = prepareRPL(pending, pendingModules, inflateJobs);
+
+         if (!module) {
+            pending.module = nullptr;
+         }
       }
    }
 
    if (!module) {
       gLog->error("Failed to load module {}", fileName);
       gLoadedModules.erase(moduleName);
-      return nullptr;
-   } else {
-      gLog->info("Loaded module {}", fileName);
+   }
+
+   return module;
+}
+
+LoadedModule *
+loadRPLNoLock(const std::string &name)
+{
+   auto pendingModules = PendingModuleList {};
+   auto inflateJobs = SectionInflateJobList {};
+   auto timings = LoaderTimings {};
+   auto phaseStart = std::chrono::steady_clock::now();
+
+   // Read all not yet loaded modules in our dependency tree
+   auto module = prepareModule(name, pendingModules, inflateJobs);
+
+   if (pendingModules.empty()) {
       return module;
    }
+
+   auto now = std::chrono::steady_clock::now();
+   timings.read = now - phaseStart;
+   phaseStart = now;
+
+   // Inflate all their sections in parallel
+   auto numThreads = runSectionInflateJobs(inflateJobs);
+
+   now = std::chrono::steady_clock::now();
+   timings.inflate = now - phaseStart;
+   phaseStart = now;
+
+   // Process exports for every module first so imports can be resolved in
+   // any order, including cyclic dependencies
+   for (auto &pending : pendingModules) {
+      if (!pending->module) {
+         continue;
+      }
+
+      if (pending->cached) {
+         pending->module->exports = pending->cached->exports;
+         continue;
+      }
+
+      if (pending->inflateFailed || !processExports(pending->module, pending->sections)) {
+         gLog->error("Error loading exports");
+         gLog->error("Failed to load module {}", pending->fileName);
+         gLoadedModules.erase(pending->moduleName);
+         pending->module = nullptr;
+      }
+   }
+
+   checkCachedModules(pendingModules);
+
+   // Now link every module
+   for (auto &pending : pendingModules) {
+      if (!pending->module) {
+         continue;
+      }
+
+      if (pending->cached) {
+         linkCachedRPL(*pending);
+         gLog->info("Loaded module {} from prelinked image", pending->fileName);
+         continue;
+      }
+
+      if (!linkRPL(*pending)) {
+         gLog->error("Failed to load module {}", pending->fileName);
+         gLoadedModules.erase(pending->moduleName);
+         pending->module = nullptr;
+         continue;
+      }
+
+      gLog->info("Loaded module {}", pending->fileName);
+   }
+
+   now = std::chrono::steady_clock::now();
+   timings.link = now - phaseStart;
+   phaseStart = now;
+
+   analyseModules(pendingModules, getLoaderThreadCount());
+   timings.analyse = std::chrono::steady_clock::now() - phaseStart;
+
+   gLog->info("Loaded {} modules in {}ms: read {}ms, inflate {}ms ({} sections on {} threads), link {}ms, analyse {}ms",
+              pendingModules.size(),
+              std::chrono::duration_cast<std::chrono::milliseconds>(timings.read + timings.inflate + timings.link + timings.analyse).count(),
+              std::chrono::duration_cast<std::chrono::milliseconds>(timings.read).count(),
+              std::chrono::duration_cast<std::chrono::milliseconds>(timings.inflate).count(),
+              inflateJobs.size(),
+              numThreads,
+              std::chrono::duration_cast<std::chrono::milliseconds>(timings.link).count(),
+              std::chrono::duration_cast<std::chrono::milliseconds>(timings.analyse).count());
+
+   // The root module is always the first one queued when it came from a file
+   return pendingModules.front()->module;
 }
 
 LoadedModule *
@@ -1289,6 +1821,23 @@ findNearestSymbolNameForAddress(ppcaddr_t address)
    }
 }
 
+std::string *
+findContainingSymbolNameForAddress(ppcaddr_t address,
+                                   ppcaddr_t *symbolAddress)
+{
+   auto symIter = gGlobalSymbolLookup.lower_bound(address);
+
+   if (symIter == gGlobalSymbolLookup.end()) {
+      return nullptr;
+   }
+
+   if (symbolAddress) {
+      *symbolAddress = symIter->first;
+   }
+
+   return &symIter->second;
+}
+
 } // namespace loader
 
 } // namespace kernel
@@ -118,6 +118,8 @@ struct LoadedModule
    ppcsize_t defaultStackSize = 0;
    ppcaddr_t sdaBase = 0;
    ppcaddr_t sda2Base = 0;
+   ppcaddr_t codeBase = 0;
+   ppcaddr_t dataBase = 0;
    uint32_t tlsModuleIndex = -1;
    ppcaddr_t tlsBase = 0;
    ppcsize_t tlsAlignShift = 0;
@@ -151,9 +153,21 @@ findSymbolNameForAddress(ppcaddr_t address);
 std::string
 findNearestSymbolNameForAddress(ppcaddr_t address);
 
+std::string *
+findContainingSymbolNameForAddress(ppcaddr_t address,
+                                   ppcaddr_t *symbolAddress = nullptr);
+
 std::map<std::string, LoadedModule*>
 getLoadedModules();
 
+//! True while a module is being loaded or its temporary memory is in use
+bool
+isLoading();
+
+//! Changes every time symbols are added, so cached symbol names can be dropped
+uint32_t
+getSymbolGeneration();
+
 } // namespace loader
 
 } // namespace kernel
@@ -0,0 +1,330 @@
+#include "kernel_loadercache.h"
+#include "common/log.h"
+#include "common/murmur3.h"
+#include "common/platform_dir.h"
+#include "decaf_config.h"
+#include "filesystem/filesystem.h"
+#include "libcpu/mem.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace kernel
+{
+
+namespace loader
+{
+
+static const uint32_t
+CacheFileMagic = 0x44504D43; // DPMC
+
+static const uint32_t
+CacheFileVersion = 2;
+
+#pragma pack(push, 1)
+
+struct CacheFileHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   ModuleCacheKey key;
+};
+
+#pragma pack(pop)
+
+static void
+writeValue(std::ofstream &out, uint32_t value)
+{
+   out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void
+writeString(std::ofstream &out, const std::string &value)
+{
+   writeValue(out, static_cast<uint32_t>(value.size()));
+   out.write(value.data(), value.size());
+}
+
+static bool
+readValue(std::ifstream &in, uint32_t &value)
+{
+   return !!in.read(reinterpret_cast<char *>(&value), sizeof(value));
+}
+
+static bool
+readString(std::ifstream &in, std::string &value)
+{
+   auto size = uint32_t { 0 };
+
+   if (!readValue(in, size)) {
+      return false;
+   }
+
+   value.resize(size);
+   return !!in.read(&value[0], size);
+}
+
+static std::string
+getCachePath(const ModuleCacheKey &key)
+{
+   auto name = fmt::format("{:016x}{:016x}_{:08x}_{:08x}.rplcache",
+                           key.hash[0], key.hash[1], key.codeAddr, key.dataAddr);
+
+   return fs::HostPath { decaf::config::system::loader_cache_path }
+      .join(name)
+      .path();
+}
+
+bool
+isModuleCacheEnabled()
+{
+   return !decaf::config::system::loader_cache_path.empty();
+}
+
+ModuleCacheKey
+makeModuleCacheKey(const std::vector<uint8_t> &fileData,
+                   ppcaddr_t codeAddr,
+                   uint32_t codeSize,
+                   ppcaddr_t dataAddr,
+                   uint32_t dataSize,
+                   ppcaddr_t loadAddr,
+                   uint32_t tlsModuleIndex,
+                   ppcaddr_t syscallAddress,
+                   const std::vector<ImportedModuleLayout> &imports)
+{
+   auto key = ModuleCacheKey {};
+   MurmurHash3_x64_128(fileData.data(), static_cast<int>(fileData.size()), 0, key.hash);
+   MurmurHash3_x64_128(imports.data(),
+                       static_cast<int>(imports.size() * sizeof(ImportedModuleLayout)),
+                       0, key.importsHash);
+   key.codeAddr = codeAddr;
+   key.codeSize = codeSize;
+   key.dataAddr = dataAddr;
+   key.dataSize = dataSize;
+   key.loadAddr = loadAddr;
+   key.tlsModuleIndex = tlsModuleIndex;
+   key.syscallAddress = syscallAddress;
+   return key;
+}
+
+
+// Read everything but the code and data images from the cache
+bool
+readCachedModule(const ModuleCacheKey &key,
+                 CachedModule &cached)
+{
+   auto path = getCachePath(key);
+   std::ifstream in { path, std::ifstream::binary };
+
+   if (!in.is_open()) {
+      return false;
+   }
+
+   auto header = CacheFileHeader {};
+
+   if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+      return false;
+   }
+
+   if (header.magic != CacheFileMagic
+    || header.version != CacheFileVersion
+    || std::memcmp(&header.key, &key, sizeof(ModuleCacheKey)) != 0) {
+      return false;
+   }
+
+   auto count = uint32_t { 0 };
+   cached.key = key;
+   cached.path = path;
+
+   if (!readValue(in, cached.entryPoint)
+    || !readValue(in, cached.defaultStackSize)
+    || !readValue(in, cached.sdaBase)
+    || !readValue(in, cached.sda2Base)
+    || !readValue(in, cached.tlsBase)
+    || !readValue(in, cached.tlsAlignShift)
+    || !readValue(in, cached.tlsSize)) {
+      return false;
+   }
+
+   if (!readValue(in, count)) {
+      return false;
+   }
+
+   for (auto i = 0u; i < count; ++i) {
+      auto section = LoadedSection {};
+      auto type = uint32_t { 0 };
+
+      if (!readString(in, section.name)
+       || !readValue(in, type)
+       || !readValue(in, section.start)
+       || !readValue(in, section.end)) {
+         return false;
+      }
+
+      section.type = static_cast<LoadedSectionType>(type);
+      cached.sections.emplace_back(section);
+   }
+
+   if (!readValue(in, count)) {
+      return false;
+   }
+
+   for (auto i = 0u; i < count; ++i) {
+      auto name = std::string {};
+      auto addr = ppcaddr_t { 0 };
+
+      if (!readString(in, name) || !readValue(in, addr)) {
+         return false;
+      }
+
+      cached.exports.emplace(name, addr);
+   }
+
+   if (!readValue(in, count)) {
+      return false;
+   }
+
+   for (auto i = 0u; i < count; ++i) {
+      auto name = std::string {};
+      auto symbol = Symbol {};
+      auto type = uint32_t { 0 };
+
+      if (!readString(in, name)
+       || !readValue(in, symbol.address)
+       || !readValue(in, type)) {
+         return false;
+      }
+
+      symbol.type = static_cast<SymbolType>(type);
+      cached.symbols.emplace(name, symbol);
+   }
+
+   if (!readValue(in, count)) {
+      return false;
+   }
+
+   for (auto i = 0u; i < count; ++i) {
+      auto import = CachedImport {};
+
+      if (!readString(in, import.module)
+       || !readString(in, import.name)
+       || !readValue(in, import.type)
+       || !readValue(in, import.address)) {
+         return false;
+      }
+
+      cached.imports.emplace_back(import);
+   }
+
+   cached.imageOffset = static_cast<uint64_t>(in.tellg());
+   return true;
+}
+
+
+// Read the prelinked code and data images directly into guest memory
+bool
+readCachedModuleImage(const CachedModule &cached)
+{
+   std::ifstream in { cached.path, std::ifstream::binary };
+
+   if (!in.is_open()) {
+      return false;
+   }
+
+   in.seekg(cached.imageOffset);
+   in.read(reinterpret_cast<char *>(mem::translate(cached.key.codeAddr)), cached.key.codeSize);
+   in.read(reinterpret_cast<char *>(mem::translate(cached.key.dataAddr)), cached.key.dataSize);
+   return !!in;
+}
+
+
+bool
+writeCachedModule(const ModuleCacheKey &key,
+                  const LoadedModule *module,
+                  const std::vector<CachedImport> &imports)
+{
+   // Written to a temporary file which is renamed into place once complete,
+   // so a crash or a full disk never leaves a truncated entry behind
+   auto path = getCachePath(key);
+   auto tempPath = path + ".tmp";
+   platform::createParentDirectories(path);
+
+   std::ofstream out { tempPath, std::ofstream::binary };
+
+   if (!out.is_open()) {
+      gLog->warn("Could not open module cache file {} for writing", tempPath);
+      return false;
+   }
+
+   auto header = CacheFileHeader {};
+   header.magic = CacheFileMagic;
+   header.version = CacheFileVersion;
+   header.key = key;
+   out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+   writeValue(out, module->entryPoint);
+   writeValue(out, module->defaultStackSize);
+   writeValue(out, module->sdaBase);
+   writeValue(out, module->sda2Base);
+   writeValue(out, module->tlsBase);
+   writeValue(out, module->tlsAlignShift);
+   writeValue(out, module->tlsSize);
+
+   writeValue(out, static_cast<uint32_t>(module->sections.size()));
+
+   for (auto &section : module->sections) {
+      writeString(out, section.name);
+      writeValue(out, static_cast<uint32_t>(section.type));
+      writeValue(out, section.start);
+      writeValue(out, section.end);
+   }
+
+   writeValue(out, static_cast<uint32_t>(module->exports.size()));
+
+   for (auto &exp : module->exports) {
+      writeString(out, exp.first);
+      writeValue(out, exp.second);
+   }
+
+   writeValue(out, static_cast<uint32_t>(module->symbols.size()));
+
+   for (auto &sym : module->symbols) {
+      writeString(out, sym.first);
+      writeValue(out, sym.second.address);
+      writeValue(out, static_cast<uint32_t>(sym.second.type));
+   }
+
+   writeValue(out, static_cast<uint32_t>(imports.size()));
+
+   for (auto &import : imports) {
+      writeString(out, import.module);
+      writeString(out, import.name);
+      writeValue(out, import.type);
+      writeValue(out, import.address);
+   }
+
+   out.write(reinterpret_cast<const char *>(mem::translate(key.codeAddr)), key.codeSize);
+   out.write(reinterpret_cast<const char *>(mem::translate(key.dataAddr)), key.dataSize);
+   out.close();
+
+   if (!out) {
+      gLog->warn("Could not write module cache file {}", tempPath);
+      std::remove(tempPath.c_str());
+      return false;
+   }
+
+   // rename does not replace an existing file on Windows
+   std::remove(path.c_str());
+
+   if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+      gLog->warn("Could not rename {} to {}", tempPath, path);
+      std::remove(tempPath.c_str());
+      return false;
+   }
+
+   return true;
+}
+
+} // namespace loader
+
+} // namespace kernel
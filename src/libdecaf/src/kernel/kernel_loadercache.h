@@ -0,0 +1,103 @@
+#pragma once
+#include "kernel_loader.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kernel
+{
+
+namespace loader
+{
+
+/**
+ * Where an imported module was loaded, R_PPC_DTPMOD32 relocations resolve to
+ * its TLS module index.
+ */
+struct ImportedModuleLayout
+{
+   uint32_t tlsModuleIndex;
+   ppcaddr_t codeAddr;
+   ppcaddr_t dataAddr;
+};
+
+/**
+ * A prelinked module image is only valid when the module is loaded from the
+ * exact same file into the exact same memory layout, with its imports loaded
+ * at the same addresses too.
+ */
+struct ModuleCacheKey
+{
+   uint64_t hash[2];
+   uint64_t importsHash[2];
+   ppcaddr_t codeAddr;
+   uint32_t codeSize;
+   ppcaddr_t dataAddr;
+   uint32_t dataSize;
+   ppcaddr_t loadAddr;
+   uint32_t tlsModuleIndex;
+   ppcaddr_t syscallAddress;
+   uint32_t pad;
+};
+
+/**
+ * A symbol imported by a module and the address it was resolved to, used to
+ * verify the imported modules have not moved since the image was cached.
+ */
+struct CachedImport
+{
+   std::string module;
+   std::string name;
+   uint32_t type;
+   ppcaddr_t address;
+};
+
+struct CachedModule
+{
+   ModuleCacheKey key;
+   ppcaddr_t entryPoint;
+   ppcsize_t defaultStackSize;
+   ppcaddr_t sdaBase;
+   ppcaddr_t sda2Base;
+   ppcaddr_t tlsBase;
+   ppcsize_t tlsAlignShift;
+   ppcsize_t tlsSize;
+   std::vector<LoadedSection> sections;
+   std::map<std::string, ppcaddr_t> exports;
+   std::map<std::string, Symbol> symbols;
+   std::vector<CachedImport> imports;
+
+   //! Where the code and data images are stored
+   std::string path;
+   uint64_t imageOffset;
+};
+
+bool
+isModuleCacheEnabled();
+
+ModuleCacheKey
+makeModuleCacheKey(const std::vector<uint8_t> &fileData,
+                   ppcaddr_t codeAddr,
+                   uint32_t codeSize,
+                   ppcaddr_t dataAddr,
+                   uint32_t dataSize,
+                   ppcaddr_t loadAddr,
+                   uint32_t tlsModuleIndex,
+                   ppcaddr_t syscallAddress,
+                   const std::vector<ImportedModuleLayout> &imports);
+
+bool
+readCachedModule(const ModuleCacheKey &key,
+                 CachedModule &cached);
+
+bool
+readCachedModuleImage(const CachedModule &cached);
+
+bool
+writeCachedModule(const ModuleCacheKey &key,
+                  const LoadedModule *module,
+                  const std::vector<CachedImport> &imports);
+
+} // namespace loader
+
+} // namespace kernel
@@ -1,5 +1,6 @@
 #include "common/decaf_assert.h"
 #include "kernel_memory.h"
+#include "kernel_snapshot.h"
 #include "libcpu/mem.h"
 
 namespace kernel
@@ -16,6 +17,14 @@ initialiseCodeHeap(uint32_t size)
 {
    sCodeHeap = new TeenyHeap(mem::translate(mem::MEM2Base), size);
    sCodeHeapSize = size;
+
+   registerSnapshotState("code heap", []() -> SnapshotRestoreFunction {
+      auto state = sCodeHeap->saveState();
+
+      return [=]() {
+         sCodeHeap->restoreState(state);
+      };
+   });
 }
 
 TeenyHeap *
@@ -0,0 +1,1042 @@
+#include "kernel_replay.h"
+#include "common/decaf_assert.h"
+#include "common/log.h"
+#include "libcpu/cpu.h"
+#include "modules/coreinit/coreinit_scheduler.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <spdlog/fmt/fmt.h>
+#include <thread>
+#include <vector>
+
+namespace kernel
+{
+
+static const uint32_t
+ReplayCoreCount = 3;
+
+// Interrupts which can change what the guest does, anything else is handled
+//  as normal while recording or replaying.
+static const uint32_t
+ReplayInterruptFlags = cpu::GENERIC_INTERRUPT
+                     | cpu::ALARM_INTERRUPT
+                     | cpu::GPU_RETIRE_INTERRUPT
+                     | cpu::GPU_FLIP_INTERRUPT
+                     | cpu::FS_DONE_INTERRUPT;
+
+// How much a recording buffers before writing a chunk
+static const size_t
+ReplayChunkSize = 64 * 1024;
+
+// How long a replay waits for the other cores to catch up before giving up
+static const auto
+ReplayStallTimeout = std::chrono::seconds { 10 };
+
+// How long a recording holds an interrupt back from a thread which makes no
+//  kernel calls, such as one spinning on memory an interrupt callback writes,
+//  before giving it up to keep the game running.
+static const auto
+ReplayHoldTimeout = std::chrono::milliseconds { 100 };
+
+static const auto
+ReplayWatchdogInterval = std::chrono::milliseconds { 10 };
+
+static const size_t
+NoRecord = SIZE_MAX;
+
+enum class ReplayMode
+{
+   Off,
+   Record,
+   Replay,
+};
+
+struct ReplayOrderRecord
+{
+   ReplayOrderType type;
+   uint32_t core;
+   uint64_t kernelCalls;
+   uint32_t flags;
+};
+
+struct ReplayValueRecord
+{
+   ReplayChannel channel;
+   uint64_t value;
+};
+
+struct ReplayCore
+{
+   //! Kernel calls the core has made so far
+   std::atomic<uint64_t> kernelCalls;
+
+   //! Interrupts which may be handled now, while replaying only touched with
+   //  sMutex held
+   std::atomic<uint32_t> released;
+
+   //! Interrupts which came in between kernel calls while recording, the
+   //  watchdog may take them from another thread
+   std::atomic<uint32_t> held;
+
+   //! Last value on each channel, used for the deltas in the file
+   std::array<uint64_t, static_cast<size_t>(ReplayChannel::Max)> lastValue;
+
+   //! Kernel calls at the last interrupt, used for the deltas in the file
+   uint64_t lastInterruptCalls;
+
+   //! Values waiting to be written while recording
+   std::vector<uint8_t> values;
+   uint64_t valueCount;
+
+   //! Indices of this core's records in sOrder while replaying
+   std::vector<size_t> order;
+   size_t orderPosition;
+
+   std::vector<ReplayValueRecord> valueRecords;
+   size_t valuePosition;
+
+   //! Last time base read while replaying
+   std::atomic<uint64_t> lastTime;
+};
+
+static std::atomic<ReplayMode>
+sMode { ReplayMode::Off };
+
+static std::mutex
+sMutex;
+
+static std::condition_variable
+sCondition;
+
+static std::array<ReplayCore, ReplayCoreCount>
+sCores;
+
+static std::string
+sPath;
+
+static std::ofstream
+sFile;
+
+static std::thread
+sWatchdogThread;
+
+static bool
+sWatchdogRunning = false;
+
+//! Interrupts the watchdog had to let go of while recording
+static uint64_t
+sForcedReleases = 0;
+
+//! Order records waiting to be written while recording
+static std::vector<uint8_t>
+sOrderBuffer;
+
+static uint64_t
+sOrderCount = 0;
+
+static std::vector<ReplayOrderRecord>
+sOrder;
+
+//! Index in sOrder of the next thing to happen while replaying
+static size_t
+sCursor = 0;
+
+//! Whether the interrupt at sCursor has been raised on its core
+static bool
+sRaised = false;
+
+static const char *
+channelName(ReplayChannel channel)
+{
+   switch (channel) {
+   case ReplayChannel::TimeBase:
+      return "the time base";
+   case ReplayChannel::ClockBase:
+      return "the clock base";
+   case ReplayChannel::GpuRetiredTimeStamp:
+      return "the retired timestamp";
+   case ReplayChannel::GpuFlipCount:
+      return "the flip count";
+   case ReplayChannel::GpuLastFlip:
+      return "the last flip time";
+   case ReplayChannel::CommandBufferSize:
+      return "a command buffer size";
+   case ReplayChannel::Input:
+      return "input";
+   case ReplayChannel::GpuLastVsync:
+      return "the last vsync time";
+   default:
+      return "an unknown value";
+   }
+}
+
+static void
+writeVarint(std::vector<uint8_t> &buffer,
+            uint64_t value)
+{
+   while (value >= 0x80) {
+      buffer.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+   }
+
+   buffer.push_back(static_cast<uint8_t>(value));
+}
+
+static bool
+readVarint(const uint8_t *&pos,
+           const uint8_t *end,
+           uint64_t &value)
+{
+   value = 0;
+
+   for (auto shift = 0u; shift < 64; shift += 7) {
+      if (pos == end) {
+         return false;
+      }
+
+      auto byte = *pos++;
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+      if (!(byte & 0x80)) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+static uint64_t
+zigzagEncode(uint64_t delta)
+{
+   return (delta << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(delta) >> 63);
+}
+
+static uint64_t
+zigzagDecode(uint64_t value)
+{
+   return (value >> 1) ^ (0 - (value & 1));
+}
+
+static void
+resetCores()
+{
+   for (auto &core : sCores) {
+      core.kernelCalls.store(0);
+      core.released.store(0);
+      core.held.store(0);
+      core.lastValue.fill(0);
+      core.lastInterruptCalls = 0;
+      core.values.clear();
+      core.valueCount = 0;
+      core.order.clear();
+      core.orderPosition = 0;
+      core.valueRecords.clear();
+      core.valuePosition = 0;
+      core.lastTime.store(0);
+   }
+
+   sOrderBuffer.clear();
+   sOrderCount = 0;
+   sForcedReleases = 0;
+   sOrder.clear();
+   sCursor = 0;
+   sRaised = false;
+}
+
+// Must be called with sMutex held
+static void
+writeChunk(ReplayChunkType type,
+           uint32_t core,
+           std::vector<uint8_t> &buffer)
+{
+   if (buffer.empty()) {
+      return;
+   }
+
+   auto chunk = ReplayChunk { type, core, static_cast<uint32_t>(buffer.size()) };
+   sFile.write(reinterpret_cast<const char *>(&chunk), sizeof(ReplayChunk));
+   sFile.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+   buffer.clear();
+}
+
+static void
+recordOrder(ReplayOrderType type,
+            uint32_t coreId,
+            uint32_t flags)
+{
+   decaf_check(coreId < ReplayCoreCount);
+   std::unique_lock<std::mutex> lock { sMutex };
+
+   if (sMode.load() != ReplayMode::Record) {
+      return;
+   }
+
+   auto &core = sCores[coreId];
+   sOrderBuffer.push_back(static_cast<uint8_t>(static_cast<uint8_t>(type) | (coreId << 4)));
+
+   if (type == ReplayOrderType::Interrupt) {
+      auto calls = core.kernelCalls.load(std::memory_order_relaxed);
+      writeVarint(sOrderBuffer, calls - core.lastInterruptCalls);
+      writeVarint(sOrderBuffer, flags);
+      core.lastInterruptCalls = calls;
+   }
+
+   sOrderCount++;
+
+   if (sOrderBuffer.size() >= ReplayChunkSize) {
+      writeChunk(ReplayChunkType::Order, 0, sOrderBuffer);
+   }
+}
+
+// Only ever called from the core itself, so the core's buffer needs no lock
+static void
+recordValue(uint32_t coreId,
+            ReplayChannel channel,
+            uint64_t value)
+{
+   auto &core = sCores[coreId];
+   auto &last = core.lastValue[static_cast<size_t>(channel)];
+   core.values.push_back(static_cast<uint8_t>(channel));
+   writeVarint(core.values, zigzagEncode(value - last));
+   core.valueCount++;
+   last = value;
+
+   if (core.values.size() >= ReplayChunkSize) {
+      std::unique_lock<std::mutex> lock { sMutex };
+      writeChunk(ReplayChunkType::Values, coreId, core.values);
+   }
+}
+
+// Lets the game carry on in real time from wherever the replay got to, must
+//  be called with sMutex held
+static void
+stopReplaying(bool diverged,
+              const std::string &reason)
+{
+   if (sMode.load() != ReplayMode::Replay) {
+      return;
+   }
+
+   sMode.store(ReplayMode::Off);
+
+   if (diverged) {
+      gLog->error("Replay diverged at record {} of {}, {}", sCursor, sOrder.size(), reason);
+   } else {
+      gLog->info("Replay stopped at record {} of {}, {}", sCursor, sOrder.size(), reason);
+   }
+
+   gLog->info("Continuing in real time");
+
+   // Guest time comes from the host again, it must not go backwards
+   auto time = uint64_t { 0 };
+
+   for (auto &core : sCores) {
+      time = std::max(time, core.lastTime.load());
+   }
+
+   cpu::advanceTimeBase(time);
+
+   // Real interrupts were dropped while replaying, every handler copes with
+   //  being called when there is nothing to do.
+   for (auto i = 0u; i < ReplayCoreCount; ++i) {
+      cpu::interrupt(i, ReplayInterruptFlags);
+   }
+
+   sCondition.notify_all();
+}
+
+static size_t
+nextOrder(ReplayCore &core)
+{
+   if (core.orderPosition == core.order.size()) {
+      return NoRecord;
+   }
+
+   return core.order[core.orderPosition];
+}
+
+// Raises the interrupt at the cursor if its core has got to the kernel call
+//  it was taken after, must be called with sMutex held
+static void
+raiseNextInterrupt()
+{
+   auto &record = sOrder[sCursor];
+
+   if (record.type != ReplayOrderType::Interrupt || sRaised) {
+      return;
+   }
+
+   auto &core = sCores[record.core];
+
+   if (core.kernelCalls.load(std::memory_order_acquire) != record.kernelCalls) {
+      return;
+   }
+
+   sRaised = true;
+   core.released.fetch_or(record.flags);
+   cpu::interrupt(record.core, record.flags);
+}
+
+// Must be called with sMutex held, by the core which owns the record at the
+//  cursor
+static void
+advanceOrder()
+{
+   sCores[sOrder[sCursor].core].orderPosition++;
+   sCursor++;
+   sRaised = false;
+
+   if (sCursor == sOrder.size()) {
+      stopReplaying(false, "the end of the recording");
+      return;
+   }
+
+   raiseNextInterrupt();
+   sCondition.notify_all();
+}
+
+static bool
+waitUntil(std::unique_lock<std::mutex> &lock,
+          std::chrono::steady_clock::time_point deadline,
+          uint32_t coreId,
+          const char *what)
+{
+   if (sCondition.wait_until(lock, deadline) == std::cv_status::timeout) {
+      stopReplaying(true, fmt::format("core {} gave up waiting for {}", coreId, what));
+      return false;
+   }
+
+   return true;
+}
+
+// Waits until the core's next record is at the cursor
+static void
+waitForTurn(std::unique_lock<std::mutex> &lock,
+            uint32_t coreId,
+            size_t index)
+{
+   auto deadline = std::chrono::steady_clock::now() + ReplayStallTimeout;
+
+   while (sMode.load() == ReplayMode::Replay && sCursor != index) {
+      if (!waitUntil(lock, deadline, coreId, "its turn at the scheduler lock")) {
+         return;
+      }
+   }
+}
+
+// Holds the core at a kernel call which an interrupt was taken after until
+//  the interrupt has been raised.
+static void
+waitForInterrupt(std::unique_lock<std::mutex> &lock,
+                 uint32_t coreId)
+{
+   auto &core = sCores[coreId];
+   auto deadline = std::chrono::steady_clock::now() + ReplayStallTimeout;
+
+   while (sMode.load() == ReplayMode::Replay) {
+      auto index = nextOrder(core);
+
+      if (index == NoRecord || sOrder[index].type != ReplayOrderType::Interrupt) {
+         return;
+      }
+
+      auto &record = sOrder[index];
+      auto calls = core.kernelCalls.load(std::memory_order_relaxed);
+
+      if (record.kernelCalls > calls) {
+         return;
+      }
+
+      if (record.kernelCalls < calls) {
+         stopReplaying(true, fmt::format("core {} made kernel call {} before taking interrupts 0x{:X} after kernel call {}",
+                                         coreId, calls, record.flags, record.kernelCalls));
+         return;
+      }
+
+      if (sCursor == index) {
+         raiseNextInterrupt();
+         return;
+      }
+
+      if (!waitUntil(lock, deadline, coreId, "its next interrupt")) {
+         return;
+      }
+   }
+}
+
+static uint64_t
+readValue(uint32_t coreId,
+          ReplayChannel channel,
+          uint64_t value)
+{
+   auto &core = sCores[coreId];
+
+   if (core.valuePosition == core.valueRecords.size()) {
+      std::unique_lock<std::mutex> lock { sMutex };
+      stopReplaying(false, fmt::format("core {} has read every value in the recording", coreId));
+      return value;
+   }
+
+   auto &record = core.valueRecords[core.valuePosition];
+
+   if (record.channel != channel) {
+      std::unique_lock<std::mutex> lock { sMutex };
+      stopReplaying(true, fmt::format("core {} read {} where the recording read {}",
+                                      coreId, channelName(channel), channelName(record.channel)));
+      return value;
+   }
+
+   core.valuePosition++;
+   return record.value;
+}
+
+static uint64_t
+replayTimeBase(uint64_t tb)
+{
+   auto mode = sMode.load(std::memory_order_relaxed);
+   auto coreId = cpu::this_core::id();
+
+   if (mode == ReplayMode::Record) {
+      recordValue(coreId, ReplayChannel::TimeBase, tb);
+   } else if (mode == ReplayMode::Replay) {
+      auto value = readValue(coreId, ReplayChannel::TimeBase, tb);
+
+      if (sMode.load(std::memory_order_relaxed) == ReplayMode::Replay) {
+         sCores[coreId].lastTime.store(value);
+         return value;
+      }
+   }
+
+   return tb;
+}
+
+// Lets go of interrupts held back from a core which has made no kernel call
+//  for too long. The replay still raises them after the same kernel call, but
+//  no longer at the same instruction, so it may diverge.
+static void
+watchdogThreadEntry()
+{
+   auto heldCalls = std::array<uint64_t, ReplayCoreCount> { };
+   auto heldSince = std::array<std::chrono::steady_clock::time_point, ReplayCoreCount> { };
+   auto heldSeen = std::array<bool, ReplayCoreCount> { };
+   std::unique_lock<std::mutex> lock { sMutex };
+
+   while (sWatchdogRunning) {
+      sCondition.wait_for(lock, ReplayWatchdogInterval);
+      auto now = std::chrono::steady_clock::now();
+
+      for (auto i = 0u; i < ReplayCoreCount; ++i) {
+         auto &core = sCores[i];
+         auto calls = core.kernelCalls.load(std::memory_order_acquire);
+
+         if (!core.held.load() || (heldSeen[i] && heldCalls[i] != calls)) {
+            heldSeen[i] = false;
+            continue;
+         }
+
+         if (!heldSeen[i]) {
+            heldSeen[i] = true;
+            heldCalls[i] = calls;
+            heldSince[i] = now;
+            continue;
+         }
+
+         if (now - heldSince[i] < ReplayHoldTimeout) {
+            continue;
+         }
+
+         auto held = core.held.exchange(0);
+         heldSeen[i] = false;
+
+         if (held) {
+            core.released.fetch_or(held);
+            cpu::interrupt(i, held);
+
+            if (sForcedReleases++ == 0) {
+               gLog->warn("Core {} made no kernel call for {} ms while interrupts 0x{:X} were held, "
+                          "letting them go, the replay may diverge",
+                          i, std::chrono::duration_cast<std::chrono::milliseconds>(ReplayHoldTimeout).count(), held);
+            }
+         }
+      }
+   }
+}
+
+bool
+startRecording(const std::string &path)
+{
+   std::unique_lock<std::mutex> lock { sMutex };
+   sFile.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+   if (!sFile.is_open()) {
+      gLog->error("Could not open {} to record to", path);
+      return false;
+   }
+
+   auto header = ReplayHeader { ReplayMagic, ReplayVersion, ReplayCoreCount, 0 };
+   sFile.write(reinterpret_cast<const char *>(&header), sizeof(ReplayHeader));
+
+   resetCores();
+   sPath = path;
+   cpu::setTimeBaseHandler(replayTimeBase);
+   sMode.store(ReplayMode::Record);
+   sWatchdogRunning = true;
+   sWatchdogThread = std::thread { watchdogThreadEntry };
+   gLog->info("Recording to {}", path);
+   return true;
+}
+
+static bool
+parseOrderChunk(const uint8_t *pos,
+                const uint8_t *end)
+{
+   while (pos != end) {
+      auto byte = *pos++;
+      auto record = ReplayOrderRecord { };
+      record.type = static_cast<ReplayOrderType>(byte & 0xF);
+      record.core = byte >> 4;
+
+      if (record.core >= ReplayCoreCount) {
+         return false;
+      }
+
+      auto &core = sCores[record.core];
+
+      if (record.type == ReplayOrderType::Interrupt) {
+         auto delta = uint64_t { 0 };
+         auto flags = uint64_t { 0 };
+
+         if (!readVarint(pos, end, delta) || !readVarint(pos, end, flags)) {
+            return false;
+         }
+
+         core.lastInterruptCalls += delta;
+         record.kernelCalls = core.lastInterruptCalls;
+         record.flags = static_cast<uint32_t>(flags);
+      } else if (record.type != ReplayOrderType::SchedulerLock) {
+         return false;
+      }
+
+      core.order.push_back(sOrder.size());
+      sOrder.push_back(record);
+   }
+
+   return true;
+}
+
+static bool
+parseValuesChunk(uint32_t coreId,
+                 const uint8_t *pos,
+                 const uint8_t *end)
+{
+   if (coreId >= ReplayCoreCount) {
+      return false;
+   }
+
+   auto &core = sCores[coreId];
+
+   while (pos != end) {
+      auto record = ReplayValueRecord { };
+      record.channel = static_cast<ReplayChannel>(*pos++);
+
+      if (record.channel >= ReplayChannel::Max) {
+         return false;
+      }
+
+      auto delta = uint64_t { 0 };
+
+      if (!readVarint(pos, end, delta)) {
+         return false;
+      }
+
+      auto &last = core.lastValue[static_cast<size_t>(record.channel)];
+      last += zigzagDecode(delta);
+      record.value = last;
+      core.valueRecords.push_back(record);
+   }
+
+   return true;
+}
+
+bool
+startReplay(const std::string &path)
+{
+   std::unique_lock<std::mutex> lock { sMutex };
+   std::ifstream file { path, std::ifstream::in | std::ifstream::binary };
+
+   if (!file.is_open()) {
+      gLog->error("Could not open {} to replay", path);
+      return false;
+   }
+
+   auto data = std::vector<uint8_t> { std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> { } };
+   auto header = ReplayHeader { };
+
+   if (data.size() < sizeof(ReplayHeader)) {
+      gLog->error("{} is not a replay file", path);
+      return false;
+   }
+
+   std::memcpy(&header, data.data(), sizeof(ReplayHeader));
+
+   if (header.magic != ReplayMagic || header.version != ReplayVersion || header.coreCount != ReplayCoreCount) {
+      gLog->error("{} is not a replay file this version can read", path);
+      return false;
+   }
+
+   resetCores();
+   auto pos = data.data() + sizeof(ReplayHeader);
+   auto end = data.data() + data.size();
+   auto valid = true;
+
+   while (valid && pos != end) {
+      auto chunk = ReplayChunk { };
+
+      if (static_cast<size_t>(end - pos) < sizeof(ReplayChunk)) {
+         valid = false;
+         break;
+      }
+
+      std::memcpy(&chunk, pos, sizeof(ReplayChunk));
+      pos += sizeof(ReplayChunk);
+
+      if (static_cast<size_t>(end - pos) < chunk.size) {
+         valid = false;
+         break;
+      }
+
+      if (chunk.type == ReplayChunkType::Order) {
+         valid = parseOrderChunk(pos, pos + chunk.size);
+      } else if (chunk.type == ReplayChunkType::Values) {
+         valid = parseValuesChunk(chunk.core, pos, pos + chunk.size);
+      }
+
+      pos += chunk.size;
+   }
+
+   if (!valid) {
+      gLog->error("{} is corrupt", path);
+      resetCores();
+      return false;
+   }
+
+   if (sOrder.empty()) {
+      gLog->error("{} has nothing to replay", path);
+      return false;
+   }
+
+   auto values = size_t { 0 };
+
+   for (auto &core : sCores) {
+      core.lastValue.fill(0);
+      values += core.valueRecords.size();
+   }
+
+   sPath = path;
+   cpu::setTimeBaseHandler(replayTimeBase);
+   sMode.store(ReplayMode::Replay);
+   gLog->info("Replaying {} events and {} values from {}", sOrder.size(), values, path);
+
+   // The recording may have started with an interrupt
+   raiseNextInterrupt();
+   return true;
+}
+
+void
+stopReplay()
+{
+   std::unique_lock<std::mutex> lock { sMutex };
+
+   if (sWatchdogThread.joinable()) {
+      sWatchdogRunning = false;
+      sCondition.notify_all();
+      lock.unlock();
+      sWatchdogThread.join();
+      lock.lock();
+   }
+
+   auto mode = sMode.exchange(ReplayMode::Off);
+
+   if (mode == ReplayMode::Record) {
+      auto values = uint64_t { 0 };
+      writeChunk(ReplayChunkType::Order, 0, sOrderBuffer);
+
+      for (auto i = 0u; i < ReplayCoreCount; ++i) {
+         writeChunk(ReplayChunkType::Values, i, sCores[i].values);
+         values += sCores[i].valueCount;
+      }
+
+      gLog->info("Recorded {} events and {} values to {}", sOrderCount, values, sPath);
+
+      if (sForcedReleases) {
+         gLog->warn("{} interrupts were let go without a kernel call, the replay may diverge", sForcedReleases);
+      }
+   } else if (mode == ReplayMode::Replay) {
+      gLog->info("Replay stopped at record {} of {}", sCursor, sOrder.size());
+   }
+
+   if (sFile.is_open()) {
+      sFile.close();
+   }
+
+   cpu::setTimeBaseHandler(nullptr);
+   resetCores();
+   sCondition.notify_all();
+}
+
+bool
+isReplayActive()
+{
+   return sMode.load(std::memory_order_relaxed) != ReplayMode::Off;
+}
+
+bool
+isReplaying()
+{
+   return sMode.load(std::memory_order_relaxed) == ReplayMode::Replay;
+}
+
+uint64_t
+replayValue(ReplayChannel channel,
+            uint64_t value)
+{
+   auto mode = sMode.load(std::memory_order_relaxed);
+   auto core = cpu::this_core::state();
+
+   // Reads from host threads are left alone, only the cores are replayed
+   if (mode == ReplayMode::Off || !core) {
+      return value;
+   }
+
+   if (mode == ReplayMode::Record) {
+      recordValue(core->id, channel, value);
+      return value;
+   }
+
+   return readValue(core->id, channel, value);
+}
+
+float
+replayValue(ReplayChannel channel,
+            float value)
+{
+   auto bits = uint32_t { 0 };
+   std::memcpy(&bits, &value, sizeof(float));
+   bits = static_cast<uint32_t>(replayValue(channel, static_cast<uint64_t>(bits)));
+   std::memcpy(&value, &bits, sizeof(float));
+   return value;
+}
+
+void
+replayKernelCall()
+{
+   auto mode = sMode.load(std::memory_order_relaxed);
+
+   if (mode == ReplayMode::Off) {
+      return;
+   }
+
+   auto coreId = cpu::this_core::id();
+   auto &core = sCores[coreId];
+   auto calls = core.kernelCalls.load(std::memory_order_relaxed) + 1;
+   core.kernelCalls.store(calls, std::memory_order_release);
+
+   if (mode == ReplayMode::Record) {
+      // Interrupts which came in since the last kernel call go in now
+      auto held = core.held.exchange(0);
+
+      if (held) {
+         core.released.fetch_or(held);
+         cpu::interrupt(coreId, held);
+      }
+
+      return;
+   }
+
+   // Only the core itself moves its position on, so it can look without a lock
+   auto index = nextOrder(core);
+
+   if (index == NoRecord
+    || sOrder[index].type != ReplayOrderType::Interrupt
+    || sOrder[index].kernelCalls > calls) {
+      return;
+   }
+
+   std::unique_lock<std::mutex> lock { sMutex };
+   waitForInterrupt(lock, coreId);
+}
+
+void
+replaySchedulerLock()
+{
+   // Host threads take the scheduler lock too, to look at guest threads, but
+   //  only the cores are recorded.
+   if (sMode.load(std::memory_order_relaxed) != ReplayMode::Replay || !cpu::this_core::state()) {
+      return;
+   }
+
+   auto coreId = cpu::this_core::id();
+   std::unique_lock<std::mutex> lock { sMutex };
+
+   if (sMode.load() != ReplayMode::Replay) {
+      return;
+   }
+
+   auto index = nextOrder(sCores[coreId]);
+
+   if (index == NoRecord) {
+      stopReplaying(false, fmt::format("core {} has nothing left in the recording", coreId));
+      return;
+   }
+
+   if (sOrder[index].type != ReplayOrderType::SchedulerLock) {
+      stopReplaying(true, fmt::format("core {} took the scheduler lock where the recording took interrupts 0x{:X}",
+                                      coreId, sOrder[index].flags));
+      return;
+   }
+
+   waitForTurn(lock, coreId, index);
+}
+
+void
+replaySchedulerUnlock()
+{
+   auto mode = sMode.load(std::memory_order_relaxed);
+
+   if (mode == ReplayMode::Off || !cpu::this_core::state()) {
+      return;
+   }
+
+   auto coreId = cpu::this_core::id();
+
+   if (mode == ReplayMode::Record) {
+      // Logged while the lock is still held, so the order in the file is the
+      //  order the cores held it in.
+      recordOrder(ReplayOrderType::SchedulerLock, coreId, 0);
+   } else if (mode == ReplayMode::Replay) {
+      std::unique_lock<std::mutex> lock { sMutex };
+
+      if (sMode.load() != ReplayMode::Replay) {
+         return;
+      }
+
+      if (sCursor != nextOrder(sCores[coreId])) {
+         stopReplaying(true, fmt::format("core {} released the scheduler lock out of turn", coreId));
+         return;
+      }
+
+      advanceOrder();
+   }
+}
+
+void
+replaySchedulerUnlocked()
+{
+   if (sMode.load(std::memory_order_relaxed) != ReplayMode::Replay || !cpu::this_core::state()) {
+      return;
+   }
+
+   // The recording may have taken an interrupt before doing anything else
+   auto coreId = cpu::this_core::id();
+   auto &core = sCores[coreId];
+   auto index = nextOrder(core);
+
+   if (index == NoRecord || sOrder[index].type != ReplayOrderType::Interrupt) {
+      return;
+   }
+
+   std::unique_lock<std::mutex> lock { sMutex };
+   waitForInterrupt(lock, coreId);
+}
+
+uint32_t
+replayInterrupts(uint32_t flags)
+{
+   auto mode = sMode.load(std::memory_order_relaxed);
+
+   if (mode == ReplayMode::Off) {
+      return flags;
+   }
+
+   auto coreId = cpu::this_core::id();
+   decaf_check(coreId < ReplayCoreCount);
+
+   auto &core = sCores[coreId];
+   auto other = flags & ~ReplayInterruptFlags;
+   auto guest = flags & ReplayInterruptFlags;
+
+   if (mode == ReplayMode::Record) {
+      auto deliver = uint32_t { 0 };
+
+      if (!coreinit::internal::getCurrentThread()) {
+         // An idle core has nothing to interrupt, so anything can go in now
+         deliver = guest | core.held.exchange(0);
+      } else {
+         deliver = guest & core.released.load();
+         core.held.fetch_or(guest & ~deliver);
+      }
+
+      core.released.fetch_and(~deliver);
+
+      if (deliver) {
+         recordOrder(ReplayOrderType::Interrupt, coreId, deliver);
+      }
+
+      return other | deliver;
+   }
+
+   // Real interrupts are dropped, the recorded ones are raised when their turn
+   //  comes and are the only ones released.
+   std::unique_lock<std::mutex> lock { sMutex };
+
+   if (sMode.load() != ReplayMode::Replay) {
+      return flags;
+   }
+
+   auto deliver = guest & core.released.load();
+
+   if (!deliver) {
+      return other;
+   }
+
+   auto index = nextOrder(core);
+
+   if (index != sCursor
+    || sOrder[index].type != ReplayOrderType::Interrupt
+    || sOrder[index].flags != deliver) {
+      stopReplaying(true, fmt::format("core {} took interrupts 0x{:X} out of turn", coreId, deliver));
+      return flags;
+   }
+
+   core.released.fetch_and(~deliver);
+   advanceOrder();
+   return other | deliver;
+}
+
+void
+replayCoreIdle()
+{
+   if (sMode.load(std::memory_order_relaxed) != ReplayMode::Record) {
+      return;
+   }
+
+   // Wake the idle loop for anything held back from the thread which just left
+   auto coreId = cpu::this_core::id();
+   auto &core = sCores[coreId];
+
+   auto held = core.held.exchange(0);
+
+   if (held) {
+      core.released.fetch_or(held);
+      cpu::interrupt(coreId, held);
+   }
+}
+
+} // namespace kernel
@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace kernel
+{
+
+/*
+ * Record and replay of everything which makes one run of a game differ from
+ * the next, so a replay runs the same guest code as the recording did.
+ *
+ * While recording or replaying guest interrupts are only let through after a
+ * kernel call, so each delivery can be found again by how many kernel calls
+ * the core had made. The order cores take the scheduler lock in is logged
+ * and enforced on replay, which orders everything the cores do to each other
+ * through the OS. Values read from the host, such as the time base, GPU
+ * progress and controller input, are logged per core and read back from the
+ * log on replay. Filesystem commands run synchronously on the calling core.
+ *
+ * A replay checks every record against what the cores actually do. If they
+ * no longer match, or the log runs out, the replay stops and the game carries
+ * on in real time from wherever it got to.
+ *
+ * A guest thread which waits on memory without making kernel calls, such as
+ * one spinning on a flag an alarm callback sets, would never get its held
+ * interrupts. A recording lets them go after a while and warns that the
+ * replay may diverge from that point.
+ *
+ * Replay file layout, all values are in host byte order:
+ *
+ *    ReplayHeader
+ *    ReplayChunk, followed by chunk.size bytes of payload
+ *    ...
+ *
+ * An Order chunk is a sequence of records which start with a byte holding the
+ * ReplayOrderType in the low four bits and the core in the high four bits.
+ * Interrupt records follow that with LEB128 varints of the number of kernel
+ * calls since the core's previous interrupt and the interrupt flags.
+ *
+ * A Values chunk holds records for chunk.core only. Each is a byte holding
+ * the ReplayChannel followed by a zigzag varint of the difference from the
+ * previous value on the same core and channel.
+ */
+static const uint32_t ReplayMagic = 0x4C505244; // "DRPL"
+static const uint32_t ReplayVersion = 1;
+
+enum class ReplayChunkType : uint32_t
+{
+   Order = 1,
+   Values = 2,
+};
+
+enum class ReplayOrderType : uint8_t
+{
+   SchedulerLock = 0,
+   Interrupt = 1,
+};
+
+enum class ReplayChannel : uint8_t
+{
+   TimeBase,
+   ClockBase,
+   GpuRetiredTimeStamp,
+   GpuFlipCount,
+   GpuLastFlip,
+   CommandBufferSize,
+   Input,
+   GpuLastVsync,
+   Max,
+};
+
+struct ReplayHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t coreCount;
+   uint32_t reserved;
+};
+
+struct ReplayChunk
+{
+   ReplayChunkType type;
+   uint32_t core;
+   uint32_t size;
+};
+
+bool
+startRecording(const std::string &path);
+
+bool
+startReplay(const std::string &path);
+
+//! Stops a recording or replay, the cores must have stopped
+void
+stopReplay();
+
+//! True while recording or replaying
+bool
+isReplayActive();
+
+bool
+isReplaying();
+
+//! Logs a value read from the host while recording, returns the logged value
+//  instead while replaying.
+uint64_t
+replayValue(ReplayChannel channel,
+            uint64_t value);
+
+float
+replayValue(ReplayChannel channel,
+            float value);
+
+//! Called by a core at the start of every kernel call
+void
+replayKernelCall();
+
+//! Called by a core before it takes the scheduler lock
+void
+replaySchedulerLock();
+
+//! Called by a core just before it releases the scheduler lock
+void
+replaySchedulerUnlock();
+
+//! Called by a core after it has released the scheduler lock
+void
+replaySchedulerUnlocked();
+
+//! Called by a core from its interrupt handler, returns the flags which should
+//  be handled now.
+uint32_t
+replayInterrupts(uint32_t flags);
+
+//! Called by a core when it has no thread left to run
+void
+replayCoreIdle();
+
+} // namespace kernel
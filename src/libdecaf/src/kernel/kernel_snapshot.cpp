@@ -0,0 +1,404 @@
+#include "kernel_snapshot.h"
+#include "kernel_internal.h"
+#include "kernel_loader.h"
+#include "kernel_replay.h"
+#include "common/decaf_assert.h"
+#include "common/log.h"
+#include "common/platform_fiber.h"
+#include "common/platform_memory.h"
+#include "libcpu/cpu.h"
+#include "libcpu/mem.h"
+#include "modules/coreinit/coreinit_scheduler.h"
+#include "modules/coreinit/coreinit_thread.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kernel
+{
+
+// How long to wait for every core to stop
+static const auto
+ParkTimeout = std::chrono::seconds { 2 };
+
+// How many times a capture is tried while some state is busy, and how long
+//  the cores get to run in between.
+static const unsigned
+CaptureAttempts = 50;
+
+static const auto
+CaptureRetryDelay = std::chrono::milliseconds { 10 };
+
+struct SnapshotState
+{
+   const char *name;
+   SnapshotCaptureFunction capture;
+   SnapshotWaitFunction wait;
+};
+
+struct Snapshot
+{
+   ~Snapshot()
+   {
+      if (fibers) {
+         freeFiberSnapshot(fibers);
+      }
+
+      if (memory) {
+         platform::freeMemorySnapshot(memory);
+      }
+   }
+
+   platform::MemorySnapshot *memory = nullptr;
+   FiberSnapshot *fibers = nullptr;
+   cpu::StateSnapshot cpu;
+
+   //! Fiber each core was on when it stopped
+   std::array<platform::Fiber *, 3> resumeFibers;
+
+   std::vector<std::string> modules;
+   std::vector<SnapshotRestoreFunction> states;
+};
+
+static std::mutex
+sStatesMutex;
+
+static std::vector<SnapshotState>
+sStates;
+
+//! Held for the whole of a save or restore
+static std::mutex
+sOperationMutex;
+
+static std::unique_ptr<Snapshot>
+sSnapshot;
+
+static std::mutex
+sParkMutex;
+
+static std::condition_variable
+sParkCondition;
+
+static bool
+sParkRequested = false;
+
+//! Bit for each core which is stopped on its park fiber
+static uint32_t
+sParkedCores = 0;
+
+static platform::Fiber *
+sParkFiber[3];
+
+static platform::Fiber *
+sResumeFiber[3];
+
+void
+registerSnapshotState(const char *name,
+                      SnapshotCaptureFunction capture,
+                      SnapshotWaitFunction wait)
+{
+   std::unique_lock<std::mutex> lock { sStatesMutex };
+   sStates.push_back({ name, capture, wait });
+}
+
+// Holds a core on a fiber of its own, so the fiber it was running is left
+//  suspended and can be saved or replaced.
+static void
+parkFiberEntryPoint(void *)
+{
+   auto coreId = cpu::this_core::id();
+   std::unique_lock<std::mutex> lock { sParkMutex };
+   sParkedCores |= 1 << coreId;
+   sParkCondition.notify_all();
+
+   while (sParkRequested) {
+      sParkCondition.wait(lock);
+   }
+
+   sParkedCores &= ~(1 << coreId);
+   sParkCondition.notify_all();
+
+   // After a restore this may be a different fiber to the one we came from
+   auto resumeFiber = sResumeFiber[coreId];
+   lock.unlock();
+
+   setCurrentFiber(resumeFiber);
+   platform::swapToFiber(nullptr, resumeFiber);
+}
+
+void
+handleSnapshotInterrupt()
+{
+   auto coreId = cpu::this_core::id();
+
+   {
+      std::unique_lock<std::mutex> lock { sParkMutex };
+
+      if (!sParkRequested) {
+         return;
+      }
+   }
+
+   // Another core could be spinning on a lock this thread holds, with
+   //  interrupts disabled, so wait until it has been released.
+   auto thread = coreinit::internal::getCurrentThread();
+
+   if (thread && thread->context.spinLockCount > 0) {
+      cpu::interrupt(coreId, cpu::SNAPSHOT_INTERRUPT);
+      return;
+   }
+
+   coreinit::internal::pauseCoreTime(true);
+
+   sResumeFiber[coreId] = getCurrentFiber();
+   sParkFiber[coreId] = platform::createFiber(parkFiberEntryPoint, nullptr);
+   platform::swapToFiber(sResumeFiber[coreId], sParkFiber[coreId]);
+
+   // The park fiber is never switched to again once it has let go of us
+   platform::destroyFiber(sParkFiber[coreId]);
+   sParkFiber[coreId] = nullptr;
+
+   // The restored guest may be using a different rounding mode
+   cpu::this_core::updateRoundingMode();
+   coreinit::internal::pauseCoreTime(false);
+}
+
+static void
+releaseCores(std::unique_lock<std::mutex> &lock)
+{
+   sParkRequested = false;
+   sParkCondition.notify_all();
+
+   sParkCondition.wait(lock, [] {
+      return sParkedCores == 0;
+   });
+}
+
+static bool
+parkCores(std::unique_lock<std::mutex> &lock)
+{
+   sParkRequested = true;
+
+   for (auto i = 0; i < 3; ++i) {
+      cpu::interrupt(i, cpu::SNAPSHOT_INTERRUPT);
+   }
+
+   auto parked = sParkCondition.wait_for(lock, ParkTimeout, [] {
+      return sParkedCores == 0x7;
+   });
+
+   if (!parked) {
+      releaseCores(lock);
+      return false;
+   }
+
+   return true;
+}
+
+static std::vector<std::string>
+getModuleNames()
+{
+   auto names = std::vector<std::string> { };
+
+   for (auto &module : loader::getLoadedModules()) {
+      names.push_back(module.first);
+   }
+
+   return names;
+}
+
+// Returns false if some state was busy and the capture should be tried again
+static bool
+captureParked(Snapshot &snapshot,
+              bool &failed)
+{
+   std::unique_lock<std::mutex> lock { sStatesMutex };
+
+   for (auto &state : sStates) {
+      auto restore = state.capture();
+
+      if (!restore) {
+         gLog->debug("Snapshot waiting for {}", state.name);
+         snapshot.states.clear();
+         return false;
+      }
+
+      snapshot.states.push_back(restore);
+   }
+
+   snapshot.fibers = captureFibers();
+
+   if (!snapshot.fibers) {
+      gLog->error("Snapshots are not supported, the host could not save guest thread fibers");
+      failed = true;
+      return false;
+   }
+
+   snapshot.cpu = cpu::captureState();
+   snapshot.modules = getModuleNames();
+
+   for (auto i = 0; i < 3; ++i) {
+      snapshot.resumeFibers[i] = sResumeFiber[i];
+   }
+
+   // Last, so the copy is taken as late as possible before the cores resume
+   snapshot.memory = mem::captureSnapshot();
+
+   if (!snapshot.memory) {
+      gLog->error("Snapshots are not supported, the host could not copy guest memory");
+      failed = true;
+      return false;
+   }
+
+   return true;
+}
+
+bool
+saveSnapshot()
+{
+   decaf_check(!cpu::this_core::state());
+   std::unique_lock<std::mutex> operationLock { sOperationMutex };
+   auto start = std::chrono::steady_clock::now();
+
+   if (isReplayActive()) {
+      gLog->error("Snapshots cannot be taken while recording or replaying");
+      return false;
+   }
+
+   for (auto attempt = 0u; attempt < CaptureAttempts; ++attempt) {
+      auto snapshot = std::unique_ptr<Snapshot> { new Snapshot { } };
+      auto failed = false;
+      auto captured = false;
+      auto stopped = std::chrono::steady_clock::now();
+
+      {
+         std::unique_lock<std::mutex> lock { sParkMutex };
+
+         if (!parkCores(lock)) {
+            gLog->error("Could not take a snapshot, the cores did not stop");
+            return false;
+         }
+
+         // Only one snapshot is kept, the fibers it holds on to have to be
+         //  released while the cores are stopped.
+         stopped = std::chrono::steady_clock::now();
+         sSnapshot.reset();
+         captured = captureParked(*snapshot, failed);
+
+         if (!captured && snapshot->fibers) {
+            freeFiberSnapshot(snapshot->fibers);
+            snapshot->fibers = nullptr;
+         }
+
+         releaseCores(lock);
+      }
+
+      if (failed) {
+         return false;
+      }
+
+      if (captured) {
+         auto end = std::chrono::steady_clock::now();
+         gLog->info("Took a snapshot in {} ms, the cores were stopped for {} ms",
+                    std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(),
+                    std::chrono::duration_cast<std::chrono::milliseconds>(end - stopped).count());
+         sSnapshot = std::move(snapshot);
+         return true;
+      }
+
+      std::this_thread::sleep_for(CaptureRetryDelay);
+   }
+
+   gLog->error("Could not take a snapshot, some state stayed busy");
+   return false;
+}
+
+bool
+restoreSnapshot()
+{
+   decaf_check(!cpu::this_core::state());
+   std::unique_lock<std::mutex> operationLock { sOperationMutex };
+   auto start = std::chrono::steady_clock::now();
+
+   if (!sSnapshot) {
+      gLog->error("There is no snapshot to restore");
+      return false;
+   }
+
+   if (isReplayActive()) {
+      gLog->error("Snapshots cannot be restored while recording or replaying");
+      return false;
+   }
+
+   // Finishes writing the copy of guest memory before anything is stopped
+   if (!platform::waitMemorySnapshot(sSnapshot->memory)) {
+      gLog->error("Could not restore the snapshot, copying guest memory failed");
+      return false;
+   }
+
+   std::unique_lock<std::mutex> lock { sParkMutex };
+
+   if (!parkCores(lock)) {
+      gLog->error("Could not restore the snapshot, the cores did not stop");
+      return false;
+   }
+
+   // Host code for modules loaded since would be left referring to memory
+   //  which no longer holds them.
+   if (getModuleNames() != sSnapshot->modules) {
+      gLog->error("Could not restore the snapshot, the loaded modules have changed");
+      releaseCores(lock);
+      return false;
+   }
+
+   std::unique_lock<std::mutex> statesLock { sStatesMutex };
+
+   for (auto &state : sStates) {
+      if (state.wait) {
+         state.wait();
+      }
+   }
+
+   // Guest memory is the first thing changed, so past this point there is
+   //  no going back to the current state.
+   if (!mem::restoreSnapshot(sSnapshot->memory)) {
+      decaf_abort("Failed to map the snapshot over guest memory");
+   }
+
+   // Code generated since the snapshot may not match the guest code now
+   cpu::invalidateJitCache();
+
+   restoreFibers(sSnapshot->fibers);
+   cpu::restoreState(sSnapshot->cpu);
+
+   for (auto &restore : sSnapshot->states) {
+      restore();
+   }
+
+   statesLock.unlock();
+
+   for (auto i = 0; i < 3; ++i) {
+      sResumeFiber[i] = sSnapshot->resumeFibers[i];
+   }
+
+   releaseCores(lock);
+
+   auto end = std::chrono::steady_clock::now();
+   gLog->info("Restored the snapshot in {} ms",
+              std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+   return true;
+}
+
+bool
+hasSnapshot()
+{
+   std::unique_lock<std::mutex> operationLock { sOperationMutex };
+   return !!sSnapshot;
+}
+
+} // namespace kernel
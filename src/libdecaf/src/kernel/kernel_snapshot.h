@@ -0,0 +1,59 @@
+#pragma once
+#include <functional>
+
+namespace kernel
+{
+
+/*
+ * Snapshots of the running guest which can be restored within the same
+ * process.
+ *
+ * Every core is stopped at an interrupt, guest memory is copied with fork
+ * style copy-on-write, and the cores carry on as soon as the host side state
+ * has been copied. Restoring maps the copy back over guest memory so pages are
+ * only read in as they are touched, then puts back the host side state and
+ * resumes each core exactly where it was stopped.
+ *
+ * They are not save states. Guest threads run on host fibers whose stacks
+ * hold host frames, so a snapshot cannot outlive the process. They are meant
+ * for going back to the same point of one boot again and again, such as
+ * measuring the same scene several times. Code the JIT generated after the
+ * snapshot is dropped on restore.
+ *
+ * Host state which is not kept in guest memory is registered with
+ * registerSnapshotState. The capture function is called with every core
+ * stopped and returns a function which puts the copy back, which may be
+ * called any number of times. An empty function means the state is busy, for
+ * example with work in flight on another host thread, and the capture is
+ * tried again a little later.
+ *
+ * The optional wait function is called before a restore with every core
+ * stopped but before anything has been changed, so host threads can finish
+ * work which still refers to the current guest memory.
+ */
+
+using SnapshotRestoreFunction = std::function<void()>;
+using SnapshotCaptureFunction = std::function<SnapshotRestoreFunction()>;
+using SnapshotWaitFunction = std::function<void()>;
+
+void
+registerSnapshotState(const char *name,
+                      SnapshotCaptureFunction capture,
+                      SnapshotWaitFunction wait = nullptr);
+
+//! Replaces any earlier snapshot, must not be called from a core
+bool
+saveSnapshot();
+
+//! Must not be called from a core
+bool
+restoreSnapshot();
+
+bool
+hasSnapshot();
+
+//! Called by a core from its interrupt handler for SNAPSHOT_INTERRUPT
+void
+handleSnapshotInterrupt();
+
+} // namespace kernel
@@ -19,10 +19,14 @@ Module::initialise()
    initialiseAllocatorFunctions();
    initialiseEvent();
    initialiseExceptions();
+   initialiseExpHeap();
+   initialiseFileSystem();
+   initialiseFsClients();
    initialiseGHS();
    initialiseGhsTypeInfo();
    initialiseLockedCache();
    initialiseMembase();
+   initialiseMemory();
    initialiseMessageQueues();
    initialiseSchedulerFunctions();
    initialiseShared();
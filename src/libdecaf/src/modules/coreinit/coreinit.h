@@ -26,10 +26,14 @@ private:
    void initialiseAllocatorFunctions();
    void initialiseEvent();
    void initialiseExceptions();
+   void initialiseExpHeap();
+   void initialiseFileSystem();
+   void initialiseFsClients();
    void initialiseGHS();
    void initialiseGhsTypeInfo();
    void initialiseLockedCache();
    void initialiseMembase();
+   void initialiseMemory();
    void initialiseMessageQueues();
    void initialiseSchedulerFunctions();
    void initialiseShared();
@@ -295,7 +295,7 @@ OSWaitAlarm(OSAlarm *alarm)
    }
 
    OSGetCurrentThread()->alarmCancelled = false;
-   internal::sleepThreadNoLock(&alarm->threadQueue);
+   internal::sleepThreadNoLock(&alarm->threadQueue, internal::ThreadWaitReason::Alarm);
 
    internal::releaseIdLock(sAlarmLock, alarm);
    internal::rescheduleSelfNoLock();
@@ -324,7 +324,7 @@ AlarmCallbackThreadEntry(uint32_t core_id, void *arg2)
       OSAlarm *alarm = internal::AlarmQueue::popFront(cbQueue);
       if (alarm == nullptr) {
          // No alarms currently pending for callback
-         internal::sleepThreadNoLock(threadQueue);
+         internal::sleepThreadNoLock(threadQueue, internal::ThreadWaitReason::Alarm);
          internal::releaseIdLock(sAlarmLock);
 
          internal::rescheduleSelfNoLock();
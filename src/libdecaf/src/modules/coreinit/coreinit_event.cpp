@@ -210,7 +210,7 @@ OSWaitEvent(OSEvent *event)
       }
    } else {
       // Wait for event to be set
-      internal::sleepThreadNoLock(&event->queue);
+      internal::sleepThreadNoLock(&event->queue, internal::ThreadWaitReason::Event);
       internal::rescheduleSelfNoLock();
    }
 
@@ -280,7 +280,7 @@ OSWaitEventWithTimeout(OSEvent *event, OSTime timeout)
    thread->waitEventTimeoutAlarm = alarm;
 
    // Wait for the event
-   internal::sleepThreadNoLock(&event->queue);
+   internal::sleepThreadNoLock(&event->queue, internal::ThreadWaitReason::Event);
    internal::rescheduleAllCoreNoLock();
 
    // Clear waitEventTimeoutAlarm
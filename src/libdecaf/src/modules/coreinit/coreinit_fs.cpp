@@ -7,7 +7,10 @@
 #include "coreinit_fs_stat.h"
 #include "coreinit_internal_appio.h"
 #include "coreinit_memheap.h"
+#include "decaf.h"
 #include "filesystem/filesystem.h"
+#include "kernel/kernel_replay.h"
+#include "kernel/kernel_snapshot.h"
 #include <condition_variable>
 #include <thread>
 #include <mutex>
@@ -91,6 +94,10 @@ sFsQueue;
 static std::queue<FSCmdBlock *>
 sFsDoneQueue;
 
+//! True while the FS thread is running a command outside of the queue lock
+static bool
+sFsThreadBusy = false;
+
 void
 handleFsDoneInterrupt()
 {
@@ -123,11 +130,17 @@ fsThreadEntry()
       if (!sFsQueue.empty()) {
          auto item = sFsQueue.top();
          sFsQueue.pop();
+         sFsThreadBusy = true;
          lock.unlock();
 
          item->result.status = item->func();
 
+         // The command block is in guest memory, so do not leave it holding
+         //  on to host memory once the command is done.
+         item->func = nullptr;
+
          lock.lock();
+         sFsThreadBusy = false;
          sFsDoneQueue.push(item);
          cpu::interrupt(sFsCoreId, cpu::FS_DONE_INTERRUPT);
       }
@@ -152,6 +165,7 @@ startFsThread()
    std::unique_lock<std::mutex> lock(sFsQueueMutex);
    sFsThreadRunning.store(true);
    sFsThread = std::thread(fsThreadEntry);
+   decaf::placeHelperThread(&sFsThread);
 }
 
 void
@@ -207,6 +221,18 @@ queueFsWork(FSClient *client,
    asyncRes.client = client;
    asyncRes.block = block;
 
+   // When recording or replaying, run the command right here so its results
+   //  reach guest memory at the same point in every run. Completion is still
+   //  signalled with an interrupt, which is logged like any other.
+   if (kernel::isReplayActive()) {
+      asyncRes.status = func();
+
+      std::unique_lock<std::mutex> lock(sFsQueueMutex);
+      sFsDoneQueue.push(block);
+      cpu::interrupt(sFsCoreId, cpu::FS_DONE_INTERRUPT);
+      return;
+   }
+
    block->func = func;
    std::unique_lock<std::mutex> lock(sFsQueueMutex);
    sFsQueue.push(block);
@@ -227,6 +253,27 @@ cancelAllFsWork()
 
 } // namespace internal
 
+void
+Module::initialiseFileSystem()
+{
+   // Queued commands hold host functions which a snapshot cannot copy, so
+   //  wait until they have all been run.
+   kernel::registerSnapshotState("filesystem queue", []() -> kernel::SnapshotRestoreFunction {
+      std::unique_lock<std::mutex> lock(internal::sFsQueueMutex);
+
+      if (!internal::sFsQueue.empty() || internal::sFsThreadBusy) {
+         return { };
+      }
+
+      auto doneQueue = internal::sFsDoneQueue;
+
+      return [=]() {
+         std::unique_lock<std::mutex> lock(internal::sFsQueueMutex);
+         internal::sFsDoneQueue = doneQueue;
+      };
+   });
+}
+
 void
 Module::registerFileSystemFunctions()
 {
@@ -1,9 +1,15 @@
 #include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include "common/decaf_assert.h"
+#include "coreinit.h"
 #include "coreinit_fs.h"
 #include "coreinit_fs_client.h"
 #include "coreinit_memheap.h"
 #include "coreinit_internal_appio.h"
+#include "kernel/kernel_snapshot.h"
 #include "ppcutils/wfunc_call.h"
 
 namespace coreinit
@@ -12,30 +18,62 @@ namespace coreinit
 static std::vector<FSClient*>
 sClients;
 
+// The handle tables are kept on the host rather than in the FSClient, so
+//  guest memory never holds pointers to host objects.
+struct OpenHandles
+{
+   std::vector<fs::FileHandle *> files;
+   std::vector<fs::FolderHandle *> folders;
+};
+
+static std::mutex
+sHandlesMutex;
+
+static std::unordered_map<FSClient *, OpenHandles>
+sOpenHandles;
+
+// Handles a snapshot refers to are not closed when the guest closes them, so
+//  the snapshot can put them back.
+static std::unordered_set<fs::FileHandle *>
+sSnapshotFiles;
+
+static std::unordered_set<fs::FolderHandle *>
+sSnapshotFolders;
+
+static std::vector<fs::FileHandle *>
+sRetiredFiles;
+
+static std::vector<fs::FolderHandle *>
+sRetiredFolders;
+
 FSClient::FSClient()
 {
+   std::lock_guard<std::mutex> lock(sHandlesMutex);
+
    // Let's just ensure there is never a file handle 0 just in case it's not a valid handle
-   mOpenFiles.push_back(nullptr);
-   mOpenFolders.push_back(nullptr);
+   auto &handles = sOpenHandles[this];
+   handles.files.assign(1, nullptr);
+   handles.folders.assign(1, nullptr);
 }
 
 
 FSFileHandle
 FSClient::addOpenFile(fs::FileHandle *file)
 {
-   std::lock_guard<std::mutex> lock(mMutex);
+   std::lock_guard<std::mutex> lock(sHandlesMutex);
+   auto &openFiles = sOpenHandles[this].files;
 
    // Try use an existing slot
-   for (auto i = 1; i < mOpenFiles.size(); ++i) {
-      if (mOpenFiles[i] == nullptr) {
-         mOpenFiles[i] = file;
+   for (auto i = 1; i < openFiles.size(); ++i) {
+      if (openFiles[i] == nullptr) {
+         openFiles[i] = file;
          return i;
       }
    }
 
    // Add a new slot
-   auto handle = static_cast<FSFileHandle>(mOpenFiles.size());
-   mOpenFiles.push_back(file);
+   auto handle = static_cast<FSFileHandle>(openFiles.size());
+   openFiles.push_back(file);
    return handle;
 }
 
@@ -43,19 +81,20 @@ FSClient::addOpenFile(fs::FileHandle *file)
 FSDirectoryHandle
 FSClient::addOpenDirectory(fs::FolderHandle *folder)
 {
-   std::lock_guard<std::mutex> lock(mMutex);
+   std::lock_guard<std::mutex> lock(sHandlesMutex);
+   auto &openFolders = sOpenHandles[this].folders;
 
    // Try use an existing slot
-   for (auto i = 1; i < mOpenFolders.size(); ++i) {
-      if (mOpenFolders[i] == nullptr) {
-         mOpenFolders[i] = folder;
+   for (auto i = 1; i < openFolders.size(); ++i) {
+      if (openFolders[i] == nullptr) {
+         openFolders[i] = folder;
          return i;
       }
    }
 
    // Add a new slot
-   auto handle = static_cast<FSFileHandle>(mOpenFolders.size());
-   mOpenFolders.push_back(folder);
+   auto handle = static_cast<FSFileHandle>(openFolders.size());
+   openFolders.push_back(folder);
    return handle;
 }
 
@@ -63,43 +102,53 @@ FSClient::addOpenDirectory(fs::FolderHandle *folder)
 fs::FileHandle *
 FSClient::getOpenFile(FSFileHandle handle)
 {
-   std::lock_guard<std::mutex> lock(mMutex);
+   std::lock_guard<std::mutex> lock(sHandlesMutex);
+   auto &openFiles = sOpenHandles[this].files;
 
-   if (handle > mOpenFiles.size()) {
+   if (handle > openFiles.size()) {
       return nullptr;
    }
 
-   return mOpenFiles[handle];
+   return openFiles[handle];
 }
 
 
 fs::FolderHandle *
 FSClient::getOpenDirectory(FSDirectoryHandle handle)
 {
-   std::lock_guard<std::mutex> lock(mMutex);
+   std::lock_guard<std::mutex> lock(sHandlesMutex);
+   auto &openFolders = sOpenHandles[this].folders;
 
-   if (handle > mOpenFolders.size()) {
+   if (handle > openFolders.size()) {
       return nullptr;
    }
 
-   return mOpenFolders[handle];
+   return openFolders[handle];
 }
 
 
 void
 FSClient::removeOpenDirectory(FSDirectoryHandle handle)
 {
-   std::lock_guard<std::mutex> lock(mMutex);
+   std::lock_guard<std::mutex> lock(sHandlesMutex);
+   auto &openFolders = sOpenHandles[this].folders;
 
-   if (handle > mOpenFolders.size()) {
+   if (handle > openFolders.size()) {
       return;
    } else {
-      if (mOpenFolders[handle]) {
-         mOpenFolders[handle]->close();
+      auto folder = openFolders[handle];
+      openFolders[handle] = nullptr;
+
+      if (sSnapshotFolders.count(folder)) {
+         sRetiredFolders.push_back(folder);
+         return;
+      }
+
+      if (folder) {
+         folder->close();
       }
 
-      delete mOpenFolders[handle];
-      mOpenFolders[handle] = nullptr;
+      delete folder;
    }
 }
 
@@ -107,17 +156,25 @@ FSClient::removeOpenDirectory(FSDirectoryHandle handle)
 void
 FSClient::removeOpenFile(FSFileHandle handle)
 {
-   std::lock_guard<std::mutex> lock(mMutex);
+   std::lock_guard<std::mutex> lock(sHandlesMutex);
+   auto &openFiles = sOpenHandles[this].files;
 
-   if (handle > mOpenFiles.size()) {
+   if (handle > openFiles.size()) {
       return;
    } else {
-      if (mOpenFiles[handle]) {
-         mOpenFiles[handle]->close();
+      auto file = openFiles[handle];
+      openFiles[handle] = nullptr;
+
+      if (sSnapshotFiles.count(file)) {
+         sRetiredFiles.push_back(file);
+         return;
+      }
+
+      if (file) {
+         file->close();
       }
 
-      delete mOpenFiles[handle];
-      mOpenFiles[handle] = nullptr;
+      delete file;
    }
 }
 
@@ -160,6 +217,12 @@ FSDelClient(FSClient *client,
             uint32_t flags)
 {
    client->~FSClient();
+
+   {
+      std::lock_guard<std::mutex> lock(sHandlesMutex);
+      sOpenHandles.erase(client);
+   }
+
    sClients.erase(std::remove(sClients.begin(), sClients.end(), client), sClients.end());
    return FSStatus::OK;
 }
@@ -235,6 +298,105 @@ FSGetCurrentCmdBlock(FSClient *client)
    return nullptr;
 }
 
+// Copy of the clients and their handles, and where each file was at
+struct SavedClients
+{
+   ~SavedClients()
+   {
+      std::lock_guard<std::mutex> lock(sHandlesMutex);
+
+      for (auto file : sRetiredFiles) {
+         file->close();
+         delete file;
+      }
+
+      for (auto folder : sRetiredFolders) {
+         folder->close();
+         delete folder;
+      }
+
+      sRetiredFiles.clear();
+      sRetiredFolders.clear();
+      sSnapshotFiles.clear();
+      sSnapshotFolders.clear();
+   }
+
+   std::vector<FSClient *> clients;
+   std::unordered_map<FSClient *, OpenHandles> handles;
+   std::unordered_map<fs::FileHandle *, size_t> positions;
+};
+
+static void
+restoreClients(const SavedClients &saved)
+{
+   std::lock_guard<std::mutex> lock(sHandlesMutex);
+
+   // Anything opened since the snapshot was taken is not needed again
+   for (auto &client : sOpenHandles) {
+      for (auto file : client.second.files) {
+         if (file && !sSnapshotFiles.count(file)) {
+            file->close();
+            delete file;
+         }
+      }
+
+      for (auto folder : client.second.folders) {
+         if (folder && !sSnapshotFolders.count(folder)) {
+            folder->close();
+            delete folder;
+         }
+      }
+   }
+
+   sRetiredFiles.clear();
+   sRetiredFolders.clear();
+   sOpenHandles = saved.handles;
+   sClients = saved.clients;
+
+   // The contents of host files are not part of the snapshot, only where
+   //  each handle was in them.
+   for (auto &position : saved.positions) {
+      position.first->seek(position.second);
+   }
+
+   for (auto folder : sSnapshotFolders) {
+      folder->rewind();
+   }
+}
+
+void
+Module::initialiseFsClients()
+{
+   kernel::registerSnapshotState("filesystem clients", []() -> kernel::SnapshotRestoreFunction {
+      auto saved = std::make_shared<SavedClients>();
+      saved->clients = sClients;
+
+      {
+         std::lock_guard<std::mutex> lock(sHandlesMutex);
+         saved->handles = sOpenHandles;
+
+         for (auto &client : sOpenHandles) {
+            for (auto file : client.second.files) {
+               if (file) {
+                  saved->positions[file] = file->tell();
+                  sSnapshotFiles.insert(file);
+               }
+            }
+
+            for (auto folder : client.second.folders) {
+               if (folder) {
+                  sSnapshotFolders.insert(folder);
+               }
+            }
+         }
+      }
+
+      return [saved]() {
+         restoreClients(*saved);
+      };
+   });
+}
+
 namespace internal
 {
 
@@ -1,6 +1,4 @@
 #pragma once
-#include <mutex>
-#include <vector>
 #include "coreinit_fs.h"
 #include "filesystem/filesystem.h"
 
@@ -42,9 +40,6 @@ public:
 
 private:
    FSError mLastError;
-   std::mutex mMutex;
-   std::vector<fs::FileHandle *> mOpenFiles;
-   std::vector<fs::FolderHandle *> mOpenFolders;
 };
 
 static_assert(sizeof(FSClient) < 0x1700, "FSClient must be less than 0x1700 bytes");
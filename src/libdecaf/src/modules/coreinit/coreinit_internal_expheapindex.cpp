@@ -0,0 +1,211 @@
+#include "coreinit_internal_expheapindex.h"
+#include "common/decaf_assert.h"
+#include <algorithm>
+
+namespace coreinit
+{
+
+namespace internal
+{
+
+void
+ExpHeapFreeIndex::clear()
+{
+   mNodes.clear();
+   mUnusedNodes.clear();
+   mBySize.clear();
+   mRoot = InvalidNode;
+   mTotalSize = 0;
+}
+
+void
+ExpHeapFreeIndex::insert(uint32_t address,
+                         uint32_t size)
+{
+   int32_t left, right;
+   split(mRoot, address, left, right);
+   mRoot = merge(merge(left, newNode(address, size)), right);
+   mBySize.emplace(size, address);
+   mTotalSize += size;
+}
+
+void
+ExpHeapFreeIndex::erase(uint32_t address)
+{
+   int32_t left, middle, right;
+   split(mRoot, address, left, right);
+   split(right, address + 1, middle, right);
+   decaf_check(middle != InvalidNode);
+   decaf_check(mNodes[middle].left == InvalidNode && mNodes[middle].right == InvalidNode);
+
+   mBySize.erase({ mNodes[middle].size, address });
+   mTotalSize -= mNodes[middle].size;
+   mUnusedNodes.push_back(middle);
+   mRoot = merge(left, right);
+}
+
+void
+ExpHeapFreeIndex::resize(uint32_t address,
+                         uint32_t size)
+{
+   erase(address);
+   insert(address, size);
+}
+
+uint32_t
+ExpHeapFreeIndex::findFirst(uint32_t minSize,
+                            uint32_t minAddress) const
+{
+   auto node = findFirst(mRoot, minSize, minAddress);
+   return node == InvalidNode ? 0 : mNodes[node].address;
+}
+
+uint32_t
+ExpHeapFreeIndex::findPrevious(uint32_t address) const
+{
+   auto result = 0u;
+
+   for (auto node = mRoot; node != InvalidNode; ) {
+      if (mNodes[node].address < address) {
+         result = mNodes[node].address;
+         node = mNodes[node].right;
+      } else {
+         node = mNodes[node].left;
+      }
+   }
+
+   return result;
+}
+
+bool
+ExpHeapFreeIndex::contains(uint32_t address) const
+{
+   return find(mRoot, address) != InvalidNode;
+}
+
+int32_t
+ExpHeapFreeIndex::newNode(uint32_t address,
+                          uint32_t size)
+{
+   auto node = int32_t { 0 };
+
+   if (!mUnusedNodes.empty()) {
+      node = mUnusedNodes.back();
+      mUnusedNodes.pop_back();
+   } else {
+      node = static_cast<int32_t>(mNodes.size());
+      mNodes.emplace_back();
+   }
+
+   // xorshift32, the priorities only need to be well distributed
+   mSeed ^= mSeed << 13;
+   mSeed ^= mSeed >> 17;
+   mSeed ^= mSeed << 5;
+
+   mNodes[node] = Node { address, size, size, mSeed, InvalidNode, InvalidNode };
+   return node;
+}
+
+void
+ExpHeapFreeIndex::update(int32_t node)
+{
+   auto &info = mNodes[node];
+   info.maxSize = info.size;
+
+   if (info.left != InvalidNode) {
+      info.maxSize = std::max(info.maxSize, mNodes[info.left].maxSize);
+   }
+
+   if (info.right != InvalidNode) {
+      info.maxSize = std::max(info.maxSize, mNodes[info.right].maxSize);
+   }
+}
+
+//! Splits node into nodes below address and nodes at or above address
+void
+ExpHeapFreeIndex::split(int32_t node,
+                        uint32_t address,
+                        int32_t &left,
+                        int32_t &right)
+{
+   if (node == InvalidNode) {
+      left = InvalidNode;
+      right = InvalidNode;
+   } else if (mNodes[node].address < address) {
+      split(mNodes[node].right, address, mNodes[node].right, right);
+      left = node;
+      update(node);
+   } else {
+      split(mNodes[node].left, address, left, mNodes[node].left);
+      right = node;
+      update(node);
+   }
+}
+
+//! Merges two treaps where every node in left is below every node in right
+int32_t
+ExpHeapFreeIndex::merge(int32_t left,
+                        int32_t right)
+{
+   if (left == InvalidNode) {
+      return right;
+   } else if (right == InvalidNode) {
+      return left;
+   } else if (mNodes[left].priority > mNodes[right].priority) {
+      mNodes[left].right = merge(mNodes[left].right, right);
+      update(left);
+      return left;
+   } else {
+      mNodes[right].left = merge(left, mNodes[right].left);
+      update(right);
+      return right;
+   }
+}
+
+int32_t
+ExpHeapFreeIndex::find(int32_t node,
+                       uint32_t address) const
+{
+   while (node != InvalidNode && mNodes[node].address != address) {
+      if (address < mNodes[node].address) {
+         node = mNodes[node].left;
+      } else {
+         node = mNodes[node].right;
+      }
+   }
+
+   return node;
+}
+
+int32_t
+ExpHeapFreeIndex::findFirst(int32_t node,
+                            uint32_t minSize,
+                            uint32_t minAddress) const
+{
+   while (node != InvalidNode && mNodes[node].maxSize >= minSize) {
+      auto &info = mNodes[node];
+
+      if (info.address < minAddress) {
+         node = info.right;
+         continue;
+      }
+
+      auto result = findFirst(info.left, minSize, minAddress);
+
+      if (result != InvalidNode) {
+         return result;
+      }
+
+      if (info.size >= minSize) {
+         return node;
+      }
+
+      node = info.right;
+   }
+
+   return InvalidNode;
+}
+
+} // namespace internal
+
+} // namespace coreinit
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace coreinit
+{
+
+namespace internal
+{
+
+/**
+ * A host side index of the free blocks in an expanded heap.
+ *
+ * The guest free list is still kept exactly as it always was, this just
+ * mirrors it so that allocation does not have to walk the whole list.
+ *
+ * Blocks are stored in a treap ordered by address where every node knows the
+ * largest block in its subtree, which lets us find the first block of at least
+ * a given size in address order. A second set ordered by size is used for
+ * best fit searches.
+ */
+class ExpHeapFreeIndex
+{
+   static const int32_t InvalidNode = -1;
+
+   struct Node
+   {
+      uint32_t address;
+      uint32_t size;
+      uint32_t maxSize;
+      uint32_t priority;
+      int32_t left;
+      int32_t right;
+   };
+
+public:
+   using SizeIterator = std::set<std::pair<uint32_t, uint32_t>>::const_iterator;
+
+   void
+   clear();
+
+   void
+   insert(uint32_t address,
+          uint32_t size);
+
+   void
+   erase(uint32_t address);
+
+   void
+   resize(uint32_t address,
+          uint32_t size);
+
+   //! Returns the address of the first block at or after minAddress with a
+   //!  size of at least minSize, or 0 if there is none.
+   uint32_t
+   findFirst(uint32_t minSize,
+             uint32_t minAddress) const;
+
+   //! Returns the address of the last block before address, or 0 if there is
+   //!  none.
+   uint32_t
+   findPrevious(uint32_t address) const;
+
+   bool
+   contains(uint32_t address) const;
+
+   //! Iterates blocks ordered by size and then address
+   SizeIterator
+   sizeBegin(uint32_t minSize) const
+   {
+      return mBySize.lower_bound({ minSize, 0 });
+   }
+
+   SizeIterator
+   sizeEnd() const
+   {
+      return mBySize.end();
+   }
+
+   uint32_t
+   totalSize() const
+   {
+      return mTotalSize;
+   }
+
+private:
+   int32_t
+   newNode(uint32_t address,
+           uint32_t size);
+
+   void
+   update(int32_t node);
+
+   void
+   split(int32_t node,
+         uint32_t address,
+         int32_t &left,
+         int32_t &right);
+
+   int32_t
+   merge(int32_t left,
+         int32_t right);
+
+   int32_t
+   find(int32_t node,
+        uint32_t address) const;
+
+   int32_t
+   findFirst(int32_t node,
+             uint32_t minSize,
+             uint32_t minAddress) const;
+
+private:
+   std::vector<Node> mNodes;
+   std::vector<int32_t> mUnusedNodes;
+   std::set<std::pair<uint32_t, uint32_t>> mBySize;
+   int32_t mRoot = InvalidNode;
+   uint32_t mSeed = 0x2545F491;
+   uint32_t mTotalSize = 0;
+};
+
+} // namespace internal
+
+} // namespace coreinit
@@ -1,4 +1,5 @@
 #include "coreinit_internal_idlock.h"
+#include "common/adaptive_spinlock.h"
 #include "libcpu/mem.h"
 
 namespace coreinit
@@ -7,20 +8,19 @@ namespace coreinit
 namespace internal
 {
 
+static SpinLockStats
+sIdLockStats { "IdLock" };
+
 void
 acquireIdLock(IdLock &lock, uint32_t id)
 {
-   uint32_t expected = 0;
-
-   while (!lock.owner.compare_exchange_weak(expected, id, std::memory_order_acquire)) {
-      expected = 0;
-   }
+   spinlock_acquire(lock.owner, id, sIdLockStats);
 }
 
 void
 releaseIdLock(IdLock &lock, uint32_t id)
 {
-   lock.owner.store(0, std::memory_order_release);
+   spinlock_release(lock.owner);
 }
 
 void
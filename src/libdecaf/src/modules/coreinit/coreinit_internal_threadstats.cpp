@@ -0,0 +1,182 @@
+#include "coreinit_internal_threadstats.h"
+#include "coreinit_scheduler.h"
+#include "coreinit_thread.h"
+#include "common/decaf_assert.h"
+#include "libcpu/mem.h"
+#include <chrono>
+#include <unordered_map>
+
+namespace coreinit
+{
+
+namespace internal
+{
+
+using ThreadStatsClock = std::chrono::high_resolution_clock;
+
+enum class ThreadStatsState
+{
+   None,
+   Running,
+   Ready,
+   Waiting,
+};
+
+struct ThreadStatsEntry
+{
+   ThreadStats stats;
+   ThreadStatsState state = ThreadStatsState::None;
+   ThreadWaitReason waitReason = ThreadWaitReason::Other;
+   ThreadStatsClock::time_point stateStart;
+   uint32_t lastCore = 0xFF;
+};
+
+static std::unordered_map<uint32_t, ThreadStatsEntry>
+sThreadStats;
+
+static const char *
+sThreadWaitReasonNames[] = {
+   "Other",
+   "Mutex",
+   "Condition",
+   "Event",
+   "MessageQueue",
+   "Semaphore",
+   "Join",
+   "Sleep",
+   "Alarm",
+   "Suspend",
+};
+
+static_assert(sizeof(sThreadWaitReasonNames) / sizeof(sThreadWaitReasonNames[0]) == static_cast<size_t>(ThreadWaitReason::Max),
+              "Every ThreadWaitReason needs a name");
+
+static ThreadStatsEntry &
+getEntry(OSThread *thread)
+{
+   return sThreadStats[mem::untranslate(thread)];
+}
+
+// Adds the time spent in the current state to the totals and starts a new one
+static void
+changeState(ThreadStatsEntry &entry,
+            ThreadStatsState state,
+            ThreadStatsClock::time_point now)
+{
+   auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - entry.stateStart).count());
+
+   switch (entry.state) {
+   case ThreadStatsState::Running:
+      entry.stats.runTimeNs += elapsed;
+      break;
+   case ThreadStatsState::Ready:
+      entry.stats.readyTimeNs += elapsed;
+      break;
+   case ThreadStatsState::Waiting:
+      entry.stats.blockedTimeNs[static_cast<size_t>(entry.waitReason)] += elapsed;
+      break;
+   case ThreadStatsState::None:
+      break;
+   }
+
+   entry.state = state;
+   entry.stateStart = now;
+}
+
+const char *
+threadWaitReasonName(ThreadWaitReason reason)
+{
+   decaf_check(reason < ThreadWaitReason::Max);
+   return sThreadWaitReasonNames[static_cast<size_t>(reason)];
+}
+
+void
+resetThreadStatsNoLock(OSThread *thread)
+{
+   decaf_check(isSchedulerLocked());
+   getEntry(thread) = ThreadStatsEntry { };
+}
+
+void
+removeThreadStatsNoLock(OSThread *thread)
+{
+   decaf_check(isSchedulerLocked());
+   sThreadStats.erase(mem::untranslate(thread));
+}
+
+void
+recordThreadReadyNoLock(OSThread *thread)
+{
+   auto &entry = getEntry(thread);
+
+   if (entry.state == ThreadStatsState::Ready) {
+      // Requeued after a priority or affinity change
+      return;
+   }
+
+   if (entry.state == ThreadStatsState::Running) {
+      entry.stats.preemptCount++;
+   }
+
+   changeState(entry, ThreadStatsState::Ready, ThreadStatsClock::now());
+}
+
+void
+recordThreadWaitNoLock(OSThread *thread,
+                       ThreadWaitReason reason)
+{
+   auto &entry = getEntry(thread);
+   changeState(entry, ThreadStatsState::Waiting, ThreadStatsClock::now());
+   entry.waitReason = reason;
+}
+
+void
+recordThreadSwitchNoLock(uint32_t coreId,
+                         OSThread *previous,
+                         OSThread *next)
+{
+   auto now = ThreadStatsClock::now();
+
+   // If the previous thread did not become ready or start waiting then it
+   //  has exited or been suspended, which we do not count as either.
+   if (previous) {
+      auto itr = sThreadStats.find(mem::untranslate(previous));
+
+      if (itr != sThreadStats.end() && itr->second.state == ThreadStatsState::Running) {
+         changeState(itr->second, ThreadStatsState::None, now);
+      }
+   }
+
+   if (next) {
+      auto &entry = getEntry(next);
+      changeState(entry, ThreadStatsState::Running, now);
+      entry.stats.switchCount++;
+
+      if (entry.lastCore != 0xFF && entry.lastCore != coreId) {
+         entry.stats.migrationCount++;
+      }
+
+      entry.lastCore = coreId;
+   }
+}
+
+bool
+getThreadStatsNoLock(OSThread *thread,
+                     ThreadStats &stats)
+{
+   auto itr = sThreadStats.find(mem::untranslate(thread));
+
+   if (itr == sThreadStats.end()) {
+      return false;
+   }
+
+   // Work on a copy so the time in the current state is not counted twice
+   auto entry = itr->second;
+   changeState(entry, ThreadStatsState::None, ThreadStatsClock::now());
+   stats = entry.stats;
+   return true;
+}
+
+} // namespace internal
+
+} // namespace coreinit
@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+namespace coreinit
+{
+
+struct OSThread;
+
+namespace internal
+{
+
+/**
+ * Host side accounting of how guest threads spend their time.
+ *
+ * This is kept in a table keyed by the OSThread address rather than in the
+ * OSThread itself so that the guest structure keeps its real layout. All of
+ * these must be called with the scheduler lock held.
+ */
+
+enum class ThreadWaitReason : uint32_t
+{
+   Other,
+   Mutex,
+   Condition,
+   Event,
+   MessageQueue,
+   Semaphore,
+   Join,
+   Sleep,
+   Alarm,
+   Suspend,
+   Max,
+};
+
+struct ThreadStats
+{
+   //! Time spent running on a core
+   uint64_t runTimeNs = 0;
+
+   //! Time spent in a run queue waiting for a core
+   uint64_t readyTimeNs = 0;
+
+   //! Time spent waiting, by what was waited on
+   std::array<uint64_t, static_cast<size_t>(ThreadWaitReason::Max)> blockedTimeNs = { };
+
+   //! Number of times the thread was switched onto a core
+   uint64_t switchCount = 0;
+
+   //! Number of times the thread was switched out while still runnable
+   uint64_t preemptCount = 0;
+
+   //! Number of times the thread ran on a different core to last time
+   uint64_t migrationCount = 0;
+};
+
+const char *
+threadWaitReasonName(ThreadWaitReason reason);
+
+void
+resetThreadStatsNoLock(OSThread *thread);
+
+void
+removeThreadStatsNoLock(OSThread *thread);
+
+void
+recordThreadReadyNoLock(OSThread *thread);
+
+void
+recordThreadWaitNoLock(OSThread *thread,
+                       ThreadWaitReason reason);
+
+void
+recordThreadSwitchNoLock(uint32_t coreId,
+                         OSThread *previous,
+                         OSThread *next);
+
+//! Returns the stats for thread including the time spent in its current state
+bool
+getThreadStatsNoLock(OSThread *thread,
+                     ThreadStats &stats);
+
+} // namespace internal
+
+} // namespace coreinit
@@ -1,8 +1,10 @@
 #include <array>
+#include <vector>
 #include "coreinit.h"
 #include "coreinit_core.h"
 #include "coreinit_lockedcache.h"
 #include "coreinit_thread.h"
+#include "kernel/kernel_snapshot.h"
 #include "libcpu/mem.h"
 #include "common/teenyheap.h"
 
@@ -194,6 +196,23 @@ Module::initialiseLockedCache()
    for (auto i = 0u; i < CoreCount; ++i) {
       sLockedCache[i] = new TeenyHeap(base + (sLockedCacheSize * i), sLockedCacheSize);
    }
+
+   kernel::registerSnapshotState("locked cache", []() -> kernel::SnapshotRestoreFunction {
+      auto dmaEnabled = sDMAEnabled;
+      auto states = std::vector<TeenyHeap::State> { };
+
+      for (auto cache : sLockedCache) {
+         states.push_back(cache->saveState());
+      }
+
+      return [=]() {
+         sDMAEnabled = dmaEnabled;
+
+         for (auto i = 0u; i < CoreCount; ++i) {
+            sLockedCache[i]->restoreState(states[i]);
+         }
+      };
+   });
 }
 
 void
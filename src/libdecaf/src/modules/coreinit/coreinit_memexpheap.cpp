@@ -1,9 +1,14 @@
 #include "coreinit.h"
+#include "coreinit_internal_expheapindex.h"
 #include "coreinit_memexpheap.h"
 #include "common/bitfield.h"
+#include "decaf_config.h"
+#include "kernel/kernel_snapshot.h"
 #include "libcpu/mem.h"
 #include "common/align.h"
 #include "virtual_ptr.h"
+#include <mutex>
+#include <unordered_map>
 
 namespace coreinit
 {
@@ -14,6 +19,30 @@ FreeTag = 0x4654; // 'FR'
 static const auto
 UsedTag = 0x5544; // 'UD'
 
+static std::mutex
+sFreeIndexMutex;
+
+static std::unordered_map<uint32_t, internal::ExpHeapFreeIndex>
+sFreeIndices;
+
+/**
+ * Get the host side free block index for a heap, or nullptr if it has none.
+ *
+ * Callers must hold the heap lock while using the index.
+ */
+static internal::ExpHeapFreeIndex *
+getFreeIndex(MEMExpHeap *heap)
+{
+   std::unique_lock<std::mutex> lock { sFreeIndexMutex };
+   auto itr = sFreeIndices.find(mem::untranslate(heap));
+
+   if (itr == sFreeIndices.end()) {
+      return nullptr;
+   }
+
+   return &itr->second;
+}
+
 static uint8_t *
 getBlockMemStart(MEMExpHeapBlock *block)
 {
@@ -103,6 +132,43 @@ removeBlock(MEMExpHeapBlockList *list,
    block->next = nullptr;
 }
 
+static void
+insertFreeBlock(MEMExpHeap *heap,
+                internal::ExpHeapFreeIndex *index,
+                MEMExpHeapBlock *prev,
+                MEMExpHeapBlock *block)
+{
+   insertBlock(&heap->freeList, prev, block);
+
+   if (index) {
+      index->insert(mem::untranslate(block), block->blockSize);
+   }
+}
+
+static void
+removeFreeBlock(MEMExpHeap *heap,
+                internal::ExpHeapFreeIndex *index,
+                MEMExpHeapBlock *block)
+{
+   removeBlock(&heap->freeList, block);
+
+   if (index) {
+      index->erase(mem::untranslate(block));
+   }
+}
+
+static void
+growFreeBlock(internal::ExpHeapFreeIndex *index,
+              MEMExpHeapBlock *block,
+              uint32_t size)
+{
+   block->blockSize += size;
+
+   if (index) {
+      index->resize(mem::untranslate(block), block->blockSize);
+   }
+}
+
 static uint32_t
 getAlignedBlockSize(MEMExpHeapBlock *block,
                     uint32_t alignment,
@@ -135,6 +201,7 @@ getAlignedBlockSize(MEMExpHeapBlock *block,
 
 static MEMExpHeapBlock *
 createUsedBlockFromFreeBlock(MEMExpHeap *heap,
+                             internal::ExpHeapFreeIndex *index,
                              MEMExpHeapBlock *freeBlock,
                              uint32_t size,
                              uint32_t alignment,
@@ -144,13 +211,13 @@ createUsedBlockFromFreeBlock(MEMExpHeap *heap,
    auto expHeapAttribs = heap->attribs.value();
    auto freeBlockAttribs = freeBlock->attribs.value();
 
-   auto freeBlockPrev = freeBlock->prev;
+   MEMExpHeapBlock *freeBlockPrev = freeBlock->prev;
    auto freeMemStart = getBlockMemStart(freeBlock);
    auto freeMemEnd = getBlockMemEnd(freeBlock);
 
    // Free blocks should never have alignment...
    decaf_check(!freeBlockAttribs.alignment());
-   removeBlock(&heap->freeList, freeBlock);
+   removeFreeBlock(heap, index, freeBlock);
 
    // Find where we are going to start
    uint8_t *alignedDataStart = nullptr;
@@ -184,8 +251,11 @@ createUsedBlockFromFreeBlock(MEMExpHeap *heap,
          freeBlock->prev = nullptr;
          freeBlock->tag = FreeTag;
 
-         insertBlock(&heap->freeList, freeBlockPrev, freeBlock);
+         insertFreeBlock(heap, index, freeBlockPrev, freeBlock);
          topSpaceRemain = 0;
+
+         // Keep the free list sorted if we also release the bottom space
+         freeBlockPrev = freeBlock;
       }
    }
 
@@ -201,7 +271,7 @@ createUsedBlockFromFreeBlock(MEMExpHeap *heap,
          freeBlock->prev = nullptr;
          freeBlock->tag = FreeTag;
 
-         insertBlock(&heap->freeList, freeBlockPrev, freeBlock);
+         insertFreeBlock(heap, index, freeBlockPrev, freeBlock);
          bottomSpaceRemain = 0;
       }
    }
@@ -227,8 +297,9 @@ createUsedBlockFromFreeBlock(MEMExpHeap *heap,
    return alignedBlock;
 }
 
-void
+static void
 releaseMemory(MEMExpHeap *heap,
+              internal::ExpHeapFreeIndex *index,
               uint8_t *memStart,
               uint8_t *memEnd)
 {
@@ -245,12 +316,19 @@ releaseMemory(MEMExpHeap *heap,
    MEMExpHeapBlock *prevBlock = nullptr;
    MEMExpHeapBlock *nextBlock = heap->freeList.head;
 
-   for (auto block = heap->freeList.head; block; block = block->next) {
-      if (getBlockMemStart(block) < memStart) {
-         prevBlock = block;
-         nextBlock = block->next;
-      } else if (block >= prevBlock) {
-         break;
+   if (index) {
+      if (auto prevAddress = index->findPrevious(mem::untranslate(memStart))) {
+         prevBlock = mem::translate<MEMExpHeapBlock>(prevAddress);
+         nextBlock = prevBlock->next;
+      }
+   } else {
+      for (auto block = heap->freeList.head; block; block = block->next) {
+         if (getBlockMemStart(block) < memStart) {
+            prevBlock = block;
+            nextBlock = block->next;
+         } else if (block >= prevBlock) {
+            break;
+         }
       }
    }
 
@@ -263,7 +341,7 @@ releaseMemory(MEMExpHeap *heap,
 
       if (memStart == prevMemEnd) {
          // Previous block absorbs the new memory
-         prevBlock->blockSize += memEnd - memStart;
+         growFreeBlock(index, prevBlock, static_cast<uint32_t>(memEnd - memStart));
 
          // Our free block becomes the previous one
          freeBlock = prevBlock;
@@ -280,7 +358,7 @@ releaseMemory(MEMExpHeap *heap,
       freeBlock->prev = nullptr;
       freeBlock->tag = FreeTag;
 
-      insertBlock(&heap->freeList, prevBlock, freeBlock);
+      insertFreeBlock(heap, index, prevBlock, freeBlock);
    }
 
    if (nextBlock) {
@@ -292,9 +370,8 @@ releaseMemory(MEMExpHeap *heap,
          // The next block needs to be merged into the freeBlock, as they
          //  are directly adjacent to each other in memory.
          auto nextBlockEnd = getBlockMemEnd(nextBlock);
-         freeBlock->blockSize += nextBlockEnd - nextBlockStart;
-
-         removeBlock(&heap->freeList, nextBlock);
+         removeFreeBlock(heap, index, nextBlock);
+         growFreeBlock(index, freeBlock, static_cast<uint32_t>(nextBlockEnd - nextBlockStart));
       }
    }
 }
@@ -343,6 +420,13 @@ MEMCreateExpHeapEx(void *base,
    heap->groupId = 0;
    heap->attribs = MEMExpHeapAttribs::get(0);
 
+   if (decaf::config::system::expheap_free_index) {
+      std::unique_lock<std::mutex> lock { sFreeIndexMutex };
+      auto &index = sFreeIndices[mem::untranslate(heap)];
+      index.clear();
+      index.insert(mem::untranslate(firstBlock), firstBlock->blockSize);
+   }
+
    return heap;
 }
 
@@ -352,37 +436,26 @@ MEMDestroyExpHeap(MEMExpHeap *heap)
    decaf_check(heap);
    decaf_check(heap->header.tag == MEMHeapTag::ExpandedHeap);
    internal::unregisterHeap(&heap->header);
+
+   std::unique_lock<std::mutex> lock { sFreeIndexMutex };
+   sFreeIndices.erase(mem::untranslate(heap));
    return heap;
 }
 
-void *
-MEMAllocFromExpHeapEx(MEMExpHeap *heap,
-                      uint32_t size,
-                      int32_t alignment)
+static MEMExpHeapBlock *
+findFreeBlock(MEMExpHeap *heap,
+              internal::ExpHeapFreeIndex *index,
+              uint32_t size,
+              uint32_t alignment,
+              MEMExpHeapDirection dir)
 {
-   decaf_check(heap->header.tag == MEMHeapTag::ExpandedHeap);
    auto expHeapFlags = heap->attribs.value();
+   MEMExpHeapBlock *foundBlock = nullptr;
+   auto bestAlignedSize = 0xFFFFFFFFu;
 
-   if (size == 0) {
-      size = 1;
-   }
-
-   decaf_check(alignment != 0);
-
-   internal::HeapLock lock(&heap->header);
-   MEMExpHeapBlock *newBlock = nullptr;
-
-   size = align_up(size, 4);
-
-   if (alignment > 0) {
-      MEMExpHeapBlock *foundBlock = nullptr;
-      uint32_t bestAlignedSize = 0xFFFFFFFF;
-
-      alignment = std::max(4, alignment);
-      decaf_check((alignment & 0x3) == 0);
-
+   if (!index) {
       for (auto block = heap->freeList.head; block; block = block->next) {
-         auto alignedSize = getAlignedBlockSize(block, alignment, MEMExpHeapDirection::FromStart);
+         auto alignedSize = getAlignedBlockSize(block, alignment, dir);
 
          if (alignedSize >= size) {
             if (expHeapFlags.allocMode() == MEMExpHeapMode::FirstFree) {
@@ -397,37 +470,86 @@ MEMAllocFromExpHeapEx(MEMExpHeap *heap,
          }
       }
 
-      if (foundBlock) {
-         newBlock = createUsedBlockFromFreeBlock(heap, foundBlock, size, alignment, MEMExpHeapDirection::FromStart);
+      return foundBlock;
+   }
+
+   // The index must pick exactly the same block as walking the free list
+   //  would, so that the guest heap ends up looking exactly the same.
+   if (expHeapFlags.allocMode() == MEMExpHeapMode::FirstFree) {
+      // Aligning can only make a block smaller, so check each block big
+      //  enough before alignment in address order.
+      for (auto address = index->findFirst(size, 0); address; address = index->findFirst(size, address + 1)) {
+         auto block = mem::translate<MEMExpHeapBlock>(address);
+
+         if (getAlignedBlockSize(block, alignment, dir) >= size) {
+            return block;
+         }
       }
    } else {
-      alignment = std::max(4, -alignment);
-      decaf_check((alignment & 0x3) == 0);
+      auto bestAddress = 0u;
 
-      MEMExpHeapBlock *foundBlock = nullptr;
-      auto bestAlignedSize = 0xFFFFFFFFu;
+      // Blocks are visited smallest first, alignment can waste at most
+      //  alignment - 4 bytes so we can stop once no block could be better.
+      for (auto itr = index->sizeBegin(size); itr != index->sizeEnd(); ++itr) {
+         auto blockSize = itr->first;
+         auto address = itr->second;
 
-      for (auto block = heap->freeList.head; block; block = block->next) {
-         auto alignedSize = getAlignedBlockSize(block, alignment, MEMExpHeapDirection::FromEnd);
+         if (foundBlock && static_cast<uint64_t>(blockSize) > static_cast<uint64_t>(bestAlignedSize) + alignment - 4) {
+            break;
+         }
 
-         if (alignedSize >= size) {
-            if (expHeapFlags.allocMode() == MEMExpHeapMode::FirstFree) {
-               foundBlock = block;
-               break;
-            } else {
-               if (alignedSize < bestAlignedSize) {
-                  foundBlock = block;
-                  bestAlignedSize = alignedSize;
-               }
-            }
+         auto block = mem::translate<MEMExpHeapBlock>(address);
+         auto alignedSize = getAlignedBlockSize(block, alignment, dir);
+
+         if (alignedSize < size) {
+            continue;
          }
-      }
 
-      if (foundBlock) {
-         newBlock = createUsedBlockFromFreeBlock(heap, foundBlock, size, alignment, MEMExpHeapDirection::FromEnd);
+         // Walking the list would keep the lowest address of equal sizes
+         if (alignedSize < bestAlignedSize || (alignedSize == bestAlignedSize && address < bestAddress)) {
+            foundBlock = block;
+            bestAlignedSize = alignedSize;
+            bestAddress = address;
+         }
       }
    }
 
+   return foundBlock;
+}
+
+void *
+MEMAllocFromExpHeapEx(MEMExpHeap *heap,
+                      uint32_t size,
+                      int32_t alignment)
+{
+   decaf_check(heap->header.tag == MEMHeapTag::ExpandedHeap);
+
+   if (size == 0) {
+      size = 1;
+   }
+
+   decaf_check(alignment != 0);
+
+   internal::HeapLock lock(&heap->header);
+   auto index = getFreeIndex(heap);
+   auto dir = MEMExpHeapDirection::FromStart;
+   MEMExpHeapBlock *newBlock = nullptr;
+
+   size = align_up(size, 4);
+
+   if (alignment > 0) {
+      alignment = std::max(4, alignment);
+   } else {
+      alignment = std::max(4, -alignment);
+      dir = MEMExpHeapDirection::FromEnd;
+   }
+
+   decaf_check((alignment & 0x3) == 0);
+
+   if (auto foundBlock = findFreeBlock(heap, index, size, alignment, dir)) {
+      newBlock = createUsedBlockFromFreeBlock(heap, index, foundBlock, size, alignment, dir);
+   }
+
    if (!newBlock) {
       MEMDumpHeap(&heap->header);
       return nullptr;
@@ -460,7 +582,7 @@ MEMFreeToExpHeap(MEMExpHeap *heap,
    removeBlock(&heap->usedList, block);
 
    // Release the memory back to the heap free list
-   releaseMemory(heap, memStart, memEnd);
+   releaseMemory(heap, getFreeIndex(heap), memStart, memEnd);
 }
 
 MEMExpHeapMode
@@ -507,6 +629,10 @@ MEMAdjustExpHeap(MEMExpHeap *heap)
       lastFreeBlock->prev->next = nullptr;
    }
 
+   if (auto index = getFreeIndex(heap)) {
+      index->erase(mem::untranslate(lastFreeBlock));
+   }
+
    // Move the heaps end pointer to the true start point of this block
    heap->header.dataEnd = getBlockMemStart(lastFreeBlock);
 
@@ -525,6 +651,7 @@ MEMResizeForMBlockExpHeap(MEMExpHeap *heap,
 
    auto heapAttribs = heap->header.attribs.value();
    auto block = getUsedMemBlock(address);
+   auto index = getFreeIndex(heap);
 
    if (size < block->blockSize) {
       auto releasedSpace = block->blockSize - size;
@@ -535,23 +662,30 @@ MEMResizeForMBlockExpHeap(MEMExpHeap *heap,
 
          block->blockSize -= releasedSpace;
 
-         releaseMemory(heap, releasedMemStart, releasedMemEnd);
+         releaseMemory(heap, index, releasedMemStart, releasedMemEnd);
       }
    } else if (size > block->blockSize) {
       auto blockMemEnd = getBlockMemEnd(block);
 
       MEMExpHeapBlock *freeBlock = nullptr;
-      for (auto i = heap->freeList.head; i; i = i->next) {
-         auto freeBlockMemStart = getBlockMemStart(i);
 
-         if (freeBlockMemStart == blockMemEnd) {
-            freeBlock = i;
-            break;
+      if (index) {
+         if (index->contains(mem::untranslate(blockMemEnd))) {
+            freeBlock = reinterpret_cast<MEMExpHeapBlock *>(blockMemEnd);
          }
+      } else {
+         for (auto i = heap->freeList.head; i; i = i->next) {
+            auto freeBlockMemStart = getBlockMemStart(i);
 
-         // Free list is sorted, so we only need to search a little bit
-         if (freeBlockMemStart > blockMemEnd) {
-            break;
+            if (freeBlockMemStart == blockMemEnd) {
+               freeBlock = i;
+               break;
+            }
+
+            // Free list is sorted, so we only need to search a little bit
+            if (freeBlockMemStart > blockMemEnd) {
+               break;
+            }
          }
       }
 
@@ -565,7 +699,7 @@ MEMResizeForMBlockExpHeap(MEMExpHeap *heap,
       auto freeMemSize = freeBlockMemEnd - freeBlockMemStart;
 
       // Drop the free block from the list of free regions
-      removeBlock(&heap->freeList, freeBlock);
+      removeFreeBlock(heap, index, freeBlock);
 
       // Adjust the sizing of the free area and the block
       auto newAllocSize = (size - block->blockSize);
@@ -583,7 +717,7 @@ MEMResizeForMBlockExpHeap(MEMExpHeap *heap,
       //  the memory back to the heap.  Otherwise we just tack the remainder
       //  onto the end of the block we resized.
       if (freeMemSize >= sizeof(MEMExpHeapBlock) + 0x4) {
-         releaseMemory(heap, freeBlockMemEnd - freeMemSize, freeBlockMemEnd);
+         releaseMemory(heap, index, freeBlockMemEnd - freeMemSize, freeBlockMemEnd);
       } else {
          block->blockSize += freeMemSize;
       }
@@ -598,6 +732,10 @@ MEMGetTotalFreeSizeForExpHeap(MEMExpHeap *heap)
    internal::HeapLock lock(&heap->header);
    auto freeSize = 0u;
 
+   if (auto index = getFreeIndex(heap)) {
+      return index->totalSize();
+   }
+
    for (auto block = heap->freeList.head; block; block = block->next) {
       freeSize += block->blockSize;
    }
@@ -610,25 +748,34 @@ MEMGetAllocatableSizeForExpHeapEx(MEMExpHeap *heap,
                                   int32_t alignment)
 {
    internal::HeapLock lock(&heap->header);
+   auto index = getFreeIndex(heap);
+   auto dir = MEMExpHeapDirection::FromStart;
    auto largestFree = 0u;
 
-   if (alignment > 0) {
-      decaf_check((alignment & 0x3) == 0);
+   if (alignment < 0) {
+      alignment = -alignment;
+      dir = MEMExpHeapDirection::FromEnd;
+   }
 
-      for (auto block = heap->freeList.head; block; block = block->next) {
-         auto alignedSize = getAlignedBlockSize(block, alignment, MEMExpHeapDirection::FromStart);
+   decaf_check((alignment & 0x3) == 0);
 
-         if (alignedSize > largestFree) {
-            largestFree = alignedSize;
+   if (index) {
+      // Visit the largest blocks first, aligning can only make them smaller
+      auto smallest = index->sizeBegin(0);
+
+      for (auto itr = index->sizeEnd(); itr != smallest; ) {
+         --itr;
+
+         if (itr->first <= largestFree) {
+            break;
          }
+
+         auto block = mem::translate<MEMExpHeapBlock>(itr->second);
+         largestFree = std::max(largestFree, getAlignedBlockSize(block, alignment, dir));
       }
    } else {
-      alignment = -alignment;
-
-      decaf_check((alignment & 0x3) == 0);
-
       for (auto block = heap->freeList.head; block; block = block->next) {
-         auto alignedSize = getAlignedBlockSize(block, alignment, MEMExpHeapDirection::FromEnd);
+         auto alignedSize = getAlignedBlockSize(block, alignment, dir);
 
          if (alignedSize > largestFree) {
             largestFree = alignedSize;
@@ -709,6 +856,20 @@ dumpExpandedHeap(MEMExpHeap *heap)
 
 } // namespace internal
 
+void
+Module::initialiseExpHeap()
+{
+   kernel::registerSnapshotState("expanded heap indices", []() -> kernel::SnapshotRestoreFunction {
+      std::unique_lock<std::mutex> lock { sFreeIndexMutex };
+      auto freeIndices = sFreeIndices;
+
+      return [=]() {
+         std::unique_lock<std::mutex> lock { sFreeIndexMutex };
+         sFreeIndices = freeIndices;
+      };
+   });
+}
+
 void
 Module::registerExpHeapFunctions()
 {
@@ -1,10 +1,13 @@
+#include "common/fast_memory.h"
 #include "common/platform_memory.h"
 #include "common/teenyheap.h"
 #include "coreinit.h"
 #include "coreinit_memory.h"
 #include "coreinit_core.h"
 #include "kernel/kernel_memory.h"
+#include "kernel/kernel_snapshot.h"
 #include "libcpu/mem.h"
+#include <vector>
 
 namespace coreinit
 {
@@ -41,6 +44,7 @@ struct VallocAllocation
    uint32_t virtAddress;
    uint32_t physAddress;
    uint32_t size;
+   MEMProtectMode mode;
 };
 
 static uint8_t *
@@ -55,35 +59,35 @@ sVallocAllocs;
 void *
 OSBlockMove(void *dst, const void *src, ppcsize_t size, BOOL flush)
 {
-   std::memmove(dst, src, size);
+   fast_memmove(dst, src, size);
    return dst;
 }
 
 void *
 OSBlockSet(void *dst, uint8_t val, ppcsize_t size)
 {
-   std::memset(dst, val, size);
+   fast_memset(dst, val, size);
    return dst;
 }
 
 static void *
 coreinit_memmove(void *dst, const void *src, ppcsize_t size)
 {
-   std::memmove(dst, src, size);
+   fast_memmove(dst, src, size);
    return dst;
 }
 
 static void *
 coreinit_memcpy(void *dst, const void *src, ppcsize_t size)
 {
-   std::memcpy(dst, src, size);
+   fast_memcpy(dst, src, size);
    return dst;
 }
 
 static void *
 coreinit_memset(void *dst, int val, ppcsize_t size)
 {
-   std::memset(dst, val, size);
+   fast_memset(dst, val, size);
    return dst;
 }
 
@@ -233,7 +237,7 @@ OSMapMemory(ppcaddr_t virtAddress,
    }
 
    // Store the allocation
-   auto alloc = VallocAllocation { virtAddress, physAddress, size };
+   auto alloc = VallocAllocation { virtAddress, physAddress, size, mode };
    sVallocAllocs.emplace_back(alloc);
 
    return TRUE;
@@ -281,6 +285,62 @@ OSUnmapMemory(ppcaddr_t virtAddress,
    return TRUE;
 }
 
+static void
+unmapAllVallocMemory()
+{
+   for (auto &alloc : sVallocAllocs) {
+      platform::protectMemory(mem::base() + alloc.virtAddress, alloc.size, platform::ProtectFlags::NoAccess);
+   }
+
+   sVallocAllocs.clear();
+}
+
+void
+Module::initialiseMemory()
+{
+   // The mapped virtual region is outside of the regions a snapshot copies,
+   //  and the physical memory behind it is only on the host.
+   kernel::registerSnapshotState("virtual memory", []() -> kernel::SnapshotRestoreFunction {
+      if (!sPhysDataStore) {
+         return []() {
+            if (sPhysDataStore) {
+               unmapAllVallocMemory();
+               std::memset(sPhysDataStore, 0, VALLOC_PHYS_MEM_SIZE);
+               delete sVallocVirtualMemHeap;
+               sVallocVirtualMemHeap = new TeenyHeap(mem::translate(VALLOC_VIRT_MEM_START), VALLOC_VIRT_MEM_SIZE);
+            }
+         };
+      }
+
+      auto physData = std::vector<uint8_t> { sPhysDataStore, sPhysDataStore + VALLOC_PHYS_MEM_SIZE };
+      auto heapState = sVallocVirtualMemHeap->saveState();
+      auto allocs = sVallocAllocs;
+      auto mappedData = std::vector<std::vector<uint8_t>> { };
+
+      for (auto &alloc : allocs) {
+         auto data = mem::translate<uint8_t>(alloc.virtAddress);
+         mappedData.emplace_back(data, data + alloc.size);
+      }
+
+      return [=]() {
+         unmapAllVallocMemory();
+         std::copy(physData.begin(), physData.end(), sPhysDataStore);
+         sVallocVirtualMemHeap->restoreState(heapState);
+         sVallocAllocs = allocs;
+
+         for (auto i = 0u; i < allocs.size(); ++i) {
+            auto &alloc = allocs[i];
+            platform::protectMemory(mem::base() + alloc.virtAddress, alloc.size, platform::ProtectFlags::ReadWrite);
+            std::copy(mappedData[i].begin(), mappedData[i].end(), mem::translate<uint8_t>(alloc.virtAddress));
+
+            if (alloc.mode == MEMProtectMode::ReadOnly) {
+               platform::protectMemory(mem::base() + alloc.virtAddress, alloc.size, platform::ProtectFlags::ReadOnly);
+            }
+         }
+      };
+   });
+}
+
 void
 Module::registerMemoryFunctions()
 {
@@ -76,7 +76,7 @@ OSSendMessage(OSMessageQueue *queue,
 
    // Wait for space in the message queue
    while (queue->used == queue->size) {
-      internal::sleepThreadNoLock(&queue->sendQueue);
+      internal::sleepThreadNoLock(&queue->sendQueue, internal::ThreadWaitReason::MessageQueue);
       internal::rescheduleSelfNoLock();
    }
 
@@ -121,7 +121,7 @@ OSJamMessage(OSMessageQueue *queue,
 
    // Wait for space in the message queue
    while (queue->used == queue->size) {
-      internal::sleepThreadNoLock(&queue->sendQueue);
+      internal::sleepThreadNoLock(&queue->sendQueue, internal::ThreadWaitReason::MessageQueue);
       internal::rescheduleSelfNoLock();
    }
 
@@ -171,7 +171,7 @@ OSReceiveMessage(OSMessageQueue *queue,
 
    // Wait for a message to appear in queue
    while (queue->used == 0) {
-      internal::sleepThreadNoLock(&queue->recvQueue);
+      internal::sleepThreadNoLock(&queue->recvQueue, internal::ThreadWaitReason::MessageQueue);
       internal::rescheduleSelfNoLock();
    }
 
@@ -65,7 +65,7 @@ lockMutexNoLock(OSMutex *mutex)
       internal::promoteThreadPriorityNoLock(mutex->owner, thread->priority);
 
       // Wait for other owner to unlock
-      internal::sleepThreadNoLock(&mutex->queue);
+      internal::sleepThreadNoLock(&mutex->queue, internal::ThreadWaitReason::Mutex);
       internal::rescheduleSelfNoLock();
 
       thread->mutex = nullptr;
@@ -230,7 +230,7 @@ OSWaitCond(OSCondition *condition, OSMutex *mutex)
    internal::rescheduleOtherCoreNoLock();
 
    // Sleep on the condition
-   internal::sleepThreadNoLock(&condition->queue);
+   internal::sleepThreadNoLock(&condition->queue, internal::ThreadWaitReason::Condition);
    internal::rescheduleSelfNoLock();
 
    // Restore lock
@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <vector>
 #include "coreinit.h"
 #include "coreinit_alarm.h"
 #include "coreinit_core.h"
@@ -11,9 +13,13 @@
 #include "coreinit_mutex.h"
 #include "coreinit_thread.h"
 #include "coreinit_internal_queue.h"
+#include "coreinit_internal_threadstats.h"
+#include "common/adaptive_spinlock.h"
 #include "debugger/debugger.h"
 #include "kernel/kernel.h"
 #include "kernel/kernel_loader.h"
+#include "kernel/kernel_replay.h"
+#include "kernel/kernel_snapshot.h"
 #include "libcpu/trace.h"
 #include "ppcutils/wfunc_call.h"
 #include "ppcutils/stackobject.h"
@@ -28,6 +34,9 @@ sSchedulerEnabled[3];
 static std::atomic<uint32_t>
 sSchedulerLock { 0 };
 
+static SpinLockStats
+sSchedulerLockStats { "Scheduler" };
+
 static OSThreadQueue *
 sActiveThreads;
 
@@ -93,12 +102,9 @@ getCurrentThread()
 void
 lockScheduler()
 {
-   uint32_t expected = 0;
    auto core = 1 << cpu::this_core::id();
-
-   while (!sSchedulerLock.compare_exchange_weak(expected, core, std::memory_order_acquire)) {
-      expected = 0;
-   }
+   kernel::replaySchedulerLock();
+   spinlock_acquire(sSchedulerLock, core, sSchedulerLockStats);
 }
 
 bool
@@ -112,8 +118,10 @@ void
 unlockScheduler()
 {
    auto core = 1 << cpu::this_core::id();
-   auto oldCore = sSchedulerLock.exchange(0, std::memory_order_release);
+   kernel::replaySchedulerUnlock();
+   auto oldCore = spinlock_release(sSchedulerLock);
    decaf_check(oldCore == core);
+   kernel::replaySchedulerUnlocked();
 }
 
 bool
@@ -144,6 +152,7 @@ markThreadActiveNoLock(OSThread *thread)
 {
    decaf_check(!ActiveQueue::contains(sActiveThreads, thread));
    ActiveQueue::append(sActiveThreads, thread);
+   resetThreadStatsNoLock(thread);
    checkActiveThreadsNoLock();
 }
 
@@ -152,6 +161,7 @@ markThreadInactiveNoLock(OSThread *thread)
 {
    decaf_check(ActiveQueue::contains(sActiveThreads, thread));
    ActiveQueue::erase(sActiveThreads, thread);
+   removeThreadStatsNoLock(thread);
    checkActiveThreadsNoLock();
 }
 
@@ -168,6 +178,7 @@ queueThreadNoLock(OSThread *thread)
    decaf_check(!OSIsThreadSuspended(thread));
    decaf_check(thread->state == OSThreadState::Ready);
    decaf_check(thread->priority >= -1 && thread->priority <= 32);
+   recordThreadReadyNoLock(thread);
 
    // Schedule this thread on any cores which can run it!
    if (thread->attr & OSThreadAttributes::AffinityCPU0) {
@@ -325,9 +336,15 @@ void checkRunningThreadNoLock(bool yielding)
       next->wakeCount++;
    }
 
+   recordThreadSwitchNoLock(coreId, thread, next);
+
    // Switch thread
    sCurrentThread[coreId] = next;
 
+   if (!next) {
+      kernel::replayCoreIdle();
+   }
+
    internal::unlockScheduler();
    kernel::setContext(&next->context);
    internal::lockScheduler();
@@ -397,7 +414,8 @@ resumeThreadNoLock(OSThread *thread, int32_t counter)
 }
 
 void
-sleepThreadNoLock(OSThreadQueue *queue)
+sleepThreadNoLock(OSThreadQueue *queue,
+                  ThreadWaitReason reason)
 {
    auto thread = OSGetCurrentThread();
    decaf_check(thread->queue == nullptr);
@@ -405,6 +423,7 @@ sleepThreadNoLock(OSThreadQueue *queue)
 
    thread->queue = queue;
    thread->state = OSThreadState::Waiting;
+   recordThreadWaitNoLock(thread, reason);
 
    if (queue) {
       ThreadQueue::insert(queue, thread);
@@ -675,6 +694,22 @@ Module::initialiseSchedulerFunctions()
       sLastSwitchTime[i] = std::chrono::high_resolution_clock::now();
       sCorePauseTime[i] = std::chrono::time_point<std::chrono::high_resolution_clock>::max();
    }
+
+   kernel::registerSnapshotState("scheduler", []() -> kernel::SnapshotRestoreFunction {
+      if (sSchedulerLock.load() != 0) {
+         return { };
+      }
+
+      auto currentThread = std::vector<OSThread *> { std::begin(sCurrentThread), std::end(sCurrentThread) };
+      auto lastSwitchTime = std::vector<std::chrono::time_point<std::chrono::high_resolution_clock>> { std::begin(sLastSwitchTime), std::end(sLastSwitchTime) };
+      auto corePauseTime = std::vector<std::chrono::time_point<std::chrono::high_resolution_clock>> { std::begin(sCorePauseTime), std::end(sCorePauseTime) };
+
+      return [=]() {
+         std::copy(currentThread.begin(), currentThread.end(), sCurrentThread);
+         std::copy(lastSwitchTime.begin(), lastSwitchTime.end(), sLastSwitchTime);
+         std::copy(corePauseTime.begin(), corePauseTime.end(), sCorePauseTime);
+      };
+   });
 }
 
 } // namespace coreinit
@@ -1,6 +1,7 @@
 #pragma once
 #include "common/types.h"
 #include "coreinit_thread.h"
+#include "coreinit_internal_threadstats.h"
 
 namespace coreinit
 {
@@ -83,7 +84,8 @@ resumeThreadNoLock(OSThread *thread,
                    int32_t counter);
 
 void
-sleepThreadNoLock(OSThreadQueue *queue);
+sleepThreadNoLock(OSThreadQueue *queue,
+                  ThreadWaitReason reason = ThreadWaitReason::Other);
 
 void
 suspendThreadNoLock(OSThread *thread);
@@ -48,7 +48,7 @@ OSWaitSemaphore(OSSemaphore *semaphore)
 
    while (semaphore->count <= 0) {
       // Wait until we can decrease semaphore
-      internal::sleepThreadNoLock(&semaphore->queue);
+      internal::sleepThreadNoLock(&semaphore->queue, internal::ThreadWaitReason::Semaphore);
       internal::rescheduleSelfNoLock();
    }
 
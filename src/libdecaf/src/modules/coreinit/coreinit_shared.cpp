@@ -3,6 +3,7 @@
 #include <gsl.h>
 #include "coreinit.h"
 #include "coreinit_shared.h"
+#include "kernel/kernel_snapshot.h"
 #include "libcpu/mem.h"
 #include "virtual_ptr.h"
 #include "common/teenyheap.h"
@@ -72,6 +73,15 @@ void
 Module::initialiseShared()
 {
    sSharedHeap = new TeenyHeap(mem::translate(mem::SharedDataBase), mem::SharedDataSize);
+
+   kernel::registerSnapshotState("shared data heap", []() -> kernel::SnapshotRestoreFunction {
+      auto state = sSharedHeap->saveState();
+
+      return [=]() {
+         sSharedHeap->restoreState(state);
+      };
+   });
+
    readFont(sFonts[0], "resources/fonts/SourceSansPro-Regular.ttf");
    sFonts[1] = sFonts[0];
    sFonts[2] = sFonts[0];
@@ -4,15 +4,27 @@
 #include "coreinit_scheduler.h"
 #include "coreinit_thread.h"
 #include "libcpu/mem.h"
+#include "common/adaptive_spinlock.h"
 #include "common/decaf_assert.h"
 #include <atomic>
 
 namespace coreinit
 {
 
+static SpinLockStats
+sSpinLockStats { "OSSpinLock" };
+
+// Only the first and last spin lock held change the thread's priority, which
+//  the scheduler on other cores may be looking at. Nested locks only touch
+//  the count on the running thread, which needs no scheduler lock.
 static void
 increaseSpinLockCount(OSThread *thread)
 {
+   if (thread->context.spinLockCount > 0) {
+      thread->context.spinLockCount++;
+      return;
+   }
+
    internal::lockScheduler();
    thread->context.spinLockCount++;
    thread->priority = 0;
@@ -22,6 +34,11 @@ increaseSpinLockCount(OSThread *thread)
 static void
 decreaseSpinLockCount(OSThread *thread)
 {
+   if (thread->context.spinLockCount > 1) {
+      thread->context.spinLockCount--;
+      return;
+   }
+
    internal::lockScheduler();
    thread->context.spinLockCount--;
    thread->priority = internal::calculateThreadPriorityNoLock(thread);
@@ -39,12 +56,7 @@ spinAcquireLock(OSSpinLock *spinlock)
       return false;
    }
 
-   uint32_t expected = 0;
-
-   while (!spinlock->owner.compare_exchange_weak(expected, owner, std::memory_order_release, std::memory_order_relaxed)) {
-      expected = 0;
-   }
-
+   spinlock_acquire(spinlock->owner, owner, sSpinLockStats);
    increaseSpinLockCount(thread);
    return true;
 }
@@ -60,9 +72,7 @@ spinTryLock(OSSpinLock *spinlock)
       return true;
    }
 
-   uint32_t expected = 0;
-
-   if (spinlock->owner.compare_exchange_weak(expected, owner, std::memory_order_release, std::memory_order_relaxed)) {
+   if (spinlock_try_acquire(spinlock->owner, owner, sSpinLockStats)) {
       increaseSpinLockCount(thread);
       return true;
    } else {
@@ -81,15 +91,18 @@ spinTryLockWithTimeout(OSSpinLock *spinlock, OSTime duration)
       return true;
    }
 
-   uint32_t expected = 0;
-   auto timeout = OSGetSystemTime() + duration;
+   if (!spinlock_try_acquire(spinlock->owner, owner, sSpinLockStats)) {
+      auto timeout = OSGetSystemTime() + duration;
+      auto spinWait = SpinWait { };
+      sSpinLockStats.contended.fetch_add(1, std::memory_order_relaxed);
 
-   while (!spinlock->owner.compare_exchange_weak(expected, owner, std::memory_order_release, std::memory_order_relaxed)) {
-      if (OSGetSystemTime() >= timeout) {
-         return false;
-      }
+      do {
+         if (OSGetSystemTime() >= timeout) {
+            return false;
+         }
 
-      expected = 0;
+         spinWait.wait(spinlock->owner, sSpinLockStats);
+      } while (!spinlock_try_acquire(spinlock->owner, owner, sSpinLockStats));
    }
 
    increaseSpinLockCount(thread);
@@ -106,7 +119,7 @@ spinReleaseLock(OSSpinLock *spinlock)
       --spinlock->recursion;
       return false;
    } else if (spinlock->owner.load(std::memory_order_relaxed) == owner) {
-      spinlock->owner = 0u;
+      spinlock_release(spinlock->owner);
       decreaseSpinLockCount(thread);
       return true;
    }
@@ -7,6 +7,7 @@
 #include "coreinit_systeminfo.h"
 #include "coreinit_thread.h"
 #include "kernel/kernel_loader.h"
+#include "kernel/kernel_snapshot.h"
 #include "libcpu/mem.h"
 #include "libcpu/cpu.h"
 #include "ppcutils/stackobject.h"
@@ -482,7 +483,7 @@ OSJoinThread(OSThread *thread,
             return FALSE;
          }
 
-         internal::sleepThreadNoLock(&thread->joinQueue);
+         internal::sleepThreadNoLock(&thread->joinQueue, internal::ThreadWaitReason::Join);
          internal::rescheduleSelfNoLock();
 
          if (!internal::isThreadActiveNoLock(thread)) {
@@ -794,7 +795,7 @@ OSSleepTicks(OSTime ticks)
    internal::lockScheduler();
    internal::setAlarmInternal(alarm, ticks, sSleepAlarmHandler, OSGetCurrentThread());
 
-   internal::sleepThreadNoLock(queue);
+   internal::sleepThreadNoLock(queue, internal::ThreadWaitReason::Sleep);
    internal::rescheduleSelfNoLock();
 
    internal::unlockScheduler();
@@ -843,7 +844,7 @@ OSSuspendThread(OSThread *thread)
       } else {
          thread->needSuspend++;
          thread->requestFlag = OSThreadRequest::Suspend;
-         internal::sleepThreadNoLock(&thread->suspendQueue);
+         internal::sleepThreadNoLock(&thread->suspendQueue, internal::ThreadWaitReason::Suspend);
          internal::rescheduleSelfNoLock();
          result = thread->suspendResult;
       }
@@ -949,6 +950,16 @@ Module::initialiseThreadFunctions()
 {
    sSleepAlarmHandler = findExportAddress("internal_SleepAlarmHandler");
    sDefaultThreads.fill(nullptr);
+
+   kernel::registerSnapshotState("thread ids", []() -> kernel::SnapshotRestoreFunction {
+      auto threadId = sThreadId;
+      auto defaultThreads = sDefaultThreads;
+
+      return [=]() {
+         sThreadId = threadId;
+         sDefaultThreads = defaultThreads;
+      };
+   });
 }
 
 void
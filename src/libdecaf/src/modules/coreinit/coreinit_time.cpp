@@ -3,6 +3,7 @@
 #include "coreinit_systeminfo.h"
 #include "common/platform_time.h"
 #include "decaf_config.h"
+#include "kernel/kernel_replay.h"
 #include "libcpu/cpu.h"
 
 namespace coreinit
@@ -125,8 +126,10 @@ Module::initialiseClock()
    tm.tm_isdst = -1;
    sEpochTime = std::chrono::system_clock::from_time_t(platform::make_gm_time(tm));
 
-   sBaseClock = std::chrono::system_clock::now();
-   auto ticksSinceEpoch = std::chrono::duration_cast<cpu::TimerDuration>(sBaseClock - sEpochTime);
+   // A replay has to start from the same wall clock time as its recording
+   auto ticksSinceEpoch = std::chrono::duration_cast<cpu::TimerDuration>(std::chrono::system_clock::now() - sEpochTime);
+   ticksSinceEpoch = cpu::TimerDuration { kernel::replayValue(kernel::ReplayChannel::ClockBase, ticksSinceEpoch.count()) };
+   sBaseClock = sEpochTime + std::chrono::duration_cast<std::chrono::system_clock::duration>(ticksSinceEpoch);
    auto ticksSinceStart = cpu::TimerDuration(cpu::this_core::state()->tb());
    sBaseTicks = ticksSinceEpoch - ticksSinceStart;
 }
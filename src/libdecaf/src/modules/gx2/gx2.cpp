@@ -33,6 +33,7 @@ void
 Module::initialise()
 {
    initialiseVsync();
+   initialiseCommandBufferPool();
    initialiseResourceAllocator();
 }
 
@@ -10,6 +10,7 @@ public:
    virtual void initialise() override;
 
    void initialiseVsync();
+   void initialiseCommandBufferPool();
    void initialiseResourceAllocator();
 
 public:
@@ -1,16 +1,22 @@
 #include "common/align.h"
 #include "common/log.h"
 #include "common/decaf_assert.h"
+#include "gx2.h"
 #include "gx2_cbpool.h"
 #include "gx2_event.h"
 #include "gx2_displaylist.h"
 #include "gx2_state.h"
 #include "gpu/pm4_buffer.h"
 #include "gpu/commandqueue.h"
+#include "kernel/kernel_replay.h"
+#include "kernel/kernel_snapshot.h"
 #include "modules/coreinit/coreinit_core.h"
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <mutex>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -132,6 +138,30 @@ returnToPool(uint32_t *buffer, uint32_t usedSize, uint32_t originalSize)
    sBufferPoolHeadPtr = buffer + usedSize;
 }
 
+// How much space the pool has depends on how far the GPU has got, which the
+//  guest can see through the size of its command buffers, so a replay waits
+//  for the GPU to free up exactly what the recording was given.
+static uint32_t *
+allocateReplayed(uint32_t &allocatedSize)
+{
+   auto replayedSize = static_cast<uint32_t>(kernel::replayValue(kernel::ReplayChannel::CommandBufferSize, uint64_t { 0 }));
+
+   if (!replayedSize) {
+      return nullptr;
+   }
+
+   auto buffer = allocateFromPool(replayedSize, allocatedSize);
+
+   while (!buffer) {
+      std::this_thread::sleep_for(std::chrono::microseconds { 100 });
+      buffer = allocateFromPool(replayedSize, allocatedSize);
+   }
+
+   returnToPool(buffer, replayedSize, allocatedSize);
+   allocatedSize = replayedSize;
+   return buffer;
+}
+
 static void
 freeToPool(uint32_t *buffer, uint32_t size)
 {
@@ -202,7 +232,12 @@ allocateCommandBuffer(uint32_t size)
    uint32_t *allocatedBuffer = nullptr;
    uint32_t allocatedSize = 0;
    while (!allocatedBuffer) {
-      allocatedBuffer = allocateFromPool(size, allocatedSize);
+      if (kernel::isReplaying()) {
+         allocatedBuffer = allocateReplayed(allocatedSize);
+      } else {
+         allocatedBuffer = allocateFromPool(size, allocatedSize);
+         kernel::replayValue(kernel::ReplayChannel::CommandBufferSize, static_cast<uint64_t>(allocatedBuffer ? allocatedSize : 0));
+      }
 
       if (!allocatedBuffer) {
          // If we failed to allocate from the pool, lets wait till
@@ -424,4 +459,68 @@ endUserCommandBuffer(uint32_t *buffer)
 
 } // namespace internal
 
+struct SavedCommandBuffer
+{
+   bool active;
+   bool displayList;
+   uint32_t *buffer;
+   uint32_t curSize;
+   uint32_t maxSize;
+};
+
+void
+Module::initialiseCommandBufferPool()
+{
+   kernel::registerSnapshotState("command buffer pool", []() -> kernel::SnapshotRestoreFunction {
+      // Buffers still queued for the GPU would be freed back into the pool
+      //  after it has been restored.
+      if (!gpu::isIdle()) {
+         return { };
+      }
+
+      auto leased = sBufferPoolLeased;
+      auto base = sBufferPoolBase;
+      auto end = sBufferPoolEnd;
+      auto head = sBufferPoolHeadPtr;
+      auto tail = sBufferPoolTailPtr;
+      auto skipped = sBufferPoolSkipped;
+      auto saved = std::array<SavedCommandBuffer, coreinit::CoreCount> { };
+
+      for (auto i = 0u; i < coreinit::CoreCount; ++i) {
+         if (auto cb = sActiveBuffer[i]) {
+            saved[i] = { true, cb->displayList, cb->buffer, cb->curSize, cb->maxSize };
+         }
+      }
+
+      return [=]() {
+         std::unique_lock<std::mutex> lock(sBufferPoolMutex);
+         sBufferPoolLeased = leased;
+         sBufferPoolBase = base;
+         sBufferPoolEnd = end;
+         sBufferPoolHeadPtr = head;
+         sBufferPoolTailPtr = tail;
+         sBufferPoolSkipped = skipped;
+
+         // The buffer objects are host memory, so the active buffers are
+         //  rebuilt from the saved copies rather than reused.
+         for (auto i = 0u; i < coreinit::CoreCount; ++i) {
+            if (sActiveBuffer[i]) {
+               internal::freeBufferObj(sActiveBuffer[i]);
+               sActiveBuffer[i] = nullptr;
+            }
+
+            if (saved[i].active) {
+               auto cb = internal::allocateBufferObj();
+               cb->displayList = saved[i].displayList;
+               cb->submitTime = 0;
+               cb->buffer = saved[i].buffer;
+               cb->curSize = saved[i].curSize;
+               cb->maxSize = saved[i].maxSize;
+               sActiveBuffer[i] = cb;
+            }
+         }
+      };
+   });
+}
+
 } // namespace gx2
@@ -1,6 +1,11 @@
+#include "decaf_config.h"
+#include "decaf_graphics.h"
+#include "gpu/commandqueue.h"
 #include "gx2.h"
 #include "gx2_event.h"
 #include "gx2_state.h"
+#include "kernel/kernel_replay.h"
+#include "kernel/kernel_snapshot.h"
 #include "modules/coreinit/coreinit_alarm.h"
 #include "modules/coreinit/coreinit_memheap.h"
 #include "modules/coreinit/coreinit_mutex.h"
@@ -9,8 +14,11 @@
 #include "modules/coreinit/coreinit_thread.h"
 #include "modules/coreinit/coreinit_time.h"
 #include "ppcutils/wfunc_call.h"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <thread>
+#include <vector>
 
 using namespace coreinit;
 
@@ -35,6 +43,18 @@ sLastSubmittedTimestamp { 0 };
 static std::atomic<int64_t>
 sRetiredTimestamp { 0 };
 
+static std::atomic<uint32_t>
+sPendingGpuInterrupts { 0 };
+
+static std::atomic<int64_t>
+sLastGpuInterruptNs { 0 };
+
+static std::atomic<uint64_t>
+sGpuEventCount { 0 };
+
+static std::atomic<uint64_t>
+sGpuInterruptCount { 0 };
+
 static virtual_ptr<OSThreadQueue>
 sVsyncThreadQueue;
 
@@ -109,13 +129,45 @@ GX2GetEventCallback(GX2EventType type,
 }
 
 
+// The GPU thread moves these on whenever it likes, so they are read through
+//  the replay log and a replay sees the GPU exactly as far along as the
+//  recording did.
+static OSTime
+getRetiredTimeStamp()
+{
+   auto retired = sRetiredTimestamp.load(std::memory_order_acquire);
+   return static_cast<OSTime>(kernel::replayValue(kernel::ReplayChannel::GpuRetiredTimeStamp, static_cast<uint64_t>(retired)));
+}
+
+static uint32_t
+getFlipCount()
+{
+   auto flipCount = sFlipCount.load(std::memory_order_acquire);
+   return static_cast<uint32_t>(kernel::replayValue(kernel::ReplayChannel::GpuFlipCount, static_cast<uint64_t>(flipCount)));
+}
+
+static OSTime
+getLastFlip()
+{
+   auto lastFlip = sLastFlip.load(std::memory_order_acquire);
+   return static_cast<OSTime>(kernel::replayValue(kernel::ReplayChannel::GpuLastFlip, static_cast<uint64_t>(lastFlip)));
+}
+
+static OSTime
+getLastVsync()
+{
+   auto lastVsync = sLastVsync.load(std::memory_order_acquire);
+   return static_cast<OSTime>(kernel::replayValue(kernel::ReplayChannel::GpuLastVsync, static_cast<uint64_t>(lastVsync)));
+}
+
+
 /**
  * Get the timestamp of the last command buffer processed by the driver.
  */
 OSTime
 GX2GetRetiredTimeStamp()
 {
-   return sRetiredTimestamp.load(std::memory_order_acquire);
+   return getRetiredTimeStamp();
 }
 
 
@@ -144,10 +196,10 @@ GX2GetSwapStatus(be_val<uint32_t> *swapCount,
                  be_val<OSTime> *lastVsync)
 {
    *swapCount = sSwapCount.load(std::memory_order_acquire);
-   *flipCount = sFlipCount.load(std::memory_order_acquire);
+   *flipCount = getFlipCount();
 
-   *lastFlip = sLastFlip.load(std::memory_order_acquire);
-   *lastVsync = sLastVsync.load(std::memory_order_acquire);
+   *lastFlip = getLastFlip();
+   *lastVsync = getLastVsync();
 }
 
 
@@ -159,8 +211,8 @@ GX2WaitTimeStamp(OSTime time)
 {
    coreinit::internal::lockScheduler();
 
-   while (sRetiredTimestamp.load(std::memory_order_acquire) < time) {
-      coreinit::internal::sleepThreadNoLock(sWaitTimeStampQueue);
+   while (getRetiredTimeStamp() < time) {
+      coreinit::internal::sleepThreadNoLock(sWaitTimeStampQueue, coreinit::internal::ThreadWaitReason::Event);
       coreinit::internal::rescheduleSelfNoLock();
    }
 
@@ -185,7 +237,7 @@ GX2WaitForVsync()
 void
 GX2WaitForFlip()
 {
-   if (sFlipCount == sSwapCount) {
+   if (getFlipCount() == sSwapCount) {
       // The user has no more pending flips, return immediately.
       return;
    }
@@ -277,7 +329,7 @@ void
 setRetiredTimestamp(OSTime timestamp)
 {
    sRetiredTimestamp.store(timestamp, std::memory_order_release);
-   cpu::interrupt(gx2::internal::getMainCoreId(), cpu::GPU_RETIRE_INTERRUPT);
+   queueGpuInterrupt(cpu::GPU_RETIRE_INTERRUPT);
 }
 
 
@@ -320,7 +372,70 @@ onFlip()
 {
    sFlipCount++;
    sLastFlip.store(OSGetSystemTime(), std::memory_order_release);
-   cpu::interrupt(gx2::internal::getMainCoreId(), cpu::GPU_FLIP_INTERRUPT);
+   queueGpuInterrupt(cpu::GPU_FLIP_INTERRUPT);
+}
+
+
+static int64_t
+getGpuInterruptClockNs()
+{
+   auto now = std::chrono::steady_clock::now().time_since_epoch();
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+
+/**
+ * Queue a GPU interrupt for the main GX2 core.
+ *
+ * Events are merged into a single pending interrupt which is delivered once
+ * gpu::interrupt_interval_us has passed since the last one, or when the GPU
+ * runs out of work and calls flushGpuInterrupts. The handlers only look at
+ * the latest retired timestamp and wake every waiter, so nothing is lost by
+ * delivering several retires and flips at once.
+ */
+void
+queueGpuInterrupt(uint32_t flags)
+{
+   sGpuEventCount.fetch_add(1, std::memory_order_relaxed);
+   sPendingGpuInterrupts.fetch_or(flags, std::memory_order_acq_rel);
+
+   auto interval = static_cast<int64_t>(decaf::config::gpu::interrupt_interval_us) * 1000;
+
+   if (interval == 0 ||
+       getGpuInterruptClockNs() - sLastGpuInterruptNs.load(std::memory_order_relaxed) >= interval) {
+      flushGpuInterrupts();
+   }
+}
+
+
+/**
+ * Deliver any pending GPU interrupts now.
+ */
+void
+flushGpuInterrupts()
+{
+   auto flags = sPendingGpuInterrupts.exchange(0, std::memory_order_acq_rel);
+
+   if (!flags) {
+      return;
+   }
+
+   sLastGpuInterruptNs.store(getGpuInterruptClockNs(), std::memory_order_relaxed);
+   sGpuInterruptCount.fetch_add(1, std::memory_order_relaxed);
+   cpu::interrupt(gx2::internal::getMainCoreId(), flags);
+}
+
+
+/**
+ * Get the number of GPU events raised and the number of interrupts they were
+ * delivered in.
+ */
+void
+getGpuInterruptStats(uint64_t &events,
+                     uint64_t &interrupts)
+{
+   events = sGpuEventCount.load(std::memory_order_relaxed);
+   interrupts = sGpuInterruptCount.load(std::memory_order_relaxed);
 }
 
 } // namespace internal
@@ -330,6 +445,47 @@ void
 Module::initialiseVsync()
 {
    sVsyncAlarmHandler = findExportAddress("internal_VsyncAlarmHandler");
+
+   // The GPU keeps running while the cores are stopped, so a snapshot is only
+   //  taken between command buffers and a restore waits for the GPU to finish
+   //  with the current guest memory first.
+   kernel::registerSnapshotState("graphics", []() -> kernel::SnapshotRestoreFunction {
+      if (!gpu::isIdle()) {
+         return { };
+      }
+
+      auto lastVsync = sLastVsync.load();
+      auto lastFlip = sLastFlip.load();
+      auto swapCount = sSwapCount.load();
+      auto flipCount = sFlipCount.load();
+      auto lastSubmitted = sLastSubmittedTimestamp.load();
+      auto retired = sRetiredTimestamp.load();
+      auto callbacks = std::vector<EventCallbackData> { std::begin(sEventCallbacks), std::end(sEventCallbacks) };
+      auto registers = std::vector<uint32_t> { };
+      auto driver = decaf::getGraphicsDriver();
+
+      if (driver && !driver->saveRegisters(registers)) {
+         gLog->warn("Graphics driver does not support snapshots, GPU registers will not be restored");
+      }
+
+      return [=]() {
+         sLastVsync.store(lastVsync);
+         sLastFlip.store(lastFlip);
+         sSwapCount.store(swapCount);
+         sFlipCount.store(flipCount);
+         sLastSubmittedTimestamp.store(lastSubmitted);
+         sRetiredTimestamp.store(retired);
+         std::copy(callbacks.begin(), callbacks.end(), sEventCallbacks);
+
+         if (driver && !registers.empty()) {
+            driver->restoreRegisters(registers);
+         }
+      };
+   }, []() {
+      while (!gpu::isIdle()) {
+         std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+      }
+   });
 }
 
 } // namespace gx2
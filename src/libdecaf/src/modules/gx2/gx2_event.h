@@ -91,6 +91,16 @@ handleGpuFlipInterrupt();
 void
 onFlip();
 
+void
+queueGpuInterrupt(uint32_t flags);
+
+void
+flushGpuInterrupts();
+
+void
+getGpuInterruptStats(uint64_t &events,
+                     uint64_t &interrupts);
+
 } // namespace internal
 
 } // namespace gx2
@@ -1,10 +1,16 @@
+#include "decaf_config.h"
 #include "modules/coreinit/coreinit_memheap.h"
 #include "libcpu/mem.h"
 #include "ppcutils/wfunc_ptr.h"
 #include "ppcutils/wfunc_call.h"
 #include "virtual_ptr.h"
 #include "zlib125.h"
+#include "common/checksum.h"
 #include "common/decaf_assert.h"
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <zlib.h>
 
 namespace zlib125
@@ -87,13 +93,98 @@ zlibFreeWrapper(void *opaque,
    }
 }
 
+/*
+ * Host pool for zlib's internal state.
+ *
+ * The guest can not see inside a stream's state, so there is no need to
+ * call into the guest's allocator for it. zlib only ever allocates a few
+ * different sizes (its state, the window and deflate's buffers) and games
+ * tend to create a new stream for every file they load, so freed blocks are
+ * kept by size for the next stream to reuse.
+ */
+static const size_t
+MaxHostPoolBytes = 16 * 1024 * 1024;
+
+// Keeps the returned memory 16 byte aligned
+static const size_t
+HostBlockHeaderSize = 16;
+
+static std::mutex
+sHostPoolMutex;
+
+static std::unordered_map<size_t, std::vector<uint8_t *>>
+sHostPool;
+
+static size_t
+sHostPoolBytes = 0;
+
+static void *
+zlibHostAlloc(void *opaque,
+              unsigned items,
+              unsigned size)
+{
+   auto bytes = static_cast<size_t>(items) * size;
+
+   {
+      std::unique_lock<std::mutex> lock { sHostPoolMutex };
+      auto &blocks = sHostPool[bytes];
+
+      if (!blocks.empty()) {
+         auto block = blocks.back();
+         blocks.pop_back();
+         sHostPoolBytes -= bytes;
+         return block + HostBlockHeaderSize;
+      }
+   }
+
+   auto block = reinterpret_cast<uint8_t *>(std::malloc(bytes + HostBlockHeaderSize));
+
+   if (!block) {
+      return Z_NULL;
+   }
+
+   *reinterpret_cast<size_t *>(block) = bytes;
+   return block + HostBlockHeaderSize;
+}
+
+static void
+zlibHostFree(void *opaque,
+             void *address)
+{
+   auto block = reinterpret_cast<uint8_t *>(address) - HostBlockHeaderSize;
+   auto bytes = *reinterpret_cast<size_t *>(block);
+
+   {
+      std::unique_lock<std::mutex> lock { sHostPoolMutex };
+
+      if (sHostPoolBytes + bytes <= MaxHostPoolBytes) {
+         sHostPool[bytes].push_back(block);
+         sHostPoolBytes += bytes;
+         return;
+      }
+   }
+
+   std::free(block);
+}
+
 z_stream *
 getZStream(WZStream *in)
 {
    auto zstream = &gStreamMap[mem::untranslate(in)];
    zstream->opaque = in;
-   zstream->zalloc = &zlibAllocWrapper;
-   zstream->zfree = &zlibFreeWrapper;
+
+   // Only pick the allocator for new streams, so memory is always freed
+   //  by the allocator it came from.
+   if (!zstream->zalloc) {
+      if (decaf::config::system::zlib_host_memory) {
+         zstream->zalloc = &zlibHostAlloc;
+         zstream->zfree = &zlibHostFree;
+      } else {
+         zstream->zalloc = &zlibAllocWrapper;
+         zstream->zfree = &zlibFreeWrapper;
+      }
+   }
+
    return zstream;
 }
 
@@ -188,7 +279,9 @@ static int
 zlib125_deflateEnd(WZStream *wstrm)
 {
    auto zstrm = getZStream(wstrm);
-   return deflateEnd(zstrm);
+   auto result = deflateEnd(zstrm);
+   eraseZStream(wstrm);
+   return result;
 }
 
 static int
@@ -280,7 +373,7 @@ zlib125_adler32(uint32_t adler,
                 const uint8_t *buf,
                 uint32_t len)
 {
-   return static_cast<uint32_t>(adler32(adler, buf, len));
+   return checksum_adler32(adler, buf, len);
 }
 
 static uint32_t
@@ -288,7 +381,7 @@ zlib125_crc32(uint32_t crc,
               const uint8_t *buf,
               uint32_t len)
 {
-   return static_cast<uint32_t>(crc32(crc, buf, len));
+   return checksum_crc32(crc, buf, len);
 }
 
 static int
@@ -0,0 +1,320 @@
+#include "profiler.h"
+#include "common/log.h"
+#include "common/platform_thread.h"
+#include "debugger/debugger.h"
+#include "decaf_config.h"
+#include "kernel/kernel_loader.h"
+#include "libcpu/cpu.h"
+#include "libcpu/mem.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace profiler
+{
+
+static const size_t
+MaxStackDepth = 64;
+
+// A stack is stored as { core, activity, leaf, caller, caller's caller, ... }
+using StackKey = std::vector<uint32_t>;
+
+static std::thread
+sSamplerThread;
+
+static std::atomic<bool>
+sRunning { false };
+
+static std::mutex
+sMutex;
+
+static std::map<StackKey, uint64_t>
+sStacks;
+
+static uint64_t
+sActivitySamples[3] = { 0 };
+
+// Resolved symbol names are kept until another module is loaded, as the
+// debugger asks for a summary every frame.
+static std::mutex
+sSymbolMutex;
+
+static std::unordered_map<uint32_t, std::string>
+sSymbols;
+
+static uint32_t
+sSymbolGeneration = 0;
+
+static bool
+isValidStackAddress(ppcaddr_t address)
+{
+   return address
+      && (address & 3) == 0
+      && mem::valid(address)
+      && mem::valid(address + 7);
+}
+
+// Walk the guest backchain, this is done without stopping the core so the
+// stack can change underneath us, hence all the paranoia.
+static void
+captureStack(uint32_t coreId,
+             const cpu::CoreSample &sample,
+             StackKey &key)
+{
+   key.clear();
+   key.push_back(coreId);
+   key.push_back(static_cast<uint32_t>(sample.activity));
+
+   if (sample.activity == cpu::CoreActivity::WaitForInterrupt) {
+      return;
+   }
+
+   // The leaf is where the core is, return addresses are adjusted by -4 so
+   // they lie within the caller
+   key.push_back(sample.nia);
+
+   if (sample.lr && sample.lr != cpu::CALLBACK_ADDR) {
+      key.push_back(sample.lr - 4);
+   }
+
+   auto sp = sample.sp;
+
+   if (!isValidStackAddress(sp)) {
+      return;
+   }
+
+   auto frame = mem::read<uint32_t>(sp);
+
+   while (key.size() < MaxStackDepth && isValidStackAddress(frame) && frame > sp) {
+      auto ret = mem::read<uint32_t>(frame + 4);
+
+      if (!ret || ret == cpu::CALLBACK_ADDR) {
+         break;
+      }
+
+      // The first saved lr is usually the one we already have from the register
+      if (key.size() != 4 || key.back() != ret - 4) {
+         key.push_back(ret - 4);
+      }
+
+      sp = frame;
+      frame = mem::read<uint32_t>(frame);
+   }
+}
+
+static void
+samplerEntry(unsigned sampleRate)
+{
+   auto period = std::chrono::nanoseconds { 1000000000ull / sampleRate };
+   auto next = std::chrono::steady_clock::now();
+   auto key = StackKey {};
+   key.reserve(MaxStackDepth);
+
+   while (sRunning.load()) {
+      next += period;
+
+      if (!debugger::paused()) {
+         for (auto i = 0u; i < 3; ++i) {
+            auto sample = cpu::getCoreSample(i);
+
+            if (!sample.nia || sample.nia == cpu::CALLBACK_ADDR || !mem::valid(sample.nia)) {
+               continue;
+            }
+
+            captureStack(i, sample, key);
+
+            std::unique_lock<std::mutex> lock { sMutex };
+            sStacks[key]++;
+            sActivitySamples[static_cast<size_t>(sample.activity)]++;
+         }
+      }
+
+      auto now = std::chrono::steady_clock::now();
+
+      if (now > next + period * 100) {
+         // We have fallen way behind, don't try to catch up
+         next = now;
+      }
+
+      std::this_thread::sleep_until(next);
+   }
+}
+
+void
+start(unsigned sampleRate)
+{
+   if (sRunning.exchange(true)) {
+      return;
+   }
+
+   if (sampleRate == 0) {
+      sampleRate = 1000;
+   }
+
+   gLog->info("Starting guest profiler at {} samples per second", sampleRate);
+   sSamplerThread = std::thread { samplerEntry, sampleRate };
+   platform::setThreadName(&sSamplerThread, "Profiler Thread");
+}
+
+void
+stop()
+{
+   if (!sRunning.exchange(false)) {
+      return;
+   }
+
+   if (sSamplerThread.joinable()) {
+      sSamplerThread.join();
+   }
+}
+
+bool
+isRunning()
+{
+   return sRunning.load();
+}
+
+void
+reset()
+{
+   std::unique_lock<std::mutex> lock { sMutex };
+   sStacks.clear();
+   std::fill(std::begin(sActivitySamples), std::end(sActivitySamples), 0);
+}
+
+// Must be called with sSymbolMutex held
+static void
+checkSymbolGeneration()
+{
+   auto generation = kernel::loader::getSymbolGeneration();
+
+   if (generation != sSymbolGeneration) {
+      sSymbols.clear();
+      sSymbolGeneration = generation;
+   }
+}
+
+// Must be called with sSymbolMutex held
+static const std::string &
+symbolise(uint32_t address)
+{
+   auto itr = sSymbols.find(address);
+
+   if (itr != sSymbols.end()) {
+      return itr->second;
+   }
+
+   auto text = std::string {};
+   kernel::loader::lockLoader();
+   auto name = kernel::loader::findContainingSymbolNameForAddress(address);
+
+   if (name) {
+      text = *name;
+   } else {
+      text = fmt::format("{:08x}", address);
+   }
+
+   kernel::loader::unlockLoader();
+   return sSymbols.emplace(address, std::move(text)).first->second;
+}
+
+Summary
+getSummary(size_t maxFunctions)
+{
+   auto summary = Summary {};
+   auto functions = std::unordered_map<std::string, uint64_t> {};
+   auto leaves = std::unordered_map<uint32_t, uint64_t> {};
+   std::unique_lock<std::mutex> lock { sMutex };
+
+   summary.guestSamples = sActivitySamples[static_cast<size_t>(cpu::CoreActivity::Guest)];
+   summary.hleSamples = sActivitySamples[static_cast<size_t>(cpu::CoreActivity::KernelCall)];
+   summary.idleSamples = sActivitySamples[static_cast<size_t>(cpu::CoreActivity::WaitForInterrupt)];
+   summary.samples = summary.guestSamples + summary.hleSamples + summary.idleSamples;
+
+   for (auto &stack : sStacks) {
+      if (stack.first.size() > 2) {
+         leaves[stack.first[2]] += stack.second;
+      }
+   }
+
+   // Symbol lookup takes the loader lock, don't hold up the sampler for it
+   lock.unlock();
+
+   std::unique_lock<std::mutex> symbolLock { sSymbolMutex };
+   checkSymbolGeneration();
+
+   for (auto &leaf : leaves) {
+      functions[symbolise(leaf.first)] += leaf.second;
+   }
+
+   symbolLock.unlock();
+
+   summary.topFunctions.assign(functions.begin(), functions.end());
+   std::sort(summary.topFunctions.begin(), summary.topFunctions.end(),
+             [](const std::pair<std::string, uint64_t> &a, const std::pair<std::string, uint64_t> &b) {
+                return b.second < a.second;
+             });
+
+   if (summary.topFunctions.size() > maxFunctions) {
+      summary.topFunctions.resize(maxFunctions);
+   }
+
+   return summary;
+}
+
+
+// Writes stacks in the collapsed format used by flamegraph.pl, leaf frames are
+// annotated with _[k] for HLE functions and _[j] for JIT code.
+bool
+writeCollapsedStacks(const std::string &path)
+{
+   std::ofstream out { path };
+
+   if (!out.is_open()) {
+      gLog->error("Could not open {} to write profile", path);
+      return false;
+   }
+
+   auto stacks = std::map<std::string, uint64_t> {};
+   auto guestSuffix = decaf::config::jit::enabled ? "_[j]" : "";
+   std::unique_lock<std::mutex> lock { sMutex };
+   auto samples = sStacks;
+   lock.unlock();
+
+   std::unique_lock<std::mutex> symbolLock { sSymbolMutex };
+   checkSymbolGeneration();
+
+   for (auto &stack : samples) {
+      auto &key = stack.first;
+      auto activity = static_cast<cpu::CoreActivity>(key[1]);
+      auto line = fmt::format("Core {}", key[0]);
+
+      if (activity == cpu::CoreActivity::WaitForInterrupt) {
+         line += ";[idle]";
+      } else {
+         for (auto i = key.size() - 1; i >= 2; --i) {
+            line += ";";
+            line += symbolise(key[i]);
+         }
+
+         line += (activity == cpu::CoreActivity::KernelCall) ? "_[k]" : guestSuffix;
+      }
+
+      // Different return addresses within the same functions collapse together
+      stacks[line] += stack.second;
+   }
+
+   for (auto &stack : stacks) {
+      out << stack.first << " " << stack.second << "\n";
+   }
+
+   gLog->info("Wrote {} unique guest stacks to {}", stacks.size(), path);
+   return true;
+}
+
+} // namespace profiler
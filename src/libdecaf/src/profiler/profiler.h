@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace profiler
+{
+
+struct Summary
+{
+   uint64_t samples = 0;
+   uint64_t guestSamples = 0;
+   uint64_t hleSamples = 0;
+   uint64_t idleSamples = 0;
+
+   //! Functions with the most samples at the top of the stack
+   std::vector<std::pair<std::string, uint64_t>> topFunctions;
+};
+
+void
+start(unsigned sampleRate);
+
+void
+stop();
+
+bool
+isRunning();
+
+void
+reset();
+
+Summary
+getSummary(size_t maxFunctions);
+
+bool
+writeCollapsedStacks(const std::string &path);
+
+} // namespace profiler
@@ -0,0 +1,265 @@
+#include <hle_test.h>
+#include <coreinit/baseheap.h>
+#include <coreinit/expandedheap.h>
+#include <coreinit/time.h>
+#include <string.h>
+
+static const uint32_t
+HeapSize = 16 * 1024 * 1024;
+
+#define MaxBlocks 4096
+
+static const uint32_t
+Operations = 200000;
+
+struct Block
+{
+   uint8_t *ptr;
+   uint32_t size;
+   uint8_t fill;
+};
+
+static struct Block
+sBlocks[MaxBlocks];
+
+static uint32_t
+sRandom = 1;
+
+static uint8_t *
+sHeapStart;
+
+static uint8_t *
+sHeapEnd;
+
+static uint32_t
+nextRandom()
+{
+   sRandom = sRandom * 1103515245 + 12345;
+   return sRandom >> 8;
+}
+
+// Mostly small blocks with the odd large one, so the free list gets long
+static uint32_t
+randomSize()
+{
+   uint32_t pick = nextRandom() % 16;
+
+   if (pick == 0) {
+      return 16 * 1024 + nextRandom() % (64 * 1024);
+   } else if (pick < 4) {
+      return 512 + nextRandom() % 4096;
+   } else {
+      return 1 + nextRandom() % 256;
+   }
+}
+
+// Negative alignments allocate from the top of the heap
+static int
+randomAlignment()
+{
+   int alignment = 4 << (nextRandom() % 6);
+   return (nextRandom() & 1) ? -alignment : alignment;
+}
+
+static void
+checkFill(struct Block *block, uint32_t size)
+{
+   uint32_t i;
+
+   for (i = 0; i < size; ++i) {
+      test_assert(block->ptr[i] == block->fill);
+   }
+}
+
+static void
+allocBlock(MEMHeapHandle heap, struct Block *block, int check)
+{
+   uint32_t size = randomSize();
+   int alignment = randomAlignment();
+   uint32_t absAlignment = (uint32_t)(alignment < 0 ? -alignment : alignment);
+   uint8_t *ptr = (uint8_t *)MEMAllocFromExpHeapEx(heap, size, alignment);
+
+   if (!ptr) {
+      return;
+   }
+
+   block->ptr = ptr;
+   block->size = size;
+   block->fill = (uint8_t)(nextRandom() | 1);
+
+   if (check) {
+      test_assert(((uint32_t)ptr & (absAlignment - 1)) == 0);
+      test_assert(ptr >= sHeapStart && ptr + size <= sHeapEnd);
+      test_assert(MEMGetSizeForMBlockExpHeap(ptr) >= size);
+      memset(ptr, block->fill, size);
+   }
+}
+
+static void
+freeBlock(MEMHeapHandle heap, struct Block *block, int check)
+{
+   if (check) {
+      checkFill(block, block->size);
+   }
+
+   MEMFreeToExpHeap(heap, block->ptr);
+   block->ptr = NULL;
+}
+
+static void
+resizeBlock(MEMHeapHandle heap, struct Block *block, int check)
+{
+   uint32_t size = (nextRandom() & 1) ? block->size / 2 + 1 : block->size + randomSize();
+   uint32_t kept = size < block->size ? size : block->size;
+   uint32_t result = MEMResizeForMBlockExpHeap(heap, block->ptr, size);
+
+   if (!result) {
+      // Could not grow in place, the block must be untouched
+      if (check) {
+         checkFill(block, block->size);
+      }
+      return;
+   }
+
+   if (check) {
+      test_assert(result >= size);
+      test_assert(block->ptr + size <= sHeapEnd);
+      checkFill(block, kept);
+      memset(block->ptr, block->fill, size);
+   }
+
+   block->size = size;
+}
+
+// Random allocs, frees and resizes over MaxBlocks slots
+static void
+churn(MEMHeapHandle heap, uint32_t operations, int check)
+{
+   uint32_t i;
+
+   for (i = 0; i < operations; ++i) {
+      struct Block *block = &sBlocks[nextRandom() % MaxBlocks];
+
+      if (!block->ptr) {
+         allocBlock(heap, block, check);
+      } else if (nextRandom() % 4 == 0) {
+         resizeBlock(heap, block, check);
+      } else {
+         freeBlock(heap, block, check);
+      }
+   }
+}
+
+static void
+freeAll(MEMHeapHandle heap, int check)
+{
+   uint32_t i;
+
+   for (i = 0; i < MaxBlocks; ++i) {
+      if (sBlocks[i].ptr) {
+         freeBlock(heap, &sBlocks[i], check);
+      }
+   }
+}
+
+// Three holes of different sizes, first free takes the lowest one which fits
+//  and best fit the smallest
+static void
+checkFitOrder(MEMHeapHandle heap, MEMExpHeapMode mode)
+{
+   void *large = MEMAllocFromExpHeapEx(heap, 256, 4);
+   void *spacer0 = MEMAllocFromExpHeapEx(heap, 32, 4);
+   void *small = MEMAllocFromExpHeapEx(heap, 64, 4);
+   void *spacer1 = MEMAllocFromExpHeapEx(heap, 32, 4);
+   void *medium = MEMAllocFromExpHeapEx(heap, 128, 4);
+   void *spacer2 = MEMAllocFromExpHeapEx(heap, 32, 4);
+   void *block;
+
+   test_assert(large && spacer0 && small && spacer1 && medium && spacer2);
+   MEMFreeToExpHeap(heap, large);
+   MEMFreeToExpHeap(heap, small);
+   MEMFreeToExpHeap(heap, medium);
+
+   block = MEMAllocFromExpHeapEx(heap, 100, 4);
+
+   if (mode == MEM_EXP_HEAP_MODE_FIRST_FREE) {
+      test_assert(block == large);
+   } else {
+      test_assert(block == medium);
+   }
+
+   MEMFreeToExpHeap(heap, block);
+   MEMFreeToExpHeap(heap, spacer0);
+   MEMFreeToExpHeap(heap, spacer1);
+   MEMFreeToExpHeap(heap, spacer2);
+}
+
+// Top allocations come from the end of the heap and bottom ones the start
+static void
+checkDirections(MEMHeapHandle heap)
+{
+   uint8_t *bottom = (uint8_t *)MEMAllocFromExpHeapEx(heap, 1024, 64);
+   uint8_t *top = (uint8_t *)MEMAllocFromExpHeapEx(heap, 1024, -64);
+
+   test_assert(bottom && top);
+   test_assert(bottom < sHeapStart + 4096);
+   test_assert(top + 1024 > sHeapEnd - 4096);
+
+   MEMFreeToExpHeap(heap, top);
+   MEMFreeToExpHeap(heap, bottom);
+}
+
+static void
+reportTime(const char *name, OSTime start, uint32_t operations)
+{
+   OSTime ticks = OSGetTime() - start;
+   uint32_t us = (uint32_t)OSTicksToMicroseconds(ticks);
+   uint32_t nsPerOp = (uint32_t)((uint64_t)us * 1000 / operations);
+   test_report("%-16s %8u us  %6u ns/op", name, us, nsPerOp);
+}
+
+static void
+runMode(MEMHeapHandle heap, MEMExpHeapMode mode, const char *name)
+{
+   uint32_t freeSize = MEMGetTotalFreeSizeForExpHeap(heap);
+   OSTime start;
+
+   MEMSetAllocModeForExpHeap(heap, mode);
+   checkFitOrder(heap, mode);
+   checkDirections(heap);
+   test_assert(MEMGetTotalFreeSizeForExpHeap(heap) == freeSize);
+
+   sRandom = 1;
+   churn(heap, Operations, TRUE);
+   freeAll(heap, TRUE);
+   test_assert(MEMGetTotalFreeSizeForExpHeap(heap) == freeSize);
+   test_assert(MEMGetAllocatableSizeForExpHeapEx(heap, 4) + 64 >= freeSize);
+
+   // The same sequence again without touching the memory, for timing
+   sRandom = 1;
+   start = OSGetTime();
+   churn(heap, Operations, FALSE);
+   freeAll(heap, FALSE);
+   reportTime(name, start, Operations);
+   test_assert(MEMGetTotalFreeSizeForExpHeap(heap) == freeSize);
+}
+
+int main(int argc, char **argv)
+{
+   MEMHeapHandle mem2 = MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM2);
+   uint8_t *heapAddr = (uint8_t *)MEMAllocFromExpHeapEx(mem2, HeapSize, 64);
+   MEMHeapHandle heap;
+   test_assert(heapAddr);
+
+   heap = MEMCreateExpHeapEx(heapAddr, HeapSize, 0);
+   test_assert(heap);
+   sHeapStart = heapAddr;
+   sHeapEnd = heapAddr + HeapSize;
+
+   runMode(heap, MEM_EXP_HEAP_MODE_FIRST_FREE, "first free");
+   runMode(heap, MEM_EXP_HEAP_MODE_NEAREST, "best fit");
+
+   MEMDestroyExpHeap(heap);
+   MEMFreeToExpHeap(mem2, heapAddr);
+   return 0;
+}
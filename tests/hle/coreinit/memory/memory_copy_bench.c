@@ -0,0 +1,142 @@
+#include <hle_test.h>
+#include <coreinit/baseheap.h>
+#include <coreinit/expandedheap.h>
+#include <coreinit/memory.h>
+#include <coreinit/time.h>
+#include <string.h>
+
+static const uint32_t
+BufferSize = 8 * 1024 * 1024;
+
+static const int
+Iterations = 16;
+
+// The same loop shapes compilers emit for inline copies and clears, the
+// emulator may run these in one go rather than instruction by instruction.
+static void
+copyWordsLoop(uint32_t *dst, const uint32_t *src, uint32_t words)
+{
+   uint32_t tmp;
+   dst -= 1;
+   src -= 1;
+
+   __asm__ volatile(
+      "mtctr %3\n"
+      "1:\n"
+      "lwzu %2, 4(%1)\n"
+      "stwu %2, 4(%0)\n"
+      "bdnz 1b\n"
+      : "+b"(dst), "+b"(src), "=&r"(tmp)
+      : "r"(words)
+      : "ctr", "memory");
+}
+
+static void
+fillWordsLoop(uint32_t *dst, uint32_t value, uint32_t words)
+{
+   dst -= 1;
+
+   __asm__ volatile(
+      "mtctr %2\n"
+      "1:\n"
+      "stwu %1, 4(%0)\n"
+      "bdnz 1b\n"
+      : "+b"(dst)
+      : "r"(value), "r"(words)
+      : "ctr", "memory");
+}
+
+static void
+clearBlocksLoop(void *dst, uint32_t blocks)
+{
+   __asm__ volatile(
+      "mtctr %1\n"
+      "1:\n"
+      "dcbz 0, %0\n"
+      "addi %0, %0, 32\n"
+      "bdnz 1b\n"
+      : "+b"(dst)
+      : "r"(blocks)
+      : "ctr", "memory");
+}
+
+static void
+reportTime(const char *name, OSTime start)
+{
+   OSTime ticks = OSGetTime() - start;
+   uint32_t us = (uint32_t)OSTicksToMicroseconds(ticks);
+   uint32_t mbPerSecond = us ? (uint32_t)((uint64_t)BufferSize * Iterations / us) : 0;
+   test_report("%-16s %8u us  %6u MB/s", name, us, mbPerSecond);
+}
+
+static void
+checkWords(const uint32_t *buffer, uint32_t value)
+{
+   for (uint32_t i = 0; i < BufferSize / 4; ++i) {
+      test_assert(buffer[i] == value);
+   }
+}
+
+int main(int argc, char **argv)
+{
+   MEMHeapHandle mem2 = MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM2);
+   uint32_t *src = (uint32_t *)MEMAllocFromExpHeapEx(mem2, BufferSize, 64);
+   uint32_t *dst = (uint32_t *)MEMAllocFromExpHeapEx(mem2, BufferSize, 64);
+   OSTime start;
+   int i;
+   test_assert(src);
+   test_assert(dst);
+
+   start = OSGetTime();
+   for (i = 0; i < Iterations; ++i) {
+      OSBlockSet(src, 0x5A, BufferSize);
+   }
+   reportTime("OSBlockSet", start);
+   checkWords(src, 0x5A5A5A5A);
+
+   start = OSGetTime();
+   for (i = 0; i < Iterations; ++i) {
+      OSBlockMove(dst, src, BufferSize, TRUE);
+   }
+   reportTime("OSBlockMove", start);
+   checkWords(dst, 0x5A5A5A5A);
+
+   start = OSGetTime();
+   for (i = 0; i < Iterations; ++i) {
+      memset(dst, 0, BufferSize);
+   }
+   reportTime("memset", start);
+   checkWords(dst, 0);
+
+   start = OSGetTime();
+   for (i = 0; i < Iterations; ++i) {
+      memcpy(dst, src, BufferSize);
+   }
+   reportTime("memcpy", start);
+   checkWords(dst, 0x5A5A5A5A);
+
+   start = OSGetTime();
+   for (i = 0; i < Iterations; ++i) {
+      fillWordsLoop(src, 0x12345678, BufferSize / 4);
+   }
+   reportTime("stwu loop", start);
+   checkWords(src, 0x12345678);
+
+   start = OSGetTime();
+   for (i = 0; i < Iterations; ++i) {
+      copyWordsLoop(dst, src, BufferSize / 4);
+   }
+   reportTime("lwzu/stwu loop", start);
+   checkWords(dst, 0x12345678);
+
+   start = OSGetTime();
+   for (i = 0; i < Iterations; ++i) {
+      clearBlocksLoop(dst, BufferSize / 32);
+   }
+   reportTime("dcbz loop", start);
+   checkWords(dst, 0);
+
+   MEMFreeToExpHeap(mem2, dst);
+   MEMFreeToExpHeap(mem2, src);
+   return 0;
+}
@@ -0,0 +1,115 @@
+#include <hle_test.h>
+#include <stdint.h>
+
+// Calls through several levels of functions, each doing more work after the
+// call returns, so the return addresses land in the middle of functions. Run
+// with --jit --jit-function-blocks to check calls return into the right place
+// in function-sized blocks.
+
+static const int
+Iterations = 1000;
+
+typedef uint32_t (*MixFunction)(uint32_t value, uint32_t depth);
+
+static uint32_t mixOdd(uint32_t value, uint32_t depth);
+static uint32_t mixEven(uint32_t value, uint32_t depth);
+
+static __attribute__((noinline)) uint32_t
+rotate(uint32_t value, uint32_t shift)
+{
+   return (value << shift) | (value >> (32 - shift));
+}
+
+static __attribute__((noinline)) uint32_t
+mixOdd(uint32_t value, uint32_t depth)
+{
+   uint32_t result = rotate(value, 3) ^ 0x9E3779B9;
+
+   if (depth) {
+      result += mixEven(result, depth - 1);
+   }
+
+   return result * 5;
+}
+
+static __attribute__((noinline)) uint32_t
+mixEven(uint32_t value, uint32_t depth)
+{
+   uint32_t result = rotate(value, 7) + 0x7F4A7C15;
+
+   if (depth) {
+      result ^= mixOdd(result, depth - 1);
+   }
+
+   return result + depth;
+}
+
+static MixFunction
+sMixFunctions[] = { mixOdd, mixEven };
+
+// Indirect calls go through bctrl rather than bl
+static __attribute__((noinline)) uint32_t
+mixIndirect(uint32_t value, uint32_t depth)
+{
+   volatile uint32_t index = depth & 1;
+   uint32_t result = sMixFunctions[index](value, depth);
+   result = rotate(result, 11);
+   return result ^ sMixFunctions[index ^ 1](result, depth);
+}
+
+// The same calculation written as one function, to check the results against
+static uint32_t
+rotateInline(uint32_t value, uint32_t shift)
+{
+   return (value << shift) | (value >> (32 - shift));
+}
+
+static uint32_t
+mixInline(uint32_t value, uint32_t depth, int odd)
+{
+   uint32_t result;
+
+   if (odd) {
+      result = rotateInline(value, 3) ^ 0x9E3779B9;
+
+      if (depth) {
+         result += mixInline(result, depth - 1, 0);
+      }
+
+      return result * 5;
+   }
+
+   result = rotateInline(value, 7) + 0x7F4A7C15;
+
+   if (depth) {
+      result ^= mixInline(result, depth - 1, 1);
+   }
+
+   return result + depth;
+}
+
+static uint32_t
+mixIndirectInline(uint32_t value, uint32_t depth)
+{
+   int odd = (depth & 1) == 0;
+   uint32_t result = mixInline(value, depth, odd);
+   result = rotateInline(result, 11);
+   return result ^ mixInline(result, depth, !odd);
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t value = 1;
+   uint32_t expected = 1;
+   int i;
+
+   for (i = 0; i < Iterations; ++i) {
+      uint32_t depth = i % 8;
+      value = mixIndirect(value, depth);
+      expected = mixIndirectInline(expected, depth);
+      test_assert(value == expected);
+   }
+
+   test_report("Call chain result %08x", value);
+   return 0;
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <spdlog/spdlog.h>
+#include <vector>
+#include "common/byte_swap.h"
+#include "libdecaf/src/gpu/gpu_indices.h"
+
+using gpu::IndexExpand;
+
+extern std::shared_ptr<spdlog::logger>
+gLog;
+
+using BenchClock = std::chrono::high_resolution_clock;
+
+static const uint32_t
+MaxIndexCount = 64;
+
+static const uint32_t
+GuardValue = 0xA5A5A5A5;
+
+static const IndexExpand
+Expands[] = { IndexExpand::None, IndexExpand::Quads, IndexExpand::Rects };
+
+static const char *
+expandName(IndexExpand expand)
+{
+   switch (expand) {
+   case IndexExpand::Quads:
+      return "quads";
+   case IndexExpand::Rects:
+      return "rects";
+   default:
+      return "none";
+   }
+}
+
+// What the GPU draws for each quad, written out the long way
+template<typename Type>
+static std::vector<Type>
+referenceIndices(const std::vector<Type> &src,
+                 uint32_t count,
+                 bool swap,
+                 IndexExpand expand)
+{
+   static const uint32_t quadOrder[] = { 0, 1, 2, 0, 2, 3 };
+   static const uint32_t rectOrder[] = { 0, 1, 2, 2, 1, 3 };
+   auto result = std::vector<Type> { };
+
+   auto get = [&](uint32_t i) {
+      return swap ? byte_swap(src[i]) : src[i];
+   };
+
+   if (expand == IndexExpand::None) {
+      for (auto i = 0u; i < count; ++i) {
+         result.push_back(get(i));
+      }
+   } else {
+      auto order = (expand == IndexExpand::Quads) ? quadOrder : rectOrder;
+
+      for (auto quad = 0u; quad < count / 4; ++quad) {
+         for (auto i = 0u; i < 6; ++i) {
+            result.push_back(get(quad * 4 + order[i]));
+         }
+      }
+   }
+
+   return result;
+}
+
+// Every count up to MaxIndexCount, including ones which are not whole quads,
+//  at every element offset within 16 bytes. Checks nothing is written past
+//  the converted count.
+template<typename Type>
+static int
+testConvert(const char *pathName)
+{
+   auto failures = 0;
+   auto maxOffset = 16 / sizeof(Type);
+   auto src = std::vector<Type>(MaxIndexCount + maxOffset);
+   auto dst = std::vector<Type>(MaxIndexCount * 2 + maxOffset + 1);
+
+   for (auto i = 0u; i < src.size(); ++i) {
+      src[i] = static_cast<Type>((i + 1) * 0x01030507u);
+   }
+
+   for (auto expand : Expands) {
+      for (auto swap : { false, true }) {
+         for (auto offset = 0u; offset < maxOffset; ++offset) {
+            for (auto count = 0u; count <= MaxIndexCount; ++count) {
+               auto shifted = std::vector<Type>(src.begin() + offset, src.end());
+               auto expected = referenceIndices(shifted, count, swap, expand);
+               auto converted = gpu::getConvertedIndexCount(expand, count);
+               std::fill(dst.begin(), dst.end(), static_cast<Type>(GuardValue));
+               gpu::convertIndices(dst.data() + offset, src.data() + offset, count, swap, expand);
+
+               auto ok = (converted == expected.size())
+                      && std::equal(expected.begin(), expected.end(), dst.begin() + offset)
+                      && std::all_of(dst.begin(), dst.begin() + offset,
+                                     [](Type value) { return value == static_cast<Type>(GuardValue); })
+                      && std::all_of(dst.begin() + offset + converted, dst.end(),
+                                     [](Type value) { return value == static_cast<Type>(GuardValue); });
+
+               if (!ok && failures++ < 20) {
+                  gLog->error("{}: {} bit {} indices, swap {}, count {} at offset {} wrong",
+                              pathName, sizeof(Type) * 8, expandName(expand), swap, count, offset);
+               }
+            }
+         }
+      }
+   }
+
+   return failures;
+}
+
+static int
+testGenerate()
+{
+   auto failures = 0;
+
+   for (auto expand : { IndexExpand::Quads, IndexExpand::Rects }) {
+      for (auto count = 0u; count <= MaxIndexCount; ++count) {
+         auto sequence = std::vector<uint32_t>(count);
+
+         for (auto i = 0u; i < count; ++i) {
+            sequence[i] = i;
+         }
+
+         auto expected = referenceIndices(sequence, count, false, expand);
+         auto dst = std::vector<uint32_t>(expected.size() + 1, GuardValue);
+         gpu::generateQuadIndices(dst.data(), count, expand);
+
+         if (!std::equal(expected.begin(), expected.end(), dst.begin()) || dst.back() != GuardValue) {
+            if (failures++ < 20) {
+               gLog->error("generated {} indices for count {} wrong", expandName(expand), count);
+            }
+         }
+      }
+   }
+
+   return failures;
+}
+
+// Returns the number of failed checks
+int
+testIndices(const char *pathName)
+{
+   return testConvert<uint16_t>(pathName)
+        + testConvert<uint32_t>(pathName)
+        + testGenerate();
+}
+
+// Millions of guest indices converted per second
+void
+benchmarkIndices(const char *pathName)
+{
+   static const uint32_t count = 4 * 1024 * 1024;
+   static const int iterations = 16;
+   auto src16 = std::vector<uint16_t>(count, 0x1234);
+   auto dst16 = std::vector<uint16_t>(count * 2);
+   auto src32 = std::vector<uint32_t>(count, 0x12345678);
+   auto dst32 = std::vector<uint32_t>(count * 2);
+
+   auto measure = [&](auto &dst, auto &src, IndexExpand expand) {
+      auto start = BenchClock::now();
+
+      for (auto i = 0; i < iterations; ++i) {
+         gpu::convertIndices(dst.data(), src.data(), count, true, expand);
+      }
+
+      auto elapsed = std::chrono::duration<double> { BenchClock::now() - start };
+      return static_cast<double>(count) * iterations / elapsed.count() / 1000000.0;
+   };
+
+   auto swap16 = measure(dst16, src16, IndexExpand::None);
+   auto quads16 = measure(dst16, src16, IndexExpand::Quads);
+   auto swap32 = measure(dst32, src32, IndexExpand::None);
+   auto quads32 = measure(dst32, src32, IndexExpand::Quads);
+   auto rects32 = measure(dst32, src32, IndexExpand::Rects);
+
+   gLog->info("{:>6}: indices u16 {:.0f}, u16 quads {:.0f}, u32 {:.0f}, u32 quads {:.0f}, u32 rects {:.0f} M/s",
+              pathName, swap16, quads16, swap32, quads32, rects32);
+}
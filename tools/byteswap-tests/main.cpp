@@ -0,0 +1,403 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <vector>
+#include "common/bit_cast.h"
+#include "common/byte_swap.h"
+#include "common/byte_swap_array.h"
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+int
+testIndices(const char *pathName);
+
+void
+benchmarkIndices(const char *pathName);
+
+using BenchClock = std::chrono::high_resolution_clock;
+
+static const size_t
+MaxTestCount = 300;
+
+static const size_t
+BenchSize = 16 * 1024 * 1024;
+
+static const int
+BenchIterations = 16;
+
+static const ByteSwapPath
+Paths[] = { ByteSwapPath::Scalar, ByteSwapPath::SSSE3, ByteSwapPath::AVX2 };
+
+static const QuantizedType
+QuantizedTypes[] = {
+   QuantizedType::Unsigned8,
+   QuantizedType::Unsigned16,
+   QuantizedType::Signed8,
+   QuantizedType::Signed16,
+};
+
+static int
+sFailures = 0;
+
+static const char *
+pathName(ByteSwapPath path)
+{
+   switch (path) {
+   case ByteSwapPath::SSSE3:
+      return "SSSE3";
+   case ByteSwapPath::AVX2:
+      return "AVX2";
+   default:
+      return "scalar";
+   }
+}
+
+static const char *
+typeName(QuantizedType type)
+{
+   switch (type) {
+   case QuantizedType::Unsigned8:
+      return "u8";
+   case QuantizedType::Unsigned16:
+      return "u16";
+   case QuantizedType::Signed8:
+      return "s8";
+   case QuantizedType::Signed16:
+      return "s16";
+   default:
+      return "float";
+   }
+}
+
+static size_t
+typeSize(QuantizedType type)
+{
+   switch (type) {
+   case QuantizedType::Unsigned8:
+   case QuantizedType::Signed8:
+      return 1;
+   case QuantizedType::Unsigned16:
+   case QuantizedType::Signed16:
+      return 2;
+   default:
+      return 4;
+   }
+}
+
+// Reads a big endian quantized value the way psq_l does
+static float
+dequantizeReference(const uint8_t *src,
+                    QuantizedType type,
+                    uint32_t scale)
+{
+   auto exp = static_cast<int>(scale & 0x3F);
+   exp -= (exp & 32) << 1;
+   auto value = 0.0f;
+
+   switch (type) {
+   case QuantizedType::Unsigned8:
+      value = static_cast<float>(src[0]);
+      break;
+   case QuantizedType::Signed8:
+      value = static_cast<float>(static_cast<int8_t>(src[0]));
+      break;
+   case QuantizedType::Unsigned16:
+      value = static_cast<float>((src[0] << 8) | src[1]);
+      break;
+   case QuantizedType::Signed16:
+      value = static_cast<float>(static_cast<int16_t>((src[0] << 8) | src[1]));
+      break;
+   default:
+      break;
+   }
+
+   return std::ldexp(value, -exp);
+}
+
+static bool
+sameBits(float a, float b)
+{
+   return bit_cast<uint32_t>(a) == bit_cast<uint32_t>(b);
+}
+
+static void
+fail(const std::string &message)
+{
+   // Don't flood the log when a whole path is broken
+   if (sFailures++ < 20) {
+      gLog->error("{}", message);
+   }
+}
+
+// Every size up to MaxTestCount at every element offset within 32 bytes, both
+//  copying and in place, checked against byte_swap one element at a time
+template<typename Type>
+static void
+testSwap(ByteSwapPath path)
+{
+   auto maxOffset = 32 / sizeof(Type);
+   auto src = std::vector<Type>(MaxTestCount + maxOffset);
+   auto dst = std::vector<Type>(MaxTestCount + maxOffset + 1);
+
+   for (auto i = 0u; i < src.size(); ++i) {
+      auto value = static_cast<uint64_t>(i + 1) * 0x0102030405060708ull;
+      src[i] = static_cast<Type>(value ^ (value >> 29));
+   }
+
+   for (auto offset = size_t { 0 }; offset < maxOffset; ++offset) {
+      for (auto count = size_t { 0 }; count <= MaxTestCount; ++count) {
+         std::fill(dst.begin(), dst.end(), static_cast<Type>(0x5A5A5A5A5A5A5A5Aull));
+         byte_swap_copy(dst.data() + offset, src.data() + offset, count);
+
+         for (auto i = size_t { 0 }; i < dst.size(); ++i) {
+            auto inside = i >= offset && i < offset + count;
+            auto expected = inside ? byte_swap(src[i]) : static_cast<Type>(0x5A5A5A5A5A5A5A5Aull);
+
+            if (dst[i] != expected) {
+               fail(fmt::format("{}: {} bit swap copy of {} at offset {} wrong at {}",
+                                pathName(path), sizeof(Type) * 8, count, offset, i));
+               break;
+            }
+         }
+
+         std::copy(src.begin(), src.end(), dst.begin());
+         byte_swap_inplace(dst.data() + offset, count);
+
+         for (auto i = size_t { 0 }; i < src.size(); ++i) {
+            auto inside = i >= offset && i < offset + count;
+            auto expected = inside ? byte_swap(src[i]) : src[i];
+
+            if (dst[i] != expected) {
+               fail(fmt::format("{}: {} bit swap in place of {} at offset {} wrong at {}",
+                                pathName(path), sizeof(Type) * 8, count, offset, i));
+               break;
+            }
+         }
+      }
+   }
+}
+
+// Every half value, against the scalar conversion and a few known values
+static void
+testHalf(ByteSwapPath path,
+         const std::vector<float> &reference)
+{
+   auto src = std::vector<uint16_t>(0x10000 + 16);
+   auto dst = std::vector<float>(src.size());
+
+   for (auto offset = 0u; offset < 16; ++offset) {
+      for (auto i = 0u; i < 0x10000; ++i) {
+         src[offset + i] = byte_swap(static_cast<uint16_t>(i));
+      }
+
+      byte_swap_half_to_float(dst.data() + offset, src.data() + offset, 0x10000);
+
+      for (auto i = 0u; i < 0x10000; ++i) {
+         if (!sameBits(dst[offset + i], reference[i])) {
+            fail(fmt::format("{}: half {:04x} at offset {} gave {:08x}, expected {:08x}",
+                             pathName(path), i, offset,
+                             bit_cast<uint32_t>(dst[offset + i]), bit_cast<uint32_t>(reference[i])));
+            break;
+         }
+      }
+   }
+}
+
+// Every value of every type at every scale, against psq_l's definition
+static void
+testDequantize(ByteSwapPath path)
+{
+   for (auto type : QuantizedTypes) {
+      auto size = typeSize(type);
+      auto count = size_t { 1 } << (size * 8);
+      auto src = std::vector<uint8_t>((count + 16) * size);
+      auto dst = std::vector<float>(count + 16);
+
+      for (auto offset = 0u; offset < 16; offset += 3) {
+         for (auto i = size_t { 0 }; i < count; ++i) {
+            auto bytes = src.data() + (offset + i) * size;
+
+            if (size == 1) {
+               bytes[0] = static_cast<uint8_t>(i);
+            } else {
+               bytes[0] = static_cast<uint8_t>(i >> 8);
+               bytes[1] = static_cast<uint8_t>(i);
+            }
+         }
+
+         for (auto scale = 0u; scale < 64; ++scale) {
+            byte_swap_dequantize(dst.data() + offset, src.data() + offset * size, type, scale, count);
+
+            for (auto i = size_t { 0 }; i < count; ++i) {
+               auto expected = dequantizeReference(src.data() + (offset + i) * size, type, scale);
+
+               if (!sameBits(dst[offset + i], expected)) {
+                  fail(fmt::format("{}: {} value {:x} scale {} at offset {} gave {}, expected {}",
+                                   pathName(path), typeName(type), i, scale, offset,
+                                   dst[offset + i], expected));
+                  break;
+               }
+            }
+         }
+      }
+   }
+
+   // Floating is a plain 32 bit swap
+   auto src = std::vector<uint32_t> { 0x0000803F, 0x000000C0, 0x0000807F };
+   auto dst = std::vector<float>(src.size());
+   byte_swap_dequantize(dst.data(), src.data(), QuantizedType::Floating, 5, src.size());
+
+   if (dst[0] != 1.0f || dst[1] != -2.0f || !std::isinf(dst[2])) {
+      fail(fmt::format("{}: floating dequantize wrong", pathName(path)));
+   }
+}
+
+// Known values to make sure the scalar conversion is itself right
+static void
+checkHalfReference(const std::vector<float> &reference)
+{
+   struct KnownHalf
+   {
+      uint16_t half;
+      float value;
+   };
+
+   static const KnownHalf known[] = {
+      { 0x0000, 0.0f },
+      { 0x3C00, 1.0f },
+      { 0xC000, -2.0f },
+      { 0x3555, 0.333251953125f },
+      { 0x7BFF, 65504.0f },
+      { 0x0001, 5.9604644775390625e-8f },
+      { 0x03FF, 6.0975551605224609e-5f },
+      { 0x0400, 6.103515625e-5f },
+   };
+
+   for (auto &test : known) {
+      if (!sameBits(reference[test.half], test.value)) {
+         fail(fmt::format("scalar: half {:04x} gave {}, expected {}", test.half, reference[test.half], test.value));
+      }
+   }
+
+   if (!sameBits(reference[0x8000], -0.0f)) {
+      fail("scalar: half 8000 is not -0");
+   }
+
+   if (!std::isinf(reference[0x7C00]) || !std::isinf(reference[0xFC00]) || reference[0xFC00] > 0.0f) {
+      fail("scalar: half infinities wrong");
+   }
+
+   // Signalling NaNs come out quiet, the same as F16C
+   if (bit_cast<uint32_t>(reference[0x7C01]) != 0x7FC02000) {
+      fail(fmt::format("scalar: half 7c01 gave {:08x}", bit_cast<uint32_t>(reference[0x7C01])));
+   }
+}
+
+template<typename Function>
+static double
+measure(Function function)
+{
+   auto start = BenchClock::now();
+
+   for (auto i = 0; i < BenchIterations; ++i) {
+      function();
+   }
+
+   auto elapsed = std::chrono::duration<double> { BenchClock::now() - start };
+   return static_cast<double>(BenchSize) * BenchIterations / elapsed.count() / (1024.0 * 1024.0 * 1024.0);
+}
+
+// Throughput in GiB/s of source data for each routine
+static void
+benchmark(ByteSwapPath path)
+{
+   auto src = std::vector<uint32_t>(BenchSize / 4, 0x12345678);
+   auto dst = std::vector<uint32_t>(BenchSize / 4);
+   auto floats = std::vector<float>(BenchSize);
+   auto src16 = reinterpret_cast<const uint16_t *>(src.data());
+   auto src64 = reinterpret_cast<const uint64_t *>(src.data());
+   auto dst16 = reinterpret_cast<uint16_t *>(dst.data());
+   auto dst64 = reinterpret_cast<uint64_t *>(dst.data());
+
+   auto swap16 = measure([&]() { byte_swap_copy(dst16, src16, BenchSize / 2); });
+   auto swap32 = measure([&]() { byte_swap_copy(dst.data(), src.data(), BenchSize / 4); });
+   auto swap64 = measure([&]() { byte_swap_copy(dst64, src64, BenchSize / 8); });
+   auto inplace = measure([&]() { byte_swap_inplace(dst.data(), BenchSize / 4); });
+   auto half = measure([&]() { byte_swap_half_to_float(floats.data(), src16, BenchSize / 2); });
+   auto u8 = measure([&]() { byte_swap_dequantize(floats.data(), src.data(), QuantizedType::Unsigned8, 3, BenchSize); });
+   auto s16 = measure([&]() { byte_swap_dequantize(floats.data(), src.data(), QuantizedType::Signed16, 3, BenchSize / 2); });
+
+   gLog->info("{:>6}: swap16 {:.2f}, swap32 {:.2f}, swap64 {:.2f}, in place {:.2f}, half {:.2f}, u8 {:.2f}, s16 {:.2f} GiB/s",
+              pathName(path), swap16, swap32, swap64, inplace, half, u8, s16);
+}
+
+// The loop byte_swap_copy replaced, for comparison
+static void
+benchmarkLoop()
+{
+   auto src = std::vector<uint32_t>(BenchSize / 4, 0x12345678);
+   auto dst = std::vector<uint32_t>(BenchSize / 4);
+
+   auto swap32 = measure([&]() {
+      for (auto i = size_t { 0 }; i < src.size(); ++i) {
+         dst[i] = byte_swap(src[i]);
+      }
+   });
+
+   gLog->info("{:>6}: swap32 {:.2f} GiB/s", "loop", swap32);
+}
+
+int main(int argc, char *argv[])
+{
+   gLog = std::make_shared<spdlog::logger>("logger", std::make_shared<spdlog::sinks::stdout_sink_st>());
+   gLog->set_level(spdlog::level::debug);
+
+   auto runBenchmark = argc > 1 && std::strcmp(argv[1], "--bench") == 0;
+   auto halfReference = std::vector<float>(0x10000);
+   auto halfSource = std::vector<uint16_t>(0x10000);
+
+   for (auto i = 0u; i < 0x10000; ++i) {
+      halfSource[i] = byte_swap(static_cast<uint16_t>(i));
+   }
+
+   byte_swap_set_max_path(ByteSwapPath::Scalar);
+   byte_swap_half_to_float(halfReference.data(), halfSource.data(), halfSource.size());
+   checkHalfReference(halfReference);
+
+   for (auto path : Paths) {
+      if (byte_swap_set_max_path(path) != path) {
+         gLog->info("{}: not supported on this host", pathName(path));
+         continue;
+      }
+
+      auto failures = sFailures;
+      testSwap<uint16_t>(path);
+      testSwap<uint32_t>(path);
+      testSwap<uint64_t>(path);
+      testHalf(path, halfReference);
+      testDequantize(path);
+      sFailures += testIndices(pathName(path));
+      gLog->info("{}: {}", pathName(path), (failures == sFailures) ? "passed" : "FAILED");
+
+      if (runBenchmark) {
+         benchmark(path);
+         benchmarkIndices(pathName(path));
+      }
+   }
+
+   if (runBenchmark) {
+      benchmarkLoop();
+   }
+
+   if (sFailures) {
+      gLog->error("{} checks failed", sFailures);
+      return 1;
+   }
+
+   return 0;
+}
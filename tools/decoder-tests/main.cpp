@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+#include "common/byte_swap.h"
+#include "libcpu/espresso/espresso_instructionset.h"
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+using DecodeClock = std::chrono::high_resolution_clock;
+
+static const uint32_t SHF_EXECINSTR = 0x4;
+static const uint32_t SHF_DEFLATED = 0x08000000;
+
+// Compares the flat decode table against the reference decode tree for
+// every possible 32 bit instruction word.
+static bool
+testEquivalence()
+{
+   auto numThreads = std::max(1u, std::thread::hardware_concurrency());
+   auto stride = static_cast<uint64_t>(0x100000000ull / numThreads);
+   std::atomic<uint64_t> mismatches { 0 };
+   auto threads = std::vector<std::thread> { };
+   auto start = DecodeClock::now();
+
+   for (auto i = 0u; i < numThreads; ++i) {
+      auto first = i * stride;
+      auto last = (i + 1 == numThreads) ? 0x100000000ull : first + stride;
+
+      threads.emplace_back([first, last, &mismatches]() {
+         for (auto value = first; value < last; ++value) {
+            auto instr = espresso::Instruction { static_cast<uint32_t>(value) };
+            auto flat = espresso::decodeInstruction(instr);
+            auto tree = espresso::decodeInstructionTree(instr);
+
+            if (flat != tree) {
+               if (mismatches++ < 16) {
+                  gLog->error("Decoder mismatch for {:08X}: flat {} tree {}",
+                              instr.value,
+                              flat ? flat->name : "<invalid>",
+                              tree ? tree->name : "<invalid>");
+               }
+            }
+         }
+      });
+   }
+
+   for (auto &thread : threads) {
+      thread.join();
+   }
+
+   auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(DecodeClock::now() - start).count();
+   gLog->info("Compared all 2^32 instructions in {}ms, {} mismatches", elapsed, mismatches.load());
+   return mismatches == 0;
+}
+
+template<typename Type>
+static Type
+readBigEndian(const std::vector<uint8_t> &data,
+              size_t offset)
+{
+   auto value = Type { };
+
+   if (offset + sizeof(Type) <= data.size()) {
+      std::memcpy(&value, data.data() + offset, sizeof(Type));
+   }
+
+   return byte_swap(value);
+}
+
+// Reads the executable sections of an RPX / RPL as host endian words.
+static bool
+readCodeSections(const std::string &path,
+                 std::vector<uint32_t> &code)
+{
+   std::ifstream file { path, std::ifstream::binary };
+
+   if (!file.is_open()) {
+      gLog->error("Could not open {}", path);
+      return false;
+   }
+
+   auto data = std::vector<uint8_t> { std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> { } };
+
+   if (data.size() < 0x34 || readBigEndian<uint32_t>(data, 0) != 0x7F454C46) {
+      gLog->error("{} is not an ELF file", path);
+      return false;
+   }
+
+   auto shoff = readBigEndian<uint32_t>(data, 0x20);
+   auto shentsize = readBigEndian<uint16_t>(data, 0x2E);
+   auto shnum = readBigEndian<uint16_t>(data, 0x30);
+
+   for (auto i = 0u; i < shnum; ++i) {
+      auto header = shoff + i * shentsize;
+      auto flags = readBigEndian<uint32_t>(data, header + 0x08);
+      auto offset = readBigEndian<uint32_t>(data, header + 0x10);
+      auto size = readBigEndian<uint32_t>(data, header + 0x14);
+
+      if (!(flags & SHF_EXECINSTR) || offset + size > data.size()) {
+         continue;
+      }
+
+      auto section = std::vector<uint8_t> { };
+
+      if (flags & SHF_DEFLATED) {
+         section.resize(readBigEndian<uint32_t>(data, offset));
+         auto inflatedSize = static_cast<uLongf>(section.size());
+
+         if (uncompress(section.data(), &inflatedSize, data.data() + offset + 4, size - 4) != Z_OK) {
+            gLog->error("Could not inflate section {} of {}", i, path);
+            return false;
+         }
+      } else {
+         section.assign(data.begin() + offset, data.begin() + offset + size);
+      }
+
+      for (auto j = 0u; j + 4 <= section.size(); j += 4) {
+         code.push_back(readBigEndian<uint32_t>(section, j));
+      }
+   }
+
+   return true;
+}
+
+template<typename DecodeFn>
+static double
+benchmarkDecoder(const std::vector<uint32_t> &code,
+                 DecodeFn decode)
+{
+   static const auto Target = size_t { 100000000 };
+   auto passes = std::max<size_t>(1, Target / code.size());
+   auto valid = size_t { 0 };
+   auto start = DecodeClock::now();
+
+   for (auto pass = 0u; pass < passes; ++pass) {
+      for (auto value : code) {
+         if (decode(espresso::Instruction { value })) {
+            ++valid;
+         }
+      }
+   }
+
+   auto elapsed = std::chrono::duration<double>(DecodeClock::now() - start).count();
+   gLog->debug("Decoded {} valid instructions", valid);
+   return (passes * code.size()) / elapsed / 1000000.0;
+}
+
+static bool
+benchmarkDecoders(const std::string &path)
+{
+   auto code = std::vector<uint32_t> { };
+
+   if (!readCodeSections(path, code)) {
+      return false;
+   }
+
+   if (code.empty()) {
+      gLog->error("{} has no executable sections", path);
+      return false;
+   }
+
+   gLog->info("Benchmarking with {} instructions from {}", code.size(), path);
+
+   auto tree = benchmarkDecoder(code, espresso::decodeInstructionTree);
+   auto flat = benchmarkDecoder(code, espresso::decodeInstruction);
+   gLog->info("Decode tree: {:.1f}M instructions/s", tree);
+   gLog->info("Flat table: {:.1f}M instructions/s ({:.2f}x)", flat, flat / tree);
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   gLog = std::make_shared<spdlog::logger>("logger", std::make_shared<spdlog::sinks::stdout_sink_st>());
+   gLog->set_level(spdlog::level::debug);
+
+   espresso::initialiseInstructionSet();
+
+   auto result = testEquivalence();
+
+   // Optionally time both decoders over the code of a real title
+   for (auto i = 1; i < argc; ++i) {
+      result = benchmarkDecoders(argv[i]) && result;
+   }
+
+   return result ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <string>
+#include "common/platform_memory.h"
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+using BenchClock = std::chrono::high_resolution_clock;
+
+// Same alignment guest memory gets from mem::initialise
+static const size_t
+RegionAlignment = 1ull << 32;
+
+static const size_t
+Accesses = 32 * 1024 * 1024;
+
+enum class Backing
+{
+   Normal,
+   Transparent,
+   Explicit,
+};
+
+static const char *
+backingName(Backing backing)
+{
+   switch (backing) {
+   case Backing::Transparent:
+      return "transparent huge pages";
+   case Backing::Explicit:
+      return "explicit huge pages";
+   default:
+      return "normal pages";
+   }
+}
+
+// Reserves and commits size bytes the same way guest memory is, returns 0 if
+//  the backing is not available
+static size_t
+mapRegion(size_t size,
+          Backing backing)
+{
+   for (auto n = 33; n < 46; ++n) {
+      auto base = static_cast<size_t>(1ull << n);
+
+      if (base % RegionAlignment || !platform::reserveMemory(base, size)) {
+         continue;
+      }
+
+      auto committed = false;
+
+      if (backing == Backing::Explicit) {
+         committed = platform::commitHugeMemory(base, size);
+      } else if (platform::commitMemory(base, size)) {
+         committed = backing == Backing::Normal || platform::adviseHugePages(base, size);
+      }
+
+      if (!committed) {
+         platform::freeMemory(base, size);
+         return 0;
+      }
+
+      return base;
+   }
+
+   return 0;
+}
+
+// Links every 64 byte line of the region into one random cycle, so each load
+//  depends on the last one like a chain of guest pointer loads.
+static void
+buildChain(uint8_t *data,
+           size_t size)
+{
+   auto lines = size / 64;
+   auto order = std::unique_ptr<uint32_t[]> { new uint32_t[lines] };
+   auto random = std::mt19937 { 1234 };
+
+   for (auto i = 0u; i < lines; ++i) {
+      order[i] = i;
+   }
+
+   // Sattolo's algorithm gives a single cycle through every line
+   for (auto i = lines - 1; i > 0; --i) {
+      auto j = std::uniform_int_distribution<size_t> { 0, i - 1 }(random);
+      std::swap(order[i], order[j]);
+   }
+
+   for (auto i = 0u; i < lines; ++i) {
+      auto next = order[(i + 1) % lines];
+      *reinterpret_cast<uint64_t *>(data + order[i] * 64ull) = next * 64ull;
+   }
+}
+
+// Returns the average nanoseconds per dependent load
+static double
+chaseChain(const uint8_t *data)
+{
+   auto offset = uint64_t { 0 };
+   auto start = BenchClock::now();
+
+   for (auto i = 0u; i < Accesses; ++i) {
+      offset = *reinterpret_cast<const uint64_t *>(data + offset);
+   }
+
+   auto elapsed = std::chrono::duration<double, std::nano> { BenchClock::now() - start };
+
+   // Stop the loop being optimised away
+   if (offset == 1) {
+      gLog->info("");
+   }
+
+   return elapsed.count() / Accesses;
+}
+
+// Returns the average nanoseconds per independent random 32 bit load, which
+//  is closer to what a JIT block of scattered loads does.
+static double
+randomLoads(const uint8_t *data,
+            size_t size)
+{
+   auto mask = size - 1;
+   auto state = uint64_t { 0x9E3779B97F4A7C15ull };
+   auto sum = uint32_t { 0 };
+   auto start = BenchClock::now();
+
+   for (auto i = 0u; i < Accesses; ++i) {
+      state = state * 6364136223846793005ull + 1442695040888963407ull;
+      sum += *reinterpret_cast<const uint32_t *>(data + ((state >> 20) & mask & ~3ull));
+   }
+
+   auto elapsed = std::chrono::duration<double, std::nano> { BenchClock::now() - start };
+
+   if (sum == 1) {
+      gLog->info("");
+   }
+
+   return elapsed.count() / Accesses;
+}
+
+int main(int argc, char *argv[])
+{
+   gLog = std::make_shared<spdlog::logger>("logger", std::make_shared<spdlog::sinks::stdout_sink_st>());
+   gLog->set_level(spdlog::level::debug);
+
+   // Defaults to the size of MEM2, must be a power of two
+   auto sizeMb = size_t { 1024 };
+
+   if (argc > 1) {
+      sizeMb = std::strtoull(argv[1], nullptr, 0);
+   }
+
+   auto size = sizeMb * 1024 * 1024;
+
+   if (!size || (size & (size - 1))) {
+      gLog->info("Usage: {} [size in MiB, a power of two]", argv[0]);
+      return 1;
+   }
+
+   gLog->info("Random access over {} MiB, huge page size {} KiB", sizeMb, platform::getHugePageSize() / 1024);
+   auto baseChase = 0.0;
+   auto baseLoads = 0.0;
+
+   for (auto backing : { Backing::Normal, Backing::Transparent, Backing::Explicit }) {
+      auto base = mapRegion(size, backing);
+
+      if (!base) {
+         gLog->info("{}: not available", backingName(backing));
+         continue;
+      }
+
+      auto data = reinterpret_cast<uint8_t *>(base);
+      buildChain(data, size);
+
+      auto chase = chaseChain(data);
+      auto loads = randomLoads(data, size);
+
+      if (backing == Backing::Normal) {
+         baseChase = chase;
+         baseLoads = loads;
+      }
+
+      gLog->info("{}: dependent loads {:.1f} ns ({:.2f}x), random loads {:.1f} ns ({:.2f}x)",
+                 backingName(backing),
+                 chase, baseChase / chase,
+                 loads, baseLoads / loads);
+
+      platform::freeMemory(base, size);
+   }
+
+   return 0;
+}
@@ -0,0 +1,155 @@
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "common/checksum.h"
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+using BenchClock = std::chrono::high_resolution_clock;
+
+// Each measurement is repeated until it has processed at least this much
+static const size_t
+TargetBytes = 256 * 1024 * 1024;
+
+static bool
+isZlibStream(const std::vector<uint8_t> &data)
+{
+   if (data.size() < 2) {
+      return false;
+   }
+
+   auto gzip = data[0] == 0x1F && data[1] == 0x8B;
+   auto zlib = (data[0] & 0x0F) == Z_DEFLATED && ((data[0] << 8) | data[1]) % 31 == 0;
+   return gzip || zlib;
+}
+
+// Inflates a whole zlib or gzip stream, returns false on any error
+static bool
+inflateAll(const std::vector<uint8_t> &input,
+           std::vector<uint8_t> &output)
+{
+   z_stream stream = { };
+
+   // 15 + 32 detects zlib and gzip headers
+   if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+      return false;
+   }
+
+   auto result = Z_OK;
+   output.resize(std::max<size_t>(input.size() * 4, 4096));
+   stream.next_in = const_cast<Bytef *>(input.data());
+   stream.avail_in = static_cast<uInt>(input.size());
+
+   while (result == Z_OK) {
+      if (stream.total_out == output.size()) {
+         output.resize(output.size() * 2);
+      }
+
+      stream.next_out = output.data() + stream.total_out;
+      stream.avail_out = static_cast<uInt>(output.size() - stream.total_out);
+      result = inflate(&stream, Z_NO_FLUSH);
+   }
+
+   output.resize(stream.total_out);
+   inflateEnd(&stream);
+   return result == Z_STREAM_END;
+}
+
+template<typename Function>
+static double
+measure(size_t bytesPerPass,
+        Function func)
+{
+   auto passes = std::max<size_t>(1, TargetBytes / std::max<size_t>(1, bytesPerPass));
+   auto start = BenchClock::now();
+
+   for (auto i = 0u; i < passes; ++i) {
+      func();
+   }
+
+   auto elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+   return (passes * bytesPerPass) / elapsed / (1024.0 * 1024.0);
+}
+
+static bool
+benchmarkFile(const std::string &path)
+{
+   std::ifstream file { path, std::ifstream::binary };
+
+   if (!file.is_open()) {
+      gLog->error("Could not open {}", path);
+      return false;
+   }
+
+   auto data = std::vector<uint8_t> { std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> { } };
+   auto compressed = std::vector<uint8_t> { };
+   auto plain = std::vector<uint8_t> { };
+
+   if (isZlibStream(data) && inflateAll(data, plain)) {
+      compressed = std::move(data);
+   } else {
+      // Not compressed already, use the default level like most games do
+      auto size = compressBound(static_cast<uLong>(data.size()));
+      compressed.resize(size);
+
+      if (compress(compressed.data(), &size, data.data(), static_cast<uLong>(data.size())) != Z_OK) {
+         gLog->error("Could not compress {}", path);
+         return false;
+      }
+
+      compressed.resize(size);
+      plain = std::move(data);
+   }
+
+   gLog->info("{}: {} bytes compressed, {} bytes inflated", path, compressed.size(), plain.size());
+
+   auto output = std::vector<uint8_t> { };
+   auto inflateRate = measure(plain.size(), [&]() { inflateAll(compressed, output); });
+   gLog->info("  inflate: {:.0f} MiB/s", inflateRate);
+
+   auto crcZlib = measure(plain.size(), [&]() { crc32(0, plain.data(), static_cast<uInt>(plain.size())); });
+   auto crcSimd = measure(plain.size(), [&]() { checksum_crc32(0, plain.data(), plain.size()); });
+   gLog->info("  crc32: zlib {:.0f} MiB/s, checksum_crc32 {:.0f} MiB/s", crcZlib, crcSimd);
+
+   auto adlerZlib = measure(plain.size(), [&]() { adler32(1, plain.data(), static_cast<uInt>(plain.size())); });
+   auto adlerSimd = measure(plain.size(), [&]() { checksum_adler32(1, plain.data(), plain.size()); });
+   gLog->info("  adler32: zlib {:.0f} MiB/s, checksum_adler32 {:.0f} MiB/s", adlerZlib, adlerSimd);
+
+   // Make sure the fast paths agree with zlib on real data
+   auto size = static_cast<uInt>(plain.size());
+
+   if (checksum_crc32(0, plain.data(), plain.size()) != crc32(0, plain.data(), size)
+    || checksum_adler32(1, plain.data(), plain.size()) != adler32(1, plain.data(), size)) {
+      gLog->error("  checksum mismatch against zlib!");
+      return false;
+   }
+
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   gLog = std::make_shared<spdlog::logger>("logger", std::make_shared<spdlog::sinks::stdout_sink_st>());
+   gLog->set_level(spdlog::level::debug);
+
+   if (argc < 2) {
+      gLog->info("Usage: {} <file>...", argv[0]);
+      gLog->info("zlib and gzip streams are inflated directly, other files are compressed first.");
+      return 1;
+   }
+
+   auto result = true;
+
+   for (auto i = 1; i < argc; ++i) {
+      result = benchmarkFile(argv[i]) && result;
+   }
+
+   return result ? 0 : 1;
+}